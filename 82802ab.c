@@ -123,12 +123,61 @@ int erase_block_82802ab(struct flashctx *flash, unsigned int page,
 	return 0;
 }
 
+/*
+ * Program up to BURST_CHUNK bytes per master transaction, waiting the maximum
+ * byte program time (tBP) instead of polling the status register, then return
+ * to read array mode and check the chunk. Bytes which did not make it are
+ * programmed again the slow way.
+ */
+static int write_burst_82802ab(struct flashctx *flash, const uint8_t *src, unsigned int start,
+			       unsigned int len)
+{
+	struct par_burst_op ops[2 * BURST_CHUNK + 1];
+	uint8_t readback[BURST_CHUNK];
+	chipaddr bios = flash->virtual_memory;
+	chipaddr dst;
+	unsigned int i, j, n, count;
+
+	for (i = 0; i < len; i += n) {
+		n = min(len - i, BURST_CHUNK);
+		count = 0;
+		for (j = 0; j < n; j++) {
+			if (src[i + j] == 0xFF)
+				continue;
+			dst = bios + start + i + j;
+			ops[count++] = (struct par_burst_op){ dst, 0x40, 0 };
+			ops[count++] = (struct par_burst_op){ dst, src[i + j], flash->chip->byte_program_time };
+		}
+		if (!count)
+			continue;
+		/* Leave status read mode. */
+		ops[count++] = (struct par_burst_op){ bios, 0xFF, 0 };
+		if (chip_write_burst(flash, ops, count))
+			return 1;
+
+		chip_readn(flash, readback, bios + start + i, n);
+		for (j = 0; j < n; j++) {
+			if (src[i + j] == 0xFF || readback[j] == src[i + j])
+				continue;
+			dst = bios + start + i + j;
+			chip_writeb(flash, 0x40, dst);
+			chip_writeb(flash, src[i + j], dst);
+			wait_82802ab(flash);
+		}
+	}
+
+	return 0;
+}
+
 /* chunksize is 1 */
 int write_82802ab(struct flashctx *flash, const uint8_t *src, unsigned int start, unsigned int len)
 {
 	unsigned int i;
 	chipaddr dst = flash->virtual_memory + start;
 
+	if (flash->chip->byte_program_time && chip_has_write_burst(flash))
+		return write_burst_82802ab(flash, src, start, len);
+
 	for (i = 0; i < len; i++) {
 		/* transfer data from source to destination */
 		chip_writeb(flash, 0x40, dst);
@@ -0,0 +1,330 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "flash.h"
+#include "digest.h"
+#include "backup.h"
+#if IS_WINDOWS
+#include <io.h>
+#endif
+
+#define BACKUP_MAGIC	"flashrom-backup 1"
+#define SHA256_HEX_SIZE	(2 * SHA256_DIGEST_SIZE + 1)
+
+#ifndef __LIBPAYLOAD__
+static void sha256_hex(const uint8_t *buf, size_t len, char hex[SHA256_HEX_SIZE])
+{
+	struct sha256_state s;
+	uint8_t digest[SHA256_DIGEST_SIZE];
+	unsigned int i;
+
+	sha256_init(&s);
+	sha256_update(&s, buf, len);
+	sha256_final(&s, digest);
+	for (i = 0; i < SHA256_DIGEST_SIZE; i++)
+		sprintf(hex + 2 * i, "%02x", digest[i]);
+}
+
+static int make_dir(const char *path)
+{
+#if IS_WINDOWS
+	if (mkdir(path) && errno != EEXIST) {
+#else
+	if (mkdir(path, 0777) && errno != EEXIST) {
+#endif
+		msg_gerr("Error: creating directory \"%s\" failed: %s\n", path, strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+/* Returns the chunk directory, by default "chunks" next to the manifest. Free the result. */
+static char *get_chunk_dir(const char *manifest, const char *chunk_dir)
+{
+	const char *const slash = strrchr(manifest, '/');
+	const size_t dirlen = slash ? (size_t)(slash - manifest + 1) : 0;
+	char *dir;
+
+	if (chunk_dir)
+		return strdup(chunk_dir);
+	dir = malloc(dirlen + sizeof("chunks"));
+	if (!dir)
+		return NULL;
+	memcpy(dir, manifest, dirlen);
+	strcpy(dir + dirlen, "chunks");
+	return dir;
+}
+
+/* Returns "<dir>/<first two digits of hex>/<hex><suffix>". Free the result. */
+static char *chunk_path(const char *dir, const char *hex, const char *suffix)
+{
+	const size_t len = strlen(dir) + 1 + 2 + 1 + strlen(hex) + strlen(suffix) + 1;
+	char *const path = malloc(len);
+
+	if (path)
+		snprintf(path, len, "%s/%.2s/%s%s", dir, hex, hex, suffix);
+	return path;
+}
+
+/*
+ * Stores a chunk unless a chunk of the same content is already there. Concurrent
+ * backups into the same store each write their own temporary file, the rename
+ * makes the complete chunk appear at once.
+ */
+static int store_chunk(const char *dir, const char *hex, const uint8_t *buf, size_t len, bool *stored)
+{
+	char *const path = chunk_path(dir, hex, "");
+	char *const tmp = chunk_path(dir, hex, ".XXXXXX");
+	struct stat st;
+	FILE *f = NULL;
+	int fd, ret = 1;
+
+	*stored = false;
+	if (!path || !tmp) {
+		msg_gerr("Out of memory!\n");
+		goto _free_ret;
+	}
+	if (!stat(path, &st)) {
+		ret = 0;
+		goto _free_ret;
+	}
+
+	/* Create the fan-out directory "<dir>/xx" by cutting the temporary path short. */
+	tmp[strlen(dir) + 3] = '\0';
+	if (make_dir(tmp))
+		goto _free_ret;
+	tmp[strlen(dir) + 3] = '/';
+
+	fd = mkstemp(tmp);
+	if (fd < 0 || (f = fdopen(fd, "wb")) == NULL) {
+		msg_gerr("Error: creating a temporary file in \"%s\" failed: %s\n", dir, strerror(errno));
+		if (fd >= 0) {
+			close(fd);
+			goto _remove_ret;
+		}
+		goto _free_ret;
+	}
+	if (fwrite(buf, 1, len, f) != len) {
+		msg_gerr("Error: file %s could not be written completely.\n", tmp);
+		(void)fclose(f);
+		goto _remove_ret;
+	}
+	if (fclose(f)) {
+		msg_gerr("Error: writing file \"%s\" failed: %s\n", tmp, strerror(errno));
+		goto _remove_ret;
+	}
+	if (rename(tmp, path)) {
+		/* Another backup may have stored the same chunk in the meantime. */
+		if (!stat(path, &st)) {
+			(void)remove(tmp);
+			ret = 0;
+			goto _free_ret;
+		}
+		msg_gerr("Error: renaming \"%s\" failed: %s\n", tmp, strerror(errno));
+		goto _remove_ret;
+	}
+	*stored = true;
+	ret = 0;
+	goto _free_ret;
+
+_remove_ret:
+	(void)remove(tmp);
+_free_ret:
+	free(tmp);
+	free(path);
+	return ret;
+}
+
+static int load_chunk(const char *dir, const char *hex, uint8_t *buf, size_t len)
+{
+	char *const path = chunk_path(dir, hex, "");
+	char check[SHA256_HEX_SIZE];
+	FILE *f;
+	int ret = 1;
+
+	if (!path) {
+		msg_gerr("Out of memory!\n");
+		return 1;
+	}
+	if ((f = fopen(path, "rb")) == NULL) {
+		msg_gerr("Error: opening chunk \"%s\" failed: %s\n", path, strerror(errno));
+		goto _free_ret;
+	}
+	if (fread(buf, 1, len, f) != len || fgetc(f) != EOF) {
+		msg_gerr("Error: Chunk \"%s\" doesn't have the expected size of %zu B.\n", path, len);
+		goto _close_ret;
+	}
+	sha256_hex(buf, len, check);
+	if (strcmp(check, hex)) {
+		msg_gerr("Error: Chunk \"%s\" is corrupt.\n", path);
+		goto _close_ret;
+	}
+	ret = 0;
+_close_ret:
+	(void)fclose(f);
+_free_ret:
+	free(path);
+	return ret;
+}
+#endif
+
+int backup_save(const uint8_t *buf, chipsize_t size, const char *chip_name,
+		const char *manifest, const char *chunk_dir)
+{
+#ifdef __LIBPAYLOAD__
+	msg_gerr("Error: No file I/O support in libpayload\n");
+	return 1;
+#else
+	char *const dir = get_chunk_dir(manifest, chunk_dir);
+	char hex[SHA256_HEX_SIZE];
+	unsigned int chunks = 0, stored_chunks = 0;
+	chipsize_t stored_bytes = 0;
+	chipoff_t pos;
+	FILE *f = NULL;
+	int ret = 1;
+
+	if (!dir) {
+		msg_gerr("Out of memory!\n");
+		return 1;
+	}
+	if (make_dir(dir))
+		goto _free_ret;
+	if ((f = fopen(manifest, "w")) == NULL) {
+		msg_gerr("Error: opening file \"%s\" failed: %s\n", manifest, strerror(errno));
+		goto _free_ret;
+	}
+
+	sha256_hex(buf, size, hex);
+	fprintf(f, "%s\nchip %s\nsize %u\nchunk-size %u\nsha256 %s\n",
+		BACKUP_MAGIC, chip_name, size, BACKUP_CHUNK_SIZE, hex);
+
+	for (pos = 0; pos < size; pos += BACKUP_CHUNK_SIZE) {
+		const size_t len = size - pos < BACKUP_CHUNK_SIZE ? size - pos : BACKUP_CHUNK_SIZE;
+		bool stored;
+
+		sha256_hex(buf + pos, len, hex);
+		if (store_chunk(dir, hex, buf + pos, len, &stored))
+			goto _close_ret;
+		fprintf(f, "%08x %s\n", pos, hex);
+		chunks++;
+		if (stored) {
+			stored_chunks++;
+			stored_bytes += len;
+		}
+	}
+
+	ret = 0;
+_close_ret:
+	if (fclose(f) && !ret) {
+		msg_gerr("Error: writing file \"%s\" failed: %s\n", manifest, strerror(errno));
+		ret = 1;
+	}
+	if (!ret)
+		msg_ginfo("Backed up %u chunks to \"%s\", %u of them (%u B) new in \"%s\".\n",
+			  chunks, manifest, stored_chunks, stored_bytes, dir);
+_free_ret:
+	free(dir);
+	return ret;
+#endif
+}
+
+int backup_load(uint8_t *buf, chipsize_t size, const char *chip_name,
+		const char *manifest, const char *chunk_dir)
+{
+#ifdef __LIBPAYLOAD__
+	msg_gerr("Error: No file I/O support in libpayload\n");
+	return 1;
+#else
+	char *const dir = get_chunk_dir(manifest, chunk_dir);
+	char line[256], hex[SHA256_HEX_SIZE], image_hex[SHA256_HEX_SIZE] = "";
+	unsigned int lineno = 0, chunks = 0, offset;
+	unsigned long manifest_size = 0, chunk_size = 0;
+	chipoff_t pos = 0;
+	FILE *f = NULL;
+	int ret = 1;
+
+	if (!dir) {
+		msg_gerr("Out of memory!\n");
+		return 1;
+	}
+	if ((f = fopen(manifest, "r")) == NULL) {
+		msg_gerr("Error: opening file \"%s\" failed: %s\n", manifest, strerror(errno));
+		goto _free_ret;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		line[strcspn(line, "\r\n")] = '\0';
+		lineno++;
+		if (lineno == 1) {
+			if (strcmp(line, BACKUP_MAGIC)) {
+				msg_gerr("Error: \"%s\" is not a backup manifest.\n", manifest);
+				goto _close_ret;
+			}
+		} else if (!strncmp(line, "chip ", 5)) {
+			if (strcmp(line + 5, chip_name))
+				msg_gwarn("Warning: The backup was taken from a %s, not a %s.\n",
+					  line + 5, chip_name);
+		} else if (sscanf(line, "size %lu", &manifest_size) == 1) {
+			if (manifest_size != size) {
+				msg_gerr("Error: The backup has %lu B, but the flash chip has %u B.\n",
+					 manifest_size, size);
+				goto _close_ret;
+			}
+		} else if (sscanf(line, "chunk-size %lu", &chunk_size) == 1) {
+			if (!chunk_size || chunk_size > size) {
+				msg_gerr("Error: Invalid chunk size in line %u of \"%s\".\n", lineno, manifest);
+				goto _close_ret;
+			}
+		} else if (sscanf(line, "sha256 %64[0-9a-f]", image_hex) == 1) {
+			continue;
+		} else if (sscanf(line, "%8x %64[0-9a-f]", &offset, hex) == 2 && strlen(hex) == 64) {
+			if (!manifest_size || !chunk_size || offset != pos || pos >= size) {
+				msg_gerr("Error: Unexpected chunk in line %u of \"%s\".\n", lineno, manifest);
+				goto _close_ret;
+			}
+			const size_t len = size - pos < chunk_size ? size - pos : chunk_size;
+			if (load_chunk(dir, hex, buf + pos, len))
+				goto _close_ret;
+			pos += len;
+			chunks++;
+		} else {
+			msg_gerr("Error: Invalid line %u in \"%s\".\n", lineno, manifest);
+			goto _close_ret;
+		}
+	}
+	if (!manifest_size || pos != size) {
+		msg_gerr("Error: \"%s\" doesn't cover the whole image, is it truncated?\n", manifest);
+		goto _close_ret;
+	}
+	sha256_hex(buf, size, hex);
+	if (strcmp(hex, image_hex)) {
+		msg_gerr("Error: The image rebuilt from \"%s\" doesn't match its hash.\n", manifest);
+		goto _close_ret;
+	}
+	msg_ginfo("Rebuilt the image of \"%s\" from %u chunks.\n", manifest, chunks);
+	ret = 0;
+
+_close_ret:
+	(void)fclose(f);
+_free_ret:
+	free(dir);
+	return ret;
+#endif
+}
@@ -0,0 +1,38 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __BACKUP_H__
+#define __BACKUP_H__ 1
+
+#include <stdint.h>
+#include "flash.h"
+
+/*
+ * A backup is a text manifest listing the SHA-256 of every 64 KiB chunk of
+ * the image, in order. The chunks themselves are stored once per content in
+ * a chunk directory as <dir>/<first two hex digits>/<sha256>, so backups of
+ * many similar chips share most of them.
+ *
+ * If chunk_dir is NULL, the directory "chunks" next to the manifest is used.
+ */
+
+#define BACKUP_CHUNK_SIZE	(64 * 1024)
+
+/* Stores the chunks of buf that are missing and writes the manifest. */
+int backup_save(const uint8_t *buf, chipsize_t size, const char *chip_name,
+		const char *manifest, const char *chunk_dir);
+/* Rebuilds the image of a manifest into buf, checking every chunk and the whole image. */
+int backup_load(uint8_t *buf, chipsize_t size, const char *chip_name,
+		const char *manifest, const char *chunk_dir);
+
+#endif				/* !__BACKUP_H__ */
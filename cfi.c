@@ -0,0 +1,495 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Common Flash Interface (JESD68) support for parallel NOR flash chips on an
+ * 8-bit bus. The query structure tells us size, erase regions, timings and
+ * write buffer size, so chips flashrom doesn't know can be handled with the
+ * Intel (0x0001/0x0003) and AMD (0x0002/0x0004) command sets.
+ */
+
+#include <limits.h>
+#include <string.h>
+#include "flash.h"
+#include "chipdrivers.h"
+#include "programmer.h"
+
+/* Offsets in the query structure, in device-width units. */
+#define CFI_QUERY_CMD_ADDR	0x55
+#define CFI_QRY			0x10
+#define CFI_PRI_CMDSET		0x13
+#define CFI_TYP_WORD_PROGRAM	0x1f	/* 2^n us */
+#define CFI_TYP_BUF_PROGRAM	0x20	/* 2^n us, 0 if there is no write buffer */
+#define CFI_TYP_BLOCK_ERASE	0x21	/* 2^n ms */
+#define CFI_TYP_CHIP_ERASE	0x22	/* 2^n ms, 0 if there is no chip erase */
+#define CFI_MAX_WORD_PROGRAM	0x23	/* 2^n times typical */
+#define CFI_MAX_BUF_PROGRAM	0x24	/* 2^n times typical */
+#define CFI_DEVICE_SIZE		0x27	/* 2^n bytes */
+#define CFI_INTERFACE		0x28
+#define CFI_BUF_SIZE		0x2a	/* 2^n bytes */
+#define CFI_NUM_REGIONS		0x2c
+#define CFI_REGIONS		0x2d	/* 2 bytes block count - 1, 2 bytes block size / 256 */
+#define CFI_QUERY_SIZE		(CFI_REGIONS + 4 * NUM_ERASEREGIONS)
+
+#define CFI_CMDSET_INTEL_EXT	0x0001
+#define CFI_CMDSET_AMD_STD	0x0002
+#define CFI_CMDSET_INTEL_STD	0x0003
+#define CFI_CMDSET_AMD_EXT	0x0004
+
+#define CFI_INTERFACE_X8	0x0000
+#define CFI_INTERFACE_X8_X16	0x0002
+
+/*
+ * The chip size is unknown while probing. Chips repeat every 2^n bytes, so
+ * the start of the top 16 MiB is the start of any chip flashrom can handle.
+ */
+#define CFI_MAX_CHIP_SIZE	(16 * 1024 * 1024)
+#define CFI_PROBE_WINDOW	4096
+
+#define CFI_MAX_BUF_SHIFT	12
+
+/* Intel status register */
+#define CFI_SR_READY		0x80
+#define CFI_SR_ERRORS		0x3a	/* erase, program, Vpp and lock errors */
+
+/* Hard limits for polling, well above any datasheet maximum. */
+#define PROGRAM_TIMEOUT_US	(100 * 1000)
+#define ERASE_TIMEOUT_US	(10 * 1000 * 1000)
+#define CHIP_ERASE_TIMEOUT_US	(300 * 1000 * 1000)
+
+static bool cfi_byte_mode(const struct flashctx *flash)
+{
+	return flash->chip->feature_bits & FEATURE_CFI_BYTE_MODE;
+}
+
+/* Unlock cycle addresses of the AMD command set. */
+static chipaddr cfi_amd_addr1(const struct flashctx *flash)
+{
+	return flash->virtual_memory + (cfi_byte_mode(flash) ? 0xaaa : 0x555);
+}
+
+static chipaddr cfi_amd_addr2(const struct flashctx *flash)
+{
+	return flash->virtual_memory + (cfi_byte_mode(flash) ? 0x555 : 0x2aa);
+}
+
+static void cfi_amd_command(const struct flashctx *flash, uint8_t cmd)
+{
+	chip_writeb(flash, 0xaa, cfi_amd_addr1(flash));
+	chip_writeb(flash, 0x55, cfi_amd_addr2(flash));
+	chip_writeb(flash, cmd, cfi_amd_addr1(flash));
+}
+
+/* Returns either command set to reading the array. */
+static void cfi_reset(const struct flashctx *flash, chipaddr bios)
+{
+	chip_writeb(flash, 0xf0, bios);
+	chip_writeb(flash, 0x50, bios);
+	chip_writeb(flash, 0xff, bios);
+}
+
+/* Returns 1 when the operation finished, 0 while it's running and -1 on failure. */
+typedef int (cfi_ready_func)(const struct flashctx *flash, chipaddr addr, uint8_t *status);
+
+static int cfi_intel_ready(const struct flashctx *flash, chipaddr addr, uint8_t *status)
+{
+	*status = chip_readb(flash, addr);
+	return !!(*status & CFI_SR_READY);
+}
+
+static int cfi_amd_ready(const struct flashctx *flash, chipaddr addr, uint8_t *status)
+{
+	uint8_t a = chip_readb(flash, addr);
+	uint8_t b = chip_readb(flash, addr);
+
+	if (!((a ^ b) & 0x40))
+		return 1;
+	/* DQ5 says the chip exceeded its time limits, unless it just finished. */
+	if (b & 0x20) {
+		a = chip_readb(flash, addr);
+		b = chip_readb(flash, addr);
+		*status = b;
+		return (a ^ b) & 0x40 ? -1 : 1;
+	}
+	return 0;
+}
+
+/*
+ * Waits for a program or erase operation like toggle_ready_jedec(): sleep for
+ * most of the typical duration, then poll with exponential backoff.
+ */
+static int cfi_wait(const struct flashctx *flash, chipaddr addr, cfi_ready_func *ready, uint8_t *status,
+		    unsigned int typical_us, unsigned int timeout_us)
+{
+	const uint64_t start = internal_time_usecs();
+	const unsigned int max_interval = max(typical_us / 2, 1);
+	unsigned int interval = max(typical_us / 8, 1);
+	int ret;
+
+	*status = 0;
+	programmer_delay(typical_us - typical_us / 4);
+	while (!(ret = ready(flash, addr, status))) {
+		if (internal_time_usecs() - start > timeout_us) {
+			msg_cerr("%s: timeout at 0x%06" PRIxPTR "\n", __func__, addr - flash->virtual_memory);
+			return TIMEOUT_ERROR;
+		}
+		programmer_delay(interval);
+		interval = min(interval * 2, max_interval);
+	}
+	return ret < 0;
+}
+
+/* Waits for an Intel command set operation and returns to reading the array. */
+static int cfi_intel_wait(const struct flashctx *flash, chipaddr addr, unsigned int typical_us,
+			  unsigned int timeout_us)
+{
+	uint8_t status;
+	int ret = cfi_wait(flash, addr, cfi_intel_ready, &status, typical_us, timeout_us);
+
+	if (!ret && (status & CFI_SR_ERRORS)) {
+		msg_cerr("%s: status 0x%02x at 0x%06" PRIxPTR ":%s%s%s%s\n", __func__, status,
+			 addr - flash->virtual_memory, status & 0x20 ? " erase error" : "",
+			 status & 0x10 ? " program error" : "", status & 0x08 ? " Vpp low" : "",
+			 status & 0x02 ? " block locked" : "");
+		ret = 1;
+	}
+	chip_writeb(flash, 0x50, addr);
+	chip_writeb(flash, 0xff, addr);
+	return ret;
+}
+
+/* Waits for an AMD command set operation. The chip returns to reading the array by itself. */
+static int cfi_amd_wait(const struct flashctx *flash, chipaddr addr, unsigned int typical_us,
+			unsigned int timeout_us)
+{
+	uint8_t status;
+	const int ret = cfi_wait(flash, addr, cfi_amd_ready, &status, typical_us, timeout_us);
+
+	if (ret) {
+		msg_cerr("%s: operation at 0x%06" PRIxPTR " failed, status 0x%02x\n", __func__,
+			 addr - flash->virtual_memory, status);
+		/* Also leaves the write-to-buffer-abort state. */
+		cfi_amd_command(flash, 0xf0);
+	}
+	return ret;
+}
+
+static int cfi_intel_program_byte(const struct flashctx *flash, uint8_t val, chipaddr dst)
+{
+	chip_writeb(flash, 0x40, dst);
+	chip_writeb(flash, val, dst);
+	return cfi_intel_wait(flash, dst, flash->chip->word_program_time, PROGRAM_TIMEOUT_US);
+}
+
+static int cfi_intel_program_buffer(const struct flashctx *flash, const uint8_t *src, chipaddr dst,
+				    unsigned int len)
+{
+	const uint64_t start = internal_time_usecs();
+
+	/* The chip answers with its extended status whether a write buffer is free. */
+	while (1) {
+		chip_writeb(flash, 0xe8, dst);
+		if (chip_readb(flash, dst) & CFI_SR_READY)
+			break;
+		if (internal_time_usecs() - start > PROGRAM_TIMEOUT_US) {
+			msg_cerr("%s: no write buffer available at 0x%06" PRIxPTR "\n", __func__,
+				 dst - flash->virtual_memory);
+			chip_writeb(flash, 0xff, dst);
+			return TIMEOUT_ERROR;
+		}
+	}
+	chip_writeb(flash, len - 1, dst);
+	chip_writen(flash, src, dst, len);
+	chip_writeb(flash, 0xd0, dst);
+	return cfi_intel_wait(flash, dst, flash->chip->buffer_program_time, PROGRAM_TIMEOUT_US);
+}
+
+static int cfi_amd_program_byte(const struct flashctx *flash, uint8_t val, chipaddr dst)
+{
+	cfi_amd_command(flash, 0xa0);
+	chip_writeb(flash, val, dst);
+	return cfi_amd_wait(flash, dst, flash->chip->word_program_time, PROGRAM_TIMEOUT_US);
+}
+
+static int cfi_amd_program_buffer(const struct flashctx *flash, const uint8_t *src, chipaddr dst,
+				  unsigned int len)
+{
+	chip_writeb(flash, 0xaa, cfi_amd_addr1(flash));
+	chip_writeb(flash, 0x55, cfi_amd_addr2(flash));
+	chip_writeb(flash, 0x25, dst);
+	chip_writeb(flash, len - 1, dst);
+	chip_writen(flash, src, dst, len);
+	chip_writeb(flash, 0x29, dst);
+	return cfi_amd_wait(flash, dst + len - 1, flash->chip->buffer_program_time, PROGRAM_TIMEOUT_US);
+}
+
+/*
+ * Programs through the write buffer where the chip has one, and byte by byte
+ * otherwise. Erased bytes at either end of a buffer aren't sent at all.
+ */
+static int write_cfi_common(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len,
+			    bool intel)
+{
+	const unsigned int bufsize = flash->chip->buffer_program_time ? flash->chip->page_size : 1;
+	const chipaddr bios = flash->virtual_memory;
+	unsigned int i, j, n, first, last;
+	int ret;
+
+	for (i = 0; i < len; i += n) {
+		n = min(len - i, bufsize - (start + i) % bufsize);
+		for (first = 0; first < n && buf[i + first] == 0xff; first++)
+			;
+		for (last = n; last > first && buf[i + last - 1] == 0xff; last--)
+			;
+		if (first == last)
+			continue;
+
+		if (last - first > 1) {
+			if (intel)
+				ret = cfi_intel_program_buffer(flash, buf + i + first, bios + start + i + first,
+							       last - first);
+			else
+				ret = cfi_amd_program_buffer(flash, buf + i + first, bios + start + i + first,
+							     last - first);
+			if (ret)
+				return ret;
+			continue;
+		}
+		for (j = first; j < last; j++) {
+			if (intel)
+				ret = cfi_intel_program_byte(flash, buf[i + j], bios + start + i + j);
+			else
+				ret = cfi_amd_program_byte(flash, buf[i + j], bios + start + i + j);
+			if (ret)
+				return ret;
+		}
+	}
+	return 0;
+}
+
+static int write_cfi_intel(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len)
+{
+	return write_cfi_common(flash, buf, start, len, true);
+}
+
+/*
+ * Also used by table entries of AMD command set chips with a write buffer. Their unlock
+ * addresses are 0x555/0x2AA like FEATURE_ADDR_2AA, page_size is the buffer size.
+ */
+int write_cfi_amd(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len)
+{
+	return write_cfi_common(flash, buf, start, len, false);
+}
+
+static int erase_block_cfi_intel(struct flashctx *flash, unsigned int addr, unsigned int blocklen)
+{
+	const chipaddr dst = flash->virtual_memory + addr;
+
+	chip_writeb(flash, 0x20, dst);
+	chip_writeb(flash, 0xd0, dst);
+	return cfi_intel_wait(flash, dst, flash->chip->erase_time.block, ERASE_TIMEOUT_US);
+}
+
+static int erase_sector_cfi_amd(struct flashctx *flash, unsigned int addr, unsigned int blocklen)
+{
+	const chipaddr dst = flash->virtual_memory + addr;
+
+	cfi_amd_command(flash, 0x80);
+	chip_writeb(flash, 0xaa, cfi_amd_addr1(flash));
+	chip_writeb(flash, 0x55, cfi_amd_addr2(flash));
+	chip_writeb(flash, 0x30, dst);
+	return cfi_amd_wait(flash, dst, flash->chip->erase_time.block, ERASE_TIMEOUT_US);
+}
+
+static int erase_chip_cfi_amd(struct flashctx *flash, unsigned int addr, unsigned int blocklen)
+{
+	if (addr != 0 || blocklen != flash->chip->total_size * 1024) {
+		msg_cerr("%s called with incorrect arguments\n", __func__);
+		return -1;
+	}
+	cfi_amd_command(flash, 0x80);
+	cfi_amd_command(flash, 0x10);
+	return cfi_amd_wait(flash, flash->virtual_memory, flash->chip->erase_time.chip, CHIP_ERASE_TIMEOUT_US);
+}
+
+/* Intel chips may power up with all blocks locked. */
+static int unlock_cfi_intel(struct flashctx *flash)
+{
+	const struct block_eraser *eraser = &flash->chip->block_erasers[0];
+	unsigned int i, j, addr = 0;
+
+	for (i = 0; i < NUM_ERASEREGIONS && eraser->eraseblocks[i].size; i++) {
+		for (j = 0; j < eraser->eraseblocks[i].count; j++) {
+			const chipaddr dst = flash->virtual_memory + addr;
+
+			chip_writeb(flash, 0x60, dst);
+			chip_writeb(flash, 0xd0, dst);
+			if (cfi_intel_wait(flash, dst, 0, ERASE_TIMEOUT_US)) {
+				msg_cerr("Unlocking the block at 0x%06x failed.\n", addr);
+				return 1;
+			}
+			addr += eraser->eraseblocks[i].size;
+		}
+	}
+	return 0;
+}
+
+static unsigned int cfi_time(uint8_t exp, uint8_t max_exp, unsigned int unit)
+{
+	const uint64_t t = exp ? ((uint64_t)unit << exp) << max_exp : 0;
+
+	return t > UINT_MAX ? UINT_MAX : t;
+}
+
+/* Reads the query structure with x8 addressing, or with the doubled addresses of x16 chips in byte mode. */
+static int cfi_read_query(const struct flashctx *flash, chipaddr bios, uint8_t *q, bool *byte_mode)
+{
+	unsigned int shift, i;
+
+	for (shift = 0; shift <= 1; shift++) {
+		bool content;
+
+		cfi_reset(flash, bios);
+		/* Flash contents that look like a query structure would fool us. */
+		content = chip_readb(flash, bios + ((CFI_QRY + 0) << shift)) == 'Q' &&
+			  chip_readb(flash, bios + ((CFI_QRY + 1) << shift)) == 'R' &&
+			  chip_readb(flash, bios + ((CFI_QRY + 2) << shift)) == 'Y';
+		chip_writeb(flash, 0x98, bios + (CFI_QUERY_CMD_ADDR << shift));
+		for (i = 0; i < CFI_QUERY_SIZE; i++)
+			q[i] = chip_readb(flash, bios + (i << shift));
+		cfi_reset(flash, bios);
+
+		if (!memcmp(q + CFI_QRY, "QRY", 3)) {
+			if (content) {
+				msg_cdbg("QRY is normal flash content. ");
+				return 1;
+			}
+			*byte_mode = shift;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static int cfi_fill_chip(struct flashchip *chip, const uint8_t *q, bool byte_mode)
+{
+	const uint16_t cmdset = q[CFI_PRI_CMDSET] | q[CFI_PRI_CMDSET + 1] << 8;
+	const uint16_t interface = q[CFI_INTERFACE] | q[CFI_INTERFACE + 1] << 8;
+	const uint8_t buf_shift = q[CFI_BUF_SIZE];
+	const unsigned int nregions = q[CFI_NUM_REGIONS];
+	struct block_eraser *eraser = &chip->block_erasers[0];
+	unsigned int i, size, total = 0;
+	bool intel;
+
+	switch (cmdset) {
+	case CFI_CMDSET_INTEL_EXT:
+	case CFI_CMDSET_INTEL_STD:
+		intel = true;
+		break;
+	case CFI_CMDSET_AMD_STD:
+	case CFI_CMDSET_AMD_EXT:
+		intel = false;
+		break;
+	default:
+		msg_cdbg("Unsupported command set 0x%04x. ", cmdset);
+		return 1;
+	}
+	if (interface != CFI_INTERFACE_X8 && interface != CFI_INTERFACE_X8_X16) {
+		msg_cdbg("Unsupported bus interface 0x%04x, an 8-bit bus needs x8 or x8/x16. ", interface);
+		return 1;
+	}
+	if (q[CFI_DEVICE_SIZE] < 10 || (1U << q[CFI_DEVICE_SIZE]) > CFI_MAX_CHIP_SIZE) {
+		msg_cdbg("Unsupported chip size 2^%u B. ", q[CFI_DEVICE_SIZE]);
+		return 1;
+	}
+	size = 1U << q[CFI_DEVICE_SIZE];
+	if (!nregions || nregions > NUM_ERASEREGIONS) {
+		msg_cdbg("Unsupported number of erase regions %u. ", nregions);
+		return 1;
+	}
+
+	memset(chip->block_erasers, 0, sizeof(chip->block_erasers));
+	for (i = 0; i < nregions; i++) {
+		const uint8_t *r = q + CFI_REGIONS + 4 * i;
+		const unsigned int count = (r[0] | r[1] << 8) + 1;
+		const unsigned int units = r[2] | r[3] << 8;
+
+		eraser->eraseblocks[i].count = count;
+		eraser->eraseblocks[i].size = units ? units * 256 : 128;
+		total += count * eraser->eraseblocks[i].size;
+		msg_cdbg2("Erase region %u: %u x %u B. ", i, count, eraser->eraseblocks[i].size);
+	}
+	if (total != size) {
+		msg_cdbg("Erase regions cover %u B of %u B. ", total, size);
+		return 1;
+	}
+	eraser->block_erase = intel ? erase_block_cfi_intel : erase_sector_cfi_amd;
+	if (!intel) {
+		chip->block_erasers[1].eraseblocks[0].count = 1;
+		chip->block_erasers[1].eraseblocks[0].size = size;
+		chip->block_erasers[1].block_erase = erase_chip_cfi_amd;
+	}
+
+	chip->total_size = size / 1024;
+	chip->byte_program_time = cfi_time(q[CFI_TYP_WORD_PROGRAM], q[CFI_MAX_WORD_PROGRAM], 1);
+	chip->word_program_time = cfi_time(q[CFI_TYP_WORD_PROGRAM], 0, 1);
+	chip->erase_time.block = cfi_time(q[CFI_TYP_BLOCK_ERASE], 0, 1000);
+	chip->erase_time.chip = cfi_time(q[CFI_TYP_CHIP_ERASE], 0, 1000);
+	if (q[CFI_TYP_BUF_PROGRAM] && buf_shift > 0 && buf_shift <= CFI_MAX_BUF_SHIFT) {
+		chip->page_size = 1 << buf_shift;
+		chip->buffer_program_time = cfi_time(q[CFI_TYP_BUF_PROGRAM], 0, 1);
+	} else {
+		chip->page_size = 1;
+		chip->buffer_program_time = 0;
+	}
+	if (byte_mode)
+		chip->feature_bits |= FEATURE_CFI_BYTE_MODE;
+	chip->write = intel ? write_cfi_intel : write_cfi_amd;
+	chip->unlock = intel ? unlock_cfi_intel : NULL;
+
+	msg_cdbg("%s command set, %u kB, %u B write buffer%s. ", intel ? "Intel" : "AMD", chip->total_size,
+		 chip->buffer_program_time ? chip->page_size : 0, byte_mode ? ", x16 chip in byte mode" : "");
+	return 0;
+}
+
+int probe_cfi(struct flashctx *flash)
+{
+	const uintptr_t base = flashbase ? flashbase : 0xffffffff - CFI_MAX_CHIP_SIZE + 1;
+	uint8_t q[CFI_QUERY_SIZE];
+	bool byte_mode = false;
+	void *addr;
+	int ret;
+
+	addr = programmer_map_flash_region("CFI query", base, CFI_PROBE_WINDOW);
+	if (addr == ERROR_PTR)
+		return 0;
+	ret = cfi_read_query(flash, (chipaddr)addr, q, &byte_mode);
+	programmer_unmap_flash_region(addr, CFI_PROBE_WINDOW);
+	if (ret) {
+		msg_cdbg("No CFI query structure found.\n");
+		return 0;
+	}
+	if (cfi_fill_chip(flash->chip, q, byte_mode)) {
+		msg_cdbg("\n");
+		flash->chip->total_size = 0;
+		return 0;
+	}
+	msg_cdbg("\n");
+
+	/* Now that the size is known, map the whole chip. */
+	if (map_flash(flash)) {
+		flash->chip->total_size = 0;
+		return 0;
+	}
+	return 1;
+}
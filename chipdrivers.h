@@ -26,6 +26,9 @@
 int spi_aai_write(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len);
 int spi_chip_write_256(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len);
 int spi_chip_read(struct flashctx *flash, uint8_t *buf, unsigned int start, int unsigned len);
+int spi_prepare_access(struct flashctx *flash);
+int spi_set_chip_speed(struct flashctx *flash, bool read_only);
+unsigned int spi_read_chunksize(struct flashctx *flash, unsigned int max_chunk);
 
 /* spi25.c */
 int probe_spi_rdid(struct flashctx *flash);
@@ -64,6 +67,7 @@ int spi_set_extended_address(struct flashctx *, uint8_t addr_high);
 /* spi25_statusreg.c */
 uint8_t spi_read_status_register(struct flashctx *flash);
 int spi_write_status_register(struct flashctx *flash, int status);
+int spi_set_quad_enable(struct flashctx *flash, bool enable);
 void spi_prettyprint_status_register_bit(uint8_t status, int bit);
 int spi_prettyprint_status_register_plain(struct flashctx *flash);
 int spi_prettyprint_status_register_default_welwip(struct flashctx *flash);
@@ -108,6 +112,10 @@ int spi_disable_blockprotect_sst26_global_unprotect(struct flashctx *flash);
 /* sfdp.c */
 int probe_spi_sfdp(struct flashctx *flash);
 
+/* cfi.c */
+int probe_cfi(struct flashctx *flash);
+int write_cfi_amd(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len);
+
 /* opaque.c */
 int probe_opaque(struct flashctx *flash);
 int read_opaque(struct flashctx *flash, uint8_t *buf, unsigned int start, unsigned int len);
@@ -138,7 +146,7 @@ int unlock_lh28f008bjt(struct flashctx *flash);
 
 /* jedec.c */
 uint8_t oddparity(uint8_t val);
-void toggle_ready_jedec(const struct flashctx *flash, chipaddr dst);
+int toggle_ready_jedec(const struct flashctx *flash, chipaddr dst);
 void data_polling_jedec(const struct flashctx *flash, chipaddr dst, uint8_t data);
 int probe_jedec(struct flashctx *flash);
 int probe_jedec_29gl(struct flashctx *flash);
@@ -28,24 +28,28 @@
 #include "fmap.h"
 #include "programmer.h"
 #include "libflashrom.h"
+#include "digest.h"
+#include "delta.h"
+#include "compression.h"
 
 static void cli_classic_usage(const char *name)
 {
-	printf("Usage: %s [-h|-R|-L|"
+	printf("Usage: %s [-h|-R|-L|--selfcheck|--make-delta <base> <new> <delta>|"
 #if CONFIG_PRINT_WIKI == 1
 	       "-z|"
 #endif
 	       "\n\t-p <programmername>[:<parameters>] [-c <chipname>]\n"
 	       "\t\t(--flash-name|--flash-size|\n"
-	       "\t\t [-E|(-r|-w|-v) <file>]\n"
+	       "\t\t [-E|(-r|-w|-v) <file>|(--backup|--restore) <manifest> [--chunk-dir <dir>]]\n"
 	       "\t\t [(-l <layoutfile>|--ifd| --fmap|--fmap-file <file>) [-i <imagename>]...]\n"
-	       "\t\t [-n] [-N] [-f])]\n"
+	       "\t\t [-n] [-N] [-f] [--tune-read-chunks]\n"
+	       "\t\t [--digest <list>] [--digest-json <file>])]\n"
 	       "\t[-V[V[V]]] [-o <logfile>]\n\n", name);
 
 	printf(" -h | --help                        print this help text\n"
 	       " -R | --version                     print version (release)\n"
 	       " -r | --read <file>                 read flash and save to <file>\n"
-	       " -w | --write <file>                write <file> to flash\n"
+	       " -w | --write <file>                write <file> (flat, Intel HEX, S-record or delta) to flash\n"
 	       " -v | --verify <file>               verify flash against <file>\n"
 	       " -E | --erase                       erase flash memory\n"
 	       " -V | --verbose                     more verbose output\n"
@@ -62,6 +66,15 @@ static void cli_classic_usage(const char *name)
 	       " -i | --image <name>                only flash image <name> from flash layout\n"
 	       " -o | --output <logfile>            log output to <logfile>\n"
 	       "      --flash-contents <ref-file>   assume flash contents to be <ref-file>\n"
+	       "      --tune-read-chunks            measure and cache the fastest SPI read chunk size\n"
+	       "      --digest <list>               print digests (sha256,crc32c) of the regions read\n"
+	       "      --digest-json <file>          also write the digests to <file> as JSON\n"
+	       "      --selfcheck                   check the built-in chip and programmer tables\n"
+	       "      --backup <manifest>           back up flash to <manifest> and deduplicated chunks\n"
+	       "      --restore <manifest>          write the backup in <manifest> to flash\n"
+	       "      --chunk-dir <dir>             chunk store of backups (default: chunks/ next to manifest)\n"
+	       "      --make-delta <base> <new> <delta>\n"
+	       "                                    write the delta from image <base> to <new> for -w\n"
 	       " -L | --list-supported              print supported devices\n"
 #if CONFIG_PRINT_WIKI == 1
 	       " -z | --list-supported-wiki         print supported devices in wiki syntax\n"
@@ -116,8 +129,9 @@ int main(int argc, char *argv[])
 	int list_supported_wiki = 0;
 #endif
 	int flash_name = 0, flash_size = 0;
-	int read_it = 0, write_it = 0, erase_it = 0, verify_it = 0;
+	int read_it = 0, write_it = 0, erase_it = 0, verify_it = 0, backup_it = 0, restore_it = 0;
 	int dont_verify_it = 0, dont_verify_all = 0, list_supported = 0, operation_specified = 0;
+	int tune_read_chunks = 0, selfcheck_it = 0, make_delta = 0;
 	struct flashrom_layout *layout = NULL;
 	enum programmer prog = PROGRAMMER_INVALID;
 	enum {
@@ -127,6 +141,14 @@ int main(int argc, char *argv[])
 		OPTION_FLASH_CONTENTS,
 		OPTION_FLASH_NAME,
 		OPTION_FLASH_SIZE,
+		OPTION_TUNE_READ_CHUNKS,
+		OPTION_SELFCHECK,
+		OPTION_DIGEST,
+		OPTION_DIGEST_JSON,
+		OPTION_MAKE_DELTA,
+		OPTION_BACKUP,
+		OPTION_RESTORE,
+		OPTION_CHUNK_DIR,
 	};
 	int ret = 0;
 
@@ -150,6 +172,14 @@ int main(int argc, char *argv[])
 		{"flash-name",		0, NULL, OPTION_FLASH_NAME},
 		{"flash-size",		0, NULL, OPTION_FLASH_SIZE},
 		{"get-size",		0, NULL, OPTION_FLASH_SIZE}, // (deprecated): back compatibility.
+		{"tune-read-chunks",	0, NULL, OPTION_TUNE_READ_CHUNKS},
+		{"selfcheck",		0, NULL, OPTION_SELFCHECK},
+		{"digest",		1, NULL, OPTION_DIGEST},
+		{"digest-json",		1, NULL, OPTION_DIGEST_JSON},
+		{"make-delta",		0, NULL, OPTION_MAKE_DELTA},
+		{"backup",		1, NULL, OPTION_BACKUP},
+		{"restore",		1, NULL, OPTION_RESTORE},
+		{"chunk-dir",		1, NULL, OPTION_CHUNK_DIR},
 		{"list-supported",	0, NULL, 'L'},
 		{"list-supported-wiki",	0, NULL, 'z'},
 		{"programmer",		1, NULL, 'p'},
@@ -163,6 +193,9 @@ int main(int argc, char *argv[])
 	char *referencefile = NULL;
 	char *layoutfile = NULL;
 	char *fmapfile = NULL;
+	char *digest_json = NULL;
+	char *chunk_dir = NULL;
+	unsigned int digests = 0;
 #ifndef STANDALONE
 	char *logfile = NULL;
 #endif /* !STANDALONE */
@@ -175,8 +208,10 @@ int main(int argc, char *argv[])
 	print_version();
 	print_banner();
 
+#if CONFIG_RUNTIME_SELFCHECK == 1
 	if (selfcheck())
 		exit(1);
+#endif
 
 	setbuf(stdout, NULL);
 	/* FIXME: Delay all operation_specified checks until after command
@@ -283,6 +318,37 @@ int main(int argc, char *argv[])
 			cli_classic_validate_singleop(&operation_specified);
 			flash_size = 1;
 			break;
+		case OPTION_TUNE_READ_CHUNKS:
+			tune_read_chunks = 1;
+			break;
+		case OPTION_DIGEST:
+			if (digest_parse_list(optarg, &digests))
+				cli_classic_abort_usage(NULL);
+			break;
+		case OPTION_DIGEST_JSON:
+			digest_json = strdup(optarg);
+			break;
+		case OPTION_SELFCHECK:
+			cli_classic_validate_singleop(&operation_specified);
+			selfcheck_it = 1;
+			break;
+		case OPTION_BACKUP:
+			cli_classic_validate_singleop(&operation_specified);
+			filename = strdup(optarg);
+			backup_it = 1;
+			break;
+		case OPTION_RESTORE:
+			cli_classic_validate_singleop(&operation_specified);
+			filename = strdup(optarg);
+			restore_it = 1;
+			break;
+		case OPTION_CHUNK_DIR:
+			chunk_dir = strdup(optarg);
+			break;
+		case OPTION_MAKE_DELTA:
+			cli_classic_validate_singleop(&operation_specified);
+			make_delta = 1;
+			break;
 		case 'L':
 			cli_classic_validate_singleop(&operation_specified);
 			list_supported = 1;
@@ -368,16 +434,35 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	if (optind < argc)
+	if (make_delta) {
+		if (argc - optind != 3)
+			cli_classic_abort_usage("Error: --make-delta needs a base, a new and a delta file.\n");
+	} else if (optind < argc) {
 		cli_classic_abort_usage("Error: Extra parameter found.\n");
+	}
 	if ((read_it | write_it | verify_it) && check_filename(filename, "image"))
 		cli_classic_abort_usage(NULL);
+	/* Refuse before the chip is read, write_buf_to_file() would leave an empty file behind. */
+	if (read_it && compression_check_name(filename))
+		cli_classic_abort_usage(NULL);
+	if ((backup_it | restore_it) && check_filename(filename, "manifest"))
+		cli_classic_abort_usage(NULL);
+	if (chunk_dir && !(backup_it | restore_it))
+		cli_classic_abort_usage("Error: --chunk-dir is only used with --backup or --restore.\n");
+	if (chunk_dir && check_filename(chunk_dir, "chunk directory"))
+		cli_classic_abort_usage(NULL);
 	if (layoutfile && check_filename(layoutfile, "layout"))
 		cli_classic_abort_usage(NULL);
 	if (fmapfile && check_filename(fmapfile, "fmap"))
 		cli_classic_abort_usage(NULL);
 	if (referencefile && check_filename(referencefile, "reference"))
 		cli_classic_abort_usage(NULL);
+	if (digest_json && check_filename(digest_json, "digest"))
+		cli_classic_abort_usage(NULL);
+	if ((digests || digest_json) && !read_it)
+		cli_classic_abort_usage("Error: Digests are only computed when reading (-r).\n");
+	if (digest_json && !digests)
+		digests = FLASHROM_DIGEST_SHA256 | FLASHROM_DIGEST_CRC32C;
 
 #ifndef STANDALONE
 	if (logfile && check_filename(logfile, "log"))
@@ -399,6 +484,19 @@ int main(int argc, char *argv[])
 		goto out;
 	}
 
+	if (selfcheck_it) {
+		if (selfcheck())
+			ret = 1;
+		else
+			msg_ginfo("Selfcheck passed.\n");
+		goto out;
+	}
+
+	if (make_delta) {
+		ret = delta_create(argv[optind], argv[optind + 1], argv[optind + 2]);
+		goto out;
+	}
+
 #ifndef STANDALONE
 	start_logging();
 #endif /* !STANDALONE */
@@ -562,7 +660,7 @@ int main(int argc, char *argv[])
 		goto out_shutdown;
 	}
 
-	if (!(read_it | write_it | verify_it | erase_it | flash_name | flash_size)) {
+	if (!(read_it | write_it | verify_it | erase_it | backup_it | restore_it | flash_name | flash_size)) {
 		msg_ginfo("No operations were specified.\n");
 		goto out_shutdown;
 	}
@@ -630,6 +728,8 @@ int main(int argc, char *argv[])
 #endif
 	flashrom_flag_set(fill_flash, FLASHROM_FLAG_VERIFY_AFTER_WRITE, !dont_verify_it);
 	flashrom_flag_set(fill_flash, FLASHROM_FLAG_VERIFY_WHOLE_CHIP, !dont_verify_all);
+	flashrom_flag_set(fill_flash, FLASHROM_FLAG_TUNE_READ_CHUNKS, !!tune_read_chunks);
+	flashrom_digest_set(fill_flash, digests, digest_json);
 
 	/* FIXME: We should issue an unconditional chip reset here. This can be
 	 * done once we have a .reset function in struct flashchip.
@@ -644,6 +744,10 @@ int main(int argc, char *argv[])
 		ret = do_write(fill_flash, filename, referencefile);
 	else if (verify_it)
 		ret = do_verify(fill_flash, filename);
+	else if (backup_it)
+		ret = do_backup(fill_flash, filename, chunk_dir);
+	else if (restore_it)
+		ret = do_restore(fill_flash, filename, chunk_dir, referencefile);
 
 	flashrom_layout_release(layout);
 
@@ -657,6 +761,8 @@ out:
 	free(filename);
 	free(fmapfile);
 	free(referencefile);
+	free(digest_json);
+	free(chunk_dir);
 	free(layoutfile);
 	free(pparam);
 	/* clean up global variables */
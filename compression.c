@@ -0,0 +1,406 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <string.h>
+#include "flash.h"
+#include "compression.h"
+
+#if HAVE_ZLIB == 1
+#include <zlib.h>
+#endif
+#if HAVE_LZMA == 1
+#include <lzma.h>
+#endif
+#if HAVE_ZSTD == 1
+#include <zstd.h>
+#endif
+
+/* Files are streamed through buffers of this size, the image itself is never copied. */
+#define COMPRESSION_CHUNK	(64 * 1024)
+
+static const struct {
+	const char *name;
+	const char *suffix;
+	uint8_t magic[6];
+	size_t magic_len;
+} formats[] = {
+	[COMPRESSION_GZIP] = { "gzip",	".gz",	{ 0x1f, 0x8b }, 2 },
+	[COMPRESSION_XZ]   = { "xz",	".xz",	{ 0xfd, '7', 'z', 'X', 'Z', 0x00 }, 6 },
+	[COMPRESSION_ZSTD] = { "zstd",	".zst",	{ 0x28, 0xb5, 0x2f, 0xfd }, 4 },
+};
+
+enum compression compression_by_magic(const uint8_t *magic, size_t len)
+{
+	enum compression c;
+
+	for (c = COMPRESSION_GZIP; c < ARRAY_SIZE(formats); c++) {
+		if (len >= formats[c].magic_len && !memcmp(magic, formats[c].magic, formats[c].magic_len))
+			return c;
+	}
+	return COMPRESSION_NONE;
+}
+
+enum compression compression_by_name(const char *filename)
+{
+	const size_t len = strlen(filename);
+	enum compression c;
+
+	for (c = COMPRESSION_GZIP; c < ARRAY_SIZE(formats); c++) {
+		const size_t suffix_len = strlen(formats[c].suffix);
+		if (len > suffix_len && !strcmp(filename + len - suffix_len, formats[c].suffix))
+			return c;
+	}
+	return COMPRESSION_NONE;
+}
+
+static int check_decompressed_size(unsigned long long got, unsigned long size, const char *filename)
+{
+	if (got != size) {
+		msg_gerr("Error: Decompressed image size (%s%llu B) doesn't match the flash chip's size (%lu B)!\n",
+			 got > size ? "at least " : "", got, size);
+		return 1;
+	}
+	return 0;
+}
+
+static int read_chunk(FILE *f, uint8_t *chunk, size_t *len, const char *filename)
+{
+	*len = fread(chunk, 1, COMPRESSION_CHUNK, f);
+	if (ferror(f)) {
+		msg_gerr("Error: reading file \"%s\" failed.\n", filename);
+		return 1;
+	}
+	return 0;
+}
+
+static int write_chunk(FILE *f, const uint8_t *chunk, size_t len, const char *filename)
+{
+	if (fwrite(chunk, 1, len, f) != len) {
+		msg_gerr("Error: file %s could not be written completely.\n", filename);
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * The decompressors below write straight into the image buffer. Once it is
+ * full, output goes to a scratch buffer only to detect oversized images.
+ */
+
+#if HAVE_ZLIB == 1
+static int gzip_decompress(FILE *f, uint8_t *buf, unsigned long size, const char *filename)
+{
+	uint8_t in[COMPRESSION_CHUNK], scratch[256];
+	unsigned long long total = 0;
+	z_stream z;
+	int zret = Z_OK, ret = 1;
+	size_t len;
+
+	memset(&z, 0, sizeof(z));
+	if (inflateInit2(&z, 16 + MAX_WBITS) != Z_OK) {
+		msg_gerr("Error: initializing zlib failed.\n");
+		return 1;
+	}
+	z.next_out = buf;
+	z.avail_out = size;
+	while (total <= size) {
+		if (!z.avail_in) {
+			if (read_chunk(f, in, &len, filename))
+				goto out;
+			if (!len)
+				break;
+			z.next_in = in;
+			z.avail_in = len;
+		}
+		if (!z.avail_out) {
+			z.next_out = scratch;
+			z.avail_out = sizeof(scratch);
+		}
+		const uLong before = z.total_out;
+		zret = inflate(&z, Z_NO_FLUSH);
+		total += z.total_out - before;
+		/* Concatenated members, as written by parallel compressors. */
+		if (zret == Z_STREAM_END && z.avail_in) {
+			const uLong out = z.total_out;
+			if (inflateReset(&z) != Z_OK)
+				goto corrupt;
+			z.total_out = out;
+		} else if (zret != Z_OK && zret != Z_STREAM_END) {
+			goto corrupt;
+		}
+	}
+	if (total <= size && zret != Z_STREAM_END)
+		goto corrupt;
+	ret = check_decompressed_size(total, size, filename);
+	goto out;
+corrupt:
+	msg_gerr("Error: decompressing \"%s\" failed: %s\n", filename, z.msg ? z.msg : "unexpected end of file");
+out:
+	inflateEnd(&z);
+	return ret;
+}
+
+static int gzip_compress(FILE *f, const uint8_t *buf, unsigned long size, const char *filename)
+{
+	uint8_t out[COMPRESSION_CHUNK];
+	z_stream z;
+	int zret, ret = 1;
+
+	memset(&z, 0, sizeof(z));
+	if (deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		msg_gerr("Error: initializing zlib failed.\n");
+		return 1;
+	}
+	z.next_in = (uint8_t *)buf;
+	z.avail_in = size;
+	do {
+		z.next_out = out;
+		z.avail_out = sizeof(out);
+		zret = deflate(&z, Z_FINISH);
+		if (zret != Z_OK && zret != Z_STREAM_END) {
+			msg_gerr("Error: gzip compression failed.\n");
+			goto out;
+		}
+		if (write_chunk(f, out, sizeof(out) - z.avail_out, filename))
+			goto out;
+	} while (zret != Z_STREAM_END);
+	ret = 0;
+out:
+	deflateEnd(&z);
+	return ret;
+}
+#endif
+
+#if HAVE_LZMA == 1
+static int xz_decompress(FILE *f, uint8_t *buf, unsigned long size, const char *filename)
+{
+	uint8_t in[COMPRESSION_CHUNK], scratch[256];
+	lzma_stream s = LZMA_STREAM_INIT;
+	lzma_action action = LZMA_RUN;
+	lzma_ret lret = LZMA_OK;
+	int ret = 1;
+	size_t len;
+
+	if (lzma_stream_decoder(&s, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) {
+		msg_gerr("Error: initializing liblzma failed.\n");
+		return 1;
+	}
+	s.next_out = buf;
+	s.avail_out = size;
+	while (s.total_out <= size && lret != LZMA_STREAM_END) {
+		if (!s.avail_in && action == LZMA_RUN) {
+			if (read_chunk(f, in, &len, filename))
+				goto out;
+			if (!len)
+				action = LZMA_FINISH;
+			s.next_in = in;
+			s.avail_in = len;
+		}
+		if (!s.avail_out) {
+			s.next_out = scratch;
+			s.avail_out = sizeof(scratch);
+		}
+		lret = lzma_code(&s, action);
+		if (lret == LZMA_BUF_ERROR) {
+			msg_gerr("Error: decompressing \"%s\" failed: unexpected end of file\n", filename);
+			goto out;
+		} else if (lret != LZMA_OK && lret != LZMA_STREAM_END) {
+			msg_gerr("Error: decompressing \"%s\" failed: liblzma error %d\n", filename, lret);
+			goto out;
+		}
+	}
+	ret = check_decompressed_size(s.total_out, size, filename);
+out:
+	lzma_end(&s);
+	return ret;
+}
+
+static int xz_compress(FILE *f, const uint8_t *buf, unsigned long size, const char *filename)
+{
+	uint8_t out[COMPRESSION_CHUNK];
+	lzma_stream s = LZMA_STREAM_INIT;
+	lzma_ret lret;
+	int ret = 1;
+
+	if (lzma_easy_encoder(&s, LZMA_PRESET_DEFAULT, LZMA_CHECK_CRC64) != LZMA_OK) {
+		msg_gerr("Error: initializing liblzma failed.\n");
+		return 1;
+	}
+	s.next_in = buf;
+	s.avail_in = size;
+	do {
+		s.next_out = out;
+		s.avail_out = sizeof(out);
+		lret = lzma_code(&s, LZMA_FINISH);
+		if (lret != LZMA_OK && lret != LZMA_STREAM_END) {
+			msg_gerr("Error: xz compression failed (liblzma error %d).\n", lret);
+			goto out;
+		}
+		if (write_chunk(f, out, sizeof(out) - s.avail_out, filename))
+			goto out;
+	} while (lret != LZMA_STREAM_END);
+	ret = 0;
+out:
+	lzma_end(&s);
+	return ret;
+}
+#endif
+
+#if HAVE_ZSTD == 1
+static int zstd_decompress(FILE *f, uint8_t *buf, unsigned long size, const char *filename)
+{
+	uint8_t in[COMPRESSION_CHUNK], scratch[256];
+	ZSTD_DCtx *const d = ZSTD_createDCtx();
+	ZSTD_outBuffer out = { buf, size, 0 };
+	unsigned long long total = 0;
+	size_t zret = 0, len;
+	int ret = 1;
+
+	if (!d) {
+		msg_gerr("Error: initializing libzstd failed.\n");
+		return 1;
+	}
+	while (total <= size) {
+		if (read_chunk(f, in, &len, filename))
+			goto out;
+		if (!len)
+			break;
+		ZSTD_inBuffer input = { in, len, 0 };
+		while (input.pos < input.size && total <= size) {
+			if (out.pos == out.size) {
+				out.dst = scratch;
+				out.size = sizeof(scratch);
+				out.pos = 0;
+			}
+			const size_t before = out.pos;
+			zret = ZSTD_decompressStream(d, &out, &input);
+			if (ZSTD_isError(zret)) {
+				msg_gerr("Error: decompressing \"%s\" failed: %s\n", filename, ZSTD_getErrorName(zret));
+				goto out;
+			}
+			total += out.pos - before;
+		}
+	}
+	/* A non-zero hint means the last frame isn't complete. */
+	if (total <= size && zret) {
+		msg_gerr("Error: decompressing \"%s\" failed: unexpected end of file\n", filename);
+		goto out;
+	}
+	ret = check_decompressed_size(total, size, filename);
+out:
+	ZSTD_freeDCtx(d);
+	return ret;
+}
+
+static int zstd_compress(FILE *f, const uint8_t *buf, unsigned long size, const char *filename)
+{
+	uint8_t chunk[COMPRESSION_CHUNK];
+	ZSTD_CCtx *const c = ZSTD_createCCtx();
+	ZSTD_inBuffer in = { buf, size, 0 };
+	size_t zret;
+	int ret = 1;
+
+	if (!c) {
+		msg_gerr("Error: initializing libzstd failed.\n");
+		return 1;
+	}
+	ZSTD_CCtx_setParameter(c, ZSTD_c_checksumFlag, 1);
+	ZSTD_CCtx_setPledgedSrcSize(c, size);
+	do {
+		ZSTD_outBuffer out = { chunk, sizeof(chunk), 0 };
+		zret = ZSTD_compressStream2(c, &out, &in, ZSTD_e_end);
+		if (ZSTD_isError(zret)) {
+			msg_gerr("Error: zstd compression failed (%s).\n", ZSTD_getErrorName(zret));
+			goto out;
+		}
+		if (write_chunk(f, chunk, out.pos, filename))
+			goto out;
+	} while (zret);
+	ret = 0;
+out:
+	ZSTD_freeCCtx(c);
+	return ret;
+}
+#endif
+
+static int unsupported(enum compression c, const char *filename)
+{
+	msg_gerr("Error: \"%s\" is %s compressed, but flashrom was built without %s support.\n",
+		 filename, formats[c].name, formats[c].name);
+	return 1;
+}
+
+int compression_check_name(const char *filename)
+{
+	const enum compression c = compression_by_name(filename);
+
+	switch (c) {
+	case COMPRESSION_NONE:
+#if HAVE_ZLIB == 1
+	case COMPRESSION_GZIP:
+#endif
+#if HAVE_LZMA == 1
+	case COMPRESSION_XZ:
+#endif
+#if HAVE_ZSTD == 1
+	case COMPRESSION_ZSTD:
+#endif
+		return 0;
+	default:
+		msg_gerr("Error: Cannot write \"%s\", flashrom was built without %s support.\n",
+			 filename, formats[c].name);
+		return 1;
+	}
+}
+
+int decompress_file(FILE *f, enum compression c, uint8_t *buf, unsigned long size, const char *filename)
+{
+	msg_gdbg("Decompressing %s image \"%s\".\n", formats[c].name, filename);
+	switch (c) {
+#if HAVE_ZLIB == 1
+	case COMPRESSION_GZIP:
+		return gzip_decompress(f, buf, size, filename);
+#endif
+#if HAVE_LZMA == 1
+	case COMPRESSION_XZ:
+		return xz_decompress(f, buf, size, filename);
+#endif
+#if HAVE_ZSTD == 1
+	case COMPRESSION_ZSTD:
+		return zstd_decompress(f, buf, size, filename);
+#endif
+	default:
+		return unsupported(c, filename);
+	}
+}
+
+int compress_to_file(FILE *f, enum compression c, const uint8_t *buf, unsigned long size, const char *filename)
+{
+	msg_gdbg("Compressing image \"%s\" with %s.\n", filename, formats[c].name);
+	switch (c) {
+#if HAVE_ZLIB == 1
+	case COMPRESSION_GZIP:
+		return gzip_compress(f, buf, size, filename);
+#endif
+#if HAVE_LZMA == 1
+	case COMPRESSION_XZ:
+		return xz_compress(f, buf, size, filename);
+#endif
+#if HAVE_ZSTD == 1
+	case COMPRESSION_ZSTD:
+		return zstd_compress(f, buf, size, filename);
+#endif
+	default:
+		return unsupported(c, filename);
+	}
+}
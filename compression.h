@@ -0,0 +1,40 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __COMPRESSION_H__
+#define __COMPRESSION_H__ 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+enum compression {
+	COMPRESSION_NONE,
+	COMPRESSION_GZIP,
+	COMPRESSION_XZ,
+	COMPRESSION_ZSTD,
+};
+
+/* Detects the format of a file from its first bytes. */
+enum compression compression_by_magic(const uint8_t *magic, size_t len);
+/* Selects the format for a new file by its extension (.gz, .xz or .zst). */
+enum compression compression_by_name(const char *filename);
+/* Returns 0 if this build can write filename in the format its extension selects. */
+int compression_check_name(const char *filename);
+
+/* Decompresses all of f into buf, which must end up filled exactly. */
+int decompress_file(FILE *f, enum compression, uint8_t *buf, unsigned long size, const char *filename);
+/* Compresses buf into f. */
+int compress_to_file(FILE *f, enum compression, const uint8_t *buf, unsigned long size, const char *filename);
+
+#endif				/* !__COMPRESSION_H__ */
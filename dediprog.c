@@ -328,20 +328,30 @@ static int dediprog_set_spi_voltage(int millivolt)
 struct dediprog_spispeeds {
 	const char *const name;
 	const int speed;
+	const unsigned int khz;
 };
 
 static const struct dediprog_spispeeds spispeeds[] = {
-	{ "24M",	0x0 },
-	{ "12M",	0x2 },
-	{ "8M",		0x1 },
-	{ "3M",		0x3 },
-	{ "2.18M",	0x4 },
-	{ "1.5M",	0x5 },
-	{ "750k",	0x6 },
-	{ "375k",	0x7 },
-	{ NULL,		0x0 },
+	{ "24M",	0x0,	24000 },
+	{ "12M",	0x2,	12000 },
+	{ "8M",		0x1,	8000 },
+	{ "3M",		0x3,	3000 },
+	{ "2.18M",	0x4,	2180 },
+	{ "1.5M",	0x5,	1500 },
+	{ "750k",	0x6,	750 },
+	{ "375k",	0x7,	375 },
+	{ NULL,		0x0,	0 },
 };
 
+/* SPI clock set by us, 0 if unknown. */
+static unsigned int dediprog_spispeed_khz;
+
+/* Some older chips specify plain READ (0x03) only up to 20 MHz, use FAST READ above. */
+#define DEDIPROG_STD_READ_MAX_KHZ	20000
+
+/* Bulk transfers that don't address the chip with 4 bytes can't cross a 16 MiB boundary. */
+#define DEDIPROG_BULK_SEGMENT		(16 * 1024 * 1024)
+
 static int dediprog_set_spi_speed(unsigned int spispeed_idx)
 {
 	if (dediprog_firmwareversion < FIRMWARE_VERSION(5, 0, 0)) {
@@ -357,6 +367,7 @@ static int dediprog_set_spi_speed(unsigned int spispeed_idx)
 		msg_perr("Command Set SPI Speed 0x%x failed!\n", spispeed->speed);
 		return 1;
 	}
+	dediprog_spispeed_khz = spispeed->khz;
 	return 0;
 }
 
@@ -371,23 +382,58 @@ static int prepare_rw_cmd(
 		return 1;
 	}
 
+	uint8_t opcode = 0;
+	bool addr_4ba = false;
+
+	/* Pick the fastest firmware mode the chip can handle. */
+	if (is_read) {
+		if (protocol() >= PROTOCOL_V2 && flash->chip->feature_bits & FEATURE_4BA_FAST_READ) {
+			dedi_spi_cmd = READ_MODE_4B_ADDR_FAST_0x0C;
+			opcode = JEDEC_READ_4BA_FAST;
+			addr_4ba = true;
+		} else if (protocol() >= PROTOCOL_V2 && flash->in_4ba_mode) {
+			dedi_spi_cmd = READ_MODE_4B_ADDR_FAST;
+			opcode = JEDEC_READ_FAST;
+			addr_4ba = true;
+		} else if (dediprog_spispeed_khz > DEDIPROG_STD_READ_MAX_KHZ) {
+			dedi_spi_cmd = READ_MODE_FAST;
+			opcode = JEDEC_READ_FAST;
+		}
+	} else if (protocol() >= PROTOCOL_V2 && dedi_spi_cmd == WRITE_MODE_PAGE_PGM) {
+		if (flash->chip->feature_bits & FEATURE_4BA_WRITE) {
+			dedi_spi_cmd = WRITE_MODE_4B_ADDR_256B_PAGE_PGM_0x12;
+			opcode = JEDEC_BYTE_PROGRAM_4BA;
+			addr_4ba = true;
+		} else if (flash->in_4ba_mode) {
+			dedi_spi_cmd = WRITE_MODE_4B_ADDR_256B_PAGE_PGM;
+			opcode = JEDEC_BYTE_PROGRAM;
+			addr_4ba = true;
+		}
+	}
+
+	if (!addr_4ba) {
+		/*
+		 * The firmware only sends the lower 3 address bytes. Callers
+		 * split transfers at 16 MiB, so that the upper byte can be
+		 * set in the extended address register.
+		 */
+		if (flash->chip->feature_bits & FEATURE_4BA_EXT_ADDR) {
+			if (spi_set_extended_address(flash, start >> 24))
+				return 1;
+		} else if (start >> 24) {
+			msg_cerr("Can't handle 4-byte address with dediprog.\n");
+			return 1;
+		}
+	}
+
 	/* First 5 bytes are common in both generations. */
 	data_packet[0] = count & 0xff;
 	data_packet[1] = (count >> 8) & 0xff;
 	data_packet[2] = 0; /* RFU */
-	data_packet[3] = dedi_spi_cmd; /* Read/Write Mode (currently READ_MODE_STD, WRITE_MODE_PAGE_PGM or WRITE_MODE_2B_AAI) */
-	data_packet[4] = 0; /* "Opcode". Specs imply necessity only for READ_MODE_4B_ADDR_FAST and WRITE_MODE_4B_ADDR_256B_PAGE_PGM */
+	data_packet[3] = dedi_spi_cmd; /* Read/Write Mode */
+	data_packet[4] = opcode; /* Specs imply necessity only for the FAST and 4B_ADDR modes */
 
 	if (protocol() >= PROTOCOL_V2) {
-		if (is_read && flash->chip->feature_bits & FEATURE_4BA_FAST_READ) {
-			data_packet[3] = READ_MODE_4B_ADDR_FAST_0x0C;
-			data_packet[4] = JEDEC_READ_4BA_FAST;
-		} else if (dedi_spi_cmd == WRITE_MODE_PAGE_PGM
-			   && (flash->chip->feature_bits & FEATURE_4BA_WRITE)) {
-			data_packet[3] = WRITE_MODE_4B_ADDR_256B_PAGE_PGM_0x12;
-			data_packet[4] = JEDEC_BYTE_PROGRAM_4BA;
-		}
-
 		*value = *idx = 0;
 		data_packet[5] = 0; /* RFU */
 		data_packet[6] = (start >>  0) & 0xff;
@@ -396,8 +442,17 @@ static int prepare_rw_cmd(
 		data_packet[9] = (start >> 24) & 0xff;
 		if (protocol() >= PROTOCOL_V3) {
 			if (is_read) {
-				data_packet[10] = 0x00;	/* address length (3 or 4) */
-				data_packet[11] = 0x00;	/* dummy cycle / 2 */
+				/*
+				 * The firmware frames fast reads from these. Standard reads
+				 * keep sending 0 for both, as they always did.
+				 */
+				if (dedi_spi_cmd == READ_MODE_STD) {
+					data_packet[10] = 0;
+					data_packet[11] = 0;
+				} else {
+					data_packet[10] = addr_4ba ? 4 : 3;	/* address length (3 or 4) */
+					data_packet[11] = 8 / 2;		/* dummy cycle / 2 */
+				}
 			} else {
 				/* 16 LSBs and 16 HSBs of page size */
 				/* FIXME: This assumes page size of 256. */
@@ -408,18 +463,6 @@ static int prepare_rw_cmd(
 			}
 		}
 	} else {
-		if (flash->chip->feature_bits & FEATURE_4BA_EXT_ADDR) {
-			if (spi_set_extended_address(flash, start >> 24))
-				return 1;
-		} else if (start >> 24) {
-			msg_cerr("Can't handle 4-byte address with dediprog.\n");
-			return 1;
-		}
-		/*
-		 * We don't know how the dediprog firmware handles 4-byte
-		 * addresses. So let's not tell it what we are doing and
-		 * only send the lower 3 bytes.
-		 */
 		*value = start & 0xffff;
 		*idx = (start >> 16) & 0xff;
 	}
@@ -532,13 +575,21 @@ err_free:
 	return err;
 }
 
+/* Returns how much of a bulk transfer from start can be sent with one command. */
+static unsigned int bulk_segment_len(unsigned int start, unsigned int len)
+{
+	const unsigned int left = DEDIPROG_BULK_SEGMENT - start % DEDIPROG_BULK_SEGMENT;
+
+	return len < left ? len : left;
+}
+
 static int dediprog_spi_read(struct flashctx *flash, uint8_t *buf, unsigned int start, unsigned int len)
 {
 	int ret;
 	/* chunksize must be 512, other sizes will NOT work at all. */
 	const unsigned int chunksize = 0x200;
 	unsigned int residue = start % chunksize ? min(len, chunksize - start % chunksize) : 0;
-	unsigned int bulklen;
+	unsigned int bulklen, done, seglen;
 
 	dediprog_set_leds(LED_BUSY);
 
@@ -552,9 +603,12 @@ static int dediprog_spi_read(struct flashctx *flash, uint8_t *buf, unsigned int
 
 	/* Round down. */
 	bulklen = (len - residue) / chunksize * chunksize;
-	ret = dediprog_spi_bulk_read(flash, buf + residue, start + residue, bulklen);
-	if (ret)
-		goto err;
+	for (done = 0; done < bulklen; done += seglen) {
+		seglen = bulk_segment_len(start + residue + done, bulklen - done);
+		ret = dediprog_spi_bulk_read(flash, buf + residue + done, start + residue + done, seglen);
+		if (ret)
+			goto err;
+	}
 
 	len -= residue + bulklen;
 	if (len != 0) {
@@ -652,13 +706,26 @@ static int dediprog_spi_bulk_write(struct flashctx *flash, const uint8_t *buf, u
 	return 0;
 }
 
+/* Writes what the firmware can't take in bulk with plain SPI commands. */
+static int dediprog_spi_write_slow(struct flashctx *flash, const uint8_t *buf,
+				   unsigned int start, unsigned int len, uint8_t dedi_spi_cmd)
+{
+	msg_pdbg("Slow write for partial block from 0x%x, length 0x%x\n", start, len);
+	/* AAI chips only take single bytes with the page program opcode. */
+	if (dedi_spi_cmd == WRITE_MODE_2B_AAI)
+		return spi_chip_write_1(flash, buf, start, len);
+	/* No idea about the real limit. Maybe 16 including command and address, maybe more. */
+	return spi_write_chunked(flash, buf, start, len, 11);
+}
+
 static int dediprog_spi_write(struct flashctx *flash, const uint8_t *buf,
 			      unsigned int start, unsigned int len, uint8_t dedi_spi_cmd)
 {
 	int ret;
-	const unsigned int chunksize = flash->chip->page_size;
+	/* AAI doesn't know pages, the firmware takes it in the same 256 byte chunks. */
+	const unsigned int chunksize = dedi_spi_cmd == WRITE_MODE_2B_AAI ? 256 : flash->chip->page_size;
 	unsigned int residue = start % chunksize ? chunksize - start % chunksize : 0;
-	unsigned int bulklen;
+	unsigned int bulklen, done, seglen;
 
 	dediprog_set_leds(LED_BUSY);
 
@@ -668,40 +735,37 @@ static int dediprog_spi_write(struct flashctx *flash, const uint8_t *buf,
 		/* Write everything like it was residue. */
 		residue = len;
 	}
+	residue = min(residue, len);
 
 	if (residue) {
-		msg_pdbg("Slow write for partial block from 0x%x, length 0x%x\n",
-			 start, residue);
-		/* No idea about the real limit. Maybe 16 including command and address, maybe more. */
-		ret = spi_write_chunked(flash, buf, start, residue, 11);
-		if (ret) {
-			dediprog_set_leds(LED_ERROR);
-			return ret;
-		}
+		ret = dediprog_spi_write_slow(flash, buf, start, residue, dedi_spi_cmd);
+		if (ret)
+			goto err;
 	}
 
 	/* Round down. */
 	bulklen = (len - residue) / chunksize * chunksize;
-	ret = dediprog_spi_bulk_write(flash, buf + residue, chunksize, start + residue, bulklen, dedi_spi_cmd);
-	if (ret) {
-		dediprog_set_leds(LED_ERROR);
-		return ret;
+	for (done = 0; done < bulklen; done += seglen) {
+		seglen = bulk_segment_len(start + residue + done, bulklen - done);
+		ret = dediprog_spi_bulk_write(flash, buf + residue + done, chunksize,
+					      start + residue + done, seglen, dedi_spi_cmd);
+		if (ret)
+			goto err;
 	}
 
 	len -= residue + bulklen;
 	if (len) {
-		msg_pdbg("Slow write for partial block from 0x%x, length 0x%x\n",
-			 start, len);
-		ret = spi_write_chunked(flash, buf + residue + bulklen,
-				        start + residue + bulklen, len, 11);
-		if (ret) {
-			dediprog_set_leds(LED_ERROR);
-			return ret;
-		}
+		ret = dediprog_spi_write_slow(flash, buf + residue + bulklen,
+					      start + residue + bulklen, len, dedi_spi_cmd);
+		if (ret)
+			goto err;
 	}
 
 	dediprog_set_leds(LED_PASS);
 	return 0;
+err:
+	dediprog_set_leds(LED_ERROR);
+	return ret;
 }
 
 static int dediprog_spi_write_256(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len)
@@ -1271,8 +1335,11 @@ int dediprog_init(void)
 	if (dediprog_devicetype == DEV_SF100 && protocol() == PROTOCOL_V1)
 		spi_master_dediprog.features &= ~SPI_MASTER_NO_4BA_MODES;
 
-	if (protocol() == PROTOCOL_V2)
+	/* The new protocols carry the full address and have 4-byte address bulk modes. */
+	if (protocol() >= PROTOCOL_V2) {
+		spi_master_dediprog.features &= ~SPI_MASTER_NO_4BA_MODES;
 		spi_master_dediprog.features |= SPI_MASTER_4BA;
+	}
 
 	if (register_spi_master(&spi_master_dediprog) || dediprog_set_leds(LED_NONE))
 		return 1;
@@ -0,0 +1,401 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "flash.h"
+#include "layout.h"
+#include "digest.h"
+#include "delta.h"
+
+#define DELTA_HEADER_SIZE	(8 + 4 + 4 + 2 * SHA256_DIGEST_SIZE)
+#define DELTA_HUNK_HEADER_SIZE	(4 + 4)
+
+static uint32_t get_le32(const uint8_t *p)
+{
+	return (uint32_t)p[3] << 24 | p[2] << 16 | p[1] << 8 | p[0];
+}
+
+static void put_le32(uint8_t *p, uint32_t val)
+{
+	p[0] = val;
+	p[1] = val >> 8;
+	p[2] = val >> 16;
+	p[3] = val >> 24;
+}
+
+#ifndef __LIBPAYLOAD__
+static uint8_t *load_file(const char *filename, size_t *len)
+{
+	struct stat st;
+	uint8_t *buf = NULL;
+	FILE *f;
+
+	if ((f = fopen(filename, "rb")) == NULL) {
+		msg_gerr("Error: opening file \"%s\" failed: %s\n", filename, strerror(errno));
+		return NULL;
+	}
+	if (fstat(fileno(f), &st) != 0) {
+		msg_gerr("Error: getting metadata of file \"%s\" failed: %s\n", filename, strerror(errno));
+		goto _close_ret;
+	}
+	*len = st.st_size;
+	buf = malloc(*len ? *len : 1);
+	if (!buf) {
+		msg_gerr("Out of memory!\n");
+		goto _close_ret;
+	}
+	if (fread(buf, 1, *len, f) != *len) {
+		msg_gerr("Error: Failed to read complete file \"%s\".\n", filename);
+		free(buf);
+		buf = NULL;
+	}
+_close_ret:
+	(void)fclose(f);
+	return buf;
+}
+#endif
+
+bool is_delta_file(const char *filename)
+{
+#ifdef __LIBPAYLOAD__
+	return false;
+#else
+	char magic[sizeof(DELTA_MAGIC) - 1];
+	FILE *const f = fopen(filename, "rb");
+	bool ret;
+
+	if (!f)
+		return false;
+	ret = fread(magic, 1, sizeof(magic), f) == sizeof(magic) && !memcmp(magic, DELTA_MAGIC, sizeof(magic));
+	(void)fclose(f);
+	return ret;
+#endif
+}
+
+void delta_free(struct delta *delta)
+{
+	if (!delta)
+		return;
+	free(delta->file);
+	free(delta);
+}
+
+struct delta *delta_load(const char *filename, chipsize_t image_size)
+{
+#ifdef __LIBPAYLOAD__
+	msg_gerr("Error: No file I/O support in libpayload\n");
+	return NULL;
+#else
+	struct delta *const delta = calloc(1, sizeof(*delta));
+	size_t len, pos;
+	unsigned int i;
+
+	if (!delta) {
+		msg_gerr("Out of memory!\n");
+		return NULL;
+	}
+	delta->file = load_file(filename, &len);
+	if (!delta->file)
+		goto _free_ret;
+
+	if (len < DELTA_HEADER_SIZE || memcmp(delta->file, DELTA_MAGIC, sizeof(DELTA_MAGIC) - 1)) {
+		msg_gerr("Error: \"%s\" is not a delta file.\n", filename);
+		goto _free_ret;
+	}
+	delta->image_size = get_le32(delta->file + 8);
+	delta->num_hunks = get_le32(delta->file + 12);
+	memcpy(delta->base_sha256, delta->file + 16, SHA256_DIGEST_SIZE);
+	memcpy(delta->result_sha256, delta->file + 16 + SHA256_DIGEST_SIZE, SHA256_DIGEST_SIZE);
+	if (delta->image_size != image_size) {
+		msg_gerr("Error: Delta \"%s\" is for an image of %u B, but the flash chip has %u B.\n",
+			 filename, delta->image_size, image_size);
+		goto _free_ret;
+	}
+	if (delta->num_hunks > MAX_ROMLAYOUT) {
+		msg_gerr("Error: Delta \"%s\" has more than %d hunks.\n", filename, MAX_ROMLAYOUT);
+		goto _free_ret;
+	}
+
+	pos = DELTA_HEADER_SIZE;
+	for (i = 0; i < delta->num_hunks; i++) {
+		struct delta_hunk *const hunk = &delta->hunks[i];
+
+		if (len - pos < DELTA_HUNK_HEADER_SIZE)
+			goto _truncated;
+		hunk->start = get_le32(delta->file + pos);
+		hunk->len = get_le32(delta->file + pos + 4);
+		pos += DELTA_HUNK_HEADER_SIZE;
+		if (hunk->len > len - pos)
+			goto _truncated;
+		hunk->xor = delta->file + pos;
+		pos += hunk->len;
+
+		if (!hunk->len || hunk->start >= image_size || hunk->len > image_size - hunk->start ||
+		    (i && hunk->start < delta->hunks[i - 1].start + delta->hunks[i - 1].len)) {
+			msg_gerr("Error: Hunk %u of delta \"%s\" is empty, out of bounds or out of order.\n",
+				 i, filename);
+			goto _free_ret;
+		}
+	}
+	if (pos != len) {
+		msg_gerr("Error: Delta \"%s\" has trailing data.\n", filename);
+		goto _free_ret;
+	}
+	return delta;
+
+_truncated:
+	msg_gerr("Error: Delta \"%s\" is truncated.\n", filename);
+_free_ret:
+	delta_free(delta);
+	return NULL;
+#endif
+}
+
+int delta_to_layout(const struct delta *delta, struct flashrom_layout *layout, chipsize_t block_size)
+{
+	struct layout_range ranges[MAX_ROMLAYOUT];
+	unsigned int i;
+
+	for (i = 0; i < delta->num_hunks; i++) {
+		ranges[i].start = delta->hunks[i].start;
+		ranges[i].end = delta->hunks[i].start + delta->hunks[i].len - 1;
+	}
+	return layout_add_coalesced(layout, ranges, delta->num_hunks, block_size, "delta");
+}
+
+static void hash_hunks(const struct delta *delta, const uint8_t *buf, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+	struct sha256_state s;
+	unsigned int i;
+
+	sha256_init(&s);
+	for (i = 0; i < delta->num_hunks; i++)
+		sha256_update(&s, buf + delta->hunks[i].start, delta->hunks[i].len);
+	sha256_final(&s, digest);
+}
+
+int delta_apply(const struct delta *delta, uint8_t *buf)
+{
+	uint8_t digest[SHA256_DIGEST_SIZE];
+	chipsize_t patched = 0;
+	unsigned int i;
+	chipsize_t j;
+
+	hash_hunks(delta, buf, digest);
+	if (memcmp(digest, delta->base_sha256, sizeof(digest))) {
+		if (!memcmp(digest, delta->result_sha256, sizeof(digest))) {
+			msg_ginfo("The flash chip already contains the patched contents.\n");
+			return 0;
+		}
+		msg_gerr("Error: The flash chip contents don't match the base of the delta.\n");
+		return 1;
+	}
+
+	for (i = 0; i < delta->num_hunks; i++) {
+		const struct delta_hunk *const hunk = &delta->hunks[i];
+		for (j = 0; j < hunk->len; j++)
+			buf[hunk->start + j] ^= hunk->xor[j];
+		patched += hunk->len;
+	}
+
+	hash_hunks(delta, buf, digest);
+	if (memcmp(digest, delta->result_sha256, sizeof(digest))) {
+		msg_gerr("Error: The patched contents don't match the hash of the delta, it is corrupt.\n");
+		return 1;
+	}
+	msg_ginfo("Delta base verified, patching %u B in %u hunk%s.\n",
+		  patched, delta->num_hunks, delta->num_hunks == 1 ? "" : "s");
+	return 0;
+}
+
+int delta_check_result(const struct delta *delta, const uint8_t *buf)
+{
+	uint8_t digest[SHA256_DIGEST_SIZE];
+
+	hash_hunks(delta, buf, digest);
+	return !!memcmp(digest, delta->result_sha256, sizeof(digest));
+}
+
+static int compare_chipsize(const void *a, const void *b)
+{
+	const chipsize_t x = *(const chipsize_t *)a, y = *(const chipsize_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Collects the runs of differing bytes into hunks. A hunk costs its header,
+ * so gaps up to that size are always bridged. If there are more than
+ * MAX_ROMLAYOUT runs, the smallest gaps are bridged until they fit.
+ */
+static int find_hunks(const uint8_t *base, const uint8_t *new, chipsize_t size, struct delta *delta)
+{
+	struct delta_hunk *runs = NULL;
+	chipsize_t *gaps = NULL, threshold = 0;
+	unsigned int num = 0, alloc = 0, at_threshold = 0, i;
+	chipoff_t pos = 0, start, last;
+	int ret = 1;
+
+	while (pos < size) {
+		if (base[pos] == new[pos]) {
+			pos++;
+			continue;
+		}
+		start = last = pos;
+		for (pos++; pos < size && pos - last <= DELTA_HUNK_HEADER_SIZE; pos++) {
+			if (base[pos] != new[pos])
+				last = pos;
+		}
+		if (num == alloc) {
+			struct delta_hunk *const tmp = realloc(runs, (alloc = alloc * 2 + 64) * sizeof(*runs));
+			if (!tmp) {
+				msg_gerr("Out of memory!\n");
+				goto _free_ret;
+			}
+			runs = tmp;
+		}
+		runs[num].start = start;
+		runs[num].len = last - start + 1;
+		num++;
+		pos = last + 1;
+	}
+
+	if (num > MAX_ROMLAYOUT) {
+		const unsigned int merges = num - MAX_ROMLAYOUT;
+
+		gaps = malloc((num - 1) * sizeof(*gaps));
+		if (!gaps) {
+			msg_gerr("Out of memory!\n");
+			goto _free_ret;
+		}
+		for (i = 1; i < num; i++)
+			gaps[i - 1] = runs[i].start - (runs[i - 1].start + runs[i - 1].len);
+		qsort(gaps, num - 1, sizeof(*gaps), compare_chipsize);
+		threshold = gaps[merges - 1];
+		/* Bridge all gaps below the threshold and as many as needed at it. */
+		for (i = 0; i < merges; i++)
+			at_threshold += gaps[i] == threshold;
+	}
+
+	delta->num_hunks = 0;
+	for (i = 0; i < num; i++) {
+		if (i && gaps) {
+			struct delta_hunk *const prev = &delta->hunks[delta->num_hunks - 1];
+			const chipsize_t gap = runs[i].start - (prev->start + prev->len);
+			if (gap < threshold || (gap == threshold && at_threshold)) {
+				if (gap == threshold)
+					at_threshold--;
+				prev->len = runs[i].start + runs[i].len - prev->start;
+				continue;
+			}
+		}
+		delta->hunks[delta->num_hunks++] = runs[i];
+	}
+	ret = 0;
+
+_free_ret:
+	free(gaps);
+	free(runs);
+	return ret;
+}
+
+int delta_create(const char *base_file, const char *new_file, const char *delta_file)
+{
+#ifdef __LIBPAYLOAD__
+	msg_gerr("Error: No file I/O support in libpayload\n");
+	return 1;
+#else
+	struct delta *const delta = calloc(1, sizeof(*delta));
+	uint8_t *base = NULL, *new = NULL, *xor = NULL;
+	uint8_t header[DELTA_HEADER_SIZE], hunk_header[DELTA_HUNK_HEADER_SIZE];
+	size_t base_len, new_len;
+	chipsize_t total = 0;
+	unsigned int i;
+	chipsize_t j;
+	FILE *f = NULL;
+	int ret = 1;
+
+	if (!delta) {
+		msg_gerr("Out of memory!\n");
+		return 1;
+	}
+	base = load_file(base_file, &base_len);
+	new = load_file(new_file, &new_len);
+	if (!base || !new)
+		goto _free_ret;
+	if (base_len != new_len || !base_len || base_len > FL_MAX_CHIPOFF + 1) {
+		msg_gerr("Error: \"%s\" and \"%s\" must be images of the same size.\n", base_file, new_file);
+		goto _free_ret;
+	}
+	delta->image_size = base_len;
+
+	if (find_hunks(base, new, delta->image_size, delta))
+		goto _free_ret;
+	hash_hunks(delta, base, delta->base_sha256);
+	hash_hunks(delta, new, delta->result_sha256);
+
+	xor = malloc(delta->image_size);
+	if (!xor) {
+		msg_gerr("Out of memory!\n");
+		goto _free_ret;
+	}
+	if ((f = fopen(delta_file, "wb")) == NULL) {
+		msg_gerr("Error: opening file \"%s\" failed: %s\n", delta_file, strerror(errno));
+		goto _free_ret;
+	}
+	memcpy(header, DELTA_MAGIC, sizeof(DELTA_MAGIC) - 1);
+	put_le32(header + 8, delta->image_size);
+	put_le32(header + 12, delta->num_hunks);
+	memcpy(header + 16, delta->base_sha256, SHA256_DIGEST_SIZE);
+	memcpy(header + 16 + SHA256_DIGEST_SIZE, delta->result_sha256, SHA256_DIGEST_SIZE);
+	if (fwrite(header, 1, sizeof(header), f) != sizeof(header))
+		goto _write_failed;
+
+	for (i = 0; i < delta->num_hunks; i++) {
+		const struct delta_hunk *const hunk = &delta->hunks[i];
+
+		put_le32(hunk_header, hunk->start);
+		put_le32(hunk_header + 4, hunk->len);
+		for (j = 0; j < hunk->len; j++)
+			xor[j] = base[hunk->start + j] ^ new[hunk->start + j];
+		if (fwrite(hunk_header, 1, sizeof(hunk_header), f) != sizeof(hunk_header) ||
+		    fwrite(xor, 1, hunk->len, f) != hunk->len)
+			goto _write_failed;
+		total += hunk->len;
+	}
+	if (fflush(f))
+		goto _write_failed;
+
+	if (delta->num_hunks)
+		msg_ginfo("Wrote delta \"%s\" covering %u B in %u hunk%s.\n",
+			  delta_file, total, delta->num_hunks, delta->num_hunks == 1 ? "" : "s");
+	else
+		msg_ginfo("The images are identical, wrote an empty delta \"%s\".\n", delta_file);
+	ret = 0;
+	goto _free_ret;
+
+_write_failed:
+	msg_gerr("Error: file %s could not be written completely.\n", delta_file);
+_free_ret:
+	if (f)
+		(void)fclose(f);
+	free(xor);
+	free(new);
+	free(base);
+	delta_free(delta);
+	return ret;
+#endif
+}
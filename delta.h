@@ -0,0 +1,76 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __DELTA_H__
+#define __DELTA_H__ 1
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "digest.h"
+#include "layout.h"
+
+/*
+ * A delta file, all numbers little-endian:
+ *
+ *   "FRDELTA1"		magic
+ *   u32		size of the image it applies to
+ *   u32		number of hunks, at most MAX_ROMLAYOUT
+ *   u8[32]		SHA-256 of the base contents of all hunks, in file order
+ *   u8[32]		SHA-256 of the patched contents of all hunks, in file order
+ *   hunks, sorted by offset and not overlapping:
+ *     u32 offset, u32 length, u8[length] to be XORed onto the base
+ *
+ * Only the hunks have to be read from the chip to check and apply it.
+ */
+
+#define DELTA_MAGIC	"FRDELTA1"
+
+struct delta_hunk {
+	chipoff_t start;
+	chipsize_t len;
+	const uint8_t *xor;
+};
+
+struct delta {
+	chipsize_t image_size;
+	unsigned int num_hunks;
+	struct delta_hunk hunks[MAX_ROMLAYOUT];
+	uint8_t base_sha256[SHA256_DIGEST_SIZE];
+	uint8_t result_sha256[SHA256_DIGEST_SIZE];
+	uint8_t *file;		/* hunk data points into this */
+};
+
+bool is_delta_file(const char *filename);
+
+/* Reads and checks a delta file for an image of the given size. Free the result with delta_free(). */
+struct delta *delta_load(const char *filename, chipsize_t image_size);
+void delta_free(struct delta *);
+
+/*
+ * Adds the hunks as included regions named "delta_<offset>", merged per erase block of
+ * block_size. The regions then also cover the unchanged bytes between merged hunks.
+ */
+int delta_to_layout(const struct delta *, struct flashrom_layout *, chipsize_t block_size);
+
+/*
+ * Checks the hunks of buf against the base hash and patches them in place. If
+ * they already match the patched hash, buf is left alone and 0 returned, too.
+ */
+int delta_apply(const struct delta *, uint8_t *buf);
+/* Returns 0 if the hunks of buf match the patched hash. */
+int delta_check_result(const struct delta *, const uint8_t *buf);
+
+/* Writes the delta from base_file to new_file, which must be of equal size, to delta_file. */
+int delta_create(const char *base_file, const char *new_file, const char *delta_file);
+
+#endif				/* !__DELTA_H__ */
@@ -0,0 +1,257 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flash.h"
+#include "layout.h"
+#include "libflashrom.h"
+#include "digest.h"
+
+/* === SHA-256 (FIPS 180-4) === */
+
+static const uint32_t sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROR32(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(struct sha256_state *s, const uint8_t *p)
+{
+	uint32_t w[64], a, b, c, d, e, f, g, h, t1, t2;
+	unsigned int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = (uint32_t)p[4 * i] << 24 | p[4 * i + 1] << 16 | p[4 * i + 2] << 8 | p[4 * i + 3];
+	for (; i < 64; i++) {
+		const uint32_t s0 = ROR32(w[i - 15], 7) ^ ROR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		const uint32_t s1 = ROR32(w[i - 2], 17) ^ ROR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	a = s->h[0]; b = s->h[1]; c = s->h[2]; d = s->h[3];
+	e = s->h[4]; f = s->h[5]; g = s->h[6]; h = s->h[7];
+	for (i = 0; i < 64; i++) {
+		t1 = h + (ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+		t2 = (ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+		h = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+	s->h[0] += a; s->h[1] += b; s->h[2] += c; s->h[3] += d;
+	s->h[4] += e; s->h[5] += f; s->h[6] += g; s->h[7] += h;
+}
+
+void sha256_init(struct sha256_state *s)
+{
+	static const uint32_t h0[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+	};
+
+	memcpy(s->h, h0, sizeof(h0));
+	s->len = 0;
+	s->fill = 0;
+}
+
+void sha256_update(struct sha256_state *s, const uint8_t *buf, size_t len)
+{
+	s->len += len;
+	if (s->fill) {
+		const size_t n = min(len, sizeof(s->block) - s->fill);
+		memcpy(s->block + s->fill, buf, n);
+		s->fill += n;
+		buf += n;
+		len -= n;
+		if (s->fill < sizeof(s->block))
+			return;
+		sha256_block(s, s->block);
+		s->fill = 0;
+	}
+	for (; len >= sizeof(s->block); buf += sizeof(s->block), len -= sizeof(s->block))
+		sha256_block(s, buf);
+	memcpy(s->block, buf, len);
+	s->fill = len;
+}
+
+void sha256_final(struct sha256_state *s, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+	const uint64_t bits = s->len * 8;
+	unsigned int i;
+
+	s->block[s->fill++] = 0x80;
+	if (s->fill > sizeof(s->block) - 8) {
+		memset(s->block + s->fill, 0, sizeof(s->block) - s->fill);
+		sha256_block(s, s->block);
+		s->fill = 0;
+	}
+	memset(s->block + s->fill, 0, sizeof(s->block) - 8 - s->fill);
+	for (i = 0; i < 8; i++)
+		s->block[56 + i] = bits >> (56 - 8 * i);
+	sha256_block(s, s->block);
+
+	for (i = 0; i < SHA256_DIGEST_SIZE; i++)
+		digest[i] = s->h[i / 4] >> (24 - 8 * (i % 4));
+}
+
+/* === CRC-32C === */
+
+uint32_t crc32c_update(uint32_t crc, const uint8_t *buf, size_t len)
+{
+	static uint32_t table[256];
+	unsigned int i, j;
+
+	if (!table[1]) {
+		for (i = 0; i < 256; i++) {
+			uint32_t c = i;
+			for (j = 0; j < 8; j++)
+				c = (c >> 1) ^ (c & 1 ? 0x82f63b78 : 0);
+			table[i] = c;
+		}
+	}
+
+	crc = ~crc;
+	while (len--)
+		crc = (crc >> 8) ^ table[(crc ^ *buf++) & 0xff];
+	return ~crc;
+}
+
+/* === Reporting === */
+
+static const struct {
+	const char *name;
+	unsigned int bit;
+} digest_names[] = {
+	{ "sha256",	FLASHROM_DIGEST_SHA256 },
+	{ "crc32c",	FLASHROM_DIGEST_CRC32C },
+};
+
+int digest_parse_list(const char *list, unsigned int *digests)
+{
+	char *const copy = strdup(list);
+	char *name, *saveptr = NULL;
+	unsigned int i;
+	int ret = 0;
+
+	if (!copy)
+		return 1;
+
+	*digests = 0;
+	for (name = strtok_r(copy, ",", &saveptr); name; name = strtok_r(NULL, ",", &saveptr)) {
+		for (i = 0; i < ARRAY_SIZE(digest_names); i++) {
+			if (!strcmp(name, digest_names[i].name)) {
+				*digests |= digest_names[i].bit;
+				break;
+			}
+		}
+		if (i == ARRAY_SIZE(digest_names)) {
+			msg_gerr("Unknown digest \"%s\", supported are sha256 and crc32c.\n", name);
+			ret = 1;
+			break;
+		}
+	}
+	free(copy);
+	return ret;
+}
+
+static void json_print_string(FILE *f, const char *str)
+{
+	fputc('"', f);
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			fprintf(f, "\\%c", *str);
+		else if ((unsigned char)*str < 0x20)
+			fprintf(f, "\\u%04x", *str);
+		else
+			fputc(*str, f);
+	}
+	fputc('"', f);
+}
+
+int digest_report_by_layout(const struct flashctx *flash, const uint8_t *buffer)
+{
+	const struct flashrom_layout *const layout = get_layout(flash);
+	const struct romentry *entry = NULL;
+	FILE *json = NULL;
+	int ret = 0;
+
+	if (!flash->digests)
+		return 0;
+
+	if (flash->digest_json) {
+#ifdef __LIBPAYLOAD__
+		msg_gerr("Error: No file I/O support in libpayload\n");
+		return 1;
+#endif
+		json = fopen(flash->digest_json, "w");
+		if (!json) {
+			msg_gerr("Error: opening file \"%s\" failed: %s\n", flash->digest_json, strerror(errno));
+			return 1;
+		}
+		fprintf(json, "{\n  \"chip\": ");
+		json_print_string(json, flash->chip->name);
+		fprintf(json, ",\n  \"size\": %u,\n  \"regions\": [", flash->chip->total_size * 1024);
+	}
+
+	while ((entry = layout_next_included(layout, entry))) {
+		const chipsize_t len = entry->end - entry->start + 1;
+		char sha256_hex[2 * SHA256_DIGEST_SIZE + 1] = "";
+		uint32_t crc32c = 0;
+
+		if (flash->digests & FLASHROM_DIGEST_SHA256) {
+			struct sha256_state s;
+			uint8_t digest[SHA256_DIGEST_SIZE];
+			unsigned int i;
+
+			sha256_init(&s);
+			sha256_update(&s, buffer + entry->start, len);
+			sha256_final(&s, digest);
+			for (i = 0; i < SHA256_DIGEST_SIZE; i++)
+				sprintf(sha256_hex + 2 * i, "%02x", digest[i]);
+			msg_ginfo("SHA-256 of %s (0x%" PRIxCHIPOFF "-0x%" PRIxCHIPOFF "): %s\n",
+				  entry->name, entry->start, entry->end, sha256_hex);
+		}
+		if (flash->digests & FLASHROM_DIGEST_CRC32C) {
+			crc32c = crc32c_update(0, buffer + entry->start, len);
+			msg_ginfo("CRC32C of %s (0x%" PRIxCHIPOFF "-0x%" PRIxCHIPOFF "): %08x\n",
+				  entry->name, entry->start, entry->end, crc32c);
+		}
+
+		if (!json)
+			continue;
+		fprintf(json, "%s\n    { \"name\": ", entry == layout_next_included(layout, NULL) ? "" : ",");
+		json_print_string(json, entry->name);
+		fprintf(json, ", \"start\": %u, \"end\": %u", entry->start, entry->end);
+		if (flash->digests & FLASHROM_DIGEST_SHA256)
+			fprintf(json, ", \"sha256\": \"%s\"", sha256_hex);
+		if (flash->digests & FLASHROM_DIGEST_CRC32C)
+			fprintf(json, ", \"crc32c\": \"%08x\"", crc32c);
+		fprintf(json, " }");
+	}
+
+	if (json) {
+		fprintf(json, "\n  ]\n}\n");
+		if (fclose(json)) {
+			msg_gerr("Error: writing file \"%s\" failed: %s\n", flash->digest_json, strerror(errno));
+			ret = 1;
+		}
+	}
+	return ret;
+}
@@ -0,0 +1,43 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __DIGEST_H__
+#define __DIGEST_H__ 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_SIZE	32
+
+struct sha256_state {
+	uint32_t h[8];
+	uint64_t len;		/* total bytes hashed */
+	uint8_t block[64];
+	size_t fill;		/* bytes buffered in block */
+};
+
+void sha256_init(struct sha256_state *);
+void sha256_update(struct sha256_state *, const uint8_t *buf, size_t len);
+void sha256_final(struct sha256_state *, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+/* CRC-32C (Castagnoli), as used by iSCSI and ext4. Start with crc = 0. */
+uint32_t crc32c_update(uint32_t crc, const uint8_t *buf, size_t len);
+
+/* Parses a comma separated list like "sha256,crc32c" into FLASHROM_DIGEST_* bits. */
+int digest_parse_list(const char *list, unsigned int *digests);
+
+struct flashrom_flashctx;
+/* Hashes the included layout regions of buffer, prints the digests and writes them as JSON if requested. */
+int digest_report_by_layout(const struct flashrom_flashctx *, const uint8_t *buffer);
+
+#endif				/* !__DIGEST_H__ */
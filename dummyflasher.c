@@ -18,18 +18,25 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
 #include "flash.h"
 #include "chipdrivers.h"
 #include "programmer.h"
 
 /* Remove the #define below if you don't want SPI flash chip emulation. */
 #define EMULATE_SPI_CHIP 1
+/* Remove the #define below if you don't want parallel flash chip emulation. */
+#define EMULATE_PAR_CHIP 1
 
 #if EMULATE_SPI_CHIP
 #define EMULATE_CHIP 1
 #include "spi.h"
 #endif
 
+#if EMULATE_PAR_CHIP
+#define EMULATE_CHIP 1
+#endif
+
 #if EMULATE_CHIP
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -44,6 +51,9 @@ enum emu_chip {
 	EMULATE_SST_SST25VF032B,
 	EMULATE_MACRONIX_MX25L6436,
 	EMULATE_WINBOND_W25Q128FV,
+	EMULATE_SPANSION_S29GL032N,
+	EMULATE_INTEL_28F320J3,
+	EMULATE_MACRONIX_MX29GL640EHL,
 };
 static enum emu_chip emu_chip = EMULATE_NONE;
 static char *emu_persistent_image = NULL;
@@ -61,6 +71,26 @@ static unsigned char spi_ignorelist[256];
 static unsigned int spi_blacklist_size = 0;
 static unsigned int spi_ignorelist_size = 0;
 static uint8_t emu_status = 0;
+static uint8_t emu_status2 = 0;
+/* Lines used for the address and data phase of the command being emulated. */
+static unsigned int emu_addr_lines = 1;
+static unsigned int emu_data_lines = 1;
+
+/* Fault and latency injection. All random decisions are drawn from a generator seeded with fault_seed,
+ * so a given set of parameters and operations reproduces the same faults. */
+static uint64_t emu_fault_rng = 1;
+static double emu_fault_read_flip = 0;		/* Probability that a READ returns one flipped bit. */
+static double emu_fault_drop_program = 0;	/* Probability that a program op is silently dropped. */
+static double emu_fault_wip_stuck = 0;		/* Probability that WIP never clears after a write op. */
+static double emu_fault_cmd_error = 0;		/* Probability that any command fails transiently. */
+#define EMU_MAX_ERASE_FAILS 16
+static unsigned int emu_fault_erase_fail[EMU_MAX_ERASE_FAILS];	/* Erases covering these do nothing. */
+static unsigned int emu_fault_erase_fail_count = 0;
+#define EMU_WIP_STUCK UINT_MAX
+static unsigned int emu_wip_polls = 0;		/* RDSRs that see WIP set after each write op. */
+static unsigned int emu_wip_remaining = 0;
+static unsigned int emu_latency_min[256];	/* Per-opcode command latency in us, uniform in [min, max]. */
+static unsigned int emu_latency_max[256];
 
 /* A legit complete SFDP table based on the MX25L6436E (rev. 1.8) datasheet. */
 static const uint8_t sfdp_table[] = {
@@ -88,6 +118,77 @@ static const uint8_t sfdp_table[] = {
 	0xFF, 0xFF, 0xFF, 0xFF, // @0x54: Macronix parameter table end
 };
 
+#endif
+#if EMULATE_PAR_CHIP
+enum emu_par_mode {
+	EMU_PAR_READ_ARRAY,
+	EMU_PAR_QUERY,
+	EMU_PAR_ID,
+	EMU_PAR_STATUS,		/* Intel command set only */
+};
+static enum emu_par_mode emu_par_mode = EMU_PAR_READ_ARRAY;
+static const uint8_t *emu_cfi_query = NULL;
+static unsigned int emu_cfi_query_size = 0;
+static unsigned int emu_par_shift = 0;		/* 1 for x16 chips in byte mode */
+static uint8_t emu_par_id[0x10];		/* Autoselect data, by word */
+static uint8_t emu_par_cmd = 0;			/* Command waiting for more bus cycles. */
+static unsigned int emu_par_unlock = 0;		/* AMD unlock cycles seen so far. */
+static bool emu_par_erase_setup = false;	/* AMD 0x80 seen, waiting for 0x30 or 0x10. */
+static uint8_t emu_par_status = 0x80;		/* Intel status register */
+static unsigned int emu_par_busy = 0;		/* Reads that still see the chip busy. */
+static uint8_t emu_par_toggle = 0;
+#define EMU_PAR_BUF_SIZE 32
+static uint8_t emu_par_buf[EMU_PAR_BUF_SIZE];
+static unsigned int emu_par_buf_offs = 0;
+static int emu_par_buf_count = -1;		/* Bytes announced for the write buffer, -1 before the count. */
+static unsigned int emu_par_buf_len = 0;
+
+/*
+ * CFI query structures based on the S29GL032N (bottom boot), 28F320J3 and MX29GL640E datasheets. The typical
+ * program and erase times are shortened, flashrom sleeps for most of them before polling.
+ */
+static const uint8_t s29gl032n_cfi[] = {
+	[0x10] = 'Q', 'R', 'Y',
+	0x02, 0x00,		// @0x13: AMD command set
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x27, 0x36, 0x00, 0x00,	// @0x1b: Vcc 2.7-3.6 V, no Vpp
+	0x01, 0x01, 0x01, 0x04,	// @0x1f: typical word, buffer, sector and chip erase times
+	0x03, 0x03, 0x03, 0x03,	// @0x23: maximum times
+	0x16,			// @0x27: 4 MiB
+	0x02, 0x00,		// @0x28: x8/x16
+	0x05, 0x00,		// @0x2a: 32 B write buffer
+	0x02,			// @0x2c: 2 erase regions
+	0x07, 0x00, 0x20, 0x00,	// @0x2d: 8 x 8 kB
+	0x3e, 0x00, 0x00, 0x01,	// @0x31: 63 x 64 kB
+};
+
+static const uint8_t i28f320j3_cfi[] = {
+	[0x10] = 'Q', 'R', 'Y',
+	0x01, 0x00,		// @0x13: Intel command set
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x27, 0x36, 0x00, 0x00,	// @0x1b: Vcc 2.7-3.6 V, no Vpp
+	0x01, 0x01, 0x01, 0x00,	// @0x1f: typical word, buffer and block erase times, no chip erase
+	0x03, 0x03, 0x03, 0x00,	// @0x23: maximum times
+	0x16,			// @0x27: 4 MiB
+	0x02, 0x00,		// @0x28: x8/x16
+	0x05, 0x00,		// @0x2a: 32 B write buffer
+	0x01,			// @0x2c: 1 erase region
+	0x1f, 0x00, 0x00, 0x02,	// @0x2d: 32 x 128 kB
+};
+
+static const uint8_t mx29gl640e_cfi[] = {
+	[0x10] = 'Q', 'R', 'Y',
+	0x02, 0x00,		// @0x13: AMD command set
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x27, 0x36, 0x00, 0x00,	// @0x1b: Vcc 2.7-3.6 V, no Vpp
+	0x01, 0x01, 0x01, 0x04,	// @0x1f: typical word, buffer, sector and chip erase times
+	0x03, 0x03, 0x03, 0x03,	// @0x23: maximum times
+	0x17,			// @0x27: 8 MiB
+	0x02, 0x00,		// @0x28: x8/x16
+	0x05, 0x00,		// @0x2a: 32 B write buffer
+	0x01,			// @0x2c: 1 erase region
+	0x7f, 0x00, 0x00, 0x01,	// @0x2d: 128 x 64 kB
+};
 #endif
 #endif
 
@@ -97,6 +198,10 @@ static int dummy_spi_send_command(struct flashctx *flash, unsigned int writecnt,
 				  const unsigned char *writearr, unsigned char *readarr);
 static int dummy_spi_write_256(struct flashctx *flash, const uint8_t *buf,
 			       unsigned int start, unsigned int len);
+static int dummy_spi_set_max_speed(struct flashctx *flash, uint32_t khz);
+static int dummy_spi_write_multi_io(struct flashctx *flash, unsigned int addr_lines, unsigned int data_lines,
+				   const unsigned char *cmd, unsigned int cmdlen,
+				   const uint8_t *data, unsigned int datalen);
 static void dummy_chip_writeb(const struct flashctx *flash, uint8_t val, chipaddr addr);
 static void dummy_chip_writew(const struct flashctx *flash, uint16_t val, chipaddr addr);
 static void dummy_chip_writel(const struct flashctx *flash, uint32_t val, chipaddr addr);
@@ -107,7 +212,7 @@ static uint32_t dummy_chip_readl(const struct flashctx *flash, const chipaddr ad
 static void dummy_chip_readn(const struct flashctx *flash, uint8_t *buf, const chipaddr addr, size_t len);
 
 static const struct spi_master spi_master_dummyflasher = {
-	.features	= SPI_MASTER_4BA,
+	.features	= SPI_MASTER_4BA | SPI_MASTER_DUAL_TX | SPI_MASTER_QUAD_TX,
 	.max_data_read	= MAX_DATA_READ_UNLIMITED,
 	.max_data_write	= MAX_DATA_UNSPECIFIED,
 	.command	= dummy_spi_send_command,
@@ -115,6 +220,8 @@ static const struct spi_master spi_master_dummyflasher = {
 	.read		= default_spi_read,
 	.write_256	= dummy_spi_write_256,
 	.write_aai	= default_spi_write_aai,
+	.set_max_speed	= dummy_spi_set_max_speed,
+	.write_multi_io	= dummy_spi_write_multi_io,
 };
 
 static const struct par_master par_master_dummy = {
@@ -147,6 +254,157 @@ static int dummy_shutdown(void *data)
 	return 0;
 }
 
+#if EMULATE_SPI_CHIP
+/* xorshift64* */
+static uint64_t emu_fault_random(void)
+{
+	emu_fault_rng ^= emu_fault_rng >> 12;
+	emu_fault_rng ^= emu_fault_rng << 25;
+	emu_fault_rng ^= emu_fault_rng >> 27;
+	return emu_fault_rng * 0x2545f4914f6cdd1dULL;
+}
+
+static bool emu_fault_hit(double probability)
+{
+	if (probability <= 0)
+		return false;
+	return (emu_fault_random() >> 11) * (1.0 / (1ULL << 53)) < probability;
+}
+
+static int dummy_parse_probability(const char *name, double *probability)
+{
+	char *const arg = extract_programmer_param(name);
+	char *endptr;
+
+	if (!arg)
+		return 0;
+	errno = 0;
+	*probability = strtod(arg, &endptr);
+	if (errno || endptr == arg || *endptr || *probability < 0 || *probability > 1) {
+		msg_perr("Error: %s must be a probability between 0 and 1, got \"%s\".\n", name, arg);
+		free(arg);
+		return 1;
+	}
+	msg_pdbg("%s is %g.\n", name, *probability);
+	free(arg);
+	return 0;
+}
+
+/* Parses "<op>@<min>[-<max>][:<op>@<min>[-<max>]...]" with op in hex and the latencies in us. */
+static int dummy_parse_latency(char *list)
+{
+	char *entry, *saveptr = NULL;
+
+	for (entry = strtok_r(list, ":", &saveptr); entry; entry = strtok_r(NULL, ":", &saveptr)) {
+		unsigned long op, lo, hi;
+		char *p, *endptr;
+
+		op = strtoul(entry, &endptr, 16);
+		if (endptr == entry || *endptr != '@' || op > 0xff)
+			goto invalid;
+		p = endptr + 1;
+		lo = hi = strtoul(p, &endptr, 0);
+		if (endptr == p)
+			goto invalid;
+		if (*endptr == '-') {
+			p = endptr + 1;
+			hi = strtoul(p, &endptr, 0);
+			if (endptr == p)
+				goto invalid;
+		}
+		if (*endptr || hi < lo || hi > UINT_MAX)
+			goto invalid;
+		emu_latency_min[op] = lo;
+		emu_latency_max[op] = hi;
+		msg_pdbg("Latency of SPI command 0x%02lx is %lu-%lu us.\n", op, lo, hi);
+		continue;
+invalid:
+		msg_perr("Error: invalid spi_latency entry \"%s\", expected <opcode>@<min>[-<max>].\n", entry);
+		return 1;
+	}
+	return 0;
+}
+
+static int dummy_init_faults(void)
+{
+	char *tmp;
+
+	/* Start clean, a previous programmer session in this process may have set other faults. */
+	emu_fault_rng = 1;
+	emu_fault_read_flip = 0;
+	emu_fault_drop_program = 0;
+	emu_fault_wip_stuck = 0;
+	emu_fault_cmd_error = 0;
+	emu_fault_erase_fail_count = 0;
+	emu_wip_polls = 0;
+	emu_wip_remaining = 0;
+	memset(emu_latency_min, 0, sizeof(emu_latency_min));
+	memset(emu_latency_max, 0, sizeof(emu_latency_max));
+
+	tmp = extract_programmer_param("fault_seed");
+	if (tmp) {
+		char *endptr;
+		errno = 0;
+		emu_fault_rng = strtoull(tmp, &endptr, 0);
+		if (errno || endptr == tmp || *endptr) {
+			msg_perr("Error: invalid fault_seed \"%s\".\n", tmp);
+			free(tmp);
+			return 1;
+		}
+		free(tmp);
+	}
+	/* xorshift gets stuck at zero. */
+	if (!emu_fault_rng)
+		emu_fault_rng = 1;
+
+	if (dummy_parse_probability("fault_read_flip", &emu_fault_read_flip) ||
+	    dummy_parse_probability("fault_drop_program", &emu_fault_drop_program) ||
+	    dummy_parse_probability("fault_wip_stuck", &emu_fault_wip_stuck) ||
+	    dummy_parse_probability("fault_cmd_error", &emu_fault_cmd_error))
+		return 1;
+
+	tmp = extract_programmer_param("fault_erase_fail");
+	if (tmp) {
+		char *addr, *saveptr = NULL;
+		for (addr = strtok_r(tmp, ":", &saveptr); addr; addr = strtok_r(NULL, ":", &saveptr)) {
+			char *endptr;
+			const unsigned long offs = strtoul(addr, &endptr, 0);
+			if (endptr == addr || *endptr || offs >= emu_chip_size ||
+			    emu_fault_erase_fail_count == EMU_MAX_ERASE_FAILS) {
+				msg_perr("Error: invalid or too many fault_erase_fail addresses at \"%s\".\n", addr);
+				free(tmp);
+				return 1;
+			}
+			emu_fault_erase_fail[emu_fault_erase_fail_count++] = offs;
+			msg_pdbg("Erases covering 0x%06lx will fail.\n", offs);
+		}
+		free(tmp);
+	}
+
+	tmp = extract_programmer_param("spi_wip_polls");
+	if (tmp) {
+		char *endptr;
+		emu_wip_polls = strtoul(tmp, &endptr, 0);
+		if (endptr == tmp || *endptr || emu_wip_polls == EMU_WIP_STUCK) {
+			msg_perr("Error: invalid spi_wip_polls \"%s\".\n", tmp);
+			free(tmp);
+			return 1;
+		}
+		free(tmp);
+	}
+
+	tmp = extract_programmer_param("spi_latency");
+	if (tmp) {
+		const int ret = dummy_parse_latency(tmp);
+		free(tmp);
+		if (ret)
+			return 1;
+	}
+
+	return 0;
+}
+#endif
+
 int dummy_init(void)
 {
 	char *bustext = NULL;
@@ -343,6 +601,43 @@ int dummy_init(void)
 		emu_jedec_ce_c7_size = emu_chip_size;
 		msg_pdbg("Emulating Winbond W25Q128FV SPI flash chip (RDID)\n");
 	}
+#endif
+#if EMULATE_PAR_CHIP
+	if (!strcmp(tmp, "S29GL032N")) {
+		emu_chip = EMULATE_SPANSION_S29GL032N;
+		emu_chip_size = 4 * 1024 * 1024;
+		emu_cfi_query = s29gl032n_cfi;
+		emu_cfi_query_size = sizeof(s29gl032n_cfi);
+		emu_par_shift = 1;
+		emu_par_id[0] = 0x01;
+		emu_par_id[1] = 0x7e;
+		msg_pdbg("Emulating Spansion S29GL032N parallel flash chip in byte mode (CFI, AMD command set, "
+			 "write buffer)\n");
+	}
+	if (!strcmp(tmp, "28F320J3")) {
+		emu_chip = EMULATE_INTEL_28F320J3;
+		emu_chip_size = 4 * 1024 * 1024;
+		emu_cfi_query = i28f320j3_cfi;
+		emu_cfi_query_size = sizeof(i28f320j3_cfi);
+		emu_par_shift = 0;
+		emu_par_id[0] = 0x89;
+		emu_par_id[1] = 0x16;
+		msg_pdbg("Emulating Intel 28F320J3 parallel flash chip (CFI, Intel command set, write buffer)\n");
+	}
+	if (!strcmp(tmp, "MX29GL640EH/L")) {
+		emu_chip = EMULATE_MACRONIX_MX29GL640EHL;
+		emu_chip_size = 8 * 1024 * 1024;
+		emu_cfi_query = mx29gl640e_cfi;
+		emu_cfi_query_size = sizeof(mx29gl640e_cfi);
+		/* Byte addressing with 0x555/0x2AA unlock cycles like its flashchips entry. */
+		emu_par_shift = 0;
+		emu_par_id[0x00] = 0xc2;
+		emu_par_id[0x01] = 0x7e;
+		emu_par_id[0x0e] = 0x0c;
+		emu_par_id[0x0f] = 0x01;
+		msg_pdbg("Emulating Macronix MX29GL640EH/L parallel flash chip (JEDEC ID, AMD command set, "
+			 "write buffer)\n");
+	}
 #endif
 	if (emu_chip == EMULATE_NONE) {
 		msg_perr("Invalid chip specified for emulation: %s\n", tmp);
@@ -371,6 +666,11 @@ int dummy_init(void)
 		msg_pdbg("Initial status register is set to 0x%02x.\n",
 			 emu_status);
 	}
+
+	if (dummy_init_faults()) {
+		free(flashchip_contents);
+		return 1;
+	}
 #endif
 
 	msg_pdbg("Filling fake flash chip with 0xff, size %i\n", emu_chip_size);
@@ -428,9 +728,250 @@ void dummy_unmap(void *virt_addr, size_t len)
 	msg_pspew("%s: Unmapping 0x%zx bytes at %p\n", __func__, len, virt_addr);
 }
 
+#if EMULATE_PAR_CHIP
+static bool emu_par_chip(void)
+{
+	return emu_chip == EMULATE_SPANSION_S29GL032N || emu_chip == EMULATE_INTEL_28F320J3 ||
+	       emu_chip == EMULATE_MACRONIX_MX29GL640EHL;
+}
+
+/* Finds the erase block containing offs from the erase regions of the query structure. */
+static void emu_par_erase_block(unsigned int offs)
+{
+	const uint8_t *r = emu_cfi_query + 0x2d;
+	unsigned int i, start = 0;
+
+	for (i = 0; i < emu_cfi_query[0x2c]; i++, r += 4) {
+		const unsigned int count = (r[0] | r[1] << 8) + 1;
+		const unsigned int size = (r[2] | r[3] << 8) * 256;
+
+		if (offs < start + count * size) {
+			start += (offs - start) / size * size;
+			msg_pdbg("%s: erasing 0x%06x-0x%06x\n", __func__, start, start + size - 1);
+			memset(flashchip_contents + start, 0xff, size);
+			return;
+		}
+		start += count * size;
+	}
+}
+
+static void emu_par_program(unsigned int offs, const uint8_t *buf, unsigned int len)
+{
+	unsigned int i;
+
+	/* Programming can only clear bits. */
+	for (i = 0; i < len; i++)
+		flashchip_contents[offs + i] &= buf[i];
+	emu_par_busy = 2;
+}
+
+/* Collects the count and data of a buffered program. Returns 1 once the buffer is full. */
+static int emu_par_buffer_write(unsigned int offs, uint8_t val)
+{
+	if (emu_par_buf_count < 0) {
+		emu_par_buf_count = val + 1;
+		emu_par_buf_offs = offs & ~(EMU_PAR_BUF_SIZE - 1);
+		emu_par_buf_len = 0;
+		memset(emu_par_buf, 0xff, sizeof(emu_par_buf));
+		return 0;
+	}
+	if (offs - emu_par_buf_offs < EMU_PAR_BUF_SIZE)
+		emu_par_buf[offs - emu_par_buf_offs] = val;
+	else
+		emu_par_buf_count = EMU_PAR_BUF_SIZE + 1;	/* Outside of the buffer, abort. */
+	return ++emu_par_buf_len >= (unsigned int)emu_par_buf_count;
+}
+
+static void emulate_intel_write(unsigned int offs, uint8_t val)
+{
+	switch (emu_par_cmd) {
+	case 0x10:
+	case 0x40:
+		emu_par_program(offs, &val, 1);
+		emu_par_cmd = 0;
+		return;
+	case 0x20:
+		if (val == 0xd0) {
+			emu_par_erase_block(offs);
+			emu_par_busy = 2;
+		} else {
+			emu_par_status |= 0x30;
+		}
+		emu_par_cmd = 0;
+		return;
+	case 0x60:
+		/* Block lock bits aren't emulated, all blocks are unlocked. */
+		if (val != 0xd0 && val != 0x01)
+			emu_par_status |= 0x30;
+		emu_par_cmd = 0;
+		return;
+	case 0xe8:
+		if (emu_par_buf_count >= 0 && emu_par_buf_len >= (unsigned int)emu_par_buf_count) {
+			if (val == 0xd0 && emu_par_buf_count <= EMU_PAR_BUF_SIZE)
+				emu_par_program(emu_par_buf_offs, emu_par_buf, EMU_PAR_BUF_SIZE);
+			else
+				emu_par_status |= 0x30;
+			emu_par_cmd = 0;
+			return;
+		}
+		emu_par_buffer_write(offs, val);
+		return;
+	}
+
+	switch (val) {
+	case 0xff:
+	case 0xf0:
+		emu_par_mode = EMU_PAR_READ_ARRAY;
+		break;
+	case 0x98:
+		emu_par_mode = EMU_PAR_QUERY;
+		break;
+	case 0x90:
+		emu_par_mode = EMU_PAR_ID;
+		break;
+	case 0x70:
+		emu_par_mode = EMU_PAR_STATUS;
+		break;
+	case 0x50:
+		emu_par_status = 0x80;
+		break;
+	case 0xe8:
+		emu_par_buf_count = -1;
+		/* fall through */
+	case 0x10:
+	case 0x20:
+	case 0x40:
+	case 0x60:
+		emu_par_cmd = val;
+		emu_par_mode = EMU_PAR_STATUS;
+		break;
+	default:
+		break;
+	}
+}
+
+static void emulate_amd_write(unsigned int offs, uint8_t val)
+{
+	const unsigned int addr1 = emu_par_shift ? 0xaaa : 0x555;
+	const unsigned int addr2 = emu_par_shift ? 0x555 : 0x2aa;
+	/* Only the low address lines are decoded for command cycles. */
+	const unsigned int cmd_offs = offs & 0xfff;
+
+	switch (emu_par_cmd) {
+	case 0xa0:
+		emu_par_program(offs, &val, 1);
+		emu_par_cmd = 0;
+		return;
+	case 0x25:
+		if (emu_par_buf_count >= 0 && emu_par_buf_len >= (unsigned int)emu_par_buf_count) {
+			if (val == 0x29 && emu_par_buf_count <= EMU_PAR_BUF_SIZE)
+				emu_par_program(emu_par_buf_offs, emu_par_buf, EMU_PAR_BUF_SIZE);
+			else
+				msg_pdbg("%s: write buffer aborted\n", __func__);
+			emu_par_cmd = 0;
+			return;
+		}
+		emu_par_buffer_write(offs, val);
+		return;
+	}
+
+	if (emu_par_unlock == 0 && val == 0xaa && cmd_offs == addr1) {
+		emu_par_unlock = 1;
+		return;
+	}
+	if (emu_par_unlock == 1 && val == 0x55 && cmd_offs == addr2) {
+		emu_par_unlock = 2;
+		return;
+	}
+	if (emu_par_unlock == 2) {
+		emu_par_unlock = 0;
+		if (emu_par_erase_setup) {
+			emu_par_erase_setup = false;
+			if (val == 0x30) {
+				emu_par_erase_block(offs);
+				emu_par_busy = 2;
+			} else if (val == 0x10 && cmd_offs == addr1) {
+				msg_pdbg("%s: erasing the chip\n", __func__);
+				memset(flashchip_contents, 0xff, emu_chip_size);
+				emu_par_busy = 2;
+			}
+			return;
+		}
+		if (val == 0x25) {
+			emu_par_cmd = val;
+			emu_par_buf_count = -1;
+			return;
+		}
+		if (cmd_offs != addr1)
+			return;
+		switch (val) {
+		case 0xa0:
+			emu_par_cmd = val;
+			break;
+		case 0x80:
+			emu_par_erase_setup = true;
+			break;
+		case 0x90:
+			emu_par_mode = EMU_PAR_ID;
+			break;
+		case 0xf0:
+			emu_par_mode = EMU_PAR_READ_ARRAY;
+			break;
+		}
+		return;
+	}
+	emu_par_unlock = 0;
+	if (val == 0xf0)
+		emu_par_mode = EMU_PAR_READ_ARRAY;
+	else if (val == 0x98 && cmd_offs == 0x55U << emu_par_shift && emu_par_mode == EMU_PAR_READ_ARRAY)
+		emu_par_mode = EMU_PAR_QUERY;
+}
+
+static uint8_t emulate_par_read(unsigned int offs)
+{
+	const unsigned int word = offs >> emu_par_shift;
+
+	/* Intel chips show the status register, AMD chips toggle DQ6 while busy. */
+	if (emu_par_busy) {
+		emu_par_busy--;
+		if (emu_chip == EMULATE_INTEL_28F320J3)
+			return emu_par_status & ~0x80;
+		emu_par_toggle ^= 0x40;
+		return emu_par_toggle;
+	}
+	/* The upper byte of x16 words is zero in query and ID mode. */
+	switch (emu_par_mode) {
+	case EMU_PAR_QUERY:
+		if (offs & ((1 << emu_par_shift) - 1))
+			return 0;
+		return word < emu_cfi_query_size ? emu_cfi_query[word] : 0;
+	case EMU_PAR_ID:
+		if (offs & ((1 << emu_par_shift) - 1))
+			return 0;
+		return word < sizeof(emu_par_id) ? emu_par_id[word] : 0;
+	case EMU_PAR_STATUS:
+		return emu_par_status;
+	default:
+		return flashchip_contents[offs];
+	}
+}
+
+static void emulate_par_write(unsigned int offs, uint8_t val)
+{
+	if (emu_chip == EMULATE_INTEL_28F320J3)
+		emulate_intel_write(offs, val);
+	else
+		emulate_amd_write(offs, val);
+}
+#endif
+
 static void dummy_chip_writeb(const struct flashctx *flash, uint8_t val, chipaddr addr)
 {
 	msg_pspew("%s: addr=0x%" PRIxPTR ", val=0x%02x\n", __func__, addr, val);
+#if EMULATE_PAR_CHIP
+	if (emu_par_chip())
+		emulate_par_write(addr & (emu_chip_size - 1), val);
+#endif
 }
 
 static void dummy_chip_writew(const struct flashctx *flash, uint16_t val, chipaddr addr)
@@ -452,10 +993,23 @@ static void dummy_chip_writen(const struct flashctx *flash, const uint8_t *buf,
 			msg_pspew("\n");
 		msg_pspew("%02x ", buf[i]);
 	}
+#if EMULATE_PAR_CHIP
+	if (emu_par_chip()) {
+		for (i = 0; i < len; i++)
+			emulate_par_write((addr + i) & (emu_chip_size - 1), buf[i]);
+	}
+#endif
 }
 
 static uint8_t dummy_chip_readb(const struct flashctx *flash, const chipaddr addr)
 {
+#if EMULATE_PAR_CHIP
+	if (emu_par_chip()) {
+		const uint8_t val = emulate_par_read(addr & (emu_chip_size - 1));
+		msg_pspew("%s:  addr=0x%" PRIxPTR ", returning 0x%02x\n", __func__, addr, val);
+		return val;
+	}
+#endif
 	msg_pspew("%s:  addr=0x%" PRIxPTR ", returning 0xff\n", __func__, addr);
 	return 0xff;
 }
@@ -474,12 +1028,57 @@ static uint32_t dummy_chip_readl(const struct flashctx *flash, const chipaddr ad
 
 static void dummy_chip_readn(const struct flashctx *flash, uint8_t *buf, const chipaddr addr, size_t len)
 {
+#if EMULATE_PAR_CHIP
+	if (emu_par_chip()) {
+		size_t i;
+		msg_pspew("%s:  addr=0x%" PRIxPTR ", len=0x%zx\n", __func__, addr, len);
+		for (i = 0; i < len; i++)
+			buf[i] = emulate_par_read((addr + i) & (emu_chip_size - 1));
+		return;
+	}
+#endif
 	msg_pspew("%s:  addr=0x%" PRIxPTR ", len=0x%zx, returning array of 0xff\n", __func__, addr, len);
 	memset(buf, 0xff, len);
 	return;
 }
 
 #if EMULATE_SPI_CHIP
+/* Marks the chip busy after a program, erase or status register write. */
+static void emu_start_busy(void)
+{
+	if (emu_fault_hit(emu_fault_wip_stuck)) {
+		msg_pdbg("Injecting stuck WIP.\n");
+		emu_wip_remaining = EMU_WIP_STUCK;
+	} else {
+		emu_wip_remaining = emu_wip_polls;
+	}
+	if (emu_wip_remaining)
+		emu_status |= SPI_SR_WIP;
+}
+
+static void emu_program(unsigned int offs, const unsigned char *buf, unsigned int len)
+{
+	if (emu_fault_hit(emu_fault_drop_program))
+		msg_pdbg("Injecting dropped program of %u bytes at 0x%06x.\n", len, offs);
+	else
+		memcpy(flashchip_contents + offs, buf, len);
+	emu_start_busy();
+}
+
+static void emu_erase(unsigned int offs, unsigned int len)
+{
+	unsigned int i;
+
+	emu_start_busy();
+	for (i = 0; i < emu_fault_erase_fail_count; i++) {
+		if (emu_fault_erase_fail[i] >= offs && emu_fault_erase_fail[i] - offs < len) {
+			msg_pdbg("Injecting failed erase of 0x%06x-0x%06x.\n", offs, offs + len - 1);
+			return;
+		}
+	}
+	memset(flashchip_contents + offs, 0xff, len);
+}
+
 static int emulate_spi_chip_response(unsigned int writecnt,
 				     unsigned int readcnt,
 				     const unsigned char *writearr,
@@ -514,6 +1113,10 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 			return 0;
 		}
 	}
+	if (emu_fault_hit(emu_fault_cmd_error)) {
+		msg_pdbg("Injecting transient failure of SPI command 0x%02x\n", writearr[0]);
+		return 1;
+	}
 
 	if (emu_max_aai_size && (emu_status & SPI_SR_AAI)) {
 		if (writearr[0] != JEDEC_AAI_WORD_PROGRAM &&
@@ -616,6 +1219,13 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 		break;
 	case JEDEC_RDSR:
 		memset(readarr, emu_status, readcnt);
+		if (emu_wip_remaining && emu_wip_remaining != EMU_WIP_STUCK && !--emu_wip_remaining)
+			emu_status &= ~SPI_SR_WIP;
+		break;
+	case JEDEC_RDSR2:
+		if (emu_chip != EMULATE_WINBOND_W25Q128FV)
+			break;
+		memset(readarr, emu_status2, readcnt);
 		break;
 	/* FIXME: this should be chip-specific. */
 	case JEDEC_EWSR:
@@ -630,6 +1240,11 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 		/* FIXME: add some reasonable simulation of the busy flag */
 		emu_status = writearr[1] & ~SPI_SR_WIP;
 		msg_pdbg2("WRSR wrote 0x%02x.\n", emu_status);
+		if (writecnt > 2 && emu_chip == EMULATE_WINBOND_W25Q128FV) {
+			emu_status2 = writearr[2];
+			msg_pdbg2("WRSR wrote 0x%02x to status register 2.\n", emu_status2);
+		}
+		emu_start_busy();
 		break;
 	case JEDEC_READ:
 		offs = writearr[1] << 16 | writearr[2] << 8 | writearr[3];
@@ -637,6 +1252,11 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 		offs %= emu_chip_size;
 		if (readcnt > 0)
 			memcpy(readarr, flashchip_contents + offs, readcnt);
+		if (readcnt > 0 && emu_fault_hit(emu_fault_read_flip)) {
+			const uint64_t bit = emu_fault_random() % (readcnt * 8ULL);
+			msg_pdbg("Injecting bit flip in READ at 0x%06x.\n", (unsigned int)(offs + bit / 8));
+			readarr[bit / 8] ^= 1 << (bit % 8);
+		}
 		break;
 	case JEDEC_BYTE_PROGRAM:
 		offs = writearr[1] << 16 | writearr[2] << 8 | writearr[3];
@@ -650,7 +1270,41 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 			msg_perr("Max BYTE PROGRAM size exceeded!\n");
 			return 1;
 		}
-		memcpy(flashchip_contents + offs, writearr + 4, writecnt - 4);
+		emu_program(offs, writearr + 4, writecnt - 4);
+		break;
+	case JEDEC_QUAD_PAGE_PROGRAM:
+	case JEDEC_QUAD_IO_PAGE_PROGRAM:
+		if (writearr[0] == JEDEC_QUAD_PAGE_PROGRAM) {
+			if (emu_chip != EMULATE_WINBOND_W25Q128FV)
+				break;
+			if (emu_addr_lines != 1 || emu_data_lines != 4 || !(emu_status2 & SPI_SR2_QE)) {
+				msg_perr("QUAD PAGE PROGRAM needs 1-1-4 transfer and QE set!\n");
+				return 1;
+			}
+		} else {
+			if (emu_chip != EMULATE_MACRONIX_MX25L6436)
+				break;
+			if (emu_addr_lines != 4 || emu_data_lines != 4 || !(emu_status & SPI_SR1_QE)) {
+				msg_perr("QUAD IO PAGE PROGRAM needs 1-4-4 transfer and QE set!\n");
+				return 1;
+			}
+		}
+		if (!(emu_status & SPI_SR_WEL)) {
+			msg_perr("QUAD PAGE PROGRAM attempted, but WEL is 0!\n");
+			break;
+		}
+		offs = writearr[1] << 16 | writearr[2] << 8 | writearr[3];
+		/* Truncate to emu_chip_size. */
+		offs %= emu_chip_size;
+		if (writecnt < 5) {
+			msg_perr("QUAD PAGE PROGRAM size too short!\n");
+			return 1;
+		}
+		if (writecnt - 4 > emu_max_byteprogram_size) {
+			msg_perr("Max QUAD PAGE PROGRAM size exceeded!\n");
+			return 1;
+		}
+		emu_program(offs, writearr + 4, writecnt - 4);
 		break;
 	case JEDEC_AAI_WORD_PROGRAM:
 		if (!emu_max_aai_size)
@@ -671,7 +1325,7 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 				   writearr[3];
 			/* Truncate to emu_chip_size. */
 			aai_offs %= emu_chip_size;
-			memcpy(flashchip_contents + aai_offs, writearr + 4, 2);
+			emu_program(aai_offs, writearr + 4, 2);
 			aai_offs += 2;
 		} else {
 			if (writecnt < JEDEC_AAI_WORD_PROGRAM_CONT_OUTSIZE) {
@@ -684,7 +1338,7 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 					 "too long!\n");
 				return 1;
 			}
-			memcpy(flashchip_contents + aai_offs, writearr + 1, 2);
+			emu_program(aai_offs, writearr + 1, 2);
 			aai_offs += 2;
 		}
 		break;
@@ -707,7 +1361,7 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 		if (offs & (emu_jedec_se_size - 1))
 			msg_pdbg("Unaligned SECTOR ERASE 0x20: 0x%x\n", offs);
 		offs &= ~(emu_jedec_se_size - 1);
-		memset(flashchip_contents + offs, 0xff, emu_jedec_se_size);
+		emu_erase(offs, emu_jedec_se_size);
 		break;
 	case JEDEC_BE_52:
 		if (!emu_jedec_be_52_size)
@@ -724,7 +1378,7 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 		if (offs & (emu_jedec_be_52_size - 1))
 			msg_pdbg("Unaligned BLOCK ERASE 0x52: 0x%x\n", offs);
 		offs &= ~(emu_jedec_be_52_size - 1);
-		memset(flashchip_contents + offs, 0xff, emu_jedec_be_52_size);
+		emu_erase(offs, emu_jedec_be_52_size);
 		break;
 	case JEDEC_BE_D8:
 		if (!emu_jedec_be_d8_size)
@@ -741,7 +1395,7 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 		if (offs & (emu_jedec_be_d8_size - 1))
 			msg_pdbg("Unaligned BLOCK ERASE 0xd8: 0x%x\n", offs);
 		offs &= ~(emu_jedec_be_d8_size - 1);
-		memset(flashchip_contents + offs, 0xff, emu_jedec_be_d8_size);
+		emu_erase(offs, emu_jedec_be_d8_size);
 		break;
 	case JEDEC_CE_60:
 		if (!emu_jedec_ce_60_size)
@@ -756,7 +1410,7 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 		}
 		/* JEDEC_CE_60_OUTSIZE is 1 (no address) -> no offset. */
 		/* emu_jedec_ce_60_size is emu_chip_size. */
-		memset(flashchip_contents, 0xff, emu_jedec_ce_60_size);
+		emu_erase(0, emu_jedec_ce_60_size);
 		break;
 	case JEDEC_CE_C7:
 		if (!emu_jedec_ce_c7_size)
@@ -771,7 +1425,7 @@ static int emulate_spi_chip_response(unsigned int writecnt,
 		}
 		/* JEDEC_CE_C7_OUTSIZE is 1 (no address) -> no offset. */
 		/* emu_jedec_ce_c7_size is emu_chip_size. */
-		memset(flashchip_contents, 0xff, emu_jedec_ce_c7_size);
+		emu_erase(0, emu_jedec_ce_c7_size);
 		break;
 	case JEDEC_SFDP:
 		if (emu_chip != EMULATE_MACRONIX_MX25L6436)
@@ -834,6 +1488,10 @@ static int dummy_spi_send_command(struct flashctx *flash, unsigned int writecnt,
 	/* Response for unknown commands and missing chip is 0xff. */
 	memset(readarr, 0xff, readcnt);
 #if EMULATE_SPI_CHIP
+	if (writecnt && emu_latency_max[writearr[0]]) {
+		const unsigned int lo = emu_latency_min[writearr[0]], hi = emu_latency_max[writearr[0]];
+		programmer_delay(lo + emu_fault_random() % (hi - lo + 1ULL));
+	}
 	switch (emu_chip) {
 	case EMULATE_ST_M25P10_RES:
 	case EMULATE_SST_SST25VF040_REMS:
@@ -862,3 +1520,35 @@ static int dummy_spi_write_256(struct flashctx *flash, const uint8_t *buf, unsig
 	return spi_write_chunked(flash, buf, start, len,
 				 spi_write_256_chunksize);
 }
+
+static int dummy_spi_write_multi_io(struct flashctx *flash, unsigned int addr_lines, unsigned int data_lines,
+				   const unsigned char *cmd, unsigned int cmdlen,
+				   const uint8_t *data, unsigned int datalen)
+{
+	unsigned char writearr[1 + JEDEC_MAX_ADDR_LEN + 256];
+	int ret;
+
+	if (cmdlen + datalen > sizeof(writearr))
+		return SPI_INVALID_LENGTH;
+
+	msg_pspew("%s: %u-%u-%u transfer\n", __func__, 1, addr_lines, data_lines);
+	memcpy(writearr, cmd, cmdlen);
+	memcpy(writearr + cmdlen, data, datalen);
+
+#if EMULATE_SPI_CHIP
+	emu_addr_lines = addr_lines;
+	emu_data_lines = data_lines;
+#endif
+	ret = dummy_spi_send_command(flash, cmdlen + datalen, 0, writearr, NULL);
+#if EMULATE_SPI_CHIP
+	emu_addr_lines = 1;
+	emu_data_lines = 1;
+#endif
+	return ret;
+}
+
+static int dummy_spi_set_max_speed(struct flashctx *flash, uint32_t khz)
+{
+	msg_pdbg("%s: setting SPI clock to %"PRIu32" kHz\n", __func__, khz);
+	return 0;
+}
@@ -140,6 +140,16 @@ enum write_granularity {
  */
 #define FEATURE_ERASED_ZERO	(1 << 17)
 #define FEATURE_NO_ERASE	(1 << 18)
+/* Multi-I/O page program instructions, in addition to the single I/O 0x02. */
+#define FEATURE_PP_1_1_2	(1 << 19) /**< Dual input page program (0xa2), data on two lines */
+#define FEATURE_PP_1_1_4	(1 << 20) /**< Quad input page program (0x32), data on four lines */
+#define FEATURE_PP_1_4_4	(1 << 21) /**< Quad page program (0x38), address and data on four lines */
+/* Location of the Quad Enable bit, which must be set before quad instructions are accepted. */
+#define FEATURE_QE_SR2_BIT1	(1 << 22) /**< QE is bit 1 of status register 2, written by a 2-byte WRSR */
+#define FEATURE_QE_SR1_BIT6	(1 << 23) /**< QE is bit 6 of status register 1 */
+/** EWSR (0x50) before WRSR writes the volatile status register, which takes effect at once */
+#define FEATURE_WRSR_VOLATILE	(1 << 24)
+#define FEATURE_CFI_BYTE_MODE	(1 << 25) /**< x16 CFI chip on an 8-bit bus, query and unlock addresses are doubled */
 
 #define ERASED_VALUE(flash)	(((flash)->chip->feature_bits & FEATURE_ERASED_ZERO) ? 0x00 : 0xff)
 
@@ -241,8 +251,30 @@ struct flashchip {
 	} voltage;
 	enum write_granularity gran;
 
+	/* Maximum single byte program time (tBP) in microseconds, 0 if unknown. */
+	unsigned int byte_program_time;
+	/* Typical single word program time in microseconds, 0 if unknown. Used to pace status polling. */
+	unsigned int word_program_time;
+	/* Typical write buffer program time in microseconds, 0 if the chip has no write buffer.
+	   Used to pace status polling. */
+	unsigned int buffer_program_time;
+	/* Maximum EEPROM write cycle time (tW) in microseconds, 0 if unknown or not an EEPROM. */
+	unsigned int write_cycle_time;
+	/* Typical JEDEC sector (0x30), block (0x50) and chip (0x10) erase times in microseconds,
+	   0 if unknown. Used to pace toggle bit polling. */
+	struct jedec_erase_time {
+		unsigned int sector;
+		unsigned int block;
+		unsigned int chip;
+	} erase_time;
+
 	/* SPI specific options (TODO: Make it a union in case other bustypes get specific options.) */
 	uint8_t wrea_override; /**< override opcode for write extended address register */
+	/* Maximum SPI clock in kHz for READ (0x03) and for all other commands, 0 if unknown. */
+	struct spi_clock {
+		uint32_t read;
+		uint32_t program;
+	} max_spi_clock;
 };
 
 struct flashrom_flashctx {
@@ -264,6 +296,7 @@ struct flashrom_flashctx {
 		bool force_boardmismatch;
 		bool verify_after_write;
 		bool verify_whole_chip;
+		bool tune_read_chunks;
 	} flags;
 	/* We cache the state of the extended address register (highest byte
            of a 4BA for 3BA instructions) and the state of the 4BA mode here.
@@ -271,6 +304,15 @@ struct flashrom_flashctx {
            of the extended address register. */
 	int address_high_byte;
 	bool in_4ba_mode;
+	/* The page program mode selected for this chip/master combination,
+	   NULL until the first write. If we had to set the QE bit for it, we
+	   clear it again when done. */
+	const struct spi_program_mode *program_mode;
+	bool restore_qe;
+	/* FLASHROM_DIGEST_* bits of the digests to report after reading, and
+	   an optional file to write them to as JSON. */
+	unsigned int digests;
+	const char *digest_json;
 };
 
 /* Timing used in probe routines. ZERO is -2 to differentiate between an unset
@@ -286,6 +328,16 @@ struct flashrom_flashctx {
 extern const struct flashchip flashchips[];
 extern const unsigned int flashchips_size;
 
+/* Bytes programmed per write burst before reading them back. */
+#define BURST_CHUNK 64
+
+/* One step of a parallel bus write burst: write val to addr, then wait delay_us. */
+struct par_burst_op {
+	chipaddr addr;
+	uint8_t val;
+	unsigned int delay_us;
+};
+
 void chip_writeb(const struct flashctx *flash, uint8_t val, chipaddr addr);
 void chip_writew(const struct flashctx *flash, uint16_t val, chipaddr addr);
 void chip_writel(const struct flashctx *flash, uint32_t val, chipaddr addr);
@@ -294,6 +346,8 @@ uint8_t chip_readb(const struct flashctx *flash, const chipaddr addr);
 uint16_t chip_readw(const struct flashctx *flash, const chipaddr addr);
 uint32_t chip_readl(const struct flashctx *flash, const chipaddr addr);
 void chip_readn(const struct flashctx *flash, uint8_t *buf, const chipaddr addr, size_t len);
+bool chip_has_write_burst(const struct flashctx *flash);
+int chip_write_burst(const struct flashctx *flash, const struct par_burst_op *ops, size_t count);
 
 /* print.c */
 int print_supported(void);
@@ -346,6 +400,9 @@ int do_read(struct flashctx *, const char *filename);
 int do_erase(struct flashctx *);
 int do_write(struct flashctx *, const char *const filename, const char *const referencefile);
 int do_verify(struct flashctx *, const char *const filename);
+int do_backup(struct flashctx *, const char *const manifest, const char *const chunk_dir);
+int do_restore(struct flashctx *, const char *const manifest, const char *const chunk_dir,
+	       const char *const referencefile);
 
 /* Something happened that shouldn't happen, but we can go on. */
 #define ERROR_NONFATAL 0x100
@@ -5526,7 +5526,7 @@ const struct flashchip flashchips[] = {
 		.manufacture_id	= EON_ID,
 		.model_id	= EON_EN29GL064B,
 		.total_size	= 8192,
-		.page_size	= 128 * 1024, /* actual page size is 16 */
+		.page_size	= 32, /* write buffer, page reads are 16 B */
 		.feature_bits	= FEATURE_ADDR_2AA | FEATURE_SHORT_RESET,
 		.tested		= TEST_UNTESTED,
 		.probe		= probe_jedec_29gl,
@@ -5544,9 +5544,10 @@ const struct flashchip flashchips[] = {
 				.block_erase = erase_chip_block_jedec,
 			},
 		},
-		.write		= write_jedec_1,
+		.write		= write_cfi_amd,
 		.read		= read_memmapped,
 		.voltage	= {2700, 3600},
+		.buffer_program_time	= 240, /* write buffer program typ */
 	},
 
 	{
@@ -5556,7 +5557,7 @@ const struct flashchip flashchips[] = {
 		.manufacture_id	= EON_ID,
 		.model_id	= EON_EN29GL064T,
 		.total_size	= 8192,
-		.page_size	= 128 * 1024, /* actual page size is 16 */
+		.page_size	= 32, /* write buffer, page reads are 16 B */
 		.feature_bits	= FEATURE_ADDR_2AA | FEATURE_SHORT_RESET,
 		.tested		= TEST_UNTESTED,
 		.probe		= probe_jedec_29gl,
@@ -5574,9 +5575,10 @@ const struct flashchip flashchips[] = {
 				.block_erase = erase_chip_block_jedec,
 			},
 		},
-		.write		= write_jedec_1,
+		.write		= write_cfi_amd,
 		.read		= read_memmapped,
 		.voltage	= {2700, 3600},
+		.buffer_program_time	= 240, /* write buffer program typ */
 	},
 
 	{
@@ -5586,7 +5588,7 @@ const struct flashchip flashchips[] = {
 		.manufacture_id	= EON_ID,
 		.model_id	= EON_EN29GL064HL,
 		.total_size	= 8192,
-		.page_size	= 128 * 1024, /* actual page size is 16 */
+		.page_size	= 32, /* write buffer, page reads are 16 B */
 		.feature_bits	= FEATURE_ADDR_2AA | FEATURE_SHORT_RESET,
 		.tested		= TEST_UNTESTED,
 		.probe		= probe_jedec_29gl,
@@ -5601,9 +5603,10 @@ const struct flashchip flashchips[] = {
 				.block_erase = erase_chip_block_jedec,
 			},
 		},
-		.write		= write_jedec_1,
+		.write		= write_cfi_amd,
 		.read		= read_memmapped,
 		.voltage	= {2700, 3600},
+		.buffer_program_time	= 240, /* write buffer program typ */
 	},
 
 	{
@@ -5613,7 +5616,7 @@ const struct flashchip flashchips[] = {
 		.manufacture_id	= EON_ID,
 		.model_id	= EON_EN29GL128HL,
 		.total_size	= 16384,
-		.page_size	= 128 * 1024, /* actual page size is 16 */
+		.page_size	= 64, /* write buffer, page reads are 16 B */
 		.feature_bits	= FEATURE_ADDR_2AA | FEATURE_SHORT_RESET,
 		.tested		= TEST_UNTESTED,
 		.probe		= probe_jedec_29gl,
@@ -5628,9 +5631,10 @@ const struct flashchip flashchips[] = {
 				.block_erase = erase_chip_block_jedec,
 			},
 		},
-		.write		= write_jedec_1,
+		.write		= write_cfi_amd,
 		.read		= read_memmapped,
 		.voltage	= {2700, 3600},
+		.buffer_program_time	= 480, /* write buffer program typ */
 	},
 
 	{
@@ -8625,7 +8629,8 @@ const struct flashchip flashchips[] = {
 		.page_size	= 256,
 		/* supports SFDP */
 		/* OTP: 512B total; enter 0xB1, exit 0xC1 */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP
+			| FEATURE_PP_1_4_4 | FEATURE_QE_SR1_BIT6,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -8653,6 +8658,7 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_256,
 		.read		= spi_chip_read, /* Fast read (0x0B) and multi I/O supported */
 		.voltage	= {2700, 3600},
+		.max_spi_clock	= {50000, 104000},
 	},
 
 	{
@@ -9303,7 +9309,7 @@ const struct flashchip flashchips[] = {
 		.manufacture_id	= MACRONIX_ID,
 		.model_id	= MACRONIX_MX29GL128F,
 		.total_size	= 16384,
-		.page_size	= 128 * 1024, /* actual page size is 16 */
+		.page_size	= 64, /* write buffer, page reads are 16 B */
 		.feature_bits	= FEATURE_ADDR_2AA | FEATURE_SHORT_RESET,
 		.tested		= TEST_UNTESTED,
 		.probe		= probe_jedec_29gl,
@@ -9318,9 +9324,10 @@ const struct flashchip flashchips[] = {
 				.block_erase = erase_chip_block_jedec,
 			},
 		},
-		.write		= write_jedec_1,
+		.write		= write_cfi_amd,
 		.read		= read_memmapped,
 		.voltage	= {2700, 3600},
+		.buffer_program_time	= 480, /* write buffer program typ */
 	},
 
 	{
@@ -9330,7 +9337,7 @@ const struct flashchip flashchips[] = {
 		.manufacture_id	= MACRONIX_ID,
 		.model_id	= MACRONIX_MX29GL320EB,
 		.total_size	= 4096,
-		.page_size	= 128 * 1024, /* actual page size is 16 */
+		.page_size	= 32, /* write buffer, page reads are 16 B */
 		.feature_bits	= FEATURE_ADDR_2AA | FEATURE_SHORT_RESET,
 		.tested		= TEST_UNTESTED,
 		.probe		= probe_jedec_29gl,
@@ -9348,9 +9355,10 @@ const struct flashchip flashchips[] = {
 				.block_erase = erase_chip_block_jedec,
 			},
 		},
-		.write		= write_jedec_1,
+		.write		= write_cfi_amd,
 		.read		= read_memmapped,
 		.voltage	= {2700, 3600},
+		.buffer_program_time	= 240, /* write buffer program typ */
 	},
 
 	{
@@ -9360,7 +9368,7 @@ const struct flashchip flashchips[] = {
 		.manufacture_id	= MACRONIX_ID,
 		.model_id	= MACRONIX_MX29GL320EHL,
 		.total_size	= 4096,
-		.page_size	= 128 * 1024, /* actual page size is 16 */
+		.page_size	= 32, /* write buffer, page reads are 16 B */
 		.feature_bits	= FEATURE_ADDR_2AA | FEATURE_SHORT_RESET,
 		.tested		= TEST_UNTESTED,
 		.probe		= probe_jedec_29gl,
@@ -9375,9 +9383,10 @@ const struct flashchip flashchips[] = {
 				.block_erase = erase_chip_block_jedec,
 			},
 		},
-		.write		= write_jedec_1,
+		.write		= write_cfi_amd,
 		.read		= read_memmapped,
 		.voltage	= {2700, 3600},
+		.buffer_program_time	= 240, /* write buffer program typ */
 	},
 
 	{
@@ -9387,7 +9396,7 @@ const struct flashchip flashchips[] = {
 		.manufacture_id	= MACRONIX_ID,
 		.model_id	= MACRONIX_MX29GL320ET,
 		.total_size	= 4096,
-		.page_size	= 128 * 1024, /* actual page size is 16 */
+		.page_size	= 32, /* write buffer, page reads are 16 B */
 		.feature_bits	= FEATURE_ADDR_2AA | FEATURE_SHORT_RESET,
 		.tested		= TEST_UNTESTED,
 		.probe		= probe_jedec_29gl,
@@ -9405,9 +9414,10 @@ const struct flashchip flashchips[] = {
 				.block_erase = erase_chip_block_jedec,
 			},
 		},
-		.write		= write_jedec_1,
+		.write		= write_cfi_amd,
 		.read		= read_memmapped,
 		.voltage	= {2700, 3600},
+		.buffer_program_time	= 240, /* write buffer program typ */
 	},
 
 	{
@@ -9417,7 +9427,7 @@ const struct flashchip flashchips[] = {
 		.manufacture_id	= MACRONIX_ID,
 		.model_id	= MACRONIX_MX29GL640EB,
 		.total_size	= 8192,
-		.page_size	= 128 * 1024, /* actual page size is 16 */
+		.page_size	= 32, /* write buffer, page reads are 16 B */
 		.feature_bits	= FEATURE_ADDR_2AA | FEATURE_SHORT_RESET,
 		.tested		= TEST_UNTESTED,
 		.probe		= probe_jedec_29gl,
@@ -9435,9 +9445,10 @@ const struct flashchip flashchips[] = {
 				.block_erase = erase_chip_block_jedec,
 			},
 		},
-		.write		= write_jedec_1,
+		.write		= write_cfi_amd,
 		.read		= read_memmapped,
 		.voltage	= {2700, 3600},
+		.buffer_program_time	= 240, /* write buffer program typ */
 	},
 
 	{
@@ -9447,7 +9458,7 @@ const struct flashchip flashchips[] = {
 		.manufacture_id	= MACRONIX_ID,
 		.model_id	= MACRONIX_MX29GL640EHL,
 		.total_size	= 8192,
-		.page_size	= 128 * 1024, /* actual page size is 16 */
+		.page_size	= 32, /* write buffer, page reads are 16 B */
 		.feature_bits	= FEATURE_ADDR_2AA | FEATURE_SHORT_RESET,
 		.tested		= TEST_UNTESTED,
 		.probe		= probe_jedec_29gl,
@@ -9462,9 +9473,10 @@ const struct flashchip flashchips[] = {
 				.block_erase = erase_chip_block_jedec,
 			},
 		},
-		.write		= write_jedec_1,
+		.write		= write_cfi_amd,
 		.read		= read_memmapped,
 		.voltage	= {2700, 3600},
+		.buffer_program_time	= 240, /* write buffer program typ */
 	},
 
 	{
@@ -9474,7 +9486,7 @@ const struct flashchip flashchips[] = {
 		.manufacture_id	= MACRONIX_ID,
 		.model_id	= MACRONIX_MX29GL640ET,
 		.total_size	= 8192,
-		.page_size	= 128 * 1024, /* actual page size is 16 */
+		.page_size	= 32, /* write buffer, page reads are 16 B */
 		.feature_bits	= FEATURE_ADDR_2AA | FEATURE_SHORT_RESET,
 		.tested		= TEST_UNTESTED,
 		.probe		= probe_jedec_29gl,
@@ -9492,9 +9504,10 @@ const struct flashchip flashchips[] = {
 				.block_erase = erase_chip_block_jedec,
 			},
 		},
-		.write		= write_jedec_1,
+		.write		= write_cfi_amd,
 		.read		= read_memmapped,
 		.voltage	= {2700, 3600},
+		.buffer_program_time	= 240, /* write buffer program typ */
 	},
 
 	{
@@ -12610,6 +12623,7 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_1, /* AAI supported, but opcode is 0xAF */
 		.read		= spi_chip_read, /* Fast read (0x0B) supported */
 		.voltage	= {2700, 3600},
+		.byte_program_time	= 20, /* tBP max */
 	},
 
 	{
@@ -12642,6 +12656,7 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_1, /* AAI supported, but opcode is 0xAF */
 		.read		= spi_chip_read,
 		.voltage	= {3000, 3600},
+		.byte_program_time	= 20, /* tBP max */
 	},
 
 	{
@@ -12674,6 +12689,7 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_1, /* AAI supported, but opcode is 0xAF */
 		.read		= spi_chip_read,
 		.voltage	= {3000, 3600},
+		.byte_program_time	= 20, /* tBP max */
 	},
 
 	{
@@ -12712,6 +12728,7 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_1, /* AAI supported, but opcode is 0xAF */
 		.read		= spi_chip_read, /* Fast read (0x0B) supported by SST25VF010A only */
 		.voltage	= {2700, 3600},
+		.byte_program_time	= 20, /* tBP max */
 	},
 
 	{
@@ -12750,6 +12767,7 @@ const struct flashchip flashchips[] = {
 		.write		= spi_aai_write,
 		.read		= spi_chip_read,
 		.voltage	= {2700, 3600},
+		.max_spi_clock	= {25000, 50000},
 	},
 
 	{
@@ -12782,6 +12800,7 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_1, /* AAI supported, but opcode is 0xAF */
 		.read		= spi_chip_read, /* only */
 		.voltage	= {2700, 3600},
+		.byte_program_time	= 20, /* tBP max */
 	},
 
 	{
@@ -12858,6 +12877,7 @@ const struct flashchip flashchips[] = {
 		.write		= spi_aai_write,
 		.read		= spi_chip_read,
 		.voltage	= {2700, 3600},
+		.max_spi_clock	= {25000, 50000},
 	},
 
 	{
@@ -12890,6 +12910,7 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_1, /* AAI supported, but opcode is 0xAF */
 		.read		= spi_chip_read,
 		.voltage	= {2700, 3600},
+		.byte_program_time	= 20, /* tBP max */
 	},
 
 	{
@@ -12928,6 +12949,7 @@ const struct flashchip flashchips[] = {
 		.write		= spi_aai_write, /* AAI supported (0xAD) */
 		.read		= spi_chip_read, /* Fast read (0x0B) supported */
 		.voltage	= {2700, 3600},
+		.max_spi_clock	= {25000, 50000},
 	},
 
 	{
@@ -13080,6 +13102,7 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_1, /* AAI supported, but opcode is 0xAF */
 		.read		= spi_chip_read, /* Fast read (0x0B) supported by SST25VF512A only */
 		.voltage	= {2700, 3600},
+		.byte_program_time	= 20, /* tBP max */
 	},
 
 	{
@@ -13634,6 +13657,8 @@ const struct flashchip flashchips[] = {
 		.write		= write_jedec_1,
 		.read		= read_memmapped,
 		.voltage	= {4500, 5500},
+		.byte_program_time	= 20, /* tBP max */
+		.erase_time	= { .sector = 18000, .block = 18000, .chip = 70000 }, /* typical */
 	},
 
 	{
@@ -13661,6 +13686,8 @@ const struct flashchip flashchips[] = {
 		.write		= write_jedec_1,
 		.read		= read_memmapped,
 		.voltage	= {4500, 5500},
+		.byte_program_time	= 20, /* tBP max */
+		.erase_time	= { .sector = 18000, .block = 18000, .chip = 70000 }, /* typical */
 	},
 
 	{
@@ -13688,6 +13715,8 @@ const struct flashchip flashchips[] = {
 		.write		= write_jedec_1,
 		.read		= read_memmapped,
 		.voltage	= {4500, 5500},
+		.byte_program_time	= 20, /* tBP max */
+		.erase_time	= { .sector = 18000, .block = 18000, .chip = 70000 }, /* typical */
 	},
 
 	{
@@ -13715,6 +13744,8 @@ const struct flashchip flashchips[] = {
 		.write		= write_jedec_1,
 		.read		= read_memmapped,
 		.voltage	= {4500, 5500},
+		.byte_program_time	= 20, /* tBP max */
+		.erase_time	= { .sector = 18000, .block = 18000, .chip = 70000 }, /* typical */
 	},
 
 	{
@@ -13742,6 +13773,8 @@ const struct flashchip flashchips[] = {
 		.write		= write_jedec_1,
 		.read		= read_memmapped,
 		.voltage	= {2700, 3600},
+		.byte_program_time	= 20, /* tBP max */
+		.erase_time	= { .sector = 18000, .block = 18000, .chip = 70000 }, /* typical */
 	},
 
 	{
@@ -13769,6 +13802,8 @@ const struct flashchip flashchips[] = {
 		.write		= write_jedec_1,
 		.read		= read_memmapped,
 		.voltage	= {2700, 3600},
+		.byte_program_time	= 20, /* tBP max */
+		.erase_time	= { .sector = 18000, .block = 18000, .chip = 70000 }, /* typical */
 	},
 
 	{
@@ -13796,6 +13831,8 @@ const struct flashchip flashchips[] = {
 		.write		= write_jedec_1,
 		.read		= read_memmapped,
 		.voltage	= {2700, 3600},
+		.byte_program_time	= 20, /* tBP max */
+		.erase_time	= { .sector = 18000, .block = 18000, .chip = 70000 }, /* typical */
 	},
 
 	{
@@ -13826,6 +13863,8 @@ const struct flashchip flashchips[] = {
 		.write		= write_jedec_1,
 		.read		= read_memmapped,
 		.voltage	= {2700, 3600},
+		.byte_program_time	= 20, /* tBP max */
+		.erase_time	= { .sector = 18000, .block = 18000, .chip = 70000 }, /* typical */
 	},
 
 	{
@@ -13853,6 +13892,8 @@ const struct flashchip flashchips[] = {
 		.write		= write_jedec_1,
 		.read		= read_memmapped,
 		.voltage	= {2700, 3600},
+		.byte_program_time	= 20, /* tBP max */
+		.erase_time	= { .sector = 18000, .block = 18000, .chip = 70000 }, /* typical */
 	},
 
 	{
@@ -13885,6 +13926,8 @@ const struct flashchip flashchips[] = {
 		.write		= write_jedec_1,
 		.read		= read_memmapped,
 		.voltage	= {3000, 3600},
+		.byte_program_time	= 20, /* tBP max */
+		.erase_time	= { .sector = 18000, .block = 18000, .chip = 70000 }, /* typical */
 	},
 
 	{
@@ -13917,6 +13960,8 @@ const struct flashchip flashchips[] = {
 		.write		= write_jedec_1,
 		.read		= read_memmapped,
 		.voltage	= {3000, 3600},
+		.byte_program_time	= 20, /* tBP max */
+		.erase_time	= { .sector = 18000, .block = 18000, .chip = 70000 }, /* typical */
 	},
 
 	{
@@ -13952,6 +13997,8 @@ const struct flashchip flashchips[] = {
 		.write		= write_jedec_1,
 		.read		= read_memmapped,
 		.voltage	= {3000, 3600},
+		.byte_program_time	= 20, /* tBP max */
+		.erase_time	= { .sector = 18000, .block = 18000, .chip = 70000 }, /* typical */
 	},
 
 	{
@@ -13986,6 +14033,7 @@ const struct flashchip flashchips[] = {
 		.write		= write_82802ab,
 		.read		= read_memmapped,
 		.voltage	= {3000, 3600},
+		.byte_program_time	= 20, /* tBP max */
 	},
 
 	{
@@ -14018,6 +14066,8 @@ const struct flashchip flashchips[] = {
 		.write		= write_jedec_1,
 		.read		= read_memmapped,
 		.voltage	= {3000, 3600},
+		.byte_program_time	= 20, /* tBP max */
+		.erase_time	= { .sector = 18000, .block = 18000, .chip = 70000 }, /* typical */
 	},
 
 	{
@@ -14052,6 +14102,7 @@ const struct flashchip flashchips[] = {
 		.write		= write_82802ab,
 		.read		= read_memmapped,
 		.voltage	= {3000, 3600},
+		.byte_program_time	= 20, /* tBP max */
 	},
 
 	{
@@ -14086,6 +14137,7 @@ const struct flashchip flashchips[] = {
 		.write		= write_82802ab,
 		.read		= read_memmapped,
 		.voltage	= {3000, 3600},
+		.byte_program_time	= 20, /* tBP max */
 	},
 
 	{
@@ -14116,6 +14168,8 @@ const struct flashchip flashchips[] = {
 		.write		= write_jedec_1,
 		.read		= read_memmapped,
 		.voltage	= {3000, 3600},
+		.byte_program_time	= 20, /* tBP max */
+		.erase_time	= { .sector = 18000, .block = 18000, .chip = 70000 }, /* typical */
 	},
 
 	{
@@ -14146,6 +14200,8 @@ const struct flashchip flashchips[] = {
 		.write		= write_jedec_1,
 		.read		= read_memmapped,
 		.voltage	= {3000, 3600},
+		.byte_program_time	= 20, /* tBP max */
+		.erase_time	= { .sector = 18000, .block = 18000, .chip = 70000 }, /* typical */
 	},
 
 	{
@@ -14176,6 +14232,8 @@ const struct flashchip flashchips[] = {
 		.write		= write_jedec_1,
 		.read		= read_memmapped,
 		.voltage	= {3000, 3600},
+		.byte_program_time	= 20, /* tBP max */
+		.erase_time	= { .sector = 18000, .block = 18000, .chip = 70000 }, /* typical */
 	},
 
 	{
@@ -14207,6 +14265,8 @@ const struct flashchip flashchips[] = {
 		.write		= write_jedec_1,
 		.read		= read_memmapped,
 		.voltage	= {3000, 3600},
+		.byte_program_time	= 20, /* tBP max */
+		.erase_time	= { .sector = 18000, .block = 18000, .chip = 70000 }, /* typical */
 	},
 
 	{
@@ -14237,6 +14297,8 @@ const struct flashchip flashchips[] = {
 		.write		= write_jedec_1,
 		.read		= read_memmapped,
 		.voltage	= {3000, 3600},
+		.byte_program_time	= 20, /* tBP max */
+		.erase_time	= { .sector = 18000, .block = 18000, .chip = 70000 }, /* typical */
 	},
 
 	{
@@ -14271,6 +14333,7 @@ const struct flashchip flashchips[] = {
 		.write		= write_82802ab,
 		.read		= read_memmapped,
 		.voltage	= {3000, 3600},
+		.byte_program_time	= 20, /* tBP max */
 	},
 
 	{
@@ -14833,6 +14896,8 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_256,
 		.read		= spi_chip_read,
 		.voltage	= {2500, 5500},
+		.gran		= write_gran_1byte_implicit_erase,
+		.write_cycle_time	= 10000, /* tW max */
 	},
 
 	{
@@ -16375,7 +16440,8 @@ const struct flashchip flashchips[] = {
 		.page_size	= 256,
 		/* supports SFDP */
 		/* OTP: 1024B total, 256B reserved; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_WRSR_VOLATILE | FEATURE_OTP
+			| FEATURE_PP_1_1_4 | FEATURE_QE_SR2_BIT1,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -16403,6 +16469,7 @@ const struct flashchip flashchips[] = {
 		.write		= spi_chip_write_256,
 		.read		= spi_chip_read,
 		.voltage	= {2700, 3600},
+		.max_spi_clock	= {50000, 104000},
 	},
 
 	{
@@ -16413,7 +16480,7 @@ const struct flashchip flashchips[] = {
 		.model_id	= WINBOND_NEX_W25Q128_V_M,
 		.total_size	= 16384,
 		.page_size	= 256,
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP | FEATURE_QPI,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_WRSR_VOLATILE | FEATURE_OTP | FEATURE_QPI,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -16453,7 +16520,7 @@ const struct flashchip flashchips[] = {
 		.page_size	= 256,
 		/* supports SFDP */
 		/* OTP: 1024B total, 256B reserved; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP | FEATURE_QPI,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_WRSR_VOLATILE | FEATURE_OTP | FEATURE_QPI,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -16491,7 +16558,7 @@ const struct flashchip flashchips[] = {
 		.model_id	= WINBOND_NEX_W25Q128_DTR,
 		.total_size	= 16384,
 		.page_size	= 256,
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP | FEATURE_QPI,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_WRSR_VOLATILE | FEATURE_OTP | FEATURE_QPI,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -16531,7 +16598,8 @@ const struct flashchip flashchips[] = {
 		.page_size	= 256,
 		/* supports SFDP */
 		/* OTP: 1024B total, 256B reserved; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_WRSR_VOLATILE | FEATURE_OTP
+			| FEATURE_PP_1_1_4 | FEATURE_QE_SR2_BIT1,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -16571,7 +16639,7 @@ const struct flashchip flashchips[] = {
 		.page_size	= 256,
 		/* OTP: 256B total; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
 		/* QPI enable 0x38, disable 0xFF */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP | FEATURE_QPI,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_WRSR_VOLATILE | FEATURE_OTP | FEATURE_QPI,
 		.tested		= TEST_UNTESTED,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -16610,7 +16678,7 @@ const struct flashchip flashchips[] = {
 		.total_size	= 256,
 		.page_size	= 256,
 		/* OTP: 256B total; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_WRSR_VOLATILE | FEATURE_OTP,
 		.tested		= TEST_UNTESTED,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -16651,7 +16719,7 @@ const struct flashchip flashchips[] = {
 		/* supports SFDP */
 		/* OTP: 1024B total, 256B reserved; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
 		/* FOUR_BYTE_ADDR: supports 4-bytes addressing mode */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP | FEATURE_4BA_ENTER_WREN
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_WRSR_VOLATILE | FEATURE_OTP | FEATURE_4BA_ENTER_WREN
 			| FEATURE_4BA_EXT_ADDR | FEATURE_4BA_READ | FEATURE_4BA_FAST_READ,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
@@ -16693,7 +16761,7 @@ const struct flashchip flashchips[] = {
 		/* supports SFDP */
 		/* OTP: 1024B total, 256B reserved; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
 		/* FOUR_BYTE_ADDR: supports 4-bytes addressing mode */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP | FEATURE_4BA,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_WRSR_VOLATILE | FEATURE_OTP | FEATURE_4BA,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -16739,7 +16807,8 @@ const struct flashchip flashchips[] = {
 		.page_size	= 256,
 		/* supports SFDP */
 		/* OTP: 1024B total, 256B reserved; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_WRSR_VOLATILE | FEATURE_OTP
+			| FEATURE_PP_1_1_4 | FEATURE_QE_SR2_BIT1,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -16779,7 +16848,7 @@ const struct flashchip flashchips[] = {
 		.page_size	= 256,
 		/* OTP: 256B total; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
 		/* QPI enable 0x38, disable 0xFF */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP | FEATURE_QPI,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_WRSR_VOLATILE | FEATURE_OTP | FEATURE_QPI,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -16819,7 +16888,8 @@ const struct flashchip flashchips[] = {
 		.page_size	= 256,
 		/* supports SFDP */
 		/* OTP: 756B total; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_WRSR_VOLATILE | FEATURE_OTP
+			| FEATURE_PP_1_1_4 | FEATURE_QE_SR2_BIT1,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -16858,7 +16928,7 @@ const struct flashchip flashchips[] = {
 		.total_size	= 512,
 		.page_size	= 256,
 		/* OTP: 256B total; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_WRSR_VOLATILE | FEATURE_OTP,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -16897,7 +16967,7 @@ const struct flashchip flashchips[] = {
 		.total_size	= 512,
 		.page_size	= 256,
 		/* OTP: 3*256B total; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_WRSR_VOLATILE | FEATURE_OTP,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -16937,7 +17007,8 @@ const struct flashchip flashchips[] = {
 		.page_size	= 256,
 		/* supports SFDP */
 		/* OTP: 1024B total, 256B reserved; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_WRSR_VOLATILE | FEATURE_OTP
+			| FEATURE_PP_1_1_4 | FEATURE_QE_SR2_BIT1,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -16977,7 +17048,7 @@ const struct flashchip flashchips[] = {
 		.page_size	= 256,
 		/* OTP: 256B total; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
 		/* QPI enable 0x38, disable 0xFF */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP | FEATURE_QPI,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_WRSR_VOLATILE | FEATURE_OTP | FEATURE_QPI,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -17017,7 +17088,8 @@ const struct flashchip flashchips[] = {
 		.page_size	= 256,
 		/* supports SFDP */
 		/* OTP: 1024B total, 256B reserved; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_WRSR_VOLATILE | FEATURE_OTP
+			| FEATURE_PP_1_1_4 | FEATURE_QE_SR2_BIT1,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -17056,7 +17128,7 @@ const struct flashchip flashchips[] = {
 		.total_size	= 1024,
 		.page_size	= 256,
 		/* OTP: 256B total; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_WRSR_VOLATILE | FEATURE_OTP,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -17095,7 +17167,7 @@ const struct flashchip flashchips[] = {
 		.total_size	= 1024,
 		.page_size	= 256,
 		/* OTP: 3*256B total; read 0x48; write 0x42, erase 0x44, read ID 0x4B */
-		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_OTP,
+		.feature_bits	= FEATURE_WRSR_WREN | FEATURE_WRSR_VOLATILE | FEATURE_OTP,
 		.tested		= TEST_OK_PREW,
 		.probe		= probe_spi_rdid,
 		.probe_timing	= TIMING_ZERO,
@@ -18281,6 +18353,28 @@ const struct flashchip flashchips[] = {
 		.voltage	= {0},
 	},
 
+	{
+		.vendor		= "Unknown",
+		.name		= "CFI-capable chip",
+		.bustype	= BUS_PARALLEL,
+		.manufacture_id	= GENERIC_MANUF_ID,
+		.model_id	= CFI_DEVICE_ID,
+		.total_size	= 0, /* set by probing function */
+		.page_size	= 0, /* set by probing function */
+		.feature_bits	= 0, /* set by probing function */
+		/* We present our own "report this" text hence we do not */
+		/* want the default "This flash part has status UNTESTED..." */
+		/* text to be printed. */
+		.tested		= TEST_OK_PREW,
+		.probe		= probe_cfi,
+		.probe_timing	= TIMING_ZERO,
+		.block_erasers	= {}, /* set by probing function */
+		.unlock		= NULL, /* set by probing function */
+		.write		= NULL, /* set by probing function */
+		.read		= read_memmapped,
+		.voltage	= {0},
+	},
+
 	{
 		.vendor		= "Programmer",
 		.name		= "Opaque flash chip",
@@ -39,6 +39,11 @@
 #include "programmer.h"
 #include "hwaccess.h"
 #include "chipdrivers.h"
+#include "digest.h"
+#include "sparse_image.h"
+#include "compression.h"
+#include "delta.h"
+#include "backup.h"
 
 const char flashrom_version[] = FLASHROM_VERSION;
 const char *chip_to_probe = NULL;
@@ -242,6 +247,18 @@ const struct programmer_entry programmer_table[] = {
 	},
 #endif
 
+#if CONFIG_PROXY == 1
+	{
+		.name			= "proxy",
+		.type			= OTHER,
+		.devs.note		= "SPI master of a programmer served by flashrom-proxy\n",
+		.init			= proxy_init,
+		.map_flash_region	= fallback_map,
+		.unmap_flash_region	= fallback_unmap,
+		.delay			= internal_delay,
+	},
+#endif
+
 #if CONFIG_BUSPIRATE_SPI == 1
 	{
 		.name			= "buspirate_spi",
@@ -601,6 +618,8 @@ int programmer_shutdown(void)
 	}
 
 	programmer_param = NULL;
+	/* Also forgets what was learned about the masters, like tuned SPI read chunk sizes. */
+	memset(registered_masters, 0, sizeof(registered_masters[0]) * registered_master_count);
 	registered_master_count = 0;
 
 	return ret;
@@ -661,6 +680,22 @@ void chip_readn(const struct flashctx *flash, uint8_t *buf, chipaddr addr,
 	flash->mst->par.chip_readn(flash, buf, addr, len);
 }
 
+bool chip_has_write_burst(const struct flashctx *flash)
+{
+	return flash->mst->par.chip_write_burst != NULL;
+}
+
+/* Only call this if chip_has_write_burst() returned true. */
+int chip_write_burst(const struct flashctx *flash, const struct par_burst_op *ops, size_t count)
+{
+	return flash->mst->par.chip_write_burst(flash, ops, count);
+}
+
+const char *programmer_name(void)
+{
+	return programmer_table[programmer].name;
+}
+
 void programmer_delay(unsigned int usecs)
 {
 	if (usecs > 0)
@@ -753,6 +788,12 @@ static unsigned int count_usable_erasers(const struct flashctx *flash)
 	return usable_erasefunctions;
 }
 
+/* Verify in chunks of this size, so that a mismatch is reported without reading
+ * the rest of the range and memory use does not grow with the range. Reading and
+ * comparing a chunk alternate, nothing overlaps: chip reads are synchronous, and
+ * the comparison takes a tiny fraction of the read time anyway. */
+#define VERIFY_CHUNK_SIZE	(64 * 1024)
+
 static int compare_range(const uint8_t *wantbuf, const uint8_t *havebuf, unsigned int start, unsigned int len)
 {
 	int ret = 0, failcount = 0;
@@ -776,16 +817,21 @@ static int compare_range(const uint8_t *wantbuf, const uint8_t *havebuf, unsigne
 /* start is an offset to the base address of the flash chip */
 static int check_erased_range(struct flashctx *flash, unsigned int start, unsigned int len)
 {
-	int ret;
-	uint8_t *cmpbuf = malloc(len);
+	int ret = 0;
+	unsigned int pos, chunk;
+	const unsigned int bufsize = min(len, VERIFY_CHUNK_SIZE);
+	uint8_t *cmpbuf = malloc(bufsize);
 	const uint8_t erased_value = ERASED_VALUE(flash);
 
 	if (!cmpbuf) {
 		msg_gerr("Could not allocate memory!\n");
 		exit(1);
 	}
-	memset(cmpbuf, erased_value, len);
-	ret = verify_range(flash, cmpbuf, start, len);
+	memset(cmpbuf, erased_value, bufsize);
+	for (pos = 0; pos < len && !ret; pos += chunk) {
+		chunk = min(len - pos, bufsize);
+		ret = verify_range(flash, cmpbuf, start + pos, chunk);
+	}
 	free(cmpbuf);
 	return ret;
 }
@@ -807,11 +853,13 @@ int verify_range(struct flashctx *flash, const uint8_t *cmpbuf, unsigned int sta
 		return -1;
 	}
 
-	uint8_t *readbuf = malloc(len);
+	const unsigned int bufsize = min(len, VERIFY_CHUNK_SIZE);
+	uint8_t *readbuf = malloc(bufsize);
 	if (!readbuf) {
 		msg_gerr("Could not allocate memory!\n");
 		return -1;
 	}
+	unsigned int pos, chunk;
 	int ret = 0;
 
 	if (start + len > flash->chip->total_size * 1024) {
@@ -822,15 +870,19 @@ int verify_range(struct flashctx *flash, const uint8_t *cmpbuf, unsigned int sta
 		goto out_free;
 	}
 
-	ret = flash->chip->read(flash, readbuf, start, len);
-	if (ret) {
-		msg_gerr("Verification impossible because read failed "
-			 "at 0x%x (len 0x%x)\n", start, len);
-		ret = -1;
-		goto out_free;
+	/* Stop at the first chunk that differs. */
+	for (pos = 0; pos < len; pos += chunk) {
+		chunk = min(len - pos, bufsize);
+		if (flash->chip->read(flash, readbuf, start + pos, chunk)) {
+			msg_gerr("Verification impossible because read failed "
+				 "at 0x%x (len 0x%x)\n", start + pos, chunk);
+			ret = -1;
+			goto out_free;
+		}
+		ret = compare_range(cmpbuf + pos, readbuf, start + pos, chunk);
+		if (ret)
+			goto out_free;
 	}
-
-	ret = compare_range(cmpbuf, readbuf, start, len);
 out_free:
 	free(readbuf);
 	return ret;
@@ -1191,10 +1243,12 @@ int probe_flash(struct registered_master *mst, int startchip, struct flashctx *f
 		 * one for this programmer interface (master) and thus no other chip has
 		 * been found on this interface.
 		 */
-		if (startchip == 0 && flash->chip->model_id == SFDP_DEVICE_ID) {
+		if (startchip == 0 && (flash->chip->model_id == SFDP_DEVICE_ID ||
+				       flash->chip->model_id == CFI_DEVICE_ID)) {
 			msg_cinfo("===\n"
-				  "SFDP has autodetected a flash chip which is "
-				  "not natively supported by flashrom yet.\n");
+				  "%s has autodetected a flash chip which is "
+				  "not natively supported by flashrom yet.\n",
+				  flash->chip->model_id == SFDP_DEVICE_ID ? "SFDP" : "CFI");
 			if (count_usable_erasers(flash) == 0)
 				msg_cinfo("The standard operations read and "
 					  "verify should work, but to support "
@@ -1218,7 +1272,8 @@ int probe_flash(struct registered_master *mst, int startchip, struct flashctx *f
 		if (startchip == 0)
 			break;
 		/* Not the first flash chip detected on this bus, but not a generic match either. */
-		if ((flash->chip->model_id != GENERIC_DEVICE_ID) && (flash->chip->model_id != SFDP_DEVICE_ID))
+		if ((flash->chip->model_id != GENERIC_DEVICE_ID) && (flash->chip->model_id != SFDP_DEVICE_ID) &&
+		    (flash->chip->model_id != CFI_DEVICE_ID))
 			break;
 		/* Not the first flash chip detected on this bus, and it's just a generic match. Ignore it. */
 notfound:
@@ -1289,7 +1344,20 @@ int read_buf_from_file(unsigned char *buf, unsigned long size,
 		ret = 1;
 		goto out;
 	}
+	/*
+	 * A chip-sized file is always a raw image, even if it starts like a
+	 * compressed stream. Anything else may be compressed, which is recognized
+	 * by the magic whatever the file is called.
+	 */
 	if (image_stat.st_size != (intmax_t)size) {
+		uint8_t magic[6];
+		const size_t magic_len = fread(magic, 1, sizeof(magic), image);
+		const enum compression compression = compression_by_magic(magic, magic_len);
+		rewind(image);
+		if (compression != COMPRESSION_NONE) {
+			ret = decompress_file(image, compression, buf, size, filename);
+			goto out;
+		}
 		msg_gerr("Error: Image size (%jd B) doesn't match the flash chip's size (%lu B)!\n",
 			 (intmax_t)image_stat.st_size, size);
 		ret = 1;
@@ -1326,11 +1394,19 @@ int write_buf_to_file(const unsigned char *buf, unsigned long size, const char *
 		return 1;
 	}
 
-	unsigned long numbytes = fwrite(buf, 1, size, image);
-	if (numbytes != size) {
-		msg_gerr("Error: file %s could not be written completely.\n", filename);
-		ret = 1;
-		goto out;
+	const enum compression compression = compression_by_name(filename);
+	if (compression != COMPRESSION_NONE) {
+		if (compress_to_file(image, compression, buf, size, filename)) {
+			ret = 1;
+			goto out;
+		}
+	} else {
+		unsigned long numbytes = fwrite(buf, 1, size, image);
+		if (numbytes != size) {
+			msg_gerr("Error: file %s could not be written completely.\n", filename);
+			ret = 1;
+			goto out;
+		}
 	}
 	if (fflush(image)) {
 		msg_gerr("Error: flushing file \"%s\" failed: %s\n", filename, strerror(errno));
@@ -1386,8 +1462,11 @@ int read_flash_to_file(struct flashctx *flash, const char *filename)
 
 	ret = write_buf_to_file(buf, size, filename);
 out_free:
-	free(buf);
 	msg_cinfo("%s.\n", ret ? "FAILED" : "done");
+	/* Hash from memory instead of reading the file back. */
+	if (!ret)
+		ret = digest_report_by_layout(flash, buf);
+	free(buf);
 	return ret;
 }
 
@@ -1573,6 +1652,61 @@ static int walk_eraseblocks(struct flashctx *const flashctx,
 	return 0;
 }
 
+/*
+ * Returns the number of eraseblocks of erase function k that cover the
+ * region from start to end (inclusive), or 0 if the region doesn't start
+ * and end on eraseblock boundaries of that function.
+ */
+static unsigned int count_region_eraseblocks(const struct flashctx *const flashctx, const size_t k,
+					     const chipoff_t start, const chipoff_t end)
+{
+	const struct block_eraser *const eraser = &flashctx->chip->block_erasers[k];
+	bool start_aligned = false;
+	unsigned int i, j, blocks = 0;
+	chipoff_t addr = 0;
+
+	for (i = 0; i < NUM_ERASEREGIONS; ++i) {
+		for (j = 0; j < eraser->eraseblocks[i].count; ++j) {
+			if (addr == start)
+				start_aligned = true;
+			addr += eraser->eraseblocks[i].size;
+			if (start_aligned)
+				++blocks;
+			if (addr == end + 1)
+				return start_aligned ? blocks : 0;
+			if (addr > end)
+				return 0;
+		}
+	}
+	return 0;
+}
+
+/*
+ * For plain erase, there is nothing to preserve inside the region, so the
+ * erase function that needs the fewest operations to cover it exactly is
+ * the best choice. Only used for opaque chips, whose erase functions are
+ * cycles of the programmer like the 4 KB and 64 KB erase of ICH hardware
+ * sequencing. SPI chips keep the table order, starting with the smallest
+ * blocks. Returns its index or NUM_ERASEFUNCTIONS if none fits.
+ */
+static size_t select_region_eraser(const struct flashctx *const flashctx,
+				   const chipoff_t start, const chipoff_t end)
+{
+	size_t k, best = NUM_ERASEFUNCTIONS;
+	unsigned int blocks, best_blocks = 0;
+
+	for (k = 0; k < NUM_ERASEFUNCTIONS; ++k) {
+		if (check_block_eraser(flashctx, k, 0))
+			continue;
+		blocks = count_region_eraseblocks(flashctx, k, start, end);
+		if (blocks && (!best_blocks || blocks < best_blocks)) {
+			best = k;
+			best_blocks = blocks;
+		}
+	}
+	return best;
+}
+
 static int walk_by_layout(struct flashctx *const flashctx, struct walk_info *const info,
 			  const per_blockfn_t per_blockfn)
 {
@@ -1586,11 +1720,20 @@ static int walk_by_layout(struct flashctx *const flashctx, struct walk_info *con
 		info->region_start = entry->start;
 		info->region_end   = entry->end;
 
-		size_t j;
+		/* When only erasing an opaque chip, try the best fitting erase function first. */
+		const size_t best = info->curcontents || flashctx->chip->bustype != BUS_PROG ? NUM_ERASEFUNCTIONS
+				  : select_region_eraser(flashctx, entry->start, entry->end);
+		bool first_try = true;
+		size_t i;
 		int error = 1; /* retry as long as it's 1 */
-		for (j = 0; j < NUM_ERASEFUNCTIONS; ++j) {
-			if (j != 0)
+		for (i = 0; i <= NUM_ERASEFUNCTIONS; ++i) {
+			/* i == 0 selects the best one, then all are tried in order. */
+			const size_t j = i ? i - 1 : best;
+			if (j == NUM_ERASEFUNCTIONS || (i && j == best))
+				continue;
+			if (!first_try)
 				msg_cinfo("Looking for another erase function.\n");
+			first_try = false;
 			msg_cdbg("Trying erase function %zi... ", j);
 			if (check_block_eraser(flashctx, j, 1))
 				continue;
@@ -1860,12 +2003,17 @@ static int verify_by_layout(struct flashctx *const flashctx,
 	while ((entry = layout_next_included(layout, entry))) {
 		const chipoff_t region_start	= entry->start;
 		const chipsize_t region_len	= entry->end - entry->start + 1;
+		chipoff_t pos;
+		chipsize_t chunk;
 
-		if (flashctx->chip->read(flashctx, curcontents + region_start, region_start, region_len))
-			return 1;
-		if (compare_range(newcontents + region_start, curcontents + region_start,
-				  region_start, region_len))
-			return 3;
+		/* Stop at the first chunk that differs. */
+		for (pos = region_start; pos < region_start + region_len; pos += chunk) {
+			chunk = min(region_start + region_len - pos, VERIFY_CHUNK_SIZE);
+			if (flashctx->chip->read(flashctx, curcontents + pos, pos, chunk))
+				return 1;
+			if (compare_range(newcontents + pos, curcontents + pos, pos, chunk))
+				return 3;
+		}
 	}
 	return 0;
 }
@@ -2207,6 +2355,14 @@ int prepare_flash_access(struct flashctx *const flash,
 	if (map_flash(flash) != 0)
 		return 1;
 
+	if (spi_prepare_access(flash)) {
+		msg_cerr("Failed to prepare the programmer for this chip! Aborting.\n");
+		return 1;
+	}
+
+	if (spi_set_chip_speed(flash, !(write_it || erase_it)))
+		msg_cwarn("Failed to raise the SPI clock, continuing at the current rate.\n");
+
 	/* Given the existence of read locks, we want to unlock for read,
 	   erase and write. */
 	if (flash->chip->unlock)
@@ -2214,6 +2370,8 @@ int prepare_flash_access(struct flashctx *const flash,
 
 	flash->address_high_byte = -1;
 	flash->in_4ba_mode = false;
+	flash->program_mode = NULL;
+	flash->restore_qe = false;
 
 	/* Be careful about 4BA chips and broken masters */
 	if (flash->chip->total_size > 16 * 1024 && spi_master_no_4ba_modes(flash)) {
@@ -2243,6 +2401,8 @@ int prepare_flash_access(struct flashctx *const flash,
 
 void finalize_flash_access(struct flashctx *const flash)
 {
+	if (flash->restore_qe && spi_set_quad_enable(flash, false))
+		msg_cwarn("Failed to clear the Quad Enable bit again.\n");
 	unmap_flash(flash);
 }
 
@@ -2311,7 +2471,7 @@ int flashrom_image_read(struct flashctx *const flashctx, void *const buffer, con
 		goto _finalize_ret;
 	}
 	msg_cinfo("done.\n");
-	ret = 0;
+	ret = digest_report_by_layout(flashctx, buffer);
 
 _finalize_ret:
 	finalize_flash_access(flashctx);
@@ -2558,30 +2718,168 @@ int do_erase(struct flashctx *const flash)
 	return ret;
 }
 
-int do_write(struct flashctx *const flash, const char *const filename, const char *const referencefile)
+/*
+ * The granularity at which sparse extents and delta hunks are merged: the
+ * largest block of the first erase function, which the erase walker tries
+ * first. Merging at a coarser granularity than needed only costs some reads.
+ */
+static chipsize_t coalesce_block_size(const struct flashctx *const flash)
+{
+	const struct block_eraser *const eraser = &flash->chip->block_erasers[0];
+	chipsize_t size = 1;
+	size_t i;
+
+	for (i = 0; i < NUM_ERASEREGIONS; i++) {
+		if (eraser->eraseblocks[i].count && eraser->eraseblocks[i].size > size)
+			size = eraser->eraseblocks[i].size;
+	}
+	return size;
+}
+
+/*
+ * Reads a flat image of the chip's size or a sparse one. For the latter, the
+ * extents present in the file, merged per erase block, become the included
+ * regions of the global layout, which is then set for the flash context. The
+ * bytes between merged extents are read from the chip.
+ */
+static int read_image_file(struct flashctx *const flash, uint8_t *const buf, const char *const filename)
 {
 	const size_t flash_size = flash->chip->total_size * 1024;
+	uint8_t *data = NULL, *present = NULL;
+	bool gaps;
 	int ret = 1;
 
-	uint8_t *const newcontents = malloc(flash_size);
-	uint8_t *const refcontents = referencefile ? malloc(flash_size) : NULL;
+	if (!is_sparse_image(filename))
+		return read_buf_from_file(buf, flash_size, filename);
 
-	if (!newcontents || (referencefile && !refcontents)) {
+	if (flash->layout && flash->layout->num_entries) {
+		msg_gerr("Error: A sparse image can't be combined with a layout.\n");
+		return 1;
+	}
+	data = malloc(flash_size);
+	present = calloc(SPARSE_PRESENT_SIZE(flash_size), 1);
+	if (!data || !present) {
 		msg_gerr("Out of memory!\n");
 		goto _free_ret;
 	}
+	if (read_sparse_image(data, present, flash_size, filename) ||
+	    sparse_image_to_layout(present, flash_size, coalesce_block_size(flash), get_global_layout(), &gaps))
+		goto _free_ret;
+	flashrom_layout_set(flash, get_global_layout());
+
+	memset(buf, ERASED_VALUE(flash), flash_size);
+	if (gaps) {
+		if (prepare_flash_access(flash, true, false, false, false))
+			goto _free_ret;
+		msg_cinfo("Reading regions touched by the sparse image... ");
+		ret = read_by_layout(flash, buf);
+		msg_cinfo(ret ? "FAILED.\n" : "done.\n");
+		finalize_flash_access(flash);
+		if (ret)
+			goto _free_ret;
+	}
+	sparse_image_apply(buf, data, present, flash_size);
+	ret = 0;
+
+_free_ret:
+	free(present);
+	free(data);
+	return ret;
+}
+
+/*
+ * Loads a delta and sets its hunks, merged per erase block, as the included
+ * regions of the global layout, which is then set for the flash context. Then
+ * reads those regions into buf, unless read_chip is false and they are already
+ * there.
+ */
+static struct delta *read_delta_base(struct flashctx *const flash, uint8_t *const buf,
+				     const bool read_chip, const char *const filename)
+{
+	const size_t flash_size = flash->chip->total_size * 1024;
+	struct delta *delta;
+	int ret;
+
+	if (flash->layout && flash->layout->num_entries) {
+		msg_gerr("Error: A delta can't be combined with a layout.\n");
+		return NULL;
+	}
+	delta = delta_load(filename, flash_size);
+	if (!delta)
+		return NULL;
+	if (!delta->num_hunks)
+		return delta;
+	if (delta_to_layout(delta, get_global_layout(), coalesce_block_size(flash)))
+		goto _free_ret;
+	flashrom_layout_set(flash, get_global_layout());
+	if (!read_chip)
+		return delta;
+
+	if (prepare_flash_access(flash, true, false, false, false))
+		goto _free_ret;
+	msg_cinfo("Reading regions touched by the delta... ");
+	ret = read_by_layout(flash, buf);
+	msg_cinfo(ret ? "FAILED.\n" : "done.\n");
+	finalize_flash_access(flash);
+	if (!ret)
+		return delta;
+
+_free_ret:
+	delta_free(delta);
+	return NULL;
+}
+
+int do_write(struct flashctx *const flash, const char *const filename, const char *const referencefile)
+{
+	const size_t flash_size = flash->chip->total_size * 1024;
+	const struct flashrom_layout *const layout_bak = flash->layout;
+	const bool verify_all_bak = flash->flags.verify_whole_chip;
+	const bool is_delta = is_delta_file(filename);
+	struct delta *delta = NULL;
+	int ret = 1;
 
-	if (read_buf_from_file(newcontents, flash_size, filename))
+	uint8_t *const newcontents = malloc(flash_size);
+	uint8_t *const refcontents = referencefile || is_delta ? malloc(flash_size) : NULL;
+
+	if (!newcontents || ((referencefile || is_delta) && !refcontents)) {
+		msg_gerr("Out of memory!\n");
 		goto _free_ret;
+	}
 
 	if (referencefile) {
 		if (read_buf_from_file(refcontents, flash_size, referencefile))
 			goto _free_ret;
 	}
 
+	if (is_delta) {
+		/* The base is either the reference file or read from the chip, for the hunks only. */
+		if (!referencefile)
+			memset(refcontents, ERASED_VALUE(flash), flash_size);
+		delta = read_delta_base(flash, refcontents, !referencefile, filename);
+		if (!delta)
+			goto _free_ret;
+		if (!delta->num_hunks) {
+			msg_ginfo("The delta contains no changes.\n");
+			ret = 0;
+			goto _free_ret;
+		}
+		memcpy(newcontents, refcontents, flash_size);
+		if (delta_apply(delta, newcontents))
+			goto _free_ret;
+	} else if (read_image_file(flash, newcontents, filename)) {
+		goto _free_ret;
+	}
+
+	/* Only touch the extents of a sparse image or delta, don't read the gaps for a full verification. */
+	if (flash->layout != layout_bak)
+		flash->flags.verify_whole_chip = false;
+
 	ret = flashrom_image_write(flash, newcontents, flash_size, refcontents);
 
 _free_ret:
+	flash->flags.verify_whole_chip = verify_all_bak;
+	flashrom_layout_set(flash, layout_bak);
+	delta_free(delta);
 	free(refcontents);
 	free(newcontents);
 	return ret;
@@ -2590,6 +2888,7 @@ _free_ret:
 int do_verify(struct flashctx *const flash, const char *const filename)
 {
 	const size_t flash_size = flash->chip->total_size * 1024;
+	const struct flashrom_layout *const layout_bak = flash->layout;
 	int ret = 1;
 
 	uint8_t *const newcontents = malloc(flash_size);
@@ -2598,12 +2897,90 @@ int do_verify(struct flashctx *const flash, const char *const filename)
 		goto _free_ret;
 	}
 
-	if (read_buf_from_file(newcontents, flash_size, filename))
+	if (is_delta_file(filename)) {
+		/* The base is gone after writing, compare the hunks with the patched hash instead. */
+		struct delta *const delta = read_delta_base(flash, newcontents, true, filename);
+		if (!delta)
+			goto _free_ret;
+		if (delta->num_hunks && delta_check_result(delta, newcontents)) {
+			msg_cerr("Error: The flash chip doesn't contain the patched contents.\n");
+			ret = 3;
+		} else {
+			msg_cinfo("VERIFIED.\n");
+			ret = 0;
+		}
+		delta_free(delta);
+		goto _free_ret;
+	}
+
+	if (read_image_file(flash, newcontents, filename))
 		goto _free_ret;
 
 	ret = flashrom_image_verify(flash, newcontents, flash_size);
 
 _free_ret:
+	flashrom_layout_set(flash, layout_bak);
+	free(newcontents);
+	return ret;
+}
+
+int do_backup(struct flashctx *const flash, const char *const manifest, const char *const chunk_dir)
+{
+	const size_t flash_size = flash->chip->total_size * 1024;
+	int ret = 1;
+
+	if (flash->layout && flash->layout->num_entries) {
+		msg_gerr("Error: A backup always covers the whole chip and can't be combined with a layout.\n");
+		return 1;
+	}
+
+	uint8_t *const buf = malloc(flash_size);
+	if (!buf) {
+		msg_gerr("Out of memory!\n");
+		return 1;
+	}
+
+	if (prepare_flash_access(flash, true, false, false, false))
+		goto _free_ret;
+	msg_cinfo("Reading flash... ");
+	ret = read_by_layout(flash, buf);
+	msg_cinfo("%s.\n", ret ? "FAILED" : "done");
+	finalize_flash_access(flash);
+
+	if (!ret)
+		ret = backup_save(buf, flash_size, flash->chip->name, manifest, chunk_dir);
+
+_free_ret:
+	free(buf);
+	return ret;
+}
+
+int do_restore(struct flashctx *const flash, const char *const manifest, const char *const chunk_dir,
+	       const char *const referencefile)
+{
+	const size_t flash_size = flash->chip->total_size * 1024;
+	int ret = 1;
+
+	uint8_t *const newcontents = malloc(flash_size);
+	uint8_t *const refcontents = referencefile ? malloc(flash_size) : NULL;
+
+	if (!newcontents || (referencefile && !refcontents)) {
+		msg_gerr("Out of memory!\n");
+		goto _free_ret;
+	}
+
+	if (backup_load(newcontents, flash_size, flash->chip->name, manifest, chunk_dir))
+		goto _free_ret;
+
+	if (referencefile) {
+		if (read_buf_from_file(refcontents, flash_size, referencefile))
+			goto _free_ret;
+	}
+
+	ret = flashrom_image_write(flash, newcontents, flash_size, refcontents);
+
+_free_ret:
+	free(refcontents);
 	free(newcontents);
 	return ret;
 }
@@ -24,6 +24,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include "flash.h"
+#include "chipdrivers.h"
 #include "programmer.h"
 #include "hwaccess.h"
 #include "spi.h"
@@ -50,6 +51,8 @@
 /* Changed HSFC Control bits */
 #define PCH100_HSFC_FCYCLE_OFF	(17 - 16)	/* 1-4: FLASH Cycle */
 #define PCH100_HSFC_FCYCLE	(0xf << PCH100_HSFC_FCYCLE_OFF)
+#define PCH100_HSFC_FCYCLE_BERASE_4K	(0x3 << PCH100_HSFC_FCYCLE_OFF)	/* 4 KB Block Erase */
+#define PCH100_HSFC_FCYCLE_BERASE_64K	(0x4 << PCH100_HSFC_FCYCLE_OFF)	/* 64 KB Sector Erase */
 /* New HSFC Control bit */
 #define HSFC_WET_OFF		(21 - 16)	/* 5: Write Enable Type */
 #define HSFC_WET		(0x1 << HSFC_WET_OFF)
@@ -265,6 +268,9 @@ typedef struct _OPCODES {
 
 static OPCODES *curopcodes = NULL;
 
+/* Maps every opcode to its index in curopcodes, -1 if it's not in there. */
+static int8_t curopcodes_map[256];
+
 /* HW access functions */
 static uint32_t REGREAD32(int X)
 {
@@ -290,8 +296,8 @@ static int find_opcode(OPCODES *op, uint8_t opcode);
 static int find_preop(OPCODES *op, uint8_t preop);
 static int generate_opcodes(OPCODES * op);
 static int program_opcodes(OPCODES *op, int enable_undo);
-static int run_opcode(const struct flashctx *flash, OPCODE op, uint32_t offset,
-		      uint8_t datalength, uint8_t * data);
+static int run_opcode(const struct flashctx *flash, OPCODE op, int opcode_index,
+		      uint32_t offset, uint8_t datalength, uint8_t * data);
 
 /* for pairing opcodes with their required preop */
 struct preop_opcode_pair {
@@ -349,10 +355,29 @@ static OPCODE POSSIBLE_OPCODES[] = {
 	 {JEDEC_SE, SPI_OPCODE_TYPE_WRITE_WITH_ADDRESS, 0},	// Sector erase
 	 {JEDEC_BE_52, SPI_OPCODE_TYPE_WRITE_WITH_ADDRESS, 0},	// Block erase
 	 {JEDEC_AAI_WORD_PROGRAM, SPI_OPCODE_TYPE_WRITE_NO_ADDRESS, 0},	// Auto Address Increment
+	 {JEDEC_RES, SPI_OPCODE_TYPE_READ_WITH_ADDRESS, 0},	// Read Electronic Signature
+	 {JEDEC_CE_60, SPI_OPCODE_TYPE_WRITE_NO_ADDRESS, 0},	// Bulk erase
+	 {JEDEC_CE_62, SPI_OPCODE_TYPE_WRITE_NO_ADDRESS, 0},	// Bulk erase (AT25F)
+	 {JEDEC_BE_50, SPI_OPCODE_TYPE_WRITE_WITH_ADDRESS, 0},	// Block erase (AT26DF)
+	 {JEDEC_BE_81, SPI_OPCODE_TYPE_WRITE_WITH_ADDRESS, 0},	// Page erase (AT26DF)
+	 {JEDEC_BE_C4, SPI_OPCODE_TYPE_WRITE_WITH_ADDRESS, 0},	// Die erase
+	 {JEDEC_BE_D7, SPI_OPCODE_TYPE_WRITE_WITH_ADDRESS, 0},	// Sector erase (PMC)
+	 {JEDEC_PE, SPI_OPCODE_TYPE_WRITE_WITH_ADDRESS, 0},	// Page erase
+	 {JEDEC_RDSR2, SPI_OPCODE_TYPE_READ_NO_ADDRESS, 0},	// Read Status Register 2
+	 {JEDEC_WRDI, SPI_OPCODE_TYPE_WRITE_NO_ADDRESS, 0},	// Write Disable, ends AAI
+};
+
+/* Erase opcodes with 3-byte addresses (or none) we can put into the menu. */
+static const uint8_t ich_erase_opcodes[] = {
+	JEDEC_SE, JEDEC_BE_50, JEDEC_BE_52, JEDEC_CE_60, JEDEC_CE_62, JEDEC_BE_81,
+	JEDEC_BE_C4, JEDEC_CE_C7, JEDEC_BE_D7, JEDEC_BE_D8, JEDEC_PE,
 };
 
 static OPCODES O_EXISTING = {};
 
+/* Opcode menu computed from the probed chip, see ich_spi_prepare_access(). */
+static OPCODES O_CHIP_PLAN = {};
+
 /* pretty printing functions */
 static void prettyprint_opcodes(OPCODES *ops)
 {
@@ -530,6 +555,18 @@ static int reprogram_opcode_on_the_fly(uint8_t opcode, unsigned int writecnt, un
 	return oppos;
 }
 
+static void update_curopcodes_map(void)
+{
+	int a;
+
+	memset(curopcodes_map, -1, sizeof(curopcodes_map));
+	if (curopcodes == NULL)
+		return;
+	/* Backwards, so that the first occurrence wins like in a linear search. */
+	for (a = 7; a >= 0; a--)
+		curopcodes_map[curopcodes->opcode[a].opcode] = a;
+}
+
 static int find_opcode(OPCODES *op, uint8_t opcode)
 {
 	int a;
@@ -539,6 +576,9 @@ static int find_opcode(OPCODES *op, uint8_t opcode)
 		return -1;
 	}
 
+	if (op == curopcodes)
+		return curopcodes_map[opcode];
+
 	for (a = 0; a < 8; a++) {
 		if (op->opcode[a].opcode == opcode)
 			return a;
@@ -682,6 +722,7 @@ static int program_opcodes(OPCODES *op, int enable_undo)
 		break;
 	}
 
+	update_curopcodes_map();
 	return 0;
 }
 
@@ -825,21 +866,20 @@ static int ich_init_opcodes(void)
 		return 1;
 	} else {
 		curopcodes = curopcodes_done;
+		update_curopcodes_map();
 		msg_pdbg("done\n");
 		prettyprint_opcodes(curopcodes);
 		return 0;
 	}
 }
 
-static int ich7_run_opcode(OPCODE op, uint32_t offset,
+static int ich7_run_opcode(OPCODE op, int opcode_index, uint32_t offset,
 			   uint8_t datalength, uint8_t * data, int maxdata)
 {
 	int write_cmd = 0;
 	int timeout;
 	uint32_t temp32;
 	uint16_t temp16;
-	uint64_t opmenu;
-	int opcode_index;
 
 	/* Is it a write command? */
 	if ((op.spi_type == SPI_OPCODE_TYPE_WRITE_NO_ADDRESS)
@@ -881,19 +921,6 @@ static int ich7_run_opcode(OPCODE op, uint32_t offset,
 	}
 
 	/* Select opcode */
-	opmenu = REGREAD32(ICH7_REG_OPMENU);
-	opmenu |= ((uint64_t)REGREAD32(ICH7_REG_OPMENU + 4)) << 32;
-
-	for (opcode_index = 0; opcode_index < 8; opcode_index++) {
-		if ((opmenu & 0xff) == op.opcode) {
-			break;
-		}
-		opmenu >>= 8;
-	}
-	if (opcode_index == 8) {
-		msg_pdbg("Opcode %x not found.\n", op.opcode);
-		return 1;
-	}
 	temp16 |= ((uint16_t) (opcode_index & 0x07)) << 4;
 
 	timeout = 100 * 60;	/* 60 ms are 9.6 million cycles at 16 MHz. */
@@ -949,14 +976,12 @@ static int ich7_run_opcode(OPCODE op, uint32_t offset,
 	return 0;
 }
 
-static int ich9_run_opcode(OPCODE op, uint32_t offset,
+static int ich9_run_opcode(OPCODE op, int opcode_index, uint32_t offset,
 			   uint8_t datalength, uint8_t * data)
 {
 	int write_cmd = 0;
 	int timeout;
 	uint32_t temp32;
-	uint64_t opmenu;
-	int opcode_index;
 
 	/* Is it a write command? */
 	if ((op.spi_type == SPI_OPCODE_TYPE_WRITE_NO_ADDRESS)
@@ -1003,19 +1028,6 @@ static int ich9_run_opcode(OPCODE op, uint32_t offset,
 	}
 
 	/* Select opcode */
-	opmenu = REGREAD32(swseq_data.reg_opmenu);
-	opmenu |= ((uint64_t)REGREAD32(swseq_data.reg_opmenu + 4)) << 32;
-
-	for (opcode_index = 0; opcode_index < 8; opcode_index++) {
-		if ((opmenu & 0xff) == op.opcode) {
-			break;
-		}
-		opmenu >>= 8;
-	}
-	if (opcode_index == 8) {
-		msg_pdbg("Opcode %x not found.\n", op.opcode);
-		return 1;
-	}
 	temp32 |= ((uint32_t) (opcode_index & 0x07)) << (8 + 4);
 
 	timeout = 100 * 60;	/* 60 ms are 9.6 million cycles at 16 MHz. */
@@ -1074,8 +1086,9 @@ static int ich9_run_opcode(OPCODE op, uint32_t offset,
 	return 0;
 }
 
-static int run_opcode(const struct flashctx *flash, OPCODE op, uint32_t offset,
-		      uint8_t datalength, uint8_t * data)
+/* opcode_index is the position of op in the programmed OPMENU (and curopcodes). */
+static int run_opcode(const struct flashctx *flash, OPCODE op, int opcode_index,
+		      uint32_t offset, uint8_t datalength, uint8_t * data)
 {
 	/* max_data_read == max_data_write for all Intel/VIA SPI masters */
 	uint8_t maxlength = flash->mst->spi.max_data_read;
@@ -1096,10 +1109,10 @@ static int run_opcode(const struct flashctx *flash, OPCODE op, uint32_t offset,
 	case CHIPSET_ICH7:
 	case CHIPSET_TUNNEL_CREEK:
 	case CHIPSET_CENTERTON:
-		return ich7_run_opcode(op, offset, datalength, data, maxlength);
+		return ich7_run_opcode(op, opcode_index, offset, datalength, data, maxlength);
 	case CHIPSET_ICH8:
 	default:		/* Future version might behave the same */
-		return ich9_run_opcode(op, offset, datalength, data);
+		return ich9_run_opcode(op, opcode_index, offset, datalength, data);
 	}
 }
 
@@ -1212,7 +1225,7 @@ static int ich_spi_send_command(struct flashctx *flash, unsigned int writecnt,
 		addr += addr_offset;
 	}
 
-	result = run_opcode(flash, *opcode, addr, count, data);
+	result = run_opcode(flash, *opcode, opcode_index, addr, count, data);
 	if (result) {
 		msg_pdbg("Running OPCODE 0x%02x failed ", opcode->opcode);
 		if ((opcode->spi_type == SPI_OPCODE_TYPE_WRITE_WITH_ADDRESS) ||
@@ -1242,6 +1255,7 @@ static struct hwseq_data {
 	uint32_t size_comp1;
 	uint32_t addr_mask;
 	bool only_4k;
+	bool erase_64k;
 	uint32_t hsfc_fcycle;
 } hwseq_data;
 
@@ -1317,6 +1331,8 @@ static int ich_hwseq_wait_for_cycle_complete(unsigned int timeout,
 	return 0;
 }
 
+static int ich_hwseq_block_erase_64k(struct flashctx *flash, unsigned int addr, unsigned int len);
+
 static int ich_hwseq_probe(struct flashctx *flash)
 {
 	uint32_t total_size, boundary;
@@ -1369,18 +1385,26 @@ static int ich_hwseq_probe(struct flashctx *flash)
 		msg_cdbg("In that range are %d erase blocks with %d B each.\n",
 			 size_high / erase_size_high, erase_size_high);
 	}
+	/* Newer PCHs can also erase 64 KB in one cycle. */
+	if (hwseq_data.erase_64k && total_size % (64 * 1024) == 0) {
+		eraser = &(flash->chip->block_erasers[1]);
+		eraser->block_erase = ich_hwseq_block_erase_64k;
+		eraser->eraseblocks[0].size = 64 * 1024;
+		eraser->eraseblocks[0].count = total_size / (64 * 1024);
+		msg_cdbg2("Alternatively, there are %d erase blocks with %d B each.\n",
+			  total_size / (64 * 1024), 64 * 1024);
+	}
 	flash->chip->tested = TEST_OK_PREW;
 	return 1;
 }
 
-static int ich_hwseq_block_erase(struct flashctx *flash, unsigned int addr,
-				 unsigned int len)
+/* Erases one block of erase_block bytes with the given HSFC cycle. */
+static int ich_hwseq_erase(struct flashctx *flash, unsigned int addr, unsigned int len,
+			   uint32_t erase_block, uint16_t fcycle)
 {
-	uint32_t erase_block;
 	uint16_t hsfc;
 	uint32_t timeout = 5000 * 1000; /* 5 s for max 64 kB */
 
-	erase_block = ich_hwseq_get_erase_block_size(addr);
 	if (len != erase_block) {
 		msg_cerr("Erase block size for address 0x%06x is %d B, "
 			 "but requested erase block size is %d B. "
@@ -1412,7 +1436,7 @@ static int ich_hwseq_block_erase(struct flashctx *flash, unsigned int addr,
 
 	hsfc = REGREAD16(ICH9_REG_HSFC);
 	hsfc &= ~hwseq_data.hsfc_fcycle; /* clear operation */
-	hsfc |= (0x3 << HSFC_FCYCLE_OFF); /* set erase operation */
+	hsfc |= fcycle; /* set erase operation */
 	hsfc |= HSFC_FGO; /* start */
 	msg_pdbg("HSFC used for block erasing: ");
 	prettyprint_ich9_reg_hsfc(hsfc);
@@ -1423,6 +1447,23 @@ static int ich_hwseq_block_erase(struct flashctx *flash, unsigned int addr,
 	return 0;
 }
 
+static int ich_hwseq_block_erase(struct flashctx *flash, unsigned int addr,
+				 unsigned int len)
+{
+	uint16_t fcycle = 0x3 << HSFC_FCYCLE_OFF; /* block erase */
+
+	if (hwseq_data.erase_64k)
+		fcycle = PCH100_HSFC_FCYCLE_BERASE_4K;
+	return ich_hwseq_erase(flash, addr, len, ich_hwseq_get_erase_block_size(addr), fcycle);
+}
+
+/* 64 KB sector erase of PCH100 and newer, registered as a second erase function. */
+static int ich_hwseq_block_erase_64k(struct flashctx *flash, unsigned int addr,
+				     unsigned int len)
+{
+	return ich_hwseq_erase(flash, addr, len, 64 * 1024, PCH100_HSFC_FCYCLE_BERASE_64K);
+}
+
 static int ich_hwseq_read(struct flashctx *flash, uint8_t *buf,
 			  unsigned int addr, unsigned int len)
 {
@@ -1566,6 +1607,110 @@ static int ich_spi_send_multicommand(struct flashctx *flash,
 	return ret;
 }
 
+/* Returns the opcode used by erase function `fn` or -1 if it's none we can put into the menu. */
+static int ich_erase_opcode(erasefunc_t *const fn)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(ich_erase_opcodes); i++) {
+		if (spi_get_erasefn_from_opcode(ich_erase_opcodes[i]) == fn)
+			return ich_erase_opcodes[i];
+	}
+	return -1;
+}
+
+static void ich_plan_add(uint8_t *wanted, unsigned int *count, const unsigned int max, const uint8_t opcode)
+{
+	unsigned int i;
+
+	for (i = 0; i < *count; i++) {
+		if (wanted[i] == opcode)
+			return;
+	}
+	if (*count < max)
+		wanted[(*count)++] = opcode;
+	else
+		msg_pdbg2("Opcode 0x%02x doesn't fit into the opcode menu, "
+			  "it will be programmed on demand.\n", opcode);
+}
+
+/*
+ * Compute the opcode menu from the probed chip's read, write, erase and
+ * status register functions and program it once. Every opcode the chip
+ * driver will use is then found by a single table lookup and no OPMENU
+ * rewrites happen in the middle of an operation. Opcodes that don't fit or
+ * aren't planned, e.g. those of unlock functions, are still programmed on
+ * demand into slot 2 by reprogram_opcode_on_the_fly().
+ *
+ * If the configuration is locked down, we can't change the menu. Instead
+ * we disable all erase functions whose opcode isn't in there, so that the
+ * erase walker doesn't have to fail on them first.
+ */
+static int ich_spi_prepare_access(struct flashctx *flash)
+{
+	/* Slot 2 is used by reprogram_opcode_on_the_fly(), so fill it last. */
+	static const int slot_order[8] = { 0, 1, 3, 4, 5, 6, 7, 2 };
+	static const uint8_t fillers[] = { JEDEC_RDID, JEDEC_REMS, JEDEC_RES, JEDEC_CE_C7 };
+	struct flashchip *const chip = flash->chip;
+	uint8_t wanted[8];
+	unsigned int count = 0, i;
+	int k, opcode;
+
+	if (ichspi_lock) {
+		for (k = 0; k < NUM_ERASEFUNCTIONS; k++) {
+			struct block_eraser *const eraser = &chip->block_erasers[k];
+			if (!eraser->block_erase)
+				continue;
+			opcode = ich_erase_opcode(eraser->block_erase);
+			if (opcode < 0 || find_opcode(curopcodes, opcode) != -1)
+				continue;
+			msg_pdbg("Erase function %d (opcode 0x%02x) is not in the locked "
+				 "opcode menu, disabling it.\n", k, opcode);
+			memset(eraser, 0, sizeof(*eraser));
+		}
+		return 0;
+	}
+
+	ich_plan_add(wanted, &count, ARRAY_SIZE(wanted), JEDEC_READ);
+	ich_plan_add(wanted, &count, ARRAY_SIZE(wanted), JEDEC_RDSR);
+	ich_plan_add(wanted, &count, ARRAY_SIZE(wanted), JEDEC_BYTE_PROGRAM);
+	if (chip->write == spi_aai_write) {
+		ich_plan_add(wanted, &count, ARRAY_SIZE(wanted), JEDEC_AAI_WORD_PROGRAM);
+		ich_plan_add(wanted, &count, ARRAY_SIZE(wanted), JEDEC_WRDI);
+	}
+	ich_plan_add(wanted, &count, ARRAY_SIZE(wanted), JEDEC_WRSR);
+	/* WREN and EWSR are prefix opcodes, but a second status register is read with its own opcode. */
+	if (chip->feature_bits & FEATURE_QE_SR2_BIT1)
+		ich_plan_add(wanted, &count, ARRAY_SIZE(wanted), JEDEC_RDSR2);
+	for (k = 0; k < NUM_ERASEFUNCTIONS; k++) {
+		const struct block_eraser *const eraser = &chip->block_erasers[k];
+		if (!eraser->block_erase || !eraser->eraseblocks[0].count)
+			continue;
+		opcode = ich_erase_opcode(eraser->block_erase);
+		if (opcode >= 0)
+			ich_plan_add(wanted, &count, ARRAY_SIZE(wanted), opcode);
+	}
+	/* Fill up the rest with probing opcodes. */
+	for (i = 0; i < ARRAY_SIZE(fillers) && count < ARRAY_SIZE(wanted); i++)
+		ich_plan_add(wanted, &count, ARRAY_SIZE(wanted), fillers[i]);
+
+	O_CHIP_PLAN.preop[0] = JEDEC_WREN;
+	O_CHIP_PLAN.preop[1] = JEDEC_EWSR;
+	for (i = 0; i < ARRAY_SIZE(slot_order); i++) {
+		OPCODE *const op = &O_CHIP_PLAN.opcode[slot_order[i]];
+		op->opcode = i < count ? wanted[i] : JEDEC_RDSR;
+		op->spi_type = lookup_spi_type(op->opcode);
+		op->atomic = 0;
+	}
+
+	msg_pdbg("Programming opcode menu for %s... ", chip->name);
+	curopcodes = &O_CHIP_PLAN;
+	program_opcodes(curopcodes, 0);
+	msg_pdbg("done\n");
+	prettyprint_opcodes(curopcodes);
+	return 0;
+}
+
 #define ICH_BMWAG(x) ((x >> 24) & 0xff)
 #define ICH_BMRAG(x) ((x >> 16) & 0xff)
 #define ICH_BRWA(x)  ((x >>  8) & 0xff)
@@ -1693,6 +1838,7 @@ static const struct spi_master spi_master_ich7 = {
 	.read = default_spi_read,
 	.write_256 = default_spi_write_256,
 	.write_aai = default_spi_write_aai,
+	.prepare_access = ich_spi_prepare_access,
 };
 
 static const struct spi_master spi_master_ich9 = {
@@ -1703,6 +1849,7 @@ static const struct spi_master spi_master_ich9 = {
 	.read = default_spi_read,
 	.write_256 = default_spi_write_256,
 	.write_aai = default_spi_write_aai,
+	.prepare_access = ich_spi_prepare_access,
 };
 
 static const struct opaque_master opaque_master_ich_hwseq = {
@@ -1749,6 +1896,7 @@ int ich_init_spi(void *spibar, enum ich_chipset ich_gen)
 		swseq_data.reg_opmenu	= PCH100_REG_OPMENU;
 		hwseq_data.addr_mask	= PCH100_FADDR_FLA;
 		hwseq_data.only_4k	= true;
+		hwseq_data.erase_64k	= true;
 		hwseq_data.hsfc_fcycle	= PCH100_HSFC_FCYCLE;
 		break;
 	default:
@@ -1760,6 +1908,7 @@ int ich_init_spi(void *spibar, enum ich_chipset ich_gen)
 		swseq_data.reg_opmenu	= ICH9_REG_OPMENU;
 		hwseq_data.addr_mask	= ICH9_FADDR_FLA;
 		hwseq_data.only_4k	= false;
+		hwseq_data.erase_64k	= false;
 		hwseq_data.hsfc_fcycle	= HSFC_FCYCLE;
 		break;
 	}
@@ -2053,6 +2202,7 @@ static const struct spi_master spi_master_via = {
 	.read = default_spi_read,
 	.write_256 = default_spi_write_256,
 	.write_aai = default_spi_write_aai,
+	.prepare_access = ich_spi_prepare_access,
 };
 
 int via_init_spi(uint32_t mmio_base)
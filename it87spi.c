@@ -342,8 +342,25 @@ static int it8716f_spi_send_command(struct flashctx *flash,
 	return 0;
 }
 
-/* Page size is usually 256 bytes */
-static int it8716f_spi_page_program(struct flashctx *flash, const uint8_t *buf, unsigned int start)
+/*
+ * LPC memory cycles are only translated for the top 512 KiB of the 4 GiB
+ * address space, which is where the top of the chip is mapped.
+ */
+#define IT87SPI_WINDOW_SIZE	(512 * 1024)
+/* The IT87* can't send more than 1+3+256 bytes at once. */
+#define IT87SPI_MAX_PROGRAM	256
+
+/* Returns the first chip offset reachable with memory cycles. */
+static unsigned int it87spi_window_start(const struct flashctx *flash)
+{
+	const unsigned int size = flash->chip->total_size * 1024;
+
+	return size > IT87SPI_WINDOW_SIZE ? size - IT87SPI_WINDOW_SIZE : 0;
+}
+
+/* Programs len bytes within one page, which must be inside the window. */
+static int it8716f_spi_page_program(struct flashctx *flash, const uint8_t *buf,
+				    unsigned int start, unsigned int len)
 {
 	unsigned int i;
 	int result;
@@ -355,7 +372,7 @@ static int it8716f_spi_page_program(struct flashctx *flash, const uint8_t *buf,
 	/* FIXME: The command below seems to be redundant or wrong. */
 	OUTB(0x06, it8716f_flashport + 1);
 	OUTB(((2 + (fast_spi ? 1 : 0)) << 4), it8716f_flashport);
-	for (i = 0; i < flash->chip->page_size; i++)
+	for (i = 0; i < len; i++)
 		mmio_writeb(buf[i], (void *)(bios + start + i));
 	OUTB(0, it8716f_flashport);
 	/* Wait until the Write-In-Progress bit is cleared.
@@ -367,23 +384,32 @@ static int it8716f_spi_page_program(struct flashctx *flash, const uint8_t *buf,
 }
 
 /*
- * IT8716F only allows maximum of 512 kb SPI mapped to LPC memory cycles
- * Need to read this big flash using firmware cycles 3 byte at a time.
+ * IT8716F only allows maximum of 512 kb SPI mapped to LPC memory cycles.
+ * Need to read the rest of big flash chips using firmware cycles 3 bytes
+ * at a time.
  */
 static int it8716f_spi_chip_read(struct flashctx *flash, uint8_t *buf,
 				 unsigned int start, unsigned int len)
 {
+	const unsigned int window = it87spi_window_start(flash);
+
 	fast_spi = 0;
 
 	/* FIXME: Check if someone explicitly requested to use IT87 SPI although
 	 * the mainboard does not use IT87 SPI translation. This should be done
 	 * via a programmer parameter for the internal programmer.
 	 */
-	if ((flash->chip->total_size * 1024 > 512 * 1024)) {
-		spi_read_chunked(flash, buf, start, len, 3);
-	} else {
-		mmio_readn((void *)(flash->virtual_memory + start), buf, len);
+	if (start < window) {
+		const unsigned int lenhere = min(len, window - start);
+		const int ret = spi_read_chunked(flash, buf, start, lenhere, 3);
+		if (ret)
+			return ret;
+		start += lenhere;
+		len -= lenhere;
+		buf += lenhere;
 	}
+	if (len)
+		mmio_readn((void *)(flash->virtual_memory + start), buf, len);
 
 	return 0;
 }
@@ -391,41 +417,28 @@ static int it8716f_spi_chip_read(struct flashctx *flash, uint8_t *buf,
 static int it8716f_spi_chip_write_256(struct flashctx *flash, const uint8_t *buf,
 				      unsigned int start, unsigned int len)
 {
-	const struct flashchip *chip = flash->chip;
+	const unsigned int window = it87spi_window_start(flash);
+	/* Bigger pages are programmed in parts, which stay within the page. */
+	const unsigned int chunksize = min(flash->chip->page_size, IT87SPI_MAX_PROGRAM);
 	/*
-	 * IT8716F only allows maximum of 512 kb SPI chip size for memory
-	 * mapped access. It also can't write more than 1+3+256 bytes at once,
-	 * so page_size > 256 bytes needs a fallback.
-	 * FIXME: Split too big page writes into chunks IT87* can handle instead
-	 * of degrading to single-byte program.
+	 * Outside of the window, a command can carry only a single data byte.
 	 * FIXME: Check if someone explicitly requested to use IT87 SPI although
 	 * the mainboard does not use IT87 SPI translation. This should be done
 	 * via a programmer parameter for the internal programmer.
 	 */
-	if ((chip->total_size * 1024 > 512 * 1024) || (chip->page_size > 256)) {
-		spi_chip_write_1(flash, buf, start, len);
-	} else {
-		unsigned int lenhere;
-
-		if (start % chip->page_size) {
-			/* start to the end of the page or to start + len,
-			 * whichever is smaller.
-			 */
-			lenhere = min(len, chip->page_size - start % chip->page_size);
-			spi_chip_write_1(flash, buf, start, lenhere);
-			start += lenhere;
-			len -= lenhere;
-			buf += lenhere;
-		}
-
-		while (len >= chip->page_size) {
-			it8716f_spi_page_program(flash, buf, start);
-			start += chip->page_size;
-			len -= chip->page_size;
-			buf += chip->page_size;
-		}
-		if (len)
-			spi_chip_write_1(flash, buf, start, len);
+	while (len) {
+		const unsigned int lenhere = min(len, chunksize - start % chunksize);
+		int ret;
+
+		if (start >= window)
+			ret = it8716f_spi_page_program(flash, buf, start, lenhere);
+		else
+			ret = spi_chip_write_1(flash, buf, start, lenhere);
+		if (ret)
+			return ret;
+		start += lenhere;
+		len -= lenhere;
+		buf += lenhere;
 	}
 
 	return 0;
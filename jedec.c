@@ -21,11 +21,16 @@
 
 #include "flash.h"
 #include "chipdrivers.h"
+#include "programmer.h"
 
 #define MAX_REFLASH_TRIES 0x10
 #define MASK_FULL 0xffff
 #define MASK_2AA 0x7ff
 #define MASK_AAA 0xfff
+/* Hard limits for toggle bit polling, well above any datasheet maximum. */
+#define PROGRAM_TIMEOUT_US	(100 * 1000)
+#define ERASE_TIMEOUT_US	(10 * 1000 * 1000)
+#define CHIP_ERASE_TIMEOUT_US	(300 * 1000 * 1000)
 
 /* Check one byte for odd parity */
 uint8_t oddparity(uint8_t val)
@@ -35,41 +40,63 @@ uint8_t oddparity(uint8_t val)
 	return (val ^ (val >> 1)) & 0x1;
 }
 
-static void toggle_ready_jedec_common(const struct flashctx *flash, chipaddr dst, unsigned int delay)
+/*
+ * Wait until the toggle bit stops toggling, i.e. the chip finished the program
+ * or erase operation, or until timeout_us elapsed.
+ *
+ * If the typical duration of the operation is known, sleep for most of it before
+ * the first poll and back off exponentially afterwards, starting at 1/8 and capped
+ * at 1/2 of it. Otherwise poll every min_interval_us, or as fast as possible.
+ */
+static int toggle_ready_jedec_common(const struct flashctx *flash, chipaddr dst, unsigned int typical_us,
+				     unsigned int min_interval_us, unsigned int timeout_us)
 {
+	const uint64_t start = internal_time_usecs();
+	const unsigned int max_interval = max(typical_us / 2, min_interval_us);
+	unsigned int interval = max(typical_us / 8, min_interval_us);
+	unsigned int delay = max(typical_us - typical_us / 4, min_interval_us);
 	unsigned int i = 0;
 	uint8_t tmp1, tmp2;
 
 	tmp1 = chip_readb(flash, dst) & 0x40;
 
-	while (i++ < 0xFFFFFFF) {
-		if (delay)
-			programmer_delay(delay);
+	while (1) {
+		programmer_delay(delay);
+		i++;
 		tmp2 = chip_readb(flash, dst) & 0x40;
-		if (tmp1 == tmp2) {
+		if (tmp1 == tmp2)
 			break;
-		}
 		tmp1 = tmp2;
+		if (internal_time_usecs() - start > timeout_us) {
+			msg_cerr("%s: timeout after %u polls\n", __func__, i);
+			return TIMEOUT_ERROR;
+		}
+		delay = interval;
+		interval = min(interval * 2, max_interval);
 	}
 	if (i > 0x100000)
 		msg_cdbg("%s: excessive loops, i=0x%x\n", __func__, i);
+	return 0;
 }
 
-void toggle_ready_jedec(const struct flashctx *flash, chipaddr dst)
+int toggle_ready_jedec(const struct flashctx *flash, chipaddr dst)
 {
-	toggle_ready_jedec_common(flash, dst, 0);
+	return toggle_ready_jedec_common(flash, dst, flash->chip->byte_program_time / 2, 0,
+					 PROGRAM_TIMEOUT_US);
 }
 
 /* Some chips require a minimum delay between toggle bit reads.
  * The Winbond W39V040C wants 50 ms between reads on sector erase toggle,
  * but experiments show that 2 ms are already enough. Pick a safety factor
  * of 4 and use an 8 ms delay.
+ * Chips with known typical erase times are paced by those instead.
  * Given that erase is slow on all chips, it is recommended to use
  * toggle_ready_jedec_slow in erase functions.
  */
-static void toggle_ready_jedec_slow(const struct flashctx *flash, chipaddr dst)
+static int toggle_ready_jedec_slow(const struct flashctx *flash, chipaddr dst, unsigned int typical_us,
+				   unsigned int timeout_us)
 {
-	toggle_ready_jedec_common(flash, dst, 8 * 1000);
+	return toggle_ready_jedec_common(flash, dst, typical_us, typical_us ? 0 : 8 * 1000, timeout_us);
 }
 
 void data_polling_jedec(const struct flashctx *flash, chipaddr dst,
@@ -307,10 +334,8 @@ static int erase_sector_jedec_common(struct flashctx *flash, unsigned int page,
 	programmer_delay(delay_us);
 
 	/* wait for Toggle bit ready         */
-	toggle_ready_jedec_slow(flash, bios);
-
 	/* FIXME: Check the status register for errors. */
-	return 0;
+	return toggle_ready_jedec_slow(flash, bios, flash->chip->erase_time.sector, ERASE_TIMEOUT_US);
 }
 
 static int erase_block_jedec_common(struct flashctx *flash, unsigned int block,
@@ -339,10 +364,8 @@ static int erase_block_jedec_common(struct flashctx *flash, unsigned int block,
 	programmer_delay(delay_us);
 
 	/* wait for Toggle bit ready         */
-	toggle_ready_jedec_slow(flash, bios);
-
 	/* FIXME: Check the status register for errors. */
-	return 0;
+	return toggle_ready_jedec_slow(flash, bios, flash->chip->erase_time.block, ERASE_TIMEOUT_US);
 }
 
 static int erase_chip_jedec_common(struct flashctx *flash, unsigned int mask)
@@ -369,10 +392,8 @@ static int erase_chip_jedec_common(struct flashctx *flash, unsigned int mask)
 	chip_writeb(flash, 0x10, bios + ((shifted ? 0x2AAA : 0x5555) & mask));
 	programmer_delay(delay_us);
 
-	toggle_ready_jedec_slow(flash, bios);
-
 	/* FIXME: Check the status register for errors. */
-	return 0;
+	return toggle_ready_jedec_slow(flash, bios, flash->chip->erase_time.chip, CHIP_ERASE_TIMEOUT_US);
 }
 
 static int write_byte_program_jedec_common(const struct flashctx *flash, const uint8_t *src,
@@ -404,6 +425,54 @@ retry:
 	return failed;
 }
 
+/*
+ * Program up to BURST_CHUNK bytes per master transaction. Instead of toggle
+ * polling after each byte, wait the maximum byte program time (tBP) and read the
+ * whole chunk back afterwards. Bytes which did not make it are retried with the
+ * polled single byte sequence.
+ */
+static int write_burst_jedec_common(struct flashctx *flash, const uint8_t *src,
+				    unsigned int start, unsigned int len, unsigned int mask)
+{
+	struct par_burst_op ops[4 * BURST_CHUNK];
+	uint8_t readback[BURST_CHUNK];
+	chipaddr bios = flash->virtual_memory;
+	bool shifted = (flash->chip->feature_bits & FEATURE_ADDR_SHIFTED);
+	const chipaddr addr1 = bios + ((shifted ? 0x2AAA : 0x5555) & mask);
+	const chipaddr addr2 = bios + ((shifted ? 0x5555 : 0x2AAA) & mask);
+	unsigned int i, j, n, count;
+	int failed = 0;
+
+	for (i = 0; i < len; i += n) {
+		n = min(len - i, BURST_CHUNK);
+		count = 0;
+		for (j = 0; j < n; j++) {
+			/* If the data is 0xFF, don't program it. */
+			if (src[i + j] == 0xFF)
+				continue;
+			ops[count++] = (struct par_burst_op){ addr1, 0xAA, 0 };
+			ops[count++] = (struct par_burst_op){ addr2, 0x55, 0 };
+			ops[count++] = (struct par_burst_op){ addr1, 0xA0, 0 };
+			ops[count++] = (struct par_burst_op){ bios + start + i + j, src[i + j],
+							      flash->chip->byte_program_time };
+		}
+		if (!count)
+			continue;
+		if (chip_write_burst(flash, ops, count))
+			return 1;
+
+		chip_readn(flash, readback, bios + start + i, n);
+		for (j = 0; j < n; j++) {
+			if (src[i + j] == 0xFF || readback[j] == src[i + j])
+				continue;
+			if (write_byte_program_jedec_common(flash, src + i + j, bios + start + i + j, mask))
+				failed = 1;
+		}
+	}
+
+	return failed;
+}
+
 /* chunksize is 1 */
 int write_jedec_1(struct flashctx *flash, const uint8_t *src, unsigned int start,
 		  unsigned int len)
@@ -417,10 +486,14 @@ int write_jedec_1(struct flashctx *flash, const uint8_t *src, unsigned int start
 	mask = getaddrmask(flash->chip);
 
 	olddst = dst;
-	for (i = 0; i < len; i++) {
-		if (write_byte_program_jedec_common(flash, src, dst, mask))
-			failed = 1;
-		dst++, src++;
+	if (flash->chip->byte_program_time && chip_has_write_burst(flash)) {
+		failed = write_burst_jedec_common(flash, src, start, len, mask);
+	} else {
+		for (i = 0; i < len; i++) {
+			if (write_byte_program_jedec_common(flash, src, dst, mask))
+				failed = 1;
+			dst++, src++;
+		}
 	}
 	if (failed)
 		msg_cerr(" writing sector at 0x%" PRIxPTR " failed!\n", olddst);
@@ -271,11 +271,185 @@ const struct romentry *layout_next_included(
 	return NULL;
 }
 
+int layout_add_included(struct flashrom_layout *const layout,
+			const chipoff_t start, const chipoff_t end, const char *const prefix)
+{
+	struct romentry *entry;
+	const size_t namelen = strlen(prefix) + sizeof("_00000000");
+
+	if (layout->num_entries >= MAX_ROMLAYOUT) {
+		msg_gerr("Error: More than %d regions are needed.\n", MAX_ROMLAYOUT);
+		return 1;
+	}
+	entry = &layout->entries[layout->num_entries];
+	entry->name = malloc(namelen);
+	if (!entry->name) {
+		msg_gerr("Error adding layout entry: %s\n", strerror(errno));
+		return 1;
+	}
+	snprintf(entry->name, namelen, "%s_%06x", prefix, start);
+	entry->start = start;
+	entry->end = end;
+	entry->included = true;
+	msg_gdbg("%s %08x - %08x named %s\n", prefix, start, end, entry->name);
+	layout->num_entries++;
+	return 0;
+}
+
+static int compare_chipsize(const void *a, const void *b)
+{
+	const chipsize_t x = *(const chipsize_t *)a, y = *(const chipsize_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+int layout_add_coalesced(struct flashrom_layout *const layout, const struct layout_range *const ranges,
+			 const size_t num, const chipsize_t block_size, const char *const prefix)
+{
+	const size_t room = MAX_ROMLAYOUT - layout->num_entries;
+	struct layout_range *merged;
+	chipsize_t *gaps = NULL, threshold = 0;
+	size_t count = 0, at_threshold = 0, i;
+	int ret = 1;
+
+	if (!num)
+		return 0;
+	merged = malloc(num * sizeof(*merged));
+	if (!merged) {
+		msg_gerr("Out of memory!\n");
+		return 1;
+	}
+	for (i = 0; i < num; i++) {
+		if (count && ranges[i].start / block_size == merged[count - 1].end / block_size)
+			merged[count - 1].end = ranges[i].end;
+		else
+			merged[count++] = ranges[i];
+	}
+
+	/* Without any room, layout_add_included() below reports the error. */
+	if (count > room && room) {
+		const size_t merges = count - room;
+
+		gaps = malloc((count - 1) * sizeof(*gaps));
+		if (!gaps) {
+			msg_gerr("Out of memory!\n");
+			goto _free_ret;
+		}
+		for (i = 1; i < count; i++)
+			gaps[i - 1] = merged[i].start - merged[i - 1].end;
+		qsort(gaps, count - 1, sizeof(*gaps), compare_chipsize);
+		threshold = gaps[merges - 1];
+		/* Bridge all gaps below the threshold and as many as needed at it. */
+		for (i = 0; i < merges; i++)
+			at_threshold += gaps[i] == threshold;
+	}
+
+	for (i = 0; i < count; i++) {
+		const chipoff_t start = merged[i].start;
+
+		while (gaps && i + 1 < count) {
+			const chipsize_t gap = merged[i + 1].start - merged[i].end;
+			if (gap > threshold || (gap == threshold && !at_threshold))
+				break;
+			if (gap == threshold)
+				at_threshold--;
+			i++;
+		}
+		if (layout_add_included(layout, start, merged[i].end, prefix))
+			goto _free_ret;
+	}
+	ret = 0;
+
+_free_ret:
+	free(gaps);
+	free(merged);
+	return ret;
+}
+
 /**
  * @addtogroup flashrom-layout
  * @{
  */
 
+/**
+ * @brief Create a new, empty layout.
+ *
+ * Regions can be added with flashrom_layout_add_region(). Free it with
+ * flashrom_layout_release().
+ *
+ * @param layout Pointer to returned layout reference.
+ *
+ * @return 0 on success,
+ *         1 if out of memory.
+ */
+int flashrom_layout_new(struct flashrom_layout **const layout)
+{
+	struct flashrom_layout *const l = malloc(sizeof(*l) + MAX_ROMLAYOUT * sizeof(*l->entries));
+	if (!l) {
+		msg_gerr("Error creating layout: %s\n", strerror(errno));
+		return 1;
+	}
+	l->entries = (struct romentry *)(l + 1);
+	l->num_entries = 0;
+	*layout = l;
+	return 0;
+}
+
+/**
+ * @brief Add an included region to a layout created with flashrom_layout_new().
+ *
+ * @param layout The layout to alter.
+ * @param start  Offset of the first byte of the region.
+ * @param end    Offset of the last byte of the region.
+ * @param name   Name of the region, it is copied.
+ *
+ * @return 0 on success,
+ *         1 if the range is invalid or the layout is full,
+ *         2 if out of memory.
+ */
+int flashrom_layout_add_region(struct flashrom_layout *const layout,
+			       const size_t start, const size_t end, const char *const name)
+{
+	struct romentry *entry;
+
+	if (start > end || end > FL_MAX_CHIPOFF || layout->num_entries >= MAX_ROMLAYOUT)
+		return 1;
+
+	entry = &layout->entries[layout->num_entries];
+	entry->name = strdup(name);
+	if (!entry->name) {
+		msg_gerr("Error adding layout entry: %s\n", strerror(errno));
+		return 2;
+	}
+	entry->start = start;
+	entry->end = end;
+	entry->included = true;
+	layout->num_entries++;
+	return 0;
+}
+
+/**
+ * @brief Get a region of a layout by its index.
+ *
+ * @param layout The layout to query.
+ * @param index  Index of the region, starting at 0.
+ * @param name   Pointer to the returned name, valid as long as the layout.
+ * @param start  Pointer to the returned offset of the first byte.
+ * @param len    Pointer to the returned length in bytes.
+ *
+ * @return 0 on success,
+ *         1 if there is no region at `index`.
+ */
+int flashrom_layout_get_region(const struct flashrom_layout *const layout, const size_t index,
+			       const char **const name, size_t *const start, size_t *const len)
+{
+	if (index >= layout->num_entries)
+		return 1;
+	*name = layout->entries[index].name;
+	*start = layout->entries[index].start;
+	*len = layout->entries[index].end - layout->entries[index].start + 1;
+	return 0;
+}
+
 /**
  * @brief Mark given region as included.
  *
@@ -66,5 +66,21 @@ const struct flashrom_layout *get_layout(const struct flashrom_flashctx *const f
 int process_include_args(struct flashrom_layout *l, const struct layout_include_args *const args);
 const struct romentry *layout_next_included_region(const struct flashrom_layout *, chipoff_t);
 const struct romentry *layout_next_included(const struct flashrom_layout *, const struct romentry *);
+/* Appends an included entry named "<prefix>_<start>", e.g. for the extents of a sparse image. */
+int layout_add_included(struct flashrom_layout *, chipoff_t start, chipoff_t end, const char *prefix);
+
+struct layout_range {
+	chipoff_t start;
+	chipoff_t end;		/* inclusive */
+};
+/*
+ * Appends the sorted, non-overlapping ranges as included entries like layout_add_included().
+ * Ranges that share a block of block_size are merged into one entry, so that the block is
+ * read, erased and written only once. If more entries are needed than there is room for,
+ * the smallest gaps between them are bridged, too. Merged entries cover the gaps between
+ * ranges, the caller has to keep their current contents.
+ */
+int layout_add_coalesced(struct flashrom_layout *, const struct layout_range *, size_t num,
+			 chipsize_t block_size, const char *prefix);
 
 #endif				/* !__LAYOUT_H__ */
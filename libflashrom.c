@@ -396,6 +396,7 @@ void flashrom_flag_set(struct flashrom_flashctx *const flashctx,
 		case FLASHROM_FLAG_FORCE_BOARDMISMATCH:	flashctx->flags.force_boardmismatch = value; break;
 		case FLASHROM_FLAG_VERIFY_AFTER_WRITE:	flashctx->flags.verify_after_write = value; break;
 		case FLASHROM_FLAG_VERIFY_WHOLE_CHIP:	flashctx->flags.verify_whole_chip = value; break;
+		case FLASHROM_FLAG_TUNE_READ_CHUNKS:	flashctx->flags.tune_read_chunks = value; break;
 	}
 }
 
@@ -413,10 +414,29 @@ bool flashrom_flag_get(const struct flashrom_flashctx *const flashctx, const enu
 		case FLASHROM_FLAG_FORCE_BOARDMISMATCH:	return flashctx->flags.force_boardmismatch;
 		case FLASHROM_FLAG_VERIFY_AFTER_WRITE:	return flashctx->flags.verify_after_write;
 		case FLASHROM_FLAG_VERIFY_WHOLE_CHIP:	return flashctx->flags.verify_whole_chip;
+		case FLASHROM_FLAG_TUNE_READ_CHUNKS:	return flashctx->flags.tune_read_chunks;
 		default:				return false;
 	}
 }
 
+/**
+ * @brief Request content digests for the next reads.
+ *
+ * After a successful flashrom_image_read(), a digest of each included
+ * layout region is computed from the read buffer and printed.
+ *
+ * @param flashctx  Flash context to alter.
+ * @param digests   Bitwise OR of `enum flashrom_digest` values, 0 to disable.
+ * @param json_path If not NULL, the digests are also written to this file
+ *                  as JSON. The string has to stay valid while in use.
+ */
+void flashrom_digest_set(struct flashrom_flashctx *const flashctx,
+			 const unsigned int digests, const char *const json_path)
+{
+	flashctx->digests = digests;
+	flashctx->digest_json = json_path;
+}
+
 /** @} */ /* end flashrom-flash */
 
 
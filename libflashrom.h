@@ -99,10 +99,18 @@ enum flashrom_flag {
 	FLASHROM_FLAG_FORCE_BOARDMISMATCH,
 	FLASHROM_FLAG_VERIFY_AFTER_WRITE,
 	FLASHROM_FLAG_VERIFY_WHOLE_CHIP,
+	FLASHROM_FLAG_TUNE_READ_CHUNKS,
 };
 void flashrom_flag_set(struct flashrom_flashctx *, enum flashrom_flag, bool value);
 bool flashrom_flag_get(const struct flashrom_flashctx *, enum flashrom_flag);
 
+/** @ingroup flashrom-flash */
+enum flashrom_digest {
+	FLASHROM_DIGEST_SHA256	= 1 << 0,
+	FLASHROM_DIGEST_CRC32C	= 1 << 1,
+};
+void flashrom_digest_set(struct flashrom_flashctx *, unsigned int digests, const char *json_path);
+
 int flashrom_image_read(struct flashrom_flashctx *, void *buffer, size_t buffer_len);
 int flashrom_image_write(struct flashrom_flashctx *, void *buffer, size_t buffer_len, const void *refbuffer);
 int flashrom_image_verify(struct flashrom_flashctx *, const void *buffer, size_t buffer_len);
@@ -113,6 +121,10 @@ int flashrom_layout_read_fmap_from_rom(struct flashrom_layout **,
 		struct flashrom_flashctx *, off_t offset, size_t length);
 int flashrom_layout_read_fmap_from_buffer(struct flashrom_layout **layout,
 		struct flashrom_flashctx *, const uint8_t *buf, size_t len);
+int flashrom_layout_new(struct flashrom_layout **);
+int flashrom_layout_add_region(struct flashrom_layout *, size_t start, size_t end, const char *name);
+int flashrom_layout_get_region(const struct flashrom_layout *, size_t index,
+		const char **name, size_t *start, size_t *len);
 int flashrom_layout_include_region(struct flashrom_layout *, const char *name);
 void flashrom_layout_release(struct flashrom_layout *);
 void flashrom_layout_set(struct flashrom_flashctx *, const struct flashrom_layout *);
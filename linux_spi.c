@@ -47,6 +47,8 @@
 static int fd = -1;
 #define BUF_SIZE_FROM_SYSFS	"/sys/module/spidev/parameters/bufsiz"
 static size_t max_kernel_buf_size;
+/* User supplied clock limit in Hz, 0 if none. */
+static uint32_t max_speed_hz;
 
 static int linux_spi_shutdown(void *data);
 static int linux_spi_send_command(struct flashctx *flash, unsigned int writecnt,
@@ -57,6 +59,10 @@ static int linux_spi_read(struct flashctx *flash, uint8_t *buf,
 			  unsigned int start, unsigned int len);
 static int linux_spi_write_256(struct flashctx *flash, const uint8_t *buf,
 			       unsigned int start, unsigned int len);
+static int linux_spi_set_max_speed(struct flashctx *flash, uint32_t khz);
+static int linux_spi_write_multi_io(struct flashctx *flash, unsigned int addr_lines, unsigned int data_lines,
+				    const unsigned char *cmd, unsigned int cmdlen,
+				    const uint8_t *data, unsigned int datalen);
 
 static const struct spi_master spi_master_linux = {
 	.features	= SPI_MASTER_4BA,
@@ -67,17 +73,23 @@ static const struct spi_master spi_master_linux = {
 	.read		= linux_spi_read,
 	.write_256	= linux_spi_write_256,
 	.write_aai	= default_spi_write_aai,
+	.set_max_speed	= linux_spi_set_max_speed,
+	.write_multi_io	= linux_spi_write_multi_io,
 };
 
 int linux_spi_init(void)
 {
+	struct spi_master mst = spi_master_linux;
 	char *p, *endp, *dev;
 	uint32_t speed_hz = 2 * 1000 * 1000;
+	unsigned long txwidth = 1;
 	/* FIXME: make the following configurable by CLI options. */
 	/* SPI mode 0 (beware this also includes: MSB first, CS active low and others */
 	const uint8_t mode = SPI_MODE_0;
 	const uint8_t bits = 8;
 
+	/* No limit unless this session asks for one. */
+	max_speed_hz = 0;
 	p = extract_programmer_param("spispeed");
 	if (p && strlen(p)) {
 		speed_hz = (uint32_t)strtoul(p, &endp, 10) * 1000;
@@ -86,13 +98,26 @@ int linux_spi_init(void)
 			free(p);
 			return 1;
 		}
+		max_speed_hz = speed_hz;
 	} else {
-		msg_pinfo("Using default %"PRIu32
-			  "kHz clock. Use 'spispeed' parameter to override.\n",
+		msg_pinfo("Using default %"PRIu32"kHz clock until the chip is known. "
+			  "Use 'spispeed' parameter to set a limit.\n",
 			  speed_hz / 1000);
 	}
 	free(p);
 
+	/* Only the board knows whether IO2/IO3 are wired up, so multi-I/O writes are opt-in. */
+	p = extract_programmer_param("txwidth");
+	if (p && strlen(p)) {
+		txwidth = strtoul(p, &endp, 10);
+		if (p == endp || *endp || (txwidth != 1 && txwidth != 2 && txwidth != 4)) {
+			msg_perr("%s: invalid txwidth: %s, use 1, 2 or 4\n", __func__, p);
+			free(p);
+			return 1;
+		}
+	}
+	free(p);
+
 	dev = extract_programmer_param("dev");
 	if (!dev || !strlen(dev)) {
 		msg_perr("No SPI device given. Use flashrom -p "
@@ -127,6 +152,26 @@ int linux_spi_init(void)
 		return 1;
 	}
 
+	if (txwidth > 1) {
+		uint32_t mode32;
+
+		if (ioctl(fd, SPI_IOC_RD_MODE32, &mode32) == -1) {
+			msg_perr("%s: failed to read SPI mode: %s\n", __func__, strerror(errno));
+			return 1;
+		}
+		mode32 |= txwidth == 4 ? SPI_TX_QUAD : SPI_TX_DUAL;
+		if (ioctl(fd, SPI_IOC_WR_MODE32, &mode32) == -1) {
+			msg_perr("%s: failed to enable %lu-line transmit: %s\n",
+				 __func__, txwidth, strerror(errno));
+			return 1;
+		}
+		/* Quad capable controllers accept dual transfers too. */
+		mst.features |= SPI_MASTER_DUAL_TX;
+		if (txwidth == 4)
+			mst.features |= SPI_MASTER_QUAD_TX;
+		msg_pdbg("Using up to %lu lines for writes\n", txwidth);
+	}
+
 	if (ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &bits) == -1) {
 		msg_perr("%s: failed to set the number of bits per SPI word to %u: %s\n",
 			 __func__, bits == 0 ? 8 : bits, strerror(errno));
@@ -170,7 +215,8 @@ out:
 	}
 
 	msg_pdbg("%s: max_kernel_buf_size: %zu\n", __func__, max_kernel_buf_size);
-	register_spi_master(&spi_master_linux);
+	/* The multi-I/O features only apply to this session, so register a copy. */
+	register_spi_master(&mst);
 	return 0;
 }
 
@@ -183,6 +229,22 @@ static int linux_spi_shutdown(void *data)
 	return 0;
 }
 
+static int linux_spi_set_max_speed(struct flashctx *flash, uint32_t khz)
+{
+	uint32_t speed_hz = khz * 1000;
+
+	if (max_speed_hz && speed_hz > max_speed_hz)
+		speed_hz = max_speed_hz;
+
+	if (ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed_hz) == -1) {
+		msg_perr("%s: failed to set speed to %"PRIu32"Hz: %s\n",
+			 __func__, speed_hz, strerror(errno));
+		return 1;
+	}
+	msg_pdbg("Using %"PRIu32"kHz clock\n", speed_hz / 1000);
+	return 0;
+}
+
 static int linux_spi_send_command(struct flashctx *flash, unsigned int writecnt,
 				  unsigned int readcnt,
 				  const unsigned char *txbuf,
@@ -221,11 +283,48 @@ static int linux_spi_send_command(struct flashctx *flash, unsigned int writecnt,
 	return 0;
 }
 
+static int linux_spi_write_multi_io(struct flashctx *flash, unsigned int addr_lines, unsigned int data_lines,
+				    const unsigned char *cmd, unsigned int cmdlen,
+				    const uint8_t *data, unsigned int datalen)
+{
+	struct spi_ioc_transfer msg[3];
+	unsigned int n = 0;
+
+	if (fd == -1)
+		return -1;
+	if (cmdlen == 0 || cmdlen + datalen > max_kernel_buf_size)
+		return SPI_INVALID_LENGTH;
+
+	/* The opcode always goes out on a single line, chip select stays
+	   asserted across the transfers of one message. */
+	memset(msg, 0, sizeof(msg));
+	msg[n].tx_buf = (uint64_t)(uintptr_t)cmd;
+	msg[n].len = addr_lines == 1 ? cmdlen : 1;
+	msg[n++].tx_nbits = 1;
+	if (addr_lines != 1 && cmdlen > 1) {
+		msg[n].tx_buf = (uint64_t)(uintptr_t)(cmd + 1);
+		msg[n].len = cmdlen - 1;
+		msg[n++].tx_nbits = addr_lines;
+	}
+	if (datalen) {
+		msg[n].tx_buf = (uint64_t)(uintptr_t)data;
+		msg[n].len = datalen;
+		msg[n++].tx_nbits = data_lines;
+	}
+
+	if (ioctl(fd, SPI_IOC_MESSAGE(n), msg) == -1) {
+		msg_cerr("%s: ioctl: %s\n", __func__, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
 static int linux_spi_read(struct flashctx *flash, uint8_t *buf, unsigned int start, unsigned int len)
 {
 	/* Older kernels use a single buffer for combined input and output
 	   data. So account for longest possible command + address, too. */
-	return spi_read_chunked(flash, buf, start, len, max_kernel_buf_size - 5);
+	return spi_read_chunked(flash, buf, start, len,
+				spi_read_chunksize(flash, max_kernel_buf_size - 5));
 }
 
 static int linux_spi_write_256(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len)
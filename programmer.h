@@ -70,6 +70,9 @@ enum programmer {
 #if CONFIG_SERPROG == 1
 	PROGRAMMER_SERPROG,
 #endif
+#if CONFIG_PROXY == 1
+	PROGRAMMER_PROXY,
+#endif
 #if CONFIG_BUSPIRATE_SPI == 1
 	PROGRAMMER_BUSPIRATE_SPI,
 #endif
@@ -167,6 +170,7 @@ extern const struct programmer_entry programmer_table[];
 
 int programmer_init(enum programmer prog, const char *param);
 int programmer_shutdown(void);
+const char *programmer_name(void);
 
 struct bitbang_spi_master {
 	/* Note that CS# is active low, so val=0 means the chip is active. */
@@ -277,6 +281,7 @@ void myusec_delay(unsigned int usecs);
 void myusec_calibrate_delay(void);
 void internal_sleep(unsigned int usecs);
 void internal_delay(unsigned int usecs);
+uint64_t internal_time_usecs(void);
 
 #if CONFIG_INTERNAL == 1
 /* board_enable.c */
@@ -603,6 +608,8 @@ char *extract_programmer_param(const char *param_name);
 #define SPI_MASTER_4BA			(1U << 0)  /**< Can handle 4-byte addresses */
 #define SPI_MASTER_NO_4BA_MODES		(1U << 1)  /**< Compatibility modes (i.e. extended address
 						        register, 4BA mode switch) don't work */
+#define SPI_MASTER_DUAL_TX		(1U << 2)  /**< Can send data on two lines, see write_multi_io */
+#define SPI_MASTER_QUAD_TX		(1U << 3)  /**< Can send address and data on four lines */
 
 struct spi_master {
 	uint32_t features;
@@ -616,7 +623,20 @@ struct spi_master {
 	int (*read)(struct flashctx *flash, uint8_t *buf, unsigned int start, unsigned int len);
 	int (*write_256)(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len);
 	int (*write_aai)(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len);
+	/* Optional, called once the chip is known and before it is accessed. */
+	int (*prepare_access)(struct flashctx *flash);
+	/* Optional, sets the SPI clock to at most khz, within the master's and the user's limits. */
+	int (*set_max_speed)(struct flashctx *flash, uint32_t khz);
+	/* Required with SPI_MASTER_DUAL_TX/QUAD_TX. Sends the opcode cmd[0] on one line,
+	   the address cmd[1..cmdlen-1] on addr_lines and then data on data_lines. */
+	int (*write_multi_io)(struct flashctx *flash, unsigned int addr_lines, unsigned int data_lines,
+			      const unsigned char *cmd, unsigned int cmdlen,
+			      const uint8_t *data, unsigned int datalen);
 	const void *data;
+	/* Read chunk size tuned for a maximum of tuned_read_max, 0 until tuned. Kept by spi.c
+	   in the registered copy, so every master of a session is tuned on its own. */
+	unsigned int tuned_read_chunk;
+	unsigned int tuned_read_max;
 };
 
 int default_spi_send_command(struct flashctx *flash, unsigned int writecnt, unsigned int readcnt,
@@ -722,6 +742,10 @@ struct par_master {
 	uint16_t (*chip_readw) (const struct flashctx *flash, const chipaddr addr);
 	uint32_t (*chip_readl) (const struct flashctx *flash, const chipaddr addr);
 	void (*chip_readn) (const struct flashctx *flash, uint8_t *buf, const chipaddr addr, size_t len);
+	/* Optional, queues a whole sequence of writes and delays at once. A master
+	 * may only split the burst into separate transactions after an op with a
+	 * non-zero delay. */
+	int (*chip_write_burst) (const struct flashctx *flash, const struct par_burst_op *ops, size_t count);
 	const void *data;
 };
 int register_par_master(const struct par_master *mst, const enum chipbustype buses);
@@ -744,6 +768,11 @@ void serprog_delay(unsigned int usecs);
 void *serprog_map(const char *descr, uintptr_t phys_addr, size_t len);
 #endif
 
+/* proxy.c */
+#if CONFIG_PROXY == 1
+int proxy_init(void);
+#endif
+
 /* serial.c */
 #if IS_WINDOWS
 typedef HANDLE fdtype;
@@ -801,6 +830,16 @@ static inline bool spi_master_no_4ba_modes(const struct flashctx *const flash)
 	return flash->mst->buses_supported & BUS_SPI &&
 		flash->mst->spi.features & SPI_MASTER_NO_4BA_MODES;
 }
+static inline bool spi_master_dual_tx(const struct flashctx *const flash)
+{
+	return flash->mst->buses_supported & BUS_SPI &&
+		flash->mst->spi.features & SPI_MASTER_DUAL_TX;
+}
+static inline bool spi_master_quad_tx(const struct flashctx *const flash)
+{
+	return flash->mst->buses_supported & BUS_SPI &&
+		flash->mst->spi.features & SPI_MASTER_QUAD_TX;
+}
 
 /* usbdev.c */
 struct libusb_device_handle;
@@ -0,0 +1,448 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Client for flashrom-proxy, which serves the SPI master of a programmer on
+ * another machine. SPI commands are sent as they come and only waited for
+ * when their result is needed, up to `window` of them in flight. Reads and
+ * page programming run in batches: the reads of a whole region are all sent
+ * before the first answer is awaited, and the status register polling after
+ * each page program is done by the server.
+ */
+
+#include <errno.h>
+#include <netdb.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include "flash.h"
+#include "chipdrivers.h"
+#include "programmer.h"
+#include "spi.h"
+#include "proxy.h"
+
+#define DEFAULT_WINDOW		64
+#define MAX_WINDOW		1024
+/* Status register polling done by the server after each page program. */
+#define POLL_DELAY_US		10
+#define POLL_TIMEOUT_US		(10 * 1000 * 1000)
+
+enum proxy_batch {
+	PROXY_SYNC,		/* wait for every command */
+	PROXY_BATCH_READ,	/* read data lands in caller buffers that outlive the batch */
+	PROXY_BATCH_WRITE,	/* WIP polling is left to the server */
+};
+
+struct proxy_request {
+	uint8_t *readarr;	/* NULL to discard the response payload */
+	unsigned int readcnt;
+};
+
+/* Connection state, allocated by every proxy_init(). */
+struct proxy_data {
+	int fd;
+	unsigned int window;
+	enum proxy_batch batch;
+
+	/* Ring of requests sent but not answered yet. */
+	struct proxy_request *pending;
+	unsigned int pending_first, pending_count;
+	/* First error reported for a request nobody waited for. */
+	int deferred_error;
+
+	/* Requests are collected here and sent together before waiting for a response. */
+	uint8_t *outbuf;
+	size_t outlen;
+};
+
+static uint32_t get_le32(const uint8_t *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void put_le32(uint8_t *p, uint32_t val)
+{
+	p[0] = val;
+	p[1] = val >> 8;
+	p[2] = val >> 16;
+	p[3] = val >> 24;
+}
+
+static void proxy_disconnect(struct proxy_data *pd)
+{
+	if (pd->fd >= 0)
+		close(pd->fd);
+	pd->fd = -1;
+}
+
+static int proxy_write_all(struct proxy_data *pd, const uint8_t *buf, size_t len)
+{
+	while (len) {
+		const ssize_t ret = write(pd->fd, buf, len);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0) {
+			msg_perr("Error: Sending to the proxy failed: %s\n", ret ? strerror(errno) : "closed");
+			proxy_disconnect(pd);
+			return 1;
+		}
+		buf += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+static int proxy_read_all(struct proxy_data *pd, uint8_t *buf, size_t len)
+{
+	while (len) {
+		const ssize_t ret = read(pd->fd, buf, len);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0) {
+			msg_perr("Error: Receiving from the proxy failed: %s\n",
+				 ret ? strerror(errno) : "connection closed");
+			proxy_disconnect(pd);
+			return 1;
+		}
+		buf += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+static int proxy_flush(struct proxy_data *pd)
+{
+	const size_t len = pd->outlen;
+
+	pd->outlen = 0;
+	return len ? proxy_write_all(pd, pd->outbuf, len) : 0;
+}
+
+/* Waits for the response to the oldest pending request. */
+static int proxy_receive(struct proxy_data *pd)
+{
+	const struct proxy_request req = pd->pending[pd->pending_first];
+	uint8_t header[PROXY_HEADER_SIZE], discard[16];
+
+	pd->pending_first = (pd->pending_first + 1) % pd->window;
+	pd->pending_count--;
+
+	if (proxy_flush(pd) || proxy_read_all(pd, header, sizeof(header)))
+		return 1;
+	const int32_t status = (int32_t)get_le32(header);
+	const uint32_t len = get_le32(header + 4);
+
+	if (len != (status ? 0 : req.readcnt) || (!req.readarr && len > sizeof(discard))) {
+		msg_perr("Error: Unexpected response of %u B from the proxy.\n", len);
+		proxy_disconnect(pd);
+		return 1;
+	}
+	if (proxy_read_all(pd, req.readarr ? req.readarr : discard, len))
+		return 1;
+	if (status && !pd->deferred_error)
+		pd->deferred_error = status;
+	return 0;
+}
+
+/* Waits for all pending requests, returns the first error any of them had. */
+static int proxy_sync(struct proxy_data *pd)
+{
+	int ret;
+
+	while (pd->pending_count) {
+		if (proxy_receive(pd))
+			break;
+	}
+	ret = pd->pending_count ? SPI_GENERIC_ERROR : pd->deferred_error;
+	pd->pending_count = 0;
+	pd->deferred_error = 0;
+	return ret;
+}
+
+static int proxy_send(struct proxy_data *pd, enum proxy_op op, const uint8_t *params, size_t paramlen,
+		      const uint8_t *data, size_t datalen, uint8_t *readarr, unsigned int readcnt)
+{
+	const size_t len = PROXY_HEADER_SIZE + paramlen + datalen;
+
+	if (pd->fd < 0) {
+		msg_perr("Error: Not connected to the proxy.\n");
+		return 1;
+	}
+	if (pd->pending_count == pd->window && proxy_receive(pd))
+		return 1;
+	if (pd->outlen + len > PROXY_HEADER_SIZE + PROXY_MAX_PAYLOAD && proxy_flush(pd))
+		return 1;
+
+	uint8_t *const p = pd->outbuf + pd->outlen;
+	p[0] = op;
+	p[1] = p[2] = p[3] = 0;
+	put_le32(p + 4, paramlen + datalen);
+	memcpy(p + PROXY_HEADER_SIZE, params, paramlen);
+	if (datalen)
+		memcpy(p + PROXY_HEADER_SIZE + paramlen, data, datalen);
+	pd->outlen += len;
+
+	const unsigned int slot = (pd->pending_first + pd->pending_count) % pd->window;
+	pd->pending[slot].readarr = readarr;
+	pd->pending[slot].readcnt = readcnt;
+	pd->pending_count++;
+	return 0;
+}
+
+static int proxy_queue_command(struct proxy_data *pd, unsigned int writecnt, unsigned int readcnt,
+			       const unsigned char *writearr, unsigned char *readarr)
+{
+	uint8_t params[12];
+
+	if (writecnt > PROXY_MAX_DATA || readcnt > PROXY_MAX_DATA) {
+		msg_perr("%s: Command of %u/%u B is too long.\n", __func__, writecnt, readcnt);
+		return SPI_INVALID_LENGTH;
+	}
+
+	/* Leave WIP polling to the server, the caller only checks that the bit cleared. */
+	if (pd->batch == PROXY_BATCH_WRITE && writecnt == 1 && writearr[0] == JEDEC_RDSR && readcnt) {
+		params[0] = JEDEC_RDSR;
+		params[1] = SPI_SR_WIP;
+		params[2] = params[3] = 0;
+		put_le32(params + 4, POLL_DELAY_US);
+		put_le32(params + 8, POLL_TIMEOUT_US);
+		memset(readarr, 0, readcnt);
+		return proxy_send(pd, PROXY_OP_SPI_POLL, params, 12, NULL, 0, NULL, 1);
+	}
+
+	put_le32(params, readcnt);
+	if (proxy_send(pd, PROXY_OP_SPI_COMMAND, params, 4, writearr, writecnt, readarr, readcnt))
+		return SPI_GENERIC_ERROR;
+	/* Other reads during a write may go to the caller's stack, they can't wait. */
+	if (readcnt && pd->batch == PROXY_BATCH_WRITE)
+		return proxy_sync(pd);
+	return 0;
+}
+
+static int proxy_spi_send_command(struct flashctx *flash, unsigned int writecnt, unsigned int readcnt,
+				  const unsigned char *writearr, unsigned char *readarr)
+{
+	struct proxy_data *const pd = (struct proxy_data *)flash->mst->spi.data;
+	const int ret = proxy_queue_command(pd, writecnt, readcnt, writearr, readarr);
+
+	if (ret || pd->batch != PROXY_SYNC)
+		return ret;
+	return proxy_sync(pd);
+}
+
+static int proxy_spi_send_multicommand(struct flashctx *flash, struct spi_command *cmds)
+{
+	struct proxy_data *const pd = (struct proxy_data *)flash->mst->spi.data;
+	int ret = 0;
+
+	for (; (cmds->writecnt || cmds->readcnt) && !ret; cmds++)
+		ret = proxy_queue_command(pd, cmds->writecnt, cmds->readcnt, cmds->writearr, cmds->readarr);
+	if (pd->batch != PROXY_SYNC)
+		return ret;
+	const int sync_ret = proxy_sync(pd);
+	return ret ? ret : sync_ret;
+}
+
+static int proxy_spi_read(struct flashctx *flash, uint8_t *buf, unsigned int start, unsigned int len)
+{
+	struct proxy_data *const pd = (struct proxy_data *)flash->mst->spi.data;
+	int ret;
+
+	pd->batch = PROXY_BATCH_READ;
+	ret = spi_read_chunked(flash, buf, start, len, flash->mst->spi.max_data_read);
+	pd->batch = PROXY_SYNC;
+	const int sync_ret = proxy_sync(pd);
+	return ret ? ret : sync_ret;
+}
+
+static int proxy_spi_write_256(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len)
+{
+	struct proxy_data *const pd = (struct proxy_data *)flash->mst->spi.data;
+	int ret;
+
+	pd->batch = PROXY_BATCH_WRITE;
+	ret = spi_write_chunked(flash, buf, start, len, flash->mst->spi.max_data_write);
+	pd->batch = PROXY_SYNC;
+	const int sync_ret = proxy_sync(pd);
+	return ret ? ret : sync_ret;
+}
+
+static const struct spi_master spi_master_proxy = {
+	.command	= proxy_spi_send_command,
+	.multicommand	= proxy_spi_send_multicommand,
+	.read		= proxy_spi_read,
+	.write_256	= proxy_spi_write_256,
+	.write_aai	= default_spi_write_aai,
+};
+
+static int proxy_connect(struct proxy_data *pd, const char *host, const char *port)
+{
+	struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+	struct addrinfo *res, *ai;
+	const int flag = 1;
+	int ret;
+
+	ret = getaddrinfo(host, port, &hints, &res);
+	if (ret) {
+		msg_perr("Error: Cannot resolve %s: %s\n", host, gai_strerror(ret));
+		return 1;
+	}
+	for (ai = res; ai; ai = ai->ai_next) {
+		pd->fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (pd->fd < 0)
+			continue;
+		if (!connect(pd->fd, ai->ai_addr, ai->ai_addrlen))
+			break;
+		proxy_disconnect(pd);
+	}
+	freeaddrinfo(res);
+	if (pd->fd < 0) {
+		msg_perr("Error: Cannot connect to %s:%s: %s\n", host, port, strerror(errno));
+		return 1;
+	}
+	/* Requests are batched by hand, don't let Nagle hold back the last one. */
+	if (setsockopt(pd->fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag)))
+		msg_pwarn("Warning: Cannot disable Nagle's algorithm: %s\n", strerror(errno));
+	return 0;
+}
+
+static int proxy_hello(struct proxy_data *pd, struct spi_master *mst)
+{
+	uint8_t params[4], info[16];
+
+	put_le32(params, PROXY_VERSION);
+	if (proxy_send(pd, PROXY_OP_HELLO, params, sizeof(params), NULL, 0, info, sizeof(info)) || proxy_sync(pd)) {
+		msg_perr("Error: The proxy didn't answer the handshake.\n");
+		return 1;
+	}
+	if (get_le32(info) != PROXY_VERSION) {
+		msg_perr("Error: The proxy speaks protocol version %u, we need %u.\n",
+			 get_le32(info), PROXY_VERSION);
+		return 1;
+	}
+	/* Multi-I/O programming would need a callback of its own. */
+	mst->features = get_le32(info + 4) & ~(SPI_MASTER_DUAL_TX | SPI_MASTER_QUAD_TX);
+	/* Without a stated limit, masters take what the generic SPI code sends. */
+	uint32_t max_read = get_le32(info + 8), max_write = get_le32(info + 12);
+	if (max_read == MAX_DATA_UNSPECIFIED)
+		max_read = MAX_DATA_READ_UNLIMITED;
+	if (max_write == MAX_DATA_UNSPECIFIED)
+		max_write = MAX_DATA_WRITE_UNLIMITED;
+	mst->max_data_read = max_read < PROXY_MAX_DATA ? max_read : PROXY_MAX_DATA;
+	/* Leave room for the opcode and address. */
+	mst->max_data_write = max_write < PROXY_MAX_DATA - 16 ? max_write : PROXY_MAX_DATA - 16;
+	msg_pdbg("Proxy SPI master: features 0x%x, max read %u B, max write %u B\n",
+		 mst->features, mst->max_data_read, mst->max_data_write);
+	return 0;
+}
+
+static int proxy_shutdown(void *data)
+{
+	struct proxy_data *const pd = data;
+
+	proxy_sync(pd);
+	proxy_disconnect(pd);
+	free(pd->pending);
+	free(pd->outbuf);
+	free(pd);
+	return 0;
+}
+
+int proxy_init(void)
+{
+	struct spi_master mst = spi_master_proxy;
+	struct proxy_data *pd;
+	char *host, *port, *window;
+
+	pd = calloc(1, sizeof(*pd));
+	if (!pd) {
+		msg_perr("Out of memory!\n");
+		return 1;
+	}
+	pd->fd = -1;
+	pd->window = DEFAULT_WINDOW;
+	pd->batch = PROXY_SYNC;
+
+	window = extract_programmer_param("window");
+	if (window) {
+		char *endptr;
+		pd->window = strtoul(window, &endptr, 0);
+		if (*endptr || !pd->window || pd->window > MAX_WINDOW) {
+			msg_perr("Error: Invalid window \"%s\", use 1 to %u.\n", window, MAX_WINDOW);
+			free(window);
+			free(pd);
+			return 1;
+		}
+		free(window);
+	}
+
+	host = extract_programmer_param("host");
+	if (!host || !strlen(host)) {
+		msg_perr("Error: No host specified.\n"
+			 "Use flashrom -p proxy:host=hostname[:port]\n");
+		free(host);
+		free(pd);
+		return 1;
+	}
+	/* Split off the port, IPv6 addresses need brackets for that: [::1]:7410 */
+	if (host[0] == '[') {
+		char *const end = strchr(host, ']');
+		if (!end) {
+			msg_perr("Error: Missing ']' in host \"%s\".\n", host);
+			free(host);
+			free(pd);
+			return 1;
+		}
+		*end = '\0';
+		port = end[1] == ':' ? end + 2 : NULL;
+		memmove(host, host + 1, end - host);
+	} else {
+		port = strchr(host, ':');
+		if (port && strchr(port + 1, ':'))
+			port = NULL;
+		else if (port)
+			*port++ = '\0';
+	}
+	char default_port[8];
+	snprintf(default_port, sizeof(default_port), "%u", PROXY_DEFAULT_PORT);
+
+	pd->pending = malloc(pd->window * sizeof(*pd->pending));
+	pd->outbuf = malloc(PROXY_HEADER_SIZE + PROXY_MAX_PAYLOAD);
+	if (!pd->pending || !pd->outbuf) {
+		msg_perr("Out of memory!\n");
+		goto init_err;
+	}
+	if (proxy_connect(pd, host, port && strlen(port) ? port : default_port))
+		goto init_err;
+	free(host);
+	host = NULL;
+
+	if (register_shutdown(proxy_shutdown, pd))
+		goto init_err;
+	if (proxy_hello(pd, &mst))
+		return 1;
+	mst.data = pd;
+	return register_spi_master(&mst);
+
+init_err:
+	free(host);
+	proxy_disconnect(pd);
+	free(pd->pending);
+	free(pd->outbuf);
+	free(pd);
+	return 1;
+}
@@ -0,0 +1,50 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __PROXY_H__
+#define __PROXY_H__ 1
+
+/*
+ * Protocol between the proxy programmer and flashrom-proxy, all numbers
+ * little-endian. Every request is answered by exactly one response, in
+ * order, so a client may send many requests before reading any response.
+ *
+ * Request:  u8 op, u8[3] reserved, u32 payload length, payload
+ * Response: s32 status (0 on success), u32 payload length, payload
+ *
+ * PROXY_OP_HELLO
+ *   request:  u32 protocol version
+ *   response: u32 protocol version, u32 SPI master features,
+ *             u32 max data read, u32 max data write
+ * PROXY_OP_SPI_COMMAND
+ *   request:  u32 readcnt, bytes to write
+ *   response: readcnt bytes read
+ * PROXY_OP_SPI_POLL, reads the status register until the bits in mask are clear
+ *   request:  u8 opcode, u8 mask, u8[2] reserved, u32 delay in us, u32 timeout in us
+ *   response: u8 last status register value
+ */
+
+#define PROXY_VERSION		1
+#define PROXY_DEFAULT_PORT	7410
+#define PROXY_HEADER_SIZE	8
+/* Largest data transfer of a single SPI command. */
+#define PROXY_MAX_DATA		(64 * 1024)
+#define PROXY_MAX_PAYLOAD	(PROXY_MAX_DATA + 16)
+
+enum proxy_op {
+	PROXY_OP_HELLO		= 0,
+	PROXY_OP_SPI_COMMAND	= 1,
+	PROXY_OP_SPI_POLL	= 2,
+};
+
+#endif				/* !__PROXY_H__ */
@@ -80,6 +80,8 @@ static int sp_opbuf_usage = 0;
 /* if true causes sp_docommand to automatically check
 	whether the command is supported before doing it */
 static int sp_check_avail_automatic = 0;
+/* SPI clock limit in Hz requested by the user, 0 if none */
+static uint32_t sp_max_spi_freq = 0;
 
 #if ! IS_WINDOWS
 static int sp_opensocket(char *ip, unsigned int port)
@@ -240,6 +242,28 @@ static int sp_docommand(uint8_t command, uint32_t parmlen,
 	return 0;
 }
 
+static int sp_set_spi_freq(uint32_t f_spi_req)
+{
+	uint8_t buf[4];
+	uint32_t f_spi;
+
+	buf[0] = (f_spi_req >> (0 * 8)) & 0xFF;
+	buf[1] = (f_spi_req >> (1 * 8)) & 0xFF;
+	buf[2] = (f_spi_req >> (2 * 8)) & 0xFF;
+	buf[3] = (f_spi_req >> (3 * 8)) & 0xFF;
+
+	if (sp_docommand(S_CMD_S_SPI_FREQ, 4, buf, 4, buf))
+		return 1;
+
+	f_spi = buf[0];
+	f_spi |= buf[1] << (1 * 8);
+	f_spi |= buf[2] << (2 * 8);
+	f_spi |= buf[3] << (3 * 8);
+	msg_pdbg(MSGHEADER "Requested to set SPI clock frequency to %u Hz. "
+		 "It was actually set to %u Hz\n", f_spi_req, f_spi);
+	return 0;
+}
+
 static int sp_flush_stream(void)
 {
 	if (sp_streamed_transmit_ops)
@@ -299,6 +323,7 @@ static int serprog_spi_send_command(struct flashctx *flash,
 				    unsigned int writecnt, unsigned int readcnt,
 				    const unsigned char *writearr,
 				    unsigned char *readarr);
+static int serprog_spi_set_max_speed(struct flashctx *flash, uint32_t khz);
 static struct spi_master spi_master_serprog = {
 	.features	= SPI_MASTER_4BA,
 	.max_data_read	= MAX_DATA_READ_UNLIMITED,
@@ -308,6 +333,7 @@ static struct spi_master spi_master_serprog = {
 	.read		= default_spi_read,
 	.write_256	= default_spi_write_256,
 	.write_aai	= default_spi_write_aai,
+	.set_max_speed	= serprog_spi_set_max_speed,
 };
 
 static void serprog_chip_writeb(const struct flashctx *flash, uint8_t val,
@@ -316,6 +342,8 @@ static uint8_t serprog_chip_readb(const struct flashctx *flash,
 				  const chipaddr addr);
 static void serprog_chip_readn(const struct flashctx *flash, uint8_t *buf,
 			       const chipaddr addr, size_t len);
+static int serprog_chip_write_burst(const struct flashctx *flash,
+				    const struct par_burst_op *ops, size_t count);
 static const struct par_master par_master_serprog = {
 		.chip_readb		= serprog_chip_readb,
 		.chip_readw		= fallback_chip_readw,
@@ -327,6 +355,19 @@ static const struct par_master par_master_serprog = {
 		.chip_writen		= fallback_chip_writen,
 };
 
+/* Bursts are queued as O_WRITEB/O_DELAY, so they need native delays. */
+static const struct par_master par_master_serprog_burst = {
+		.chip_readb		= serprog_chip_readb,
+		.chip_readw		= fallback_chip_readw,
+		.chip_readl		= fallback_chip_readl,
+		.chip_readn		= serprog_chip_readn,
+		.chip_writeb		= serprog_chip_writeb,
+		.chip_writew		= fallback_chip_writew,
+		.chip_writel		= fallback_chip_writel,
+		.chip_writen		= fallback_chip_writen,
+		.chip_write_burst	= serprog_chip_write_burst,
+};
+
 static enum chipbustype serprog_buses_supported = BUS_NONE;
 
 int serprog_init(void)
@@ -508,8 +549,7 @@ int serprog_init(void)
 		}
 		spispeed = extract_programmer_param("spispeed");
 		if (spispeed && strlen(spispeed)) {
-			uint32_t f_spi_req, f_spi;
-			uint8_t buf[4];
+			uint32_t f_spi_req;
 			char *f_spi_suffix;
 
 			errno = 0;
@@ -535,22 +575,11 @@ int serprog_init(void)
 				return 1;
 			}
 
-			buf[0] = (f_spi_req >> (0 * 8)) & 0xFF;
-			buf[1] = (f_spi_req >> (1 * 8)) & 0xFF;
-			buf[2] = (f_spi_req >> (2 * 8)) & 0xFF;
-			buf[3] = (f_spi_req >> (3 * 8)) & 0xFF;
-
 			if (sp_check_commandavail(S_CMD_S_SPI_FREQ) == 0)
 				msg_pwarn(MSGHEADER "Warning: Setting the SPI clock rate is not supported!\n");
-			else if (sp_docommand(S_CMD_S_SPI_FREQ, 4, buf, 4, buf) == 0) {
-				f_spi = buf[0];
-				f_spi |= buf[1] << (1 * 8);
-				f_spi |= buf[2] << (2 * 8);
-				f_spi |= buf[3] << (3 * 8);
-				msg_pdbg(MSGHEADER "Requested to set SPI clock frequency to %u Hz. "
-					 "It was actually set to %u Hz\n", f_spi_req, f_spi);
-			} else
+			else if (sp_set_spi_freq(f_spi_req))
 				msg_pwarn(MSGHEADER "Setting SPI clock rate to %u Hz failed!\n", f_spi_req);
+			sp_max_spi_freq = f_spi_req;
 		}
 		free(spispeed);
 		bt = serprog_buses_supported;
@@ -674,8 +703,13 @@ int serprog_init(void)
 	sp_opbuf_usage = 0;
 	if (serprog_buses_supported & BUS_SPI)
 		register_spi_master(&spi_master_serprog);
-	if (serprog_buses_supported & BUS_NONSPI)
-		register_par_master(&par_master_serprog, serprog_buses_supported & BUS_NONSPI);
+	if (serprog_buses_supported & BUS_NONSPI) {
+		/* Only offer bursts with both O_WRITEB (required above) and O_DELAY. */
+		if (sp_check_commandavail(S_CMD_O_DELAY))
+			register_par_master(&par_master_serprog_burst, serprog_buses_supported & BUS_NONSPI);
+		else
+			register_par_master(&par_master_serprog, serprog_buses_supported & BUS_NONSPI);
+	}
 	return 0;
 }
 
@@ -814,6 +848,61 @@ static void serprog_chip_writeb(const struct flashctx *flash, uint8_t val,
 	}
 }
 
+/* Queue the burst as S_CMD_O_WRITEB/S_CMD_O_DELAY operations. The operation
+ * buffer is only executed between sequences, i.e. after an op with a delay. */
+static int serprog_chip_write_burst(const struct flashctx *flash,
+				    const struct par_burst_op *ops, size_t count)
+{
+	unsigned char parm[4];
+	size_t i = 0, end;
+	int needed;
+
+	msg_pspew("%s: %zu ops\n", __func__, count);
+	if ((sp_max_write_n) && (sp_write_n_bytes)) {
+		if (sp_pass_writen() != 0)
+			return 1;
+	}
+	sp_prev_was_write = 0;
+
+	while (i < count) {
+		needed = 0;
+		for (end = i; end < count; ) {
+			needed += 5;
+			if (ops[end++].delay_us) {
+				needed += 5;
+				break;
+			}
+		}
+		if (needed >= sp_device_opbuf_size) {
+			msg_perr(MSGHEADER "Error: write burst sequence does not fit into operation buffer\n");
+			return 1;
+		}
+		if (sp_device_opbuf_size <= (sp_opbuf_usage + needed)) {
+			if (sp_execute_opbuf_noflush() != 0)
+				return 1;
+		}
+		for (; i < end; i++) {
+			parm[0] = (ops[i].addr >> 0) & 0xFF;
+			parm[1] = (ops[i].addr >> 8) & 0xFF;
+			parm[2] = (ops[i].addr >> 16) & 0xFF;
+			parm[3] = ops[i].val;
+			if (sp_stream_buffer_op(S_CMD_O_WRITEB, 4, parm) != 0)
+				return 1;
+			sp_opbuf_usage += 5;
+			if (!ops[i].delay_us)
+				continue;
+			parm[0] = (ops[i].delay_us >> 0) & 0xFF;
+			parm[1] = (ops[i].delay_us >> 8) & 0xFF;
+			parm[2] = (ops[i].delay_us >> 16) & 0xFF;
+			parm[3] = (ops[i].delay_us >> 24) & 0xFF;
+			if (sp_stream_buffer_op(S_CMD_O_DELAY, 4, parm) != 0)
+				return 1;
+			sp_opbuf_usage += 5;
+		}
+	}
+	return 0;
+}
+
 static uint8_t serprog_chip_readb(const struct flashctx *flash,
 				  const chipaddr addr)
 {
@@ -894,6 +983,17 @@ void serprog_delay(unsigned int usecs)
 	sp_prev_was_write = 0;
 }
 
+static int serprog_spi_set_max_speed(struct flashctx *flash, uint32_t khz)
+{
+	uint32_t f_spi_req = khz * 1000;
+
+	if (sp_check_commandavail(S_CMD_S_SPI_FREQ) == 0)
+		return 0;
+	if (sp_max_spi_freq && f_spi_req > sp_max_spi_freq)
+		f_spi_req = sp_max_spi_freq;
+	return sp_set_spi_freq(f_spi_req);
+}
+
 static int serprog_spi_send_command(struct flashctx *flash,
 				    unsigned int writecnt, unsigned int readcnt,
 				    const unsigned char *writearr,
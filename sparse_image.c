@@ -0,0 +1,341 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flash.h"
+#include "layout.h"
+#include "sparse_image.h"
+
+/* Long enough for a record with 255 data bytes in either format. */
+#define SPARSE_MAX_LINE	1024
+
+enum sparse_format {
+	SPARSE_NONE,
+	SPARSE_IHEX,
+	SPARSE_SREC,
+};
+
+/* Return values of the line parsers. */
+#define RECORD_INVALID	-1
+#define RECORD_DATA	0
+#define RECORD_SKIP	1
+#define RECORD_END	2
+
+static int hex_nibble(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/* Decodes the hex digit pairs of str that are followed by nothing but whitespace. */
+static int decode_hex(const char *str, uint8_t *out, size_t max)
+{
+	size_t n = 0;
+
+	for (; hex_nibble(str[0]) >= 0 && hex_nibble(str[1]) >= 0; str += 2) {
+		if (n == max)
+			return -1;
+		out[n++] = hex_nibble(str[0]) << 4 | hex_nibble(str[1]);
+	}
+	for (; *str; str++) {
+		if (!isspace((unsigned char)*str))
+			return -1;
+	}
+	return n;
+}
+
+/* Intel HEX: ":LLAAAATT<data>CC", with CC making the sum of all bytes zero. */
+static int parse_ihex_line(const char *line, uint32_t *base, uint32_t *addr, uint8_t *data, unsigned int *len)
+{
+	uint8_t rec[1 + 2 + 1 + 255 + 1];
+	uint8_t sum = 0;
+	int i, n;
+
+	if (line[0] != ':')
+		return RECORD_INVALID;
+	n = decode_hex(line + 1, rec, sizeof(rec));
+	if (n < 5 || n != rec[0] + 5)
+		return RECORD_INVALID;
+	for (i = 0; i < n; i++)
+		sum += rec[i];
+	if (sum)
+		return RECORD_INVALID;
+
+	switch (rec[3]) {
+	case 0x00:	/* data */
+		*addr = *base + (rec[1] << 8 | rec[2]);
+		*len = rec[0];
+		memcpy(data, rec + 4, *len);
+		return RECORD_DATA;
+	case 0x01:	/* end of file */
+		return RECORD_END;
+	case 0x02:	/* extended segment address */
+		if (rec[0] != 2)
+			return RECORD_INVALID;
+		*base = (rec[4] << 8 | rec[5]) << 4;
+		return RECORD_SKIP;
+	case 0x04:	/* extended linear address */
+		if (rec[0] != 2)
+			return RECORD_INVALID;
+		*base = (uint32_t)(rec[4] << 8 | rec[5]) << 16;
+		return RECORD_SKIP;
+	case 0x03:	/* start segment address */
+	case 0x05:	/* start linear address */
+		return RECORD_SKIP;
+	default:
+		return RECORD_INVALID;
+	}
+}
+
+/* Motorola S-record: "S<type>LL<address><data>CC", with CC the one's complement of the byte sum. */
+static int parse_srec_line(const char *line, uint32_t *addr, uint8_t *data, unsigned int *len)
+{
+	uint8_t rec[1 + 255];
+	uint8_t sum = 0;
+	unsigned int addr_len;
+	int i, n;
+
+	if (line[0] != 'S' || !isdigit((unsigned char)line[1]))
+		return RECORD_INVALID;
+	n = decode_hex(line + 2, rec, sizeof(rec));
+	if (n < 2 || n != rec[0] + 1)
+		return RECORD_INVALID;
+	for (i = 0; i < n; i++)
+		sum += rec[i];
+	if (sum != 0xff)
+		return RECORD_INVALID;
+
+	switch (line[1]) {
+	case '1':
+	case '2':
+	case '3':
+		addr_len = line[1] - '0' + 1;
+		if (rec[0] < addr_len + 1)
+			return RECORD_INVALID;
+		*addr = 0;
+		for (i = 0; i < (int)addr_len; i++)
+			*addr = *addr << 8 | rec[1 + i];
+		*len = rec[0] - addr_len - 1;
+		memcpy(data, rec + 1 + addr_len, *len);
+		return RECORD_DATA;
+	case '0':	/* header */
+	case '5':	/* record count */
+	case '6':
+		return RECORD_SKIP;
+	case '7':	/* termination with start address */
+	case '8':
+	case '9':
+		return RECORD_END;
+	default:
+		return RECORD_INVALID;
+	}
+}
+
+static bool is_blank(const char *line)
+{
+	for (; *line; line++) {
+		if (!isspace((unsigned char)*line))
+			return false;
+	}
+	return true;
+}
+
+static enum sparse_format detect_format(FILE *f)
+{
+	char line[SPARSE_MAX_LINE];
+	uint8_t data[255];
+	uint32_t base = 0, addr;
+	unsigned int len;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (is_blank(line))
+			continue;
+		if (parse_ihex_line(line, &base, &addr, data, &len) != RECORD_INVALID)
+			return SPARSE_IHEX;
+		if (parse_srec_line(line, &addr, data, &len) != RECORD_INVALID)
+			return SPARSE_SREC;
+		break;
+	}
+	return SPARSE_NONE;
+}
+
+bool is_sparse_image(const char *filename)
+{
+#ifdef __LIBPAYLOAD__
+	return false;
+#else
+	FILE *const f = fopen(filename, "r");
+	enum sparse_format format;
+
+	if (!f)
+		return false;
+	format = detect_format(f);
+	(void)fclose(f);
+	return format != SPARSE_NONE;
+#endif
+}
+
+static bool is_present(const uint8_t *present, chipoff_t pos)
+{
+	return present[pos / 8] & 1 << pos % 8;
+}
+
+int read_sparse_image(uint8_t *data, uint8_t *present, chipsize_t size, const char *filename)
+{
+#ifdef __LIBPAYLOAD__
+	msg_gerr("Error: No file I/O support in libpayload\n");
+	return 1;
+#else
+	char line[SPARSE_MAX_LINE];
+	uint8_t rec_data[255];
+	uint32_t base = 0;
+	unsigned int lineno = 0, extents = 0;
+	chipsize_t total = 0;
+	enum sparse_format format;
+	bool ended = false;
+	chipoff_t pos;
+	int ret = 1;
+	FILE *f;
+
+	if ((f = fopen(filename, "r")) == NULL) {
+		msg_gerr("Error: opening file \"%s\" failed: %s\n", filename, strerror(errno));
+		return 1;
+	}
+	format = detect_format(f);
+	rewind(f);
+
+	while (!ended && fgets(line, sizeof(line), f)) {
+		uint32_t addr = 0;
+		unsigned int len = 0, i;
+		int rec;
+
+		lineno++;
+		if (is_blank(line))
+			continue;
+		if (format == SPARSE_IHEX)
+			rec = parse_ihex_line(line, &base, &addr, rec_data, &len);
+		else
+			rec = parse_srec_line(line, &addr, rec_data, &len);
+
+		switch (rec) {
+		case RECORD_INVALID:
+			msg_gerr("Error: Invalid record in line %u of \"%s\".\n", lineno, filename);
+			goto _close_ret;
+		case RECORD_END:
+			ended = true;
+			continue;
+		case RECORD_SKIP:
+			continue;
+		}
+		if (!len)
+			continue;
+
+		if (addr >= size || len > size - addr) {
+			msg_gerr("Error: Line %u of \"%s\" has data beyond the flash chip's size (%u B).\n",
+				 lineno, filename, size);
+			goto _close_ret;
+		}
+		for (i = 0; i < len; i++, addr++) {
+			if (is_present(present, addr)) {
+				msg_gerr("Error: Line %u of \"%s\" overlaps earlier data at 0x%06x.\n",
+					 lineno, filename, addr);
+				goto _close_ret;
+			}
+			present[addr / 8] |= 1 << addr % 8;
+			data[addr] = rec_data[i];
+		}
+		total += len;
+	}
+	if (!ended) {
+		msg_gerr("Error: \"%s\" ends without an end record, is it truncated?\n", filename);
+		goto _close_ret;
+	}
+
+	for (pos = 0; pos < size; pos++) {
+		if (is_present(present, pos) && (!pos || !is_present(present, pos - 1)))
+			extents++;
+	}
+	if (!extents) {
+		/* An empty layout would mean the whole chip. */
+		msg_gerr("Error: \"%s\" contains no data.\n", filename);
+		goto _close_ret;
+	}
+	msg_ginfo("Sparse image \"%s\" has %u B of data in %u extent%s.\n",
+		  filename, total, extents, extents == 1 ? "" : "s");
+	ret = 0;
+
+_close_ret:
+	(void)fclose(f);
+	return ret;
+#endif
+}
+
+int sparse_image_to_layout(const uint8_t *present, chipsize_t size, chipsize_t block_size,
+			   struct flashrom_layout *layout, bool *gaps)
+{
+	const size_t first = layout->num_entries;
+	struct layout_range *ranges = NULL;
+	size_t num = 0, alloc = 0, i;
+	chipsize_t total = 0, covered = 0;
+	chipoff_t pos;
+	int ret = 1;
+
+	for (pos = 0; pos < size; pos++) {
+		if (!is_present(present, pos))
+			continue;
+		if (num == alloc) {
+			struct layout_range *const tmp = realloc(ranges, (alloc = alloc * 2 + 64) * sizeof(*ranges));
+			if (!tmp) {
+				msg_gerr("Out of memory!\n");
+				goto _free_ret;
+			}
+			ranges = tmp;
+		}
+		ranges[num].start = pos;
+		while (pos + 1 < size && is_present(present, pos + 1))
+			pos++;
+		ranges[num].end = pos;
+		total += pos - ranges[num].start + 1;
+		num++;
+	}
+	if (layout_add_coalesced(layout, ranges, num, block_size, "sparse"))
+		goto _free_ret;
+
+	for (i = first; i < layout->num_entries; i++)
+		covered += layout->entries[i].end - layout->entries[i].start + 1;
+	*gaps = covered != total;
+	ret = 0;
+
+_free_ret:
+	free(ranges);
+	return ret;
+}
+
+void sparse_image_apply(uint8_t *buf, const uint8_t *data, const uint8_t *present, chipsize_t size)
+{
+	chipoff_t pos;
+
+	for (pos = 0; pos < size; pos++) {
+		if (is_present(present, pos))
+			buf[pos] = data[pos];
+	}
+}
@@ -0,0 +1,45 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __SPARSE_IMAGE_H__
+#define __SPARSE_IMAGE_H__ 1
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "layout.h"
+
+/* Returns true if the file starts with a valid Intel HEX or Motorola S-record line. */
+bool is_sparse_image(const char *filename);
+
+/* Size of the bitmap with one bit per byte of a chip of size bytes. */
+#define SPARSE_PRESENT_SIZE(size)	((size) / 8 + 1)
+
+/*
+ * Reads an Intel HEX or Motorola S-record file for a chip of size bytes into data. The bytes
+ * the file contains are marked in present, which must be SPARSE_PRESENT_SIZE(size) zeroes.
+ * Other bytes of data are left untouched.
+ */
+int read_sparse_image(uint8_t *data, uint8_t *present, chipsize_t size, const char *filename);
+
+/*
+ * Adds the contiguous runs of present bytes as included regions of layout, merged per erase
+ * block of block_size by layout_add_coalesced(). gaps is set if the regions also cover bytes
+ * the image doesn't contain, whose current contents then have to be read from the chip.
+ */
+int sparse_image_to_layout(const uint8_t *present, chipsize_t size, chipsize_t block_size,
+			   struct flashrom_layout *layout, bool *gaps);
+
+/* Copies the present bytes of data into buf. */
+void sparse_image_apply(uint8_t *buf, const uint8_t *data, const uint8_t *present, chipsize_t size);
+
+#endif				/* !__SPARSE_IMAGE_H__ */
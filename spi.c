@@ -18,8 +18,10 @@
  * Contains the generic SPI framework
  */
 
+#include <stdlib.h>
 #include <strings.h>
 #include <string.h>
+#include <unistd.h>
 #include "flash.h"
 #include "flashchips.h"
 #include "chipdrivers.h"
@@ -71,6 +73,177 @@ int default_spi_send_multicommand(struct flashctx *flash,
 	return result;
 }
 
+/* Amount of data read per candidate chunk size while tuning. */
+#define TUNE_READ_LEN		(64 * 1024)
+/* Smallest chunk size worth trying. */
+#define TUNE_MIN_CHUNK		64
+
+static char *read_chunk_cache_path(void)
+{
+	const char *dir = getenv("XDG_CACHE_HOME");
+	const char *suffix = "/flashrom-read-chunks";
+	char *path;
+
+	if (!dir || !strlen(dir)) {
+		dir = getenv("HOME");
+		suffix = "/.cache/flashrom-read-chunks";
+	}
+	if (!dir || !strlen(dir))
+		return NULL;
+
+	path = malloc(strlen(dir) + strlen(suffix) + 1);
+	if (!path)
+		return NULL;
+	strcpy(path, dir);
+	strcat(path, suffix);
+	return path;
+}
+
+/* The cache holds one "<programmer> <max chunk> <chunk>" line per programmer and maximum. */
+static unsigned int read_chunk_cache_lookup(unsigned int max_chunk)
+{
+	char name[64];
+	unsigned int max, chunk, found = 0;
+	char *path = read_chunk_cache_path();
+	FILE *f;
+
+	if (!path)
+		return 0;
+	f = fopen(path, "r");
+	free(path);
+	if (!f)
+		return 0;
+	while (fscanf(f, "%63s %u %u", name, &max, &chunk) == 3) {
+		if (!strcmp(name, programmer_name()) && max == max_chunk && chunk && chunk <= max_chunk)
+			found = chunk;
+	}
+	fclose(f);
+	return found;
+}
+
+/* Replaces the entry for this programmer and maximum, the file is swapped atomically. */
+static void read_chunk_cache_store(unsigned int max_chunk, unsigned int chunk)
+{
+	char name[64];
+	unsigned int max, old_chunk;
+	char *path = read_chunk_cache_path();
+	char *tmp = NULL;
+	FILE *in, *out = NULL;
+	int fd;
+
+	if (!path)
+		return;
+	tmp = malloc(strlen(path) + sizeof(".XXXXXX"));
+	if (!tmp)
+		goto _free_ret;
+	strcpy(tmp, path);
+	strcat(tmp, ".XXXXXX");
+	fd = mkstemp(tmp);
+	if (fd < 0 || !(out = fdopen(fd, "w"))) {
+		if (fd >= 0) {
+			close(fd);
+			unlink(tmp);
+		}
+		msg_gdbg("Could not create %s, not caching the read chunk size.\n", tmp);
+		goto _free_ret;
+	}
+
+	in = fopen(path, "r");
+	if (in) {
+		while (fscanf(in, "%63s %u %u", name, &max, &old_chunk) == 3) {
+			if (strcmp(name, programmer_name()) || max != max_chunk)
+				fprintf(out, "%s %u %u\n", name, max, old_chunk);
+		}
+		fclose(in);
+	}
+	fprintf(out, "%s %u %u\n", programmer_name(), max_chunk, chunk);
+	if (fclose(out) || rename(tmp, path)) {
+		msg_gdbg("Could not update %s, not caching the read chunk size.\n", path);
+		unlink(tmp);
+	}
+
+_free_ret:
+	free(tmp);
+	free(path);
+}
+
+/*
+ * Time reads at the start of the chip with max_chunk and smaller powers of two.
+ * Returns the fastest chunk size, or 0 if not a single read succeeded.
+ */
+static unsigned int spi_tune_read_chunk(struct flashctx *flash, unsigned int max_chunk)
+{
+	const unsigned int len = min(TUNE_READ_LEN, flash->chip->total_size * 1024);
+	unsigned int chunk, best = 0;
+	uint64_t start, elapsed, best_time = UINT64_MAX;
+	uint8_t *buf;
+
+	buf = malloc(len);
+	if (!buf) {
+		msg_gerr("Out of memory!\n");
+		return 0;
+	}
+
+	msg_cinfo("Tuning SPI read chunk size... ");
+	chunk = max_chunk;
+	while (chunk >= TUNE_MIN_CHUNK) {
+		start = internal_time_usecs();
+		if (spi_read_chunked(flash, buf, 0, len, chunk))
+			break;
+		elapsed = internal_time_usecs() - start;
+		msg_cdbg("%u: %" PRIu64 " us, ", chunk, elapsed);
+		if (elapsed < best_time) {
+			best_time = elapsed;
+			best = chunk;
+		}
+		/* Continue with the next smaller power of two. */
+		if (chunk & (chunk - 1)) {
+			while (chunk & (chunk - 1))
+				chunk &= chunk - 1;
+		} else {
+			chunk /= 2;
+		}
+	}
+	if (best)
+		msg_cinfo("using %u bytes.\n", best);
+	else
+		msg_cinfo("FAILED.\n");
+
+	free(buf);
+	return best;
+}
+
+/*
+ * Return the chunk size reads should use given the master's maximum. Unless
+ * tuning was requested this is the maximum itself.
+ */
+unsigned int spi_read_chunksize(struct flashctx *flash, unsigned int max_chunk)
+{
+	struct spi_master *const mst = &flash->mst->spi;
+
+	if (!flash->flags.tune_read_chunks || max_chunk < TUNE_MIN_CHUNK)
+		return max_chunk;
+
+	if (mst->tuned_read_chunk && mst->tuned_read_max == max_chunk)
+		return mst->tuned_read_chunk;
+
+	mst->tuned_read_max = max_chunk;
+	mst->tuned_read_chunk = read_chunk_cache_lookup(max_chunk);
+	if (mst->tuned_read_chunk) {
+		msg_cdbg("Using cached SPI read chunk size of %u bytes.\n", mst->tuned_read_chunk);
+		return mst->tuned_read_chunk;
+	}
+
+	mst->tuned_read_chunk = spi_tune_read_chunk(flash, max_chunk);
+	if (mst->tuned_read_chunk) {
+		read_chunk_cache_store(max_chunk, mst->tuned_read_chunk);
+		return mst->tuned_read_chunk;
+	}
+	/* Nothing was measured, stay with the maximum for this session but don't remember it. */
+	mst->tuned_read_chunk = max_chunk;
+	return max_chunk;
+}
+
 int default_spi_read(struct flashctx *flash, uint8_t *buf, unsigned int start,
 		     unsigned int len)
 {
@@ -81,7 +254,7 @@ int default_spi_read(struct flashctx *flash, uint8_t *buf, unsigned int start,
 			 "flashrom@flashrom.org\n", __func__);
 		return 1;
 	}
-	return spi_read_chunked(flash, buf, start, len, max_data);
+	return spi_read_chunked(flash, buf, start, len, spi_read_chunksize(flash, max_data));
 }
 
 int default_spi_write_256(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len)
@@ -131,6 +304,39 @@ int spi_aai_write(struct flashctx *flash, const uint8_t *buf, unsigned int start
 	return flash->mst->spi.write_aai(flash, buf, start, len);
 }
 
+/*
+ * Give the master a chance to set itself up for the probed chip,
+ * e.g. to load a chip specific opcode table.
+ */
+int spi_prepare_access(struct flashctx *flash)
+{
+	if (!(flash->mst->buses_supported & BUS_SPI) || !flash->mst->spi.prepare_access)
+		return 0;
+	return flash->mst->spi.prepare_access(flash);
+}
+
+/*
+ * Raise the SPI clock to the fastest rate the chip supports for the upcoming
+ * operations. The master limits it further to its own and the user's maximum.
+ * Nothing is changed if the chip's limits are unknown.
+ */
+int spi_set_chip_speed(struct flashctx *flash, bool read_only)
+{
+	const struct spi_clock *clk = &flash->chip->max_spi_clock;
+	uint32_t khz;
+
+	if (!(flash->mst->buses_supported & BUS_SPI) || !flash->mst->spi.set_max_speed)
+		return 0;
+	if (!clk->read || (!read_only && !clk->program))
+		return 0;
+
+	khz = clk->read;
+	if (!read_only)
+		khz = min(khz, clk->program);
+	msg_cdbg("Chip supports up to %"PRIu32" kHz SPI clock for this operation.\n", khz);
+	return flash->mst->spi.set_max_speed(flash, khz);
+}
+
 int register_spi_master(const struct spi_master *mst)
 {
 	struct registered_master rmst;
@@ -138,7 +344,8 @@ int register_spi_master(const struct spi_master *mst)
 	if (!mst->write_aai || !mst->write_256 || !mst->read || !mst->command ||
 	    !mst->multicommand ||
 	    ((mst->command == default_spi_send_command) &&
-	     (mst->multicommand == default_spi_send_multicommand))) {
+	     (mst->multicommand == default_spi_send_multicommand)) ||
+	    ((mst->features & (SPI_MASTER_DUAL_TX | SPI_MASTER_QUAD_TX)) && !mst->write_multi_io)) {
 		msg_perr("%s called with incomplete master definition. "
 			 "Please report a bug at flashrom@flashrom.org\n",
 			 __func__);
@@ -126,10 +126,17 @@
 #define JEDEC_RDSR_OUTSIZE	0x01
 #define JEDEC_RDSR_INSIZE	0x01
 
+/* Read Status Register 2 */
+#define JEDEC_RDSR2		0x35
+#define JEDEC_RDSR2_OUTSIZE	0x01
+#define JEDEC_RDSR2_INSIZE	0x01
+
 /* Status Register Bits */
 #define SPI_SR_WIP	(0x01 << 0)
 #define SPI_SR_WEL	(0x01 << 1)
 #define SPI_SR_AAI	(0x01 << 6)
+#define SPI_SR1_QE	(0x01 << 6)	/* Macronix-style Quad Enable */
+#define SPI_SR2_QE	(0x01 << 1)	/* Winbond-style Quad Enable */
 
 /* Write Status Enable */
 #define JEDEC_EWSR		0x50
@@ -166,6 +173,15 @@
 #define JEDEC_BYTE_PROGRAM_OUTSIZE	0x05
 #define JEDEC_BYTE_PROGRAM_INSIZE	0x00
 
+/* Write memory page, data on two lines (1-1-2) */
+#define JEDEC_DUAL_PAGE_PROGRAM		0xa2
+
+/* Write memory page, data on four lines (1-1-4) */
+#define JEDEC_QUAD_PAGE_PROGRAM		0x32
+
+/* Write memory page, address and data on four lines (1-4-4) */
+#define JEDEC_QUAD_IO_PAGE_PROGRAM	0x38
+
 /* Write AAI word (SST25VF080B) */
 #define JEDEC_AAI_WORD_PROGRAM			0xad
 #define JEDEC_AAI_WORD_PROGRAM_OUTSIZE		0x06
@@ -286,10 +286,18 @@ int probe_spi_at25f(struct flashctx *flash)
 
 static int spi_poll_wip(struct flashctx *const flash, const unsigned int poll_delay)
 {
+	/* Give up after a thousand typical polls, but never in less than a second. */
+	const uint64_t timeout_us = poll_delay > 1000 ? 1000ULL * poll_delay : 1000 * 1000;
+	const uint64_t start = internal_time_usecs();
+
 	/* FIXME: We can't tell if spi_read_status_register() failed. */
-	/* FIXME: We don't time out. */
-	while (spi_read_status_register(flash) & SPI_SR_WIP)
+	while (spi_read_status_register(flash) & SPI_SR_WIP) {
+		if (internal_time_usecs() - start > timeout_us) {
+			msg_cerr("Error: WIP bit never cleared\n");
+			return TIMEOUT_ERROR;
+		}
 		programmer_delay(poll_delay);
+	}
 	/* FIXME: Check the status register for errors. */
 	return 0;
 }
@@ -397,7 +405,7 @@ static int spi_prepare_address(struct flashctx *const flash, uint8_t cmd_buf[],
  * @param out_bytes   bytes to send after the address,
  *                    may be NULL if and only if `out_bytes` is 0
  * @param out_bytes   number of bytes to send, 256 at most, may be zero
- * @param poll_delay  interval in us for polling WIP
+ * @param poll_delay  interval in us for polling WIP, don't poll if zero
  * @return 0 on success, non-zero otherwise
  */
 static int spi_write_cmd(struct flashctx *const flash, const uint8_t op,
@@ -435,7 +443,7 @@ static int spi_write_cmd(struct flashctx *const flash, const uint8_t op,
 	if (result)
 		msg_cerr("%s failed during command execution at address 0x%x\n", __func__, addr);
 
-	const int status = spi_poll_wip(flash, poll_delay);
+	const int status = poll_delay ? spi_poll_wip(flash, poll_delay) : 0;
 
 	return result ? result : status;
 }
@@ -619,11 +627,91 @@ erasefunc_t *spi_get_erasefn_from_opcode(uint8_t opcode)
 	}
 }
 
-static int spi_nbyte_program(struct flashctx *flash, unsigned int addr, const uint8_t *bytes, unsigned int len)
+struct spi_program_mode {
+	uint8_t opcode;
+	uint32_t chip_feature;
+	unsigned int addr_lines;
+	unsigned int data_lines;
+};
+
+/* Ordered by preference, the last entry is the single I/O fallback. */
+static const struct spi_program_mode spi_program_modes[] = {
+	{ JEDEC_QUAD_IO_PAGE_PROGRAM,	FEATURE_PP_1_4_4,	4, 4 },
+	{ JEDEC_QUAD_PAGE_PROGRAM,	FEATURE_PP_1_1_4,	1, 4 },
+	{ JEDEC_DUAL_PAGE_PROGRAM,	FEATURE_PP_1_1_2,	1, 2 },
+	{ JEDEC_BYTE_PROGRAM,		0,			1, 1 },
+};
+
+/* Pick the fastest page program mode both the chip and the master support. */
+static const struct spi_program_mode *spi_select_program_mode(struct flashctx *flash)
+{
+	const struct spi_program_mode *mode;
+
+	if (flash->program_mode)
+		return flash->program_mode;
+
+	for (mode = spi_program_modes; mode->chip_feature; mode++) {
+		if (!(flash->chip->feature_bits & mode->chip_feature))
+			continue;
+		if (mode->data_lines == 4 ? !spi_master_quad_tx(flash) : !spi_master_dual_tx(flash))
+			continue;
+		if (mode->data_lines == 4 && spi_set_quad_enable(flash, true)) {
+			msg_cwarn("Can't enable quad mode, trying slower page program modes.\n");
+			continue;
+		}
+		break;
+	}
+
+	msg_cdbg("Using %u-%u-%u page program (0x%02x).\n",
+		 1, mode->addr_lines, mode->data_lines, mode->opcode);
+	flash->program_mode = mode;
+	return mode;
+}
+
+static int spi_multi_io_program(struct flashctx *flash, const struct spi_program_mode *mode, unsigned int addr,
+				const uint8_t *bytes, unsigned int len, unsigned int poll_delay)
+{
+	uint8_t cmd[1 + JEDEC_MAX_ADDR_LEN] = { mode->opcode };
+
+	const int addr_len = spi_prepare_address(flash, cmd, false, addr);
+	if (addr_len < 0)
+		return 1;
+
+	if (spi_write_enable(flash))
+		return 1;
+
+	const int result = flash->mst->spi.write_multi_io(flash, mode->addr_lines, mode->data_lines,
+							  cmd, 1 + addr_len, bytes, len);
+	if (result)
+		msg_cerr("%s failed during command execution at address 0x%x\n", __func__, addr);
+
+	const int status = poll_delay ? spi_poll_wip(flash, poll_delay) : 0;
+
+	return result ? result : status;
+}
+
+static int spi_nbyte_program_poll(struct flashctx *flash, unsigned int addr, const uint8_t *bytes,
+				  unsigned int len, unsigned int poll_delay)
 {
 	const bool native_4ba = flash->chip->feature_bits & FEATURE_4BA_WRITE && spi_master_4ba(flash);
 	const uint8_t op = native_4ba ? JEDEC_BYTE_PROGRAM_4BA : JEDEC_BYTE_PROGRAM;
-	return spi_write_cmd(flash, op, native_4ba, addr, bytes, len, 10);
+
+	/* There is no common multi-I/O program opcode with native 4-byte address. */
+	if (!native_4ba) {
+		const struct spi_program_mode *const mode = spi_select_program_mode(flash);
+		if (mode->data_lines > 1)
+			return spi_multi_io_program(flash, mode, addr, bytes, len, poll_delay);
+	}
+
+	return spi_write_cmd(flash, op, native_4ba, addr, bytes, len, poll_delay);
+}
+
+static int spi_nbyte_program(struct flashctx *flash, unsigned int addr, const uint8_t *bytes, unsigned int len)
+{
+	/* EEPROM write cycles take milliseconds, don't hammer the bus with RDSR meanwhile. */
+	const unsigned int poll_delay = flash->chip->write_cycle_time ? flash->chip->write_cycle_time / 16 : 10;
+
+	return spi_nbyte_program_poll(flash, addr, bytes, len, poll_delay);
 }
 
 int spi_nbyte_read(struct flashctx *flash, unsigned int address, uint8_t *bytes,
@@ -707,16 +795,38 @@ int spi_write_chunked(struct flashctx *flash, const uint8_t *buf, unsigned int s
  * This is for chips which can only handle one byte writes
  * and for chips where memory mapped programming is impossible
  * (e.g. due to size constraints in IT87* for over 512 kB)
+ *
+ * Bytes that already hold the erased value are skipped, programming them
+ * can't change a single bit. If the chip's maximum byte program time is
+ * known, we wait that long after each byte instead of polling WIP and only
+ * poll once at the end of each run of programmed bytes. This saves at least
+ * one status register round-trip per byte on high-latency (e.g. USB) masters.
  */
 /* real chunksize is 1, logical chunksize is 1 */
 int spi_chip_write_1(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len)
 {
+	const bool skip_erased = flash->chip->gran != write_gran_1byte_implicit_erase;
+	const uint8_t erased_value = ERASED_VALUE(flash);
+	const unsigned int tbp = flash->chip->byte_program_time;
+	bool pending = false;
 	unsigned int i;
 
-	for (i = start; i < start + len; i++) {
-		if (spi_nbyte_program(flash, i, buf + i - start, 1))
+	for (i = 0; i < len; i++) {
+		if (skip_erased && buf[i] == erased_value)
+			continue;
+		if (!tbp) {
+			if (spi_nbyte_program(flash, start + i, buf + i, 1))
+				return 1;
+			continue;
+		}
+		if (pending)
+			programmer_delay(tbp);
+		if (spi_nbyte_program_poll(flash, start + i, buf + i, 1, 0))
 			return 1;
+		pending = true;
 	}
+	if (pending)
+		return spi_poll_wip(flash, 10);
 	return 0;
 }
 
@@ -17,15 +17,22 @@
  * GNU General Public License for more details.
  */
 
+#include <string.h>
 #include "flash.h"
 #include "chipdrivers.h"
+#include "programmer.h"
 #include "spi.h"
 
 /* === Generic functions === */
-static int spi_write_status_register_flag(struct flashctx *flash, int status, const unsigned char enable_opcode)
+static int spi_write_status_registers_flag(struct flashctx *flash, const uint8_t *regs, unsigned int nregs,
+					   const unsigned char enable_opcode)
 {
 	int result;
-	int i = 0;
+	unsigned char wrsr[3] = { JEDEC_WRSR };
+
+	if (nregs > sizeof(wrsr) - 1)
+		return SPI_FLASHROM_BUG;
+	memcpy(wrsr + 1, regs, nregs);
 	/*
 	 * WRSR requires either EWSR or WREN depending on chip type.
 	 * The code below relies on the fact hat EWSR and WREN have the same
@@ -38,8 +45,8 @@ static int spi_write_status_register_flag(struct flashctx *flash, int status, co
 		.readcnt	= 0,
 		.readarr	= NULL,
 	}, {
-		.writecnt	= JEDEC_WRSR_OUTSIZE,
-		.writearr	= (const unsigned char[]){ JEDEC_WRSR, (unsigned char) status },
+		.writecnt	= 1 + nregs,
+		.writearr	= wrsr,
 		.readcnt	= 0,
 		.readarr	= NULL,
 	}, {
@@ -57,27 +64,50 @@ static int spi_write_status_register_flag(struct flashctx *flash, int status, co
 		 */
 		return result;
 	}
-	/* WRSR performs a self-timed erase before the changes take effect.
-	 * This may take 50-85 ms in most cases, and some chips apparently
-	 * allow running RDSR only once. Therefore pick an initial delay of
-	 * 100 ms, then wait in 10 ms steps until a total of 5 s have elapsed.
+	/* A non-volatile WRSR performs a self-timed erase before the changes take
+	 * effect. That takes anything from a few to 85 ms, a volatile write none
+	 * at all. Therefore poll right away, double the interval up to 10 ms and
+	 * give up after 5 s.
 	 */
-	programmer_delay(100 * 1000);
+	const uint64_t start = internal_time_usecs();
+	unsigned int delay = 1;
 	while (spi_read_status_register(flash) & SPI_SR_WIP) {
-		if (++i > 490) {
+		if (internal_time_usecs() - start > 5 * 1000 * 1000) {
 			msg_cerr("Error: WIP bit after WRSR never cleared\n");
 			return TIMEOUT_ERROR;
 		}
-		programmer_delay(10 * 1000);
+		programmer_delay(delay);
+		if (delay < 10 * 1000)
+			delay *= 2;
 	}
 	return 0;
 }
 
-int spi_write_status_register(struct flashctx *flash, int status)
+static int spi_write_status_register_flag(struct flashctx *flash, int status, const unsigned char enable_opcode)
+{
+	const uint8_t reg = status;
+	return spi_write_status_registers_flag(flash, &reg, 1, enable_opcode);
+}
+
+/*
+ * Writes status register 1 unless it already holds the value. With volatile
+ * set, chips that support it get a volatile write, which is lost on power-off.
+ */
+static int spi_write_status_register_mode(struct flashctx *flash, int status, bool volatile_write)
 {
 	int feature_bits = flash->chip->feature_bits;
 	int ret = 1;
 
+	/* WIP and WEL are read-only. */
+	const uint8_t old_status = spi_read_status_register(flash);
+	if (!((old_status ^ status) & ~(SPI_SR_WIP | SPI_SR_WEL))) {
+		msg_cdbg2("Status register already is 0x%02x.\n", old_status);
+		return 0;
+	}
+
+	if (volatile_write && (feature_bits & FEATURE_WRSR_VOLATILE))
+		return spi_write_status_register_flag(flash, status, JEDEC_EWSR);
+
 	if (!(feature_bits & (FEATURE_WRSR_WREN | FEATURE_WRSR_EWSR))) {
 		msg_cdbg("Missing status register write definition, assuming "
 			 "EWSR is needed\n");
@@ -90,6 +120,11 @@ int spi_write_status_register(struct flashctx *flash, int status)
 	return ret;
 }
 
+int spi_write_status_register(struct flashctx *flash, int status)
+{
+	return spi_write_status_register_mode(flash, status, false);
+}
+
 uint8_t spi_read_status_register(struct flashctx *flash)
 {
 	static const unsigned char cmd[JEDEC_RDSR_OUTSIZE] = { JEDEC_RDSR };
@@ -108,6 +143,74 @@ uint8_t spi_read_status_register(struct flashctx *flash)
 	return readarr[0];
 }
 
+static int spi_read_status_register_2(struct flashctx *flash, uint8_t *status)
+{
+	static const unsigned char cmd[JEDEC_RDSR2_OUTSIZE] = { JEDEC_RDSR2 };
+	unsigned char readarr[JEDEC_RDSR2_INSIZE];
+
+	if (spi_send_command(flash, sizeof(cmd), sizeof(readarr), cmd, readarr)) {
+		msg_cerr("RDSR2 failed!\n");
+		return 1;
+	}
+	*status = readarr[0];
+	return 0;
+}
+
+/*
+ * Set or clear the Quad Enable bit. Returns 0 on success, including for chips
+ * that don't declare a QE bit, non-zero otherwise. If the bit had to be set,
+ * flash->restore_qe tells finalize_flash_access() to clear it again.
+ */
+int spi_set_quad_enable(struct flashctx *flash, bool enable)
+{
+	const uint32_t feature_bits = flash->chip->feature_bits;
+	uint8_t regs[2], qe_mask;
+	unsigned int nregs, qe_reg;
+	int ret;
+
+	if (!(feature_bits & (FEATURE_QE_SR1_BIT6 | FEATURE_QE_SR2_BIT1)))
+		return 0;
+
+	regs[0] = spi_read_status_register(flash);
+	if (feature_bits & FEATURE_QE_SR1_BIT6) {
+		nregs = 1;
+		qe_reg = 0;
+		qe_mask = SPI_SR1_QE;
+	} else {
+		if (spi_read_status_register_2(flash, &regs[1]))
+			return 1;
+		nregs = 2;
+		qe_reg = 1;
+		qe_mask = SPI_SR2_QE;
+	}
+
+	if (!!(regs[qe_reg] & qe_mask) == enable)
+		return 0;
+
+	msg_cdbg("%s the Quad Enable bit.\n", enable ? "Setting" : "Clearing");
+	if (enable)
+		regs[qe_reg] |= qe_mask;
+	else
+		regs[qe_reg] &= ~qe_mask;
+
+	/* Chips with a QE bit all take WREN before WRSR. */
+	ret = spi_write_status_registers_flag(flash, regs, nregs, JEDEC_WREN);
+	if (ret)
+		return ret;
+	/* Remember to leave the chip as we found it. */
+	flash->restore_qe = enable;
+
+	if (qe_reg == 0)
+		regs[0] = spi_read_status_register(flash);
+	else if (spi_read_status_register_2(flash, &regs[1]))
+		return 1;
+	if (!!(regs[qe_reg] & qe_mask) != enable) {
+		msg_cerr("Failed to %s the Quad Enable bit.\n", enable ? "set" : "clear");
+		return 1;
+	}
+	return 0;
+}
+
 /* A generic block protection disable.
  * Tests if a protection is enabled with the block protection mask (bp_mask) and returns success otherwise.
  * Tests if the register bits are locked with the lock_mask (lock_mask).
@@ -147,7 +250,7 @@ static int spi_disable_blockprotect_generic(struct flashctx *flash, uint8_t bp_m
 			return 1;
 		}
 		/* All bits except the register lock bit (often called SPRL, SRWD, WPEN) are readonly. */
-		result = spi_write_status_register(flash, status & ~lock_mask);
+		result = spi_write_status_register_mode(flash, status & ~lock_mask, true);
 		if (result) {
 			msg_cerr("spi_write_status_register failed.\n");
 			return result;
@@ -160,7 +263,7 @@ static int spi_disable_blockprotect_generic(struct flashctx *flash, uint8_t bp_m
 		msg_cdbg("done.\n");
 	}
 	/* Global unprotect. Make sure to mask the register lock bit as well. */
-	result = spi_write_status_register(flash, status & ~(bp_mask | lock_mask) & unprotect_mask);
+	result = spi_write_status_register_mode(flash, status & ~(bp_mask | lock_mask) & unprotect_mask, true);
 	if (result) {
 		msg_cerr("spi_write_status_register failed.\n");
 		return result;
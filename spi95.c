@@ -51,19 +51,38 @@ int probe_spi_st95(struct flashctx *flash)
 	return 0;
 }
 
-/* ST95XXX chips don't have erase operation and erase is made as part of write command */
+/*
+ * ST95XXX chips don't have erase operation and erase is made as part of write command.
+ * Only bytes which don't hold the erased value yet are written, to save time and
+ * write cycles.
+ */
 int spi_block_erase_emulation(struct flashctx *flash, unsigned int addr, unsigned int blocklen)
 {
-	uint8_t *erased_contents = NULL;
+	const uint8_t erased_value = ERASED_VALUE(flash);
+	uint8_t *contents = NULL;
+	unsigned int i, run;
 	int result = 0;
 
-	erased_contents = (uint8_t *)malloc(blocklen * sizeof(uint8_t));
-	if (!erased_contents) {
+	contents = (uint8_t *)malloc(blocklen * sizeof(uint8_t));
+	if (!contents) {
 		msg_cerr("Out of memory!\n");
 		return 1;
 	}
-	memset(erased_contents, ERASED_VALUE(flash), blocklen * sizeof(uint8_t));
-	result = spi_write_chunked(flash, erased_contents, 0, blocklen, flash->chip->page_size);
-	free(erased_contents);
+	if (flash->chip->read(flash, contents, addr, blocklen)) {
+		msg_cerr("%s: Can't read block at 0x%x\n", __func__, addr);
+		free(contents);
+		return 1;
+	}
+
+	for (i = 0; i < blocklen && !result; i += run) {
+		if (contents[i] == erased_value) {
+			run = 1;
+			continue;
+		}
+		for (run = 0; i + run < blocklen && contents[i + run] != erased_value; run++)
+			contents[i + run] = erased_value;
+		result = spi_write_chunked(flash, contents + i, addr + i, run, flash->chip->page_size);
+	}
+	free(contents);
 	return result;
 }
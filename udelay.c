@@ -234,6 +234,19 @@ void internal_sleep(unsigned int usecs)
 #endif
 }
 
+/* Monotonic (if possible) time in microseconds, for measuring durations. */
+uint64_t internal_time_usecs(void)
+{
+#if HAVE_CLOCK_GETTIME == 1
+	struct timespec now;
+	if (!clock_gettime(clock_id, &now))
+		return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#endif
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
 /* Precise delay. */
 void internal_delay(unsigned int usecs)
 {
@@ -259,4 +272,9 @@ void internal_delay(unsigned int usecs)
 {
 	udelay(usecs);
 }
+
+uint64_t internal_time_usecs(void)
+{
+	return timer_us(0);
+}
 #endif
@@ -0,0 +1,123 @@
+#!/bin/sh
+#
+# This file is part of the flashrom project.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; version 2 of the License.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# Checks --backup, --restore and the deduplicating chunk store against the
+# dummy programmer:
+#
+#   backup_test.sh <flashrom>
+
+if [ $# -ne 1 ]; then
+	echo "usage: $0 <flashrom>" >&2
+	exit 2
+fi
+
+FLASHROM=$1
+CHIP=SST25VF032B
+SIZE=4194304
+CHUNKS=$((SIZE / 65536))
+
+TMPDIR=$(mktemp -d -t flashrom_backup.XXXXXXXXXX) || exit 1
+trap 'rm -rf "$TMPDIR"' EXIT
+DUMMY="dummy:emulate=$CHIP,image=$TMPDIR/chip.bin"
+STORE="$TMPDIR/chunks"
+
+fail() {
+	cat "$TMPDIR/log"
+	echo "FAIL: $1" >&2
+	exit 1
+}
+
+# Expects success unless the first argument is "!".
+run_flashrom() {
+	expect=0
+	if [ "$1" = "!" ]; then
+		expect=1
+		shift
+	fi
+	"$FLASHROM" "$@" >"$TMPDIR/log" 2>&1
+	ret=$?
+	if [ $expect -eq 0 ] && [ $ret -ne 0 ]; then
+		fail "flashrom $* returned $ret"
+	elif [ $expect -ne 0 ] && [ $ret -eq 0 ]; then
+		fail "flashrom $* succeeded"
+	fi
+}
+
+# Writes 128 KiB of data for seed $1 into an otherwise erased image, so all
+# the erased chunks share one file in the store.
+image() {
+	head -c $SIZE /dev/zero | tr '\000' '\377' >"$TMPDIR/image$1.bin"
+	awk -v x="$1" 'BEGIN { while (n < 131072) { x = (x * 1103515245 + 12345) % 2147483648;
+		s = sprintf("%08x\n", x); printf "%s", s; n += length(s) } }' | head -c 131072 |
+		dd of="$TMPDIR/image$1.bin" conv=notrunc 2>/dev/null
+}
+
+# $1 is the manifest, $2 the number of chunks expected to be new.
+backup() {
+	run_flashrom -p "$DUMMY" --backup "$1"
+	grep -q "Backed up $CHUNKS chunks to \"$1\", $2 of them" "$TMPDIR/log" ||
+		fail "backup to $1 didn't store $2 new chunks"
+}
+
+# $1 is the number of chunk files expected in the store.
+expect_store() {
+	[ "$(find "$STORE" -type f | wc -l)" -eq "$1" ] || fail "the store doesn't hold $1 files"
+	[ -z "$(find "$STORE" -type f -name '*.*')" ] || fail "temporary files left in the store"
+}
+
+image 1
+image 2
+run_flashrom -p "$DUMMY" -w "$TMPDIR/image1.bin"
+backup "$TMPDIR/first.manifest" 3
+expect_store 3
+echo "PASS: backup"
+
+backup "$TMPDIR/again.manifest" 0
+expect_store 3
+cmp -s "$TMPDIR/first.manifest" "$TMPDIR/again.manifest" || fail "manifests of the same contents differ"
+echo "PASS: unchanged backup stores nothing"
+
+# One changed chunk at the end of the chip.
+printf 'CHANGED' | dd of="$TMPDIR/chip.bin" bs=1 seek=$((SIZE - 100)) conv=notrunc 2>/dev/null
+backup "$TMPDIR/changed.manifest" 1
+expect_store 4
+echo "PASS: changed chunk stored once"
+
+run_flashrom -p "$DUMMY" -w "$TMPDIR/image2.bin"
+run_flashrom -p "$DUMMY" --restore "$TMPDIR/first.manifest"
+cmp -s "$TMPDIR/chip.bin" "$TMPDIR/image1.bin" || fail "chip contents differ after restoring"
+echo "PASS: restore"
+
+# A chunk store elsewhere, deduplicated against nothing.
+run_flashrom -p "$DUMMY" --backup "$TMPDIR/other.manifest" --chunk-dir "$TMPDIR/other"
+[ "$(find "$TMPDIR/other" -type f | wc -l)" -eq 3 ] || fail "--chunk-dir store doesn't hold 3 files"
+run_flashrom -p "$DUMMY" -w "$TMPDIR/image2.bin"
+run_flashrom -p "$DUMMY" --restore "$TMPDIR/other.manifest" --chunk-dir "$TMPDIR/other"
+cmp -s "$TMPDIR/chip.bin" "$TMPDIR/image1.bin" || fail "chip contents differ after restoring from --chunk-dir"
+echo "PASS: --chunk-dir"
+
+# Broken backups must be rejected before anything is written.
+bad() {
+	run_flashrom -p "$DUMMY" -w "$TMPDIR/image2.bin"
+	run_flashrom ! -p "$DUMMY" --restore "$1"
+	grep -q "$2" "$TMPDIR/log" || fail "expected \"$2\""
+	cmp -s "$TMPDIR/chip.bin" "$TMPDIR/image2.bin" || fail "chip changed by a rejected backup"
+}
+
+head -n 10 "$TMPDIR/first.manifest" >"$TMPDIR/truncated.manifest"
+bad "$TMPDIR/truncated.manifest" "is it truncated"
+hash=$(awk '/^[0-9a-f]+ [0-9a-f]+$/ { print $2; exit }' "$TMPDIR/first.manifest")
+chunk="$STORE/$(echo "$hash" | cut -c1-2)/$hash"
+printf 'X' | dd of="$chunk" bs=1 seek=10 conv=notrunc 2>/dev/null
+bad "$TMPDIR/first.manifest" "is corrupt"
+echo "PASS: broken backups rejected"
@@ -0,0 +1,97 @@
+#!/bin/sh
+#
+# This file is part of the flashrom project.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; version 2 of the License.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# Checks --make-delta and writing deltas against the dummy programmer:
+#
+#   delta_test.sh <flashrom>
+
+if [ $# -ne 1 ]; then
+	echo "usage: $0 <flashrom>" >&2
+	exit 2
+fi
+
+FLASHROM=$1
+# 4 KiB sectors, so hunks can share an erase block.
+CHIP=SST25VF032B
+SIZE=4194304
+
+TMPDIR=$(mktemp -d -t flashrom_delta.XXXXXXXXXX) || exit 1
+trap 'rm -rf "$TMPDIR"' EXIT
+
+fail() {
+	cat "$TMPDIR/log"
+	echo "FAIL: $1" >&2
+	exit 1
+}
+
+# Expects success unless the first argument is "!".
+run_flashrom() {
+	expect=0
+	if [ "$1" = "!" ]; then
+		expect=1
+		shift
+	fi
+	"$FLASHROM" "$@" >"$TMPDIR/log" 2>&1
+	ret=$?
+	if [ $expect -eq 0 ] && [ $ret -ne 0 ]; then
+		fail "flashrom $* returned $ret"
+	elif [ $expect -ne 0 ] && [ $ret -eq 0 ]; then
+		fail "flashrom $* succeeded"
+	fi
+}
+
+# $1 is the seed, the same data on every run.
+pattern() {
+	awk -v x="$1" 'BEGIN { while (n < '$SIZE') { x = (x * 1103515245 + 12345) % 2147483648;
+		s = sprintf("%08x\n", x); printf "%s", s; n += length(s) } }' | head -c $SIZE
+}
+
+# $1 is the file, $2 the offset.
+patch() {
+	printf 'PATCHED' | dd of="$1" bs=1 seek="$2" conv=notrunc 2>/dev/null
+}
+
+DUMMY="dummy:emulate=$CHIP,image=$TMPDIR/chip.bin"
+pattern 1 >"$TMPDIR/base.bin"
+cp "$TMPDIR/base.bin" "$TMPDIR/new.bin"
+# Three hunks in the sector at 0x1000, one far away.
+for offset in 4112 4400 5000 131072; do
+	patch "$TMPDIR/new.bin" $offset
+done
+
+run_flashrom --make-delta "$TMPDIR/base.bin" "$TMPDIR/new.bin" "$TMPDIR/patch.delta"
+run_flashrom -p "$DUMMY" -w "$TMPDIR/base.bin"
+
+run_flashrom -p "$DUMMY" -V -w "$TMPDIR/patch.delta"
+cmp -s "$TMPDIR/chip.bin" "$TMPDIR/new.bin" || fail "chip contents differ after applying the delta"
+[ "$(grep -o '0x001000-0x001fff:' "$TMPDIR/log" | wc -l)" -eq 1 ] ||
+	fail "the sector shared by three hunks was not written exactly once"
+echo "PASS: delta applied"
+
+run_flashrom -p "$DUMMY" -v "$TMPDIR/patch.delta"
+run_flashrom -p "$DUMMY" -w "$TMPDIR/patch.delta"
+grep -q "already contains the patched contents" "$TMPDIR/log" || fail "applying the delta twice"
+echo "PASS: delta verified and applied again"
+
+# A chip which holds neither the base nor the result must be left alone.
+pattern 2 >"$TMPDIR/other.bin"
+run_flashrom -p "$DUMMY" -w "$TMPDIR/other.bin"
+run_flashrom ! -p "$DUMMY" -w "$TMPDIR/patch.delta"
+cmp -s "$TMPDIR/chip.bin" "$TMPDIR/other.bin" || fail "chip changed by a delta for another base"
+run_flashrom ! -p "$DUMMY" -v "$TMPDIR/patch.delta"
+echo "PASS: delta for another base rejected"
+
+head -c 100 "$TMPDIR/patch.delta" >"$TMPDIR/truncated.delta"
+run_flashrom ! -p "$DUMMY" -w "$TMPDIR/truncated.delta"
+grep -q "truncated" "$TMPDIR/log" || fail "truncated delta"
+echo "PASS: truncated delta rejected"
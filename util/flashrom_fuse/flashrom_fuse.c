@@ -0,0 +1,502 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Mounts a flash chip as a directory with one file for the whole chip and one
+ * per FMAP or IFD region. Reads go to the chip on demand and are cached in
+ * blocks, writes are collected in the cache and committed on fsync() and
+ * unmount through flashrom_image_write(), which only erases and writes what
+ * has changed.
+ */
+
+#define FUSE_USE_VERSION 31
+
+#include <errno.h>
+#include <fuse.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "libflashrom.h"
+
+/* Granularity of the cache, the smallest erase block of most SPI flash chips. */
+#define BLOCK_SIZE		4096
+/* Runs of dirty blocks committed per flashrom_image_write(), each becomes a layout region. */
+#define MAX_COMMIT_RUNS		64
+#define MAX_FILES		129
+#define WHOLE_CHIP_FILE		"flash.bin"
+
+enum block_state {
+	BLOCK_UNCACHED,
+	BLOCK_CACHED,
+	BLOCK_DIRTY,
+};
+
+struct chip_file {
+	char *name;
+	size_t start;
+	size_t len;
+};
+
+static struct {
+	struct flashrom_programmer *prog;
+	bool prog_initialized;
+	struct flashrom_flashctx *flash;
+	size_t size;
+	size_t num_blocks;
+	uint8_t *image;
+	uint8_t *state;		/* enum block_state of each block */
+	struct chip_file files[MAX_FILES];
+	unsigned int num_files;
+	pthread_mutex_t lock;
+} fs = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static struct options {
+	char *programmer;
+	char *chip;
+	int fmap;
+	int ifd;
+	int verbose;
+	int help;
+} options;
+
+#define OPTION(t, p) { t, offsetof(struct options, p), 1 }
+static const struct fuse_opt option_spec[] = {
+	OPTION("-p %s", programmer),
+	OPTION("--programmer=%s", programmer),
+	OPTION("-c %s", chip),
+	OPTION("--chip=%s", chip),
+	OPTION("--fmap", fmap),
+	OPTION("--ifd", ifd),
+	OPTION("-V", verbose),
+	OPTION("--verbose", verbose),
+	OPTION("-h", help),
+	OPTION("--help", help),
+	FUSE_OPT_END
+};
+
+static void usage(const char *name)
+{
+	printf("Usage: %s -p <programmername>[:<parameters>] [-c <chipname>] [--fmap|--ifd] [-V]\n"
+	       "       [<FUSE options>] <mountpoint>\n\n"
+	       "Mounts the flash chip as <mountpoint>/" WHOLE_CHIP_FILE ", plus one file per region of the\n"
+	       "FMAP (--fmap) or Intel Firmware Descriptor (--ifd) found on the chip. Writes are\n"
+	       "committed to the chip on fsync and unmount. The mount stays in the foreground.\n\n",
+	       name);
+}
+
+static int log_callback(enum flashrom_log_level level, const char *fmt, va_list args)
+{
+	if (level > (options.verbose ? FLASHROM_MSG_INFO : FLASHROM_MSG_WARN))
+		return 0;
+	return vfprintf(stderr, fmt, args);
+}
+
+/* Sets a temporary layout of the given regions, runs the operation and drops the layout again. */
+static int with_layout(struct flashrom_layout *layout, bool write)
+{
+	int ret;
+
+	flashrom_layout_set(fs.flash, layout);
+	if (write)
+		ret = flashrom_image_write(fs.flash, fs.image, fs.size, NULL);
+	else
+		ret = flashrom_image_read(fs.flash, fs.image, fs.size);
+	flashrom_layout_set(fs.flash, NULL);
+	return ret;
+}
+
+static size_t block_end(size_t block)
+{
+	const size_t end = (block + 1) * BLOCK_SIZE;
+	return end < fs.size ? end : fs.size;
+}
+
+/* Makes sure that blocks first to last are cached, reading each run of missing ones at once. */
+static int load_blocks(size_t first, size_t last)
+{
+	size_t b = first, start;
+
+	while (b <= last) {
+		if (fs.state[b] != BLOCK_UNCACHED) {
+			b++;
+			continue;
+		}
+		for (start = b; b <= last && fs.state[b] == BLOCK_UNCACHED; b++)
+			;
+
+		struct flashrom_layout *layout;
+		if (flashrom_layout_new(&layout))
+			return -ENOMEM;
+		int ret = flashrom_layout_add_region(layout, start * BLOCK_SIZE, block_end(b - 1) - 1, "cache");
+		if (!ret)
+			ret = with_layout(layout, false);
+		flashrom_layout_release(layout);
+		if (ret)
+			return -EIO;
+		memset(fs.state + start, BLOCK_CACHED, b - start);
+	}
+	return 0;
+}
+
+/* Writes all dirty blocks to the chip, up to MAX_COMMIT_RUNS runs at a time. */
+static int commit(void)
+{
+	size_t b = 0;
+
+	while (b < fs.num_blocks) {
+		struct flashrom_layout *layout;
+		const char *name;
+		size_t start, len, i;
+		unsigned int runs = 0;
+		int ret = 0;
+
+		if (flashrom_layout_new(&layout))
+			return -ENOMEM;
+		while (b < fs.num_blocks && runs < MAX_COMMIT_RUNS && !ret) {
+			if (fs.state[b] != BLOCK_DIRTY) {
+				b++;
+				continue;
+			}
+			for (start = b; b < fs.num_blocks && fs.state[b] == BLOCK_DIRTY; b++)
+				;
+			ret = flashrom_layout_add_region(layout, start * BLOCK_SIZE, block_end(b - 1) - 1, "dirty");
+			runs++;
+		}
+		if (runs && !ret)
+			ret = with_layout(layout, true);
+		if (!ret) {
+			for (i = 0; !flashrom_layout_get_region(layout, i, &name, &start, &len); i++)
+				memset(fs.state + start / BLOCK_SIZE, BLOCK_CACHED, (len + BLOCK_SIZE - 1) / BLOCK_SIZE);
+		}
+		flashrom_layout_release(layout);
+		if (ret) {
+			fprintf(stderr, "Committing to the flash chip failed!\n");
+			return -EIO;
+		}
+	}
+	return 0;
+}
+
+static const struct chip_file *find_file(const char *path)
+{
+	unsigned int i;
+
+	for (i = 0; i < fs.num_files; i++) {
+		if (path[0] == '/' && !strcmp(path + 1, fs.files[i].name))
+			return &fs.files[i];
+	}
+	return NULL;
+}
+
+static void *fs_init(struct fuse_conn_info *conn, struct fuse_config *cfg)
+{
+	(void)conn;
+	/* The chip may be written behind our back by other tools, don't keep pages across opens. */
+	cfg->kernel_cache = 0;
+	return NULL;
+}
+
+static int fs_getattr(const char *path, struct stat *st, struct fuse_file_info *fi)
+{
+	const struct chip_file *file;
+
+	(void)fi;
+	memset(st, 0, sizeof(*st));
+	if (!strcmp(path, "/")) {
+		st->st_mode = S_IFDIR | 0755;
+		st->st_nlink = 2;
+		return 0;
+	}
+	file = find_file(path);
+	if (!file)
+		return -ENOENT;
+	st->st_mode = S_IFREG | 0644;
+	st->st_nlink = 1;
+	st->st_size = file->len;
+	return 0;
+}
+
+static int fs_readdir(const char *path, void *buf, fuse_fill_dir_t filler, off_t offset,
+		      struct fuse_file_info *fi, enum fuse_readdir_flags flags)
+{
+	unsigned int i;
+
+	(void)offset;
+	(void)fi;
+	(void)flags;
+	if (strcmp(path, "/"))
+		return -ENOENT;
+	filler(buf, ".", NULL, 0, 0);
+	filler(buf, "..", NULL, 0, 0);
+	for (i = 0; i < fs.num_files; i++)
+		filler(buf, fs.files[i].name, NULL, 0, 0);
+	return 0;
+}
+
+static int fs_open(const char *path, struct fuse_file_info *fi)
+{
+	(void)fi;
+	return find_file(path) ? 0 : -ENOENT;
+}
+
+static int fs_read(const char *path, char *buf, size_t size, off_t offset, struct fuse_file_info *fi)
+{
+	const struct chip_file *const file = find_file(path);
+	int ret;
+
+	(void)fi;
+	if (!file)
+		return -ENOENT;
+	if (offset < 0 || (size_t)offset >= file->len)
+		return 0;
+	if (size > file->len - offset)
+		size = file->len - offset;
+	if (!size)
+		return 0;
+
+	const size_t start = file->start + offset;
+	pthread_mutex_lock(&fs.lock);
+	ret = load_blocks(start / BLOCK_SIZE, (start + size - 1) / BLOCK_SIZE);
+	if (!ret) {
+		memcpy(buf, fs.image + start, size);
+		ret = size;
+	}
+	pthread_mutex_unlock(&fs.lock);
+	return ret;
+}
+
+static int fs_write(const char *path, const char *buf, size_t size, off_t offset, struct fuse_file_info *fi)
+{
+	const struct chip_file *const file = find_file(path);
+	int ret = 0;
+
+	(void)fi;
+	if (!file)
+		return -ENOENT;
+	if (offset < 0 || (size_t)offset >= file->len)
+		return size ? -ENOSPC : 0;
+	if (size > file->len - offset)
+		size = file->len - offset;
+	if (!size)
+		return 0;
+
+	const size_t start = file->start + offset, end = start + size;
+	const size_t first = start / BLOCK_SIZE, last = (end - 1) / BLOCK_SIZE;
+	pthread_mutex_lock(&fs.lock);
+	/* Only partially written blocks need their old contents. */
+	if (start % BLOCK_SIZE)
+		ret = load_blocks(first, first);
+	if (!ret && end % BLOCK_SIZE && end != fs.size)
+		ret = load_blocks(last, last);
+	if (!ret) {
+		memcpy(fs.image + start, buf, size);
+		memset(fs.state + first, BLOCK_DIRTY, last - first + 1);
+		ret = size;
+	}
+	pthread_mutex_unlock(&fs.lock);
+	return ret;
+}
+
+static int fs_truncate(const char *path, off_t size, struct fuse_file_info *fi)
+{
+	const struct chip_file *const file = find_file(path);
+
+	(void)fi;
+	if (!file)
+		return -ENOENT;
+	/* The files have the fixed size of their region, accept truncation so `cp` works. */
+	if (size < 0 || (size_t)size > file->len)
+		return -EFBIG;
+	return 0;
+}
+
+static int fs_fsync(const char *path, int datasync, struct fuse_file_info *fi)
+{
+	int ret;
+
+	(void)path;
+	(void)datasync;
+	(void)fi;
+	pthread_mutex_lock(&fs.lock);
+	ret = commit();
+	pthread_mutex_unlock(&fs.lock);
+	return ret;
+}
+
+static void fs_destroy(void *private_data)
+{
+	(void)private_data;
+	pthread_mutex_lock(&fs.lock);
+	commit();
+	pthread_mutex_unlock(&fs.lock);
+}
+
+static const struct fuse_operations fs_ops = {
+	.init		= fs_init,
+	.getattr	= fs_getattr,
+	.readdir	= fs_readdir,
+	.open		= fs_open,
+	.read		= fs_read,
+	.write		= fs_write,
+	.truncate	= fs_truncate,
+	.fsync		= fs_fsync,
+	.destroy	= fs_destroy,
+};
+
+static int add_file(const char *name, size_t start, size_t len)
+{
+	struct chip_file *const file = &fs.files[fs.num_files];
+	unsigned int i;
+	char *p;
+
+	if (fs.num_files >= MAX_FILES || !len || start >= fs.size || len > fs.size - start)
+		return 0;
+	file->name = strdup(name);
+	if (!file->name)
+		return 1;
+	for (p = file->name; *p; p++) {
+		if (*p == '/')
+			*p = '_';
+	}
+	/* Skip regions whose names can't be used or are taken already. */
+	for (i = 0; i < fs.num_files; i++) {
+		if (!strcmp(fs.files[i].name, file->name))
+			break;
+	}
+	if (i < fs.num_files || !file->name[0] || !strcmp(file->name, ".") || !strcmp(file->name, "..")) {
+		free(file->name);
+		return 0;
+	}
+	file->start = start;
+	file->len = len;
+	fs.num_files++;
+	return 0;
+}
+
+static int add_region_files(void)
+{
+	struct flashrom_layout *layout = NULL;
+	const char *name;
+	size_t start, len, i;
+	int ret;
+
+	if (options.fmap)
+		ret = flashrom_layout_read_fmap_from_rom(&layout, fs.flash, 0, fs.size);
+	else if (options.ifd)
+		ret = flashrom_layout_read_from_ifd(&layout, fs.flash, NULL, 0);
+	else
+		return 0;
+	if (ret) {
+		fprintf(stderr, "Reading the %s failed.\n", options.fmap ? "FMAP" : "descriptor");
+		return 1;
+	}
+	for (i = 0; !flashrom_layout_get_region(layout, i, &name, &start, &len); i++) {
+		if (add_file(name, start, len)) {
+			ret = 1;
+			break;
+		}
+	}
+	flashrom_layout_release(layout);
+	return ret;
+}
+
+static int setup(void)
+{
+	char *const params = strchr(options.programmer, ':');
+
+	if (params)
+		*params = '\0';
+	flashrom_set_log_callback(log_callback);
+	if (flashrom_init(1))
+		return 1;
+	/* The parameters are parsed in place, so they must be writable. */
+	if (flashrom_programmer_init(&fs.prog, options.programmer, params ? params + 1 : "")) {
+		fprintf(stderr, "Initializing the programmer failed.\n");
+		return 1;
+	}
+	fs.prog_initialized = true;
+	if (flashrom_flash_probe(&fs.flash, fs.prog, options.chip)) {
+		fprintf(stderr, "No unique flash chip found.\n");
+		return 1;
+	}
+	flashrom_flag_set(fs.flash, FLASHROM_FLAG_VERIFY_AFTER_WRITE, true);
+	flashrom_flag_set(fs.flash, FLASHROM_FLAG_VERIFY_WHOLE_CHIP, false);
+
+	fs.size = flashrom_flash_getsize(fs.flash);
+	fs.num_blocks = (fs.size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	fs.image = malloc(fs.size);
+	fs.state = calloc(fs.num_blocks, 1);
+	if (!fs.image || !fs.state) {
+		fprintf(stderr, "Out of memory!\n");
+		return 1;
+	}
+	if (add_file(WHOLE_CHIP_FILE, 0, fs.size))
+		return 1;
+	return add_region_files();
+}
+
+static void teardown(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < fs.num_files; i++)
+		free(fs.files[i].name);
+	free(fs.state);
+	free(fs.image);
+	if (fs.flash)
+		flashrom_flash_release(fs.flash);
+	if (fs.prog_initialized)
+		flashrom_programmer_shutdown(fs.prog);
+	flashrom_shutdown();
+}
+
+int main(int argc, char *argv[])
+{
+	struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+	int ret = 1;
+
+	if (fuse_opt_parse(&args, &options, option_spec, NULL) == -1)
+		return 1;
+	if (options.help) {
+		usage(argv[0]);
+		fuse_opt_add_arg(&args, "--help");
+		args.argv[0][0] = '\0';
+		ret = fuse_main(args.argc, args.argv, &fs_ops, NULL);
+		goto out;
+	}
+	if (!options.programmer) {
+		usage(argv[0]);
+		goto out;
+	}
+	if (options.fmap && options.ifd) {
+		fprintf(stderr, "--fmap and --ifd are mutually exclusive.\n");
+		goto out;
+	}
+
+	if (!setup()) {
+		/* Programmers often hold handles that don't survive the fork of daemonizing. */
+		fuse_opt_add_arg(&args, "-f");
+		ret = fuse_main(args.argc, args.argv, &fs_ops, NULL);
+	}
+	teardown();
+out:
+	fuse_opt_free_args(&args);
+	free(options.programmer);
+	free(options.chip);
+	return ret;
+}
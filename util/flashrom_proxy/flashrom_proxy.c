@@ -0,0 +1,376 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Serves the SPI master of a local programmer to the proxy programmer of
+ * flashrom on another machine, see proxy.h for the protocol. Clients are
+ * served one after the other, the programmer stays initialized in between.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include "flash.h"
+#include "libflashrom.h"
+#include "programmer.h"
+#include "spi.h"
+#include "proxy.h"
+
+/* Responses are collected up to this size while more requests are waiting. */
+#define OUTBUF_SIZE	(2 * (PROXY_HEADER_SIZE + PROXY_MAX_PAYLOAD))
+
+static volatile sig_atomic_t stop;
+static int verbose;
+
+static struct flashchip proxy_chip = { .name = "proxy" };
+static struct flashctx proxy_flash = { .chip = &proxy_chip };
+
+static uint8_t request[PROXY_MAX_PAYLOAD];
+static uint8_t outbuf[OUTBUF_SIZE];
+static size_t outlen;
+
+static uint32_t get_le32(const uint8_t *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void put_le32(uint8_t *p, uint32_t val)
+{
+	p[0] = val;
+	p[1] = val >> 8;
+	p[2] = val >> 16;
+	p[3] = val >> 24;
+}
+
+static int log_callback(enum flashrom_log_level level, const char *fmt, va_list args)
+{
+	if ((int)level > FLASHROM_MSG_INFO + verbose)
+		return 0;
+	return vfprintf(stderr, fmt, args);
+}
+
+static void handle_signal(int sig)
+{
+	stop = 1;
+}
+
+static int read_all(int fd, uint8_t *buf, size_t len)
+{
+	while (len) {
+		const ssize_t ret = read(fd, buf, len);
+		if (ret < 0 && errno == EINTR && !stop)
+			continue;
+		if (ret <= 0)
+			return 1;
+		buf += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+static int flush_responses(int fd)
+{
+	const uint8_t *buf = outbuf;
+
+	while (outlen) {
+		const ssize_t ret = write(fd, buf, outlen);
+		if (ret < 0 && errno == EINTR && !stop)
+			continue;
+		if (ret <= 0) {
+			fprintf(stderr, "Sending to the client failed: %s\n", strerror(errno));
+			return 1;
+		}
+		buf += ret;
+		outlen -= ret;
+	}
+	return 0;
+}
+
+/* Reserves a response with room for len bytes of payload and returns the payload. */
+static uint8_t *add_response(int fd, int32_t status, uint32_t len)
+{
+	if (outlen + PROXY_HEADER_SIZE + len > sizeof(outbuf) && flush_responses(fd))
+		return NULL;
+	uint8_t *const p = outbuf + outlen;
+	put_le32(p, status);
+	put_le32(p + 4, len);
+	outlen += PROXY_HEADER_SIZE + len;
+	return p + PROXY_HEADER_SIZE;
+}
+
+static int handle_hello(int fd, uint32_t len)
+{
+	const struct spi_master *const spi = &proxy_flash.mst->spi;
+	uint8_t *p;
+
+	if (len != 4 || get_le32(request) != PROXY_VERSION)
+		fprintf(stderr, "Client speaks protocol version %u, we speak %u.\n",
+			len == 4 ? get_le32(request) : 0, PROXY_VERSION);
+	p = add_response(fd, 0, 16);
+	if (!p)
+		return 1;
+	put_le32(p, PROXY_VERSION);
+	put_le32(p + 4, spi->features);
+	put_le32(p + 8, spi->max_data_read);
+	put_le32(p + 12, spi->max_data_write);
+	return 0;
+}
+
+static int handle_spi_command(int fd, uint32_t len)
+{
+	if (len < 4)
+		return 1;
+	const uint32_t readcnt = get_le32(request);
+	if (readcnt > PROXY_MAX_DATA)
+		return 1;
+
+	uint8_t *const p = add_response(fd, 0, readcnt);
+	if (!p)
+		return 1;
+	const int ret = spi_send_command(&proxy_flash, len - 4, readcnt, request + 4, p);
+	if (ret) {
+		/* Replace it with an error response without payload. */
+		outlen -= PROXY_HEADER_SIZE + readcnt;
+		return !add_response(fd, ret, 0);
+	}
+	return 0;
+}
+
+static int handle_spi_poll(int fd, uint32_t len)
+{
+	if (len != 12)
+		return 1;
+	const uint8_t cmd = request[0], mask = request[1];
+	const uint32_t delay = get_le32(request + 4), timeout = get_le32(request + 8);
+	const uint64_t start = internal_time_usecs();
+	/* JEDEC_RDSR_INSIZE is 1, but some masters need 2. */
+	uint8_t status[2];
+	int ret;
+
+	while (!(ret = spi_send_command(&proxy_flash, 1, sizeof(status), &cmd, status)) && (status[0] & mask)) {
+		if (internal_time_usecs() - start > timeout) {
+			ret = TIMEOUT_ERROR;
+			break;
+		}
+		programmer_delay(delay);
+	}
+	if (ret)
+		return !add_response(fd, ret, 0);
+	uint8_t *const p = add_response(fd, 0, 1);
+	if (!p)
+		return 1;
+	p[0] = status[0];
+	return 0;
+}
+
+static bool more_requests(int fd)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+	return poll(&pfd, 1, 0) > 0;
+}
+
+static void serve_client(int fd)
+{
+	uint8_t header[PROXY_HEADER_SIZE];
+	unsigned long requests = 0;
+	int ret = 0;
+
+	while (!stop && !ret && !read_all(fd, header, sizeof(header))) {
+		const uint32_t len = get_le32(header + 4);
+		if (len > sizeof(request) || read_all(fd, request, len)) {
+			ret = 1;
+			break;
+		}
+		switch (header[0]) {
+		case PROXY_OP_HELLO:
+			ret = handle_hello(fd, len);
+			break;
+		case PROXY_OP_SPI_COMMAND:
+			ret = handle_spi_command(fd, len);
+			break;
+		case PROXY_OP_SPI_POLL:
+			ret = handle_spi_poll(fd, len);
+			break;
+		default:
+			ret = 1;
+			break;
+		}
+		requests++;
+		/* Send responses in bulk while the client keeps the pipeline full. */
+		if (!ret && !more_requests(fd))
+			ret = flush_responses(fd);
+	}
+	if (ret)
+		fprintf(stderr, "Dropping client after a malformed or failed request.\n");
+	outlen = 0;
+	if (verbose)
+		fprintf(stderr, "Client disconnected after %lu requests.\n", requests);
+}
+
+static int open_listener(const char *addr, const char *port)
+{
+	struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM, .ai_flags = AI_PASSIVE };
+	struct addrinfo *res, *ai;
+	const int flag = 1;
+	int fd = -1, ret;
+
+	ret = getaddrinfo(addr, port, &hints, &res);
+	if (ret) {
+		fprintf(stderr, "Cannot resolve %s: %s\n", addr, gai_strerror(ret));
+		return -1;
+	}
+	for (ai = res; ai; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (fd < 0)
+			continue;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+		if (!bind(fd, ai->ai_addr, ai->ai_addrlen) && !listen(fd, 1))
+			break;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	if (fd < 0)
+		fprintf(stderr, "Cannot listen on %s port %s: %s\n", addr, port, strerror(errno));
+	return fd;
+}
+
+static int init_programmer(char *name)
+{
+	char *const params = strchr(name, ':');
+	unsigned int prog;
+	int i;
+
+	if (params)
+		*params = '\0';
+	for (prog = 0; prog < PROGRAMMER_INVALID; prog++) {
+		if (!strcmp(name, programmer_table[prog].name))
+			break;
+	}
+	if (prog >= PROGRAMMER_INVALID) {
+		fprintf(stderr, "Unknown programmer \"%s\".\n", name);
+		return 1;
+	}
+	/* The parameters are parsed in place, so they must be writable. */
+	if (programmer_init(prog, params ? params + 1 : "")) {
+		fprintf(stderr, "Initializing the programmer failed.\n");
+		return 1;
+	}
+	for (i = 0; i < registered_master_count; i++) {
+		if (registered_masters[i].buses_supported & BUS_SPI) {
+			proxy_flash.mst = &registered_masters[i];
+			return 0;
+		}
+	}
+	fprintf(stderr, "The programmer has no SPI master to serve.\n");
+	programmer_shutdown();
+	return 1;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s -p <programmername>[:<parameters>] [-l <address>] [-P <port>] [-V]\n\n"
+		"Serves the SPI master of the programmer to `flashrom -p proxy:host=...`.\n"
+		" -l, --listen <address>  address to listen on (default: localhost)\n"
+		" -P, --port <port>       TCP port (default: %u)\n"
+		" -V, --verbose           more verbose output, may be repeated\n",
+		name, PROXY_DEFAULT_PORT);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{"programmer",	1, NULL, 'p'},
+		{"listen",	1, NULL, 'l'},
+		{"port",	1, NULL, 'P'},
+		{"verbose",	0, NULL, 'V'},
+		{"help",	0, NULL, 'h'},
+		{NULL,		0, NULL, 0},
+	};
+	const char *addr = "localhost";
+	char *programmer = NULL, port[8];
+	struct sigaction sa = { .sa_handler = handle_signal };
+	int opt, listener, ret = 1;
+
+	snprintf(port, sizeof(port), "%u", PROXY_DEFAULT_PORT);
+	while ((opt = getopt_long(argc, argv, "p:l:P:Vh", long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'p':
+			programmer = optarg;
+			break;
+		case 'l':
+			addr = optarg;
+			break;
+		case 'P':
+			snprintf(port, sizeof(port), "%s", optarg);
+			break;
+		case 'V':
+			verbose++;
+			break;
+		default:
+			usage(argv[0]);
+			return opt != 'h';
+		}
+	}
+	if (!programmer || optind != argc) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	/* No SA_RESTART, so that accept() and read() return on SIGINT and SIGTERM. */
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	flashrom_set_log_callback(log_callback);
+	if (flashrom_init(1))
+		return 1;
+	listener = open_listener(addr, port);
+	if (listener < 0)
+		goto out;
+	if (init_programmer(programmer))
+		goto close_out;
+
+	fprintf(stderr, "Serving %s on %s port %s.\n", programmer, addr, port);
+	while (!stop) {
+		const int flag = 1;
+		const int fd = accept(listener, NULL, NULL);
+		if (fd < 0) {
+			if (errno != EINTR)
+				fprintf(stderr, "accept() failed: %s\n", strerror(errno));
+			continue;
+		}
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+		serve_client(fd);
+		close(fd);
+	}
+	ret = programmer_shutdown();
+close_out:
+	close(listener);
+out:
+	flashrom_shutdown();
+	return ret;
+}
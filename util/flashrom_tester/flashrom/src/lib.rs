@@ -46,6 +46,7 @@ pub enum FlashChip {
     HOST,
     SERVO,
     DEDIPROG,
+    DUMMY,
 }
 
 impl FlashChip {
@@ -55,6 +56,7 @@ impl FlashChip {
             "host" => Ok(FlashChip::HOST),
             "servo" => Ok(FlashChip::SERVO),
             "dediprog" => Ok(FlashChip::DEDIPROG),
+            "dummy" => Ok(FlashChip::DUMMY),
             _ => Err("cannot convert str to enum"),
         };
         return r;
@@ -65,6 +67,7 @@ impl FlashChip {
             FlashChip::HOST => "host",
             FlashChip::SERVO => "ft2231_spi:type=servo-v2",
             FlashChip::DEDIPROG => "dediprog",
+            FlashChip::DUMMY => "dummy:emulate=W25Q128FV,image=/tmp/flashrom_tester_dummy.bin",
         };
         return r;
     }
@@ -72,11 +75,11 @@ impl FlashChip {
     /// Return whether the hardware write protect signal can be controlled.
     ///
     /// Servo and dediprog adapters are assumed to always have hardware write protect
-    /// disabled.
+    /// disabled, and the dummy programmer has none.
     pub fn can_control_hw_wp(&self) -> bool {
         match self {
             FlashChip::HOST | FlashChip::EC => true,
-            FlashChip::SERVO | FlashChip::DEDIPROG => false,
+            FlashChip::SERVO | FlashChip::DEDIPROG | FlashChip::DUMMY => false,
         }
     }
 }
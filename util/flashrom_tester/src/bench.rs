@@ -0,0 +1,543 @@
+//
+// Copyright 2019, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//    * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//    * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Alternatively, this software may be distributed under the terms of the
+// GNU General Public License ("GPL") version 2 as published by the Free
+// Software Foundation.
+//
+
+//! Timing benchmarks for the common flashrom operations.
+//!
+//! Each benchmark runs a flashrom operation several times, recording the wall
+//! clock time of every run. The resulting statistics can be saved as a
+//! baseline and later runs compared against it, flagging any benchmark whose
+//! mean time grew by more than the given tolerance.
+//!
+//! Benchmarks modify the flash contents, which are restored to the image read
+//! at start once all benchmarks have run.
+
+use super::rand_util;
+use super::tester::OutputFormat;
+use super::types;
+use super::utils::{self, LayoutNames, LayoutSizes};
+use flashrom::{FlashChip, Flashrom, FlashromCmd, FlashromOpt, IOOpt};
+use serde_json::{json, Map, Value};
+use std::collections::HashSet;
+use std::fs::File;
+use std::io::Write;
+use std::path::PathBuf;
+use std::time::Instant;
+
+/// The files a benchmark run works with, in a private temporary directory.
+struct BenchFiles {
+    dir: PathBuf,
+    layout: String,
+    original: String,
+    random: String,
+    read: String,
+    /// Keep the directory on drop, it holds the only copy of the original image.
+    keep: bool,
+}
+
+impl BenchFiles {
+    /// Create a new directory in the system temporary directory, like mkdtemp().
+    fn new() -> std::io::Result<BenchFiles> {
+        let base = std::env::temp_dir();
+        let mut n = 0;
+        let dir = loop {
+            let dir = base.join(format!(
+                "flashrom_tester_bench.{}.{}",
+                std::process::id(),
+                n
+            ));
+            match std::fs::create_dir(&dir) {
+                Ok(()) => break dir,
+                Err(ref e) if e.kind() == std::io::ErrorKind::AlreadyExists && n < 100 => n += 1,
+                Err(e) => return Err(e),
+            }
+        };
+        let file = |name: &str| dir.join(name).to_string_lossy().into_owned();
+        Ok(BenchFiles {
+            layout: file("layout.file"),
+            original: file("golden.bin"),
+            random: file("random.bin"),
+            read: file("read.bin"),
+            keep: false,
+            dir,
+        })
+    }
+}
+
+impl Drop for BenchFiles {
+    fn drop(&mut self) {
+        if self.keep {
+            warn!(
+                "Keeping {} with the original flash image",
+                self.dir.display()
+            );
+        } else if let Err(e) = std::fs::remove_dir_all(&self.dir) {
+            warn!("Failed to remove {}: {}", self.dir.display(), e);
+        }
+    }
+}
+
+pub struct BenchOptions {
+    /// Number of timed runs of each benchmark.
+    pub iterations: usize,
+    /// Baseline to compare the results against.
+    pub baseline: Option<PathBuf>,
+    /// Where to save the results as a new baseline.
+    pub save_baseline: Option<PathBuf>,
+    /// Allowed slowdown relative to the baseline mean, as a fraction (0.1 = 10%).
+    pub tolerance: f64,
+}
+
+/// Summary of the run times of a benchmark, in seconds.
+#[derive(Debug, PartialEq, Clone, Copy)]
+pub struct Stats {
+    pub mean: f64,
+    pub stddev: f64,
+    pub min: f64,
+    pub max: f64,
+}
+
+impl Stats {
+    /// Compute the statistics of a set of samples, or None if there are none.
+    ///
+    /// The standard deviation is that of a sample (divided by n - 1), and zero
+    /// for a single sample.
+    pub fn from_samples(samples: &[f64]) -> Option<Stats> {
+        if samples.is_empty() {
+            return None;
+        }
+        let n = samples.len() as f64;
+        let mean = samples.iter().sum::<f64>() / n;
+        let variance = if samples.len() > 1 {
+            samples.iter().map(|s| (s - mean).powi(2)).sum::<f64>() / (n - 1.0)
+        } else {
+            0.0
+        };
+        Some(Stats {
+            mean,
+            stddev: variance.sqrt(),
+            min: samples.iter().cloned().fold(f64::INFINITY, f64::min),
+            max: samples.iter().cloned().fold(f64::NEG_INFINITY, f64::max),
+        })
+    }
+
+    fn to_json(&self) -> Value {
+        json!({
+            "mean": self.mean,
+            "stddev": self.stddev,
+            "min": self.min,
+            "max": self.max,
+        })
+    }
+
+    fn from_json(v: &Value) -> Option<Stats> {
+        Some(Stats {
+            mean: v.get("mean")?.as_f64()?,
+            stddev: v.get("stddev")?.as_f64()?,
+            min: v.get("min")?.as_f64()?,
+            max: v.get("max")?.as_f64()?,
+        })
+    }
+
+    /// Return true if these results are slower than the baseline by more than
+    /// tolerance (a fraction of the baseline mean).
+    pub fn regressed_from(&self, baseline: &Stats, tolerance: f64) -> bool {
+        self.mean > baseline.mean * (1.0 + tolerance)
+    }
+}
+
+#[derive(Debug, PartialEq, Clone, Copy)]
+enum Operation {
+    /// Read the whole flash.
+    Read,
+    /// Erase the whole flash, which holds random data.
+    Erase,
+    /// Write random data to the whole flash, which is erased.
+    Write,
+    /// Write random data to one layout region, which holds the original data.
+    WriteRegion(LayoutNames),
+    /// Write the data the flash already holds.
+    Rewrite,
+}
+
+const BENCHMARKS: &[(&'static str, Operation)] = &[
+    ("Read", Operation::Read),
+    ("Erase", Operation::Erase),
+    ("Write", Operation::Write),
+    (
+        "Write_top_quad",
+        Operation::WriteRegion(LayoutNames::TopQuad),
+    ),
+    ("Rewrite_unchanged", Operation::Rewrite),
+];
+
+fn write_region(cmd: &FlashromCmd, layout: &str, path: &str, region: &str) -> Result<(), String> {
+    let opts = FlashromOpt {
+        io_opt: IOOpt {
+            write: Some(path),
+            ..Default::default()
+        },
+        layout: Some(layout),
+        image: Some(region),
+        ..Default::default()
+    };
+
+    cmd.dispatch(opts)?;
+    Ok(())
+}
+
+impl Operation {
+    /// Bring the flash into the state this operation expects. Not timed.
+    fn prepare(
+        &self,
+        cmd: &FlashromCmd,
+        files: &BenchFiles,
+        ls: &LayoutSizes,
+    ) -> Result<(), String> {
+        match *self {
+            Operation::Read => Ok(()),
+            Operation::Erase | Operation::Rewrite => flashrom::write(cmd, &files.random),
+            Operation::Write => flashrom::erase(cmd),
+            Operation::WriteRegion(section) => {
+                let (name, _, _) = utils::layout_section(ls, section);
+                write_region(cmd, &files.layout, &files.original, name)
+            }
+        }
+    }
+
+    fn run(&self, cmd: &FlashromCmd, files: &BenchFiles, ls: &LayoutSizes) -> Result<(), String> {
+        match *self {
+            Operation::Read => flashrom::read(cmd, &files.read),
+            Operation::Erase => flashrom::erase(cmd),
+            Operation::Write | Operation::Rewrite => flashrom::write(cmd, &files.random),
+            Operation::WriteRegion(section) => {
+                let (name, _, _) = utils::layout_section(ls, section);
+                write_region(cmd, &files.layout, &files.random, name)
+            }
+        }
+    }
+
+    /// Time iterations runs of this operation.
+    ///
+    /// ls is resolved once by the caller so that no size probe ends up inside
+    /// the timed section.
+    fn measure(
+        &self,
+        cmd: &FlashromCmd,
+        files: &BenchFiles,
+        ls: &LayoutSizes,
+        iterations: usize,
+    ) -> Result<Stats, String> {
+        let mut samples = Vec::with_capacity(iterations);
+        for i in 0..iterations {
+            self.prepare(cmd, files, ls)?;
+            let start = Instant::now();
+            self.run(cmd, files, ls)?;
+            let elapsed = start.elapsed();
+            let secs = elapsed.as_secs() as f64 + elapsed.subsec_nanos() as f64 * 1e-9;
+            debug!("{:?} iteration {}: {:.3}s", self, i, secs);
+            samples.push(secs);
+        }
+        Stats::from_samples(&samples).ok_or("No iterations were run".into())
+    }
+}
+
+pub struct BenchResult {
+    pub name: String,
+    pub stats: Result<Stats, String>,
+    pub baseline: Option<Stats>,
+}
+
+impl BenchResult {
+    /// Return true if the benchmark ran and is within tolerance of its baseline
+    /// (if there is one).
+    pub fn passed(&self, tolerance: f64) -> bool {
+        match (&self.stats, &self.baseline) {
+            (Err(_), _) => false,
+            (Ok(stats), Some(baseline)) => !stats.regressed_from(baseline, tolerance),
+            (Ok(_), None) => true,
+        }
+    }
+}
+
+fn parse_baseline(s: &str) -> Result<Map<String, Value>, String> {
+    let v: Value = serde_json::from_str(s).map_err(|e| format!("Malformed baseline: {}", e))?;
+    match v.get("benchmarks") {
+        Some(Value::Object(m)) => Ok(m.clone()),
+        _ => Err("Baseline has no \"benchmarks\" object".into()),
+    }
+}
+
+fn load_baseline(path: &PathBuf) -> Result<Map<String, Value>, String> {
+    let s = std::fs::read_to_string(path)
+        .map_err(|e| format!("Failed to read baseline {}: {}", path.display(), e))?;
+    parse_baseline(&s)
+}
+
+fn baseline_json(chip_name: &str, iterations: usize, results: &[BenchResult]) -> Value {
+    let mut benchmarks = Map::new();
+    for r in results {
+        if let Ok(stats) = &r.stats {
+            benchmarks.insert(r.name.clone(), stats.to_json());
+        }
+    }
+    json!({
+        "chip_name": chip_name,
+        "iterations": iterations,
+        "benchmarks": benchmarks,
+    })
+}
+
+/// Run benchmarks.
+///
+/// Returns Ok(false) if any benchmark failed or regressed against the baseline,
+/// and only returns an Error if there was an internal error or the flash could
+/// not be restored.
+///
+/// test_names selects benchmarks the same way it selects tests in
+/// tests::generic.
+pub fn run<'a, TN: Iterator<Item = &'a str>>(
+    path: &str,
+    fc: FlashChip,
+    options: &BenchOptions,
+    output_format: OutputFormat,
+    test_names: Option<TN>,
+) -> Result<bool, Box<dyn std::error::Error>> {
+    let cmd = FlashromCmd {
+        path: path.to_string(),
+        fc,
+    };
+
+    if fc != FlashChip::DUMMY {
+        utils::ac_power_warning();
+    }
+
+    let baseline = match &options.baseline {
+        Some(p) => Some(load_baseline(p)?),
+        None => None,
+    };
+
+    let rom_sz = cmd.get_size()?;
+    let layout_sizes = utils::get_layout_sizes(rom_sz)?;
+    let mut files = BenchFiles::new()?;
+    {
+        let mut f = File::create(&files.layout)?;
+        utils::construct_layout_file(&mut f, &layout_sizes)?;
+        f.flush()?;
+    }
+
+    info!("Stashing original image to restore after benchmarking");
+    flashrom::read(&cmd, &files.original)?;
+    files.keep = true;
+    rand_util::gen_rand_testdata(&files.random, rom_sz as usize)?;
+
+    let mut filter_names: Option<HashSet<String>> =
+        test_names.map(|names| names.map(|s| s.to_lowercase()).collect());
+
+    let mut results = Vec::new();
+    for (name, op) in BENCHMARKS {
+        if let Some(ref mut names) = filter_names {
+            if !names.remove(&name.to_lowercase()) {
+                continue;
+            }
+        }
+        info!("Benchmarking {} ({} iterations)", name, options.iterations);
+        let stats = op.measure(&cmd, &files, &layout_sizes, options.iterations);
+        if let Err(e) = &stats {
+            error!("Benchmark {} failed: {}", name, e);
+        }
+        results.push(BenchResult {
+            name: name.to_string(),
+            stats,
+            baseline: baseline
+                .as_ref()
+                .and_then(|b| b.get(*name))
+                .and_then(Stats::from_json),
+        });
+    }
+
+    for leftover in filter_names.iter().flatten() {
+        warn!("No benchmark matches filter name \"{}\"", leftover);
+    }
+
+    info!("Restoring original image");
+    flashrom::write(&cmd, &files.original)?;
+    files.keep = false;
+
+    let chip_name = flashrom::name(&cmd)
+        .map(|x| format!("vendor=\"{}\" name=\"{}\"", x.0, x.1))
+        .unwrap_or("<Unknown chip>".into());
+
+    if let Some(p) = &options.save_baseline {
+        let json = baseline_json(&chip_name, options.iterations, &results);
+        std::fs::write(p, format!("{:#}\n", json))?;
+        info!("Saved baseline to {}", p.display());
+    }
+
+    collate_bench_results(&results, &chip_name, options.tolerance, output_format);
+    Ok(results.iter().all(|r| r.passed(options.tolerance)))
+}
+
+fn collate_bench_results(
+    results: &[BenchResult],
+    chip_name: &str,
+    tolerance: f64,
+    format: OutputFormat,
+) {
+    match format {
+        OutputFormat::Pretty => {
+            println!();
+            println!("  =============================");
+            println!("  ===  BENCHMARK RESULTS  =====");
+            println!("  =============================");
+            println!();
+            println!("   chip name: {}", chip_name);
+            println!("   tolerance: {:.1}%", tolerance * 100.0);
+            println!();
+
+            for r in results {
+                let label = style!(format!(" <+> {}:", r.name), types::BOLD);
+                match (&r.stats, &r.baseline) {
+                    (Err(e), _) => println!(" {} {} ({})", label, style!("FAILED", types::RED), e),
+                    (Ok(s), baseline) => {
+                        let timing = format!(
+                            "{:.3}s ± {:.3}s (min {:.3}s, max {:.3}s)",
+                            s.mean, s.stddev, s.min, s.max
+                        );
+                        match baseline {
+                            None => println!(" {} {}", label, timing),
+                            Some(b) => println!(
+                                " {} {}, baseline {:.3}s ({:+.1}%) {}",
+                                label,
+                                timing,
+                                b.mean,
+                                (s.mean / b.mean - 1.0) * 100.0,
+                                if r.passed(tolerance) {
+                                    style!("OK", types::GREEN)
+                                } else {
+                                    style!("REGRESSED", types::RED)
+                                }
+                            ),
+                        }
+                    }
+                }
+            }
+            println!();
+        }
+        OutputFormat::Json => {
+            let mut all_pass = true;
+            let mut benchmarks = Map::<String, Value>::new();
+            for r in results {
+                let passed = r.passed(tolerance);
+                all_pass &= passed;
+
+                benchmarks.insert(
+                    r.name.clone(),
+                    json!({
+                        "pass": passed,
+                        "stats": r.stats.as_ref().map(Stats::to_json).unwrap_or(Value::Null),
+                        "baseline": r.baseline.as_ref().map(Stats::to_json).unwrap_or(Value::Null),
+                        "error": r.stats.as_ref().err(),
+                    }),
+                );
+            }
+
+            let json = json!({
+                "pass": all_pass,
+                "metadata": {
+                    "chip_name": chip_name,
+                    "tolerance": tolerance,
+                },
+                "benchmarks": benchmarks,
+            });
+            println!("{:#}", json);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn stats_from_samples() {
+        assert_eq!(Stats::from_samples(&[]), None);
+
+        let s = Stats::from_samples(&[2.0]).unwrap();
+        assert_eq!(s.mean, 2.0);
+        assert_eq!(s.stddev, 0.0);
+
+        let s = Stats::from_samples(&[1.0, 2.0, 3.0, 6.0]).unwrap();
+        assert_eq!(s.mean, 3.0);
+        assert!((s.stddev - (14.0f64 / 3.0).sqrt()).abs() < 1e-12);
+        assert_eq!(s.min, 1.0);
+        assert_eq!(s.max, 6.0);
+    }
+
+    #[test]
+    fn regression_tolerance() {
+        let base = Stats::from_samples(&[10.0]).unwrap();
+        let same = Stats::from_samples(&[10.5]).unwrap();
+        let slow = Stats::from_samples(&[12.0]).unwrap();
+
+        assert!(!same.regressed_from(&base, 0.1));
+        assert!(slow.regressed_from(&base, 0.1));
+        assert!(!slow.regressed_from(&base, 0.25));
+    }
+
+    #[test]
+    fn baseline_roundtrip() {
+        let results = [
+            BenchResult {
+                name: "Read".into(),
+                stats: Ok(Stats::from_samples(&[1.0, 3.0]).unwrap()),
+                baseline: None,
+            },
+            BenchResult {
+                name: "Erase".into(),
+                stats: Err("failed".into()),
+                baseline: None,
+            },
+        ];
+        let json = baseline_json("chip", 2, &results);
+        let parsed = parse_baseline(&json.to_string()).unwrap();
+
+        assert_eq!(parsed.len(), 1);
+        assert_eq!(
+            Stats::from_json(&parsed["Read"]),
+            results[0].stats.clone().ok()
+        );
+        assert!(parse_baseline("{}").is_err());
+    }
+}
@@ -39,6 +39,7 @@ extern crate log;
 #[macro_use]
 pub mod types;
 
+pub mod bench;
 pub mod cros_sysinfo;
 pub mod rand_util;
 pub mod tester;
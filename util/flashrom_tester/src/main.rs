@@ -40,7 +40,7 @@ mod logger;
 
 use clap::{App, Arg};
 use flashrom::FlashChip;
-use flashrom_tester::{tester, tests};
+use flashrom_tester::{bench, tester, tests};
 use std::path::PathBuf;
 
 pub mod built_info {
@@ -68,7 +68,7 @@ fn main() {
         .arg(
             Arg::with_name("ccd_target_type")
                 .required(true)
-                .possible_values(&["host", "ec", "servo"]),
+                .possible_values(&["host", "ec", "servo", "dummy"]),
         )
         .arg(
             Arg::with_name("print-layout")
@@ -99,6 +99,40 @@ fn main() {
                 .possible_values(&["pretty", "json"])
                 .default_value("pretty"),
         )
+        .arg(
+            Arg::with_name("benchmark")
+                .short("b")
+                .long("benchmark")
+                .help("Time flashrom operations instead of running the functional tests"),
+        )
+        .arg(
+            Arg::with_name("iterations")
+                .long("iterations")
+                .takes_value(true)
+                .default_value("5")
+                .help("Number of timed runs of each benchmark"),
+        )
+        .arg(
+            Arg::with_name("baseline")
+                .long("baseline")
+                .takes_value(true)
+                .requires("benchmark")
+                .help("Compare benchmark results against a baseline file (exit 2 on regression)"),
+        )
+        .arg(
+            Arg::with_name("save-baseline")
+                .long("save-baseline")
+                .takes_value(true)
+                .requires("benchmark")
+                .help("Save benchmark results as a baseline file"),
+        )
+        .arg(
+            Arg::with_name("tolerance")
+                .long("tolerance")
+                .takes_value(true)
+                .default_value("10")
+                .help("Allowed slowdown against the baseline, in percent"),
+        )
         .arg(
             Arg::with_name("test_name")
                 .multiple(true)
@@ -130,6 +164,36 @@ fn main() {
         .expect("output-format is not a parseable OutputFormat");
     let test_names = matches.values_of("test_name");
 
+    if matches.is_present("benchmark") {
+        let options = bench::BenchOptions {
+            iterations: matches
+                .value_of("iterations")
+                .expect("iterations should have a default value")
+                .parse::<usize>()
+                .unwrap_or_else(|e| clap_error(&format!("Invalid --iterations: {}", e))),
+            baseline: matches.value_of_os("baseline").map(PathBuf::from),
+            save_baseline: matches.value_of_os("save-baseline").map(PathBuf::from),
+            tolerance: matches
+                .value_of("tolerance")
+                .expect("tolerance should have a default value")
+                .parse::<f64>()
+                .unwrap_or_else(|e| clap_error(&format!("Invalid --tolerance: {}", e)))
+                / 100.0,
+        };
+        match bench::run(flashrom_path, ccd_type, &options, output_format, test_names) {
+            Ok(true) => {}
+            Ok(false) => {
+                eprintln!("Benchmarks failed or regressed");
+                std::process::exit(2);
+            }
+            Err(e) => {
+                eprintln!("Failed to run benchmarks: {:?}", e);
+                std::process::exit(1);
+            }
+        }
+        return;
+    }
+
     if let Err(e) = tests::generic(
         flashrom_path,
         ccd_type,
@@ -141,3 +205,7 @@ fn main() {
         std::process::exit(1);
     }
 }
+
+fn clap_error(msg: &str) -> ! {
+    clap::Error::with_description(msg, clap::ErrorKind::InvalidValue).exit()
+}
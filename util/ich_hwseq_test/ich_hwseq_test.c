@@ -0,0 +1,371 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Runs the hardware sequencing erase of ichspi.c against a simulated SPIBAR
+ * register file. The mmio accessors below replace the ones from hwaccess.c:
+ * setting HSFC.FGO records the cycle from FADDR and HSFC.FCYCLE and completes
+ * it with HSFS.FDONE (or HSFS.FCERR when a failure was requested). The other
+ * programmer functions ichspi.c calls are stubs.
+ *
+ *   ich_hwseq_test [-v]
+ *
+ * The register layout is taken from the datasheets on purpose rather than from
+ * ichspi.c, so a wrong offset or field there shows up as a failure.
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flash.h"
+#include "chipdrivers.h"
+#include "programmer.h"
+#include "ich_descriptors.h"
+
+#define HSFS		0x04
+#define  HSFS_FDONE	(1 << 0)
+#define  HSFS_FCERR	(1 << 1)
+#define  HSFS_AEL	(1 << 2)
+#define  HSFS_BERASE(x)	((x) << 3)	/* ICH9 to 9 series: 1 = 4 KB, 3 = 64 KB */
+#define  HSFS_FDV	(1 << 14)
+#define HSFC		0x06
+#define  HSFC_FGO	(1 << 0)
+#define FADDR		0x08
+
+#define CYCLE_BERASE_4K		3	/* 4 KB on 100 series and newer, BERASE sized before */
+#define CYCLE_BERASE_64K	4	/* 100 series and newer only */
+
+#define CHIP_SIZE	(8 * 1024 * 1024)
+
+static bool verbose = false;
+static int failures = 0;
+
+static uint8_t spibar[0x200];
+static uint32_t fcycle_mask;	/* HSFC.FCYCLE, 2 bits before the 100 series and 4 bits after */
+static uint32_t fla_mask;	/* FADDR.FLA */
+static bool fail_next_cycle;
+
+static struct cycle {
+	uint32_t addr;
+	unsigned int fcycle;
+} cycles[8];
+static unsigned int num_cycles;
+
+static const struct opaque_master *opaque_master;
+
+#define CHECK(cond) do {								\
+	if (!(cond)) {									\
+		fprintf(stderr, "FAIL: %s:%d: %s\n", __FILE__, __LINE__, #cond);	\
+		failures++;								\
+	}										\
+} while (0)
+
+static uint32_t reg_read(unsigned int off, unsigned int size)
+{
+	uint32_t val = 0;
+	unsigned int i;
+
+	for (i = 0; i < size; i++)
+		val |= (uint32_t)spibar[off + i] << (8 * i);
+	return val;
+}
+
+static void reg_set(unsigned int off, uint32_t val, unsigned int size)
+{
+	unsigned int i;
+
+	for (i = 0; i < size; i++)
+		spibar[off + i] = val >> (8 * i);
+}
+
+static void run_cycle(void)
+{
+	const uint16_t hsfc = reg_read(HSFC, 2);
+
+	if (num_cycles < ARRAY_SIZE(cycles)) {
+		cycles[num_cycles].addr = reg_read(FADDR, 4) & fla_mask;
+		cycles[num_cycles].fcycle = (hsfc & fcycle_mask) >> 1;
+	}
+	num_cycles++;
+	reg_set(HSFC, hsfc & ~HSFC_FGO, 2);
+	spibar[HSFS] |= fail_next_cycle ? HSFS_FCERR : HSFS_FDONE;
+	fail_next_cycle = false;
+}
+
+/* FDONE, FCERR and AEL are write 1 to clear, the upper half of HSFS is read-only. */
+static void reg_write(void *addr, uint32_t val, unsigned int size)
+{
+	const unsigned int off = (uint8_t *)addr - spibar;
+	unsigned int i;
+
+	if (off + size > sizeof(spibar)) {
+		fprintf(stderr, "FAIL: write to 0x%x outside of SPIBAR\n", off);
+		exit(1);
+	}
+	for (i = 0; i < size; i++) {
+		const uint8_t b = val >> (8 * i);
+
+		if (off + i == HSFS)
+			spibar[HSFS] &= ~(b & (HSFS_FDONE | HSFS_FCERR | HSFS_AEL));
+		else if (off + i != HSFS + 1)
+			spibar[off + i] = b;
+	}
+	if (off <= HSFC && off + size > HSFC && (reg_read(HSFC, 2) & HSFC_FGO))
+		run_cycle();
+}
+
+void mmio_writeb(uint8_t val, void *addr)
+{
+	reg_write(addr, val, 1);
+}
+
+void mmio_writew(uint16_t val, void *addr)
+{
+	reg_write(addr, val, 2);
+}
+
+void mmio_writel(uint32_t val, void *addr)
+{
+	reg_write(addr, val, 4);
+}
+
+uint8_t mmio_readb(const void *addr)
+{
+	return reg_read((const uint8_t *)addr - spibar, 1);
+}
+
+uint16_t mmio_readw(const void *addr)
+{
+	return reg_read((const uint8_t *)addr - spibar, 2);
+}
+
+uint32_t mmio_readl(const void *addr)
+{
+	return reg_read((const uint8_t *)addr - spibar, 4);
+}
+
+void rmmio_writel(uint32_t val, void *addr)
+{
+	mmio_writel(val, addr);
+}
+
+void rmmio_valw(void *addr)
+{
+}
+
+void rmmio_vall(void *addr)
+{
+}
+
+void *rphysmap(const char *descr, uintptr_t phys_addr, size_t len)
+{
+	return NULL;
+}
+
+enum chipbustype internal_buses_supported = BUS_NONE;
+
+static const char *ich_spi_mode;
+
+char *extract_programmer_param(const char *param_name)
+{
+	if (!strcmp(param_name, "ich_spi_mode") && ich_spi_mode)
+		return strdup(ich_spi_mode);
+	return NULL;
+}
+
+int print(enum flashrom_log_level level, const char *fmt, ...)
+{
+	va_list ap;
+	int ret = 0;
+
+	if (verbose) {
+		va_start(ap, fmt);
+		ret = vfprintf(stderr, fmt, ap);
+		va_end(ap);
+	}
+	return ret;
+}
+
+void programmer_delay(unsigned int usecs)
+{
+}
+
+int register_opaque_master(const struct opaque_master *mst)
+{
+	opaque_master = mst;
+	return 0;
+}
+
+int register_spi_master(const struct spi_master *mst)
+{
+	return 0;
+}
+
+int default_spi_read(struct flashctx *flash, uint8_t *buf, unsigned int start, unsigned int len)
+{
+	return 1;
+}
+
+int default_spi_write_256(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len)
+{
+	return 1;
+}
+
+int default_spi_write_aai(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len)
+{
+	return 1;
+}
+
+int spi_aai_write(struct flashctx *flash, const uint8_t *buf, unsigned int start, unsigned int len)
+{
+	return 1;
+}
+
+erasefunc_t *spi_get_erasefn_from_opcode(uint8_t opcode)
+{
+	return NULL;
+}
+
+/* A single 8 MB component, the descriptor itself isn't needed. */
+int read_ich_descriptors_via_fdo(enum ich_chipset cs, void *bar, struct ich_descriptors *desc)
+{
+	return ICH_RET_ERR;
+}
+
+int getFCBA_component_density(enum ich_chipset cs, const struct ich_descriptors *desc, uint8_t idx)
+{
+	return idx ? 0 : CHIP_SIZE;
+}
+
+void prettyprint_ich_descriptors(enum ich_chipset cs, const struct ich_descriptors *desc)
+{
+}
+
+void prettyprint_ich_reg_vscc(uint32_t reg_val, int verbosity, bool print_vcl)
+{
+}
+
+/* Initializes ichspi.c for gen with the given HSFS and probes through its opaque master. */
+static int init(enum ich_chipset gen, const char *mode, uint16_t hsfs, struct flashctx *flash)
+{
+	const bool pch100 = gen >= CHIPSET_100_SERIES_SUNRISE_POINT;
+
+	memset(spibar, 0, sizeof(spibar));
+	reg_set(HSFS, hsfs, 2);
+	fcycle_mask = pch100 ? 0xf << 1 : 0x3 << 1;
+	fla_mask = pch100 ? 0x07ffffff : 0x01ffffff;
+	num_cycles = 0;
+	opaque_master = NULL;
+	ich_spi_mode = mode;
+
+	memset(flash->chip, 0, sizeof(*flash->chip));
+	if (ich_init_spi(spibar, gen) || !opaque_master) {
+		fprintf(stderr, "FAIL: hardware sequencing not registered for chipset %d\n", gen);
+		failures++;
+		return 1;
+	}
+	if (opaque_master->probe(flash) != 1) {
+		fprintf(stderr, "FAIL: probing chipset %d\n", gen);
+		failures++;
+		return 1;
+	}
+	return 0;
+}
+
+static bool erase_cycle(unsigned int i, uint32_t addr, unsigned int fcycle)
+{
+	return i < num_cycles && cycles[i].addr == addr && cycles[i].fcycle == fcycle;
+}
+
+static void test_pch100(void)
+{
+	struct flashchip chip;
+	struct flashctx flash = { .chip = &chip };
+	const struct block_eraser *const e = chip.block_erasers;
+
+	if (init(CHIPSET_100_SERIES_SUNRISE_POINT, NULL, HSFS_FDV, &flash))
+		return;
+
+	CHECK(chip.total_size == CHIP_SIZE / 1024);
+	CHECK(e[0].eraseblocks[0].size == 4 * 1024 && e[0].eraseblocks[0].count == CHIP_SIZE / (4 * 1024));
+	CHECK(e[0].eraseblocks[1].size == 0);
+	CHECK(e[1].eraseblocks[0].size == 64 * 1024 && e[1].eraseblocks[0].count == CHIP_SIZE / (64 * 1024));
+	CHECK(e[1].block_erase && e[1].block_erase != opaque_master->erase);
+	if (!e[1].block_erase)
+		return;
+
+	/* A stale read cycle in HSFC and the bits above FLA in FADDR. */
+	reg_set(HSFC, 0xf << 1, 2);
+	reg_set(FADDR, 0xf8000000, 4);
+	CHECK(opaque_master->erase(&flash, 0x1000, 4 * 1024) == 0);
+	CHECK(num_cycles == 1 && erase_cycle(0, 0x1000, CYCLE_BERASE_4K));
+	CHECK((reg_read(FADDR, 4) & ~fla_mask) == 0xf8000000);
+
+	CHECK(e[1].block_erase(&flash, 0x7f0000, 64 * 1024) == 0);
+	CHECK(num_cycles == 2 && erase_cycle(1, 0x7f0000, CYCLE_BERASE_64K));
+	CHECK(!(reg_read(HSFS, 2) & (HSFS_FDONE | HSFS_FCERR)));
+
+	/* Mismatched sizes, unaligned and out of range requests never start a cycle. */
+	CHECK(opaque_master->erase(&flash, 0x10000, 64 * 1024) != 0);
+	CHECK(e[1].block_erase(&flash, 0x10000, 4 * 1024) != 0);
+	CHECK(e[1].block_erase(&flash, 0x1000, 64 * 1024) != 0);
+	CHECK(e[1].block_erase(&flash, CHIP_SIZE, 64 * 1024) != 0);
+	CHECK(opaque_master->erase(&flash, CHIP_SIZE, 4 * 1024) != 0);
+	CHECK(num_cycles == 2);
+
+	fail_next_cycle = true;
+	CHECK(e[1].block_erase(&flash, 0x20000, 64 * 1024) != 0);
+	CHECK(num_cycles == 3 && erase_cycle(2, 0x20000, CYCLE_BERASE_64K));
+	CHECK(!(reg_read(HSFS, 2) & HSFS_FCERR));
+}
+
+/* Before the 100 series HSFS.BERASE gives the only erase size, there's no 64 KB cycle. */
+static void test_ich9(void)
+{
+	struct flashchip chip;
+	struct flashctx flash = { .chip = &chip };
+	const struct block_eraser *const e = chip.block_erasers;
+
+	if (init(CHIPSET_ICH9, "hwseq", HSFS_FDV | HSFS_BERASE(1), &flash))
+		return;
+	CHECK(e[0].eraseblocks[0].size == 4 * 1024 && e[0].eraseblocks[0].count == CHIP_SIZE / (4 * 1024));
+	CHECK(e[1].block_erase == NULL && e[1].eraseblocks[0].size == 0);
+	CHECK(opaque_master->erase(&flash, 0x3000, 4 * 1024) == 0);
+	CHECK(num_cycles == 1 && erase_cycle(0, 0x3000, CYCLE_BERASE_4K));
+
+	if (init(CHIPSET_ICH9, "hwseq", HSFS_FDV | HSFS_BERASE(3), &flash))
+		return;
+	CHECK(e[0].eraseblocks[0].size == 64 * 1024 && e[0].eraseblocks[0].count == CHIP_SIZE / (64 * 1024));
+	CHECK(e[1].block_erase == NULL);
+	CHECK(opaque_master->erase(&flash, 0x3000, 4 * 1024) != 0);
+	CHECK(opaque_master->erase(&flash, 0x30000, 64 * 1024) == 0);
+	CHECK(num_cycles == 1 && erase_cycle(0, 0x30000, CYCLE_BERASE_4K));
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], "-v"))
+		verbose = true;
+
+	test_pch100();
+	test_ich9();
+
+	if (failures) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	printf("PASS: hardware sequencing erase\n");
+	return 0;
+}
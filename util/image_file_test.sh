@@ -0,0 +1,74 @@
+#!/bin/sh
+#
+# This file is part of the flashrom project.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; version 2 of the License.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# Checks image file handling against the dummy programmer:
+#
+#   image_file_test.sh <flashrom> [suffix...]
+#
+# Every suffix (.gz, .xz, .zst) is round tripped: -r into a compressed file,
+# -v against it and -w it into an erased chip. Chip-sized raw images starting
+# with each compression magic must be written as they are.
+
+if [ $# -lt 1 ]; then
+	echo "usage: $0 <flashrom> [suffix...]" >&2
+	exit 2
+fi
+
+FLASHROM=$1
+shift
+SIZE=131072
+
+TMPDIR=$(mktemp -d -t flashrom_image_file.XXXXXXXXXX) || exit 1
+trap 'rm -rf "$TMPDIR"' EXIT
+
+# $1 is the chip image, the rest are flashrom arguments.
+run_flashrom() {
+	chip=$1
+	shift
+	"$FLASHROM" -p "dummy:emulate=M25P10.RES,image=$chip" "$@" >"$TMPDIR/log" 2>&1
+	ret=$?
+	if [ $ret -ne 0 ]; then
+		cat "$TMPDIR/log"
+		echo "FAIL: flashrom $* returned $ret" >&2
+		exit 1
+	fi
+}
+
+expect_same() {
+	if ! cmp -s "$1" "$2"; then
+		echo "FAIL: $3" >&2
+		exit 1
+	fi
+}
+
+# Same data on every run, compressible but not trivially so.
+awk 'BEGIN { x = 1; while (n < 131072) { x = (x * 1103515245 + 12345) % 2147483648;
+	s = sprintf("%08x\n", x); printf "%s", s; n += length(s) } }' | head -c $SIZE >"$TMPDIR/pattern.bin"
+run_flashrom "$TMPDIR/chip.bin" -w "$TMPDIR/pattern.bin"
+
+for suffix in "$@"; do
+	run_flashrom "$TMPDIR/chip.bin" -r "$TMPDIR/image$suffix"
+	run_flashrom "$TMPDIR/chip.bin" -v "$TMPDIR/image$suffix"
+	rm -f "$TMPDIR/erased.bin"
+	run_flashrom "$TMPDIR/erased.bin" -w "$TMPDIR/image$suffix"
+	expect_same "$TMPDIR/erased.bin" "$TMPDIR/pattern.bin" "$suffix round trip differs"
+	echo "PASS: $suffix round trip"
+done
+
+for magic in '\037\213' '\375\067\172\130\132\000' '\050\265\057\375'; do
+	{ printf "$magic"; cat "$TMPDIR/pattern.bin"; } | head -c $SIZE >"$TMPDIR/raw.bin"
+	rm -f "$TMPDIR/erased.bin"
+	run_flashrom "$TMPDIR/erased.bin" -w "$TMPDIR/raw.bin"
+	expect_same "$TMPDIR/erased.bin" "$TMPDIR/raw.bin" "raw image starting with $magic differs"
+done
+echo "PASS: raw images with compression magic"
@@ -0,0 +1,80 @@
+#!/bin/sh
+#
+# This file is part of the flashrom project.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; version 2 of the License.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# Checks probing, writing and erasing the parallel flash chips of the dummy
+# programmer, which are driven through CFI and the write buffer:
+#
+#   parallel_flash_test.sh <flashrom>
+
+if [ $# -ne 1 ]; then
+	echo "usage: $0 <flashrom>" >&2
+	exit 2
+fi
+
+FLASHROM=$1
+
+TMPDIR=$(mktemp -d -t flashrom_parallel.XXXXXXXXXX) || exit 1
+trap 'rm -rf "$TMPDIR"' EXIT
+
+fail() {
+	cat "$TMPDIR/log"
+	echo "FAIL: $1" >&2
+	exit 1
+}
+
+run_flashrom() {
+	"$FLASHROM" "$@" >"$TMPDIR/log" 2>&1 || fail "flashrom $* returned $?"
+}
+
+# $1 is the size, the chip is erased.
+erased() {
+	head -c "$1" /dev/zero | tr '\000' '\377'
+}
+
+# Writes the data for seed $2 at both ends of an erased image of size $1. Only
+# these get programmed, erased write buffers are skipped, which keeps the test
+# fast since the dummy programmer sleeps for the typical program times.
+image() {
+	erased "$1" >"$TMPDIR/image.bin"
+	awk -v x="$2" 'BEGIN { while (n < 65536) { x = (x * 1103515245 + 12345) % 2147483648;
+		s = sprintf("%08x\n", x); printf "%s", s; n += length(s) } }' | head -c 65536 >"$TMPDIR/data.bin"
+	dd if="$TMPDIR/data.bin" of="$TMPDIR/image.bin" conv=notrunc 2>/dev/null
+	dd if="$TMPDIR/data.bin" of="$TMPDIR/image.bin" bs=1 count=4099 seek=$(($1 - 4099)) conv=notrunc 2>/dev/null
+}
+
+# $1 is the emulated chip, $2 its size and $3 the name it is found as.
+check_chip() {
+	rm -f "$TMPDIR/chip.bin"
+	dummy="dummy:emulate=$1,image=$TMPDIR/chip.bin"
+
+	run_flashrom -p "$dummy"
+	grep -q "Found .* \"$3\" ($(($2 / 1024)) kB, Parallel)" "$TMPDIR/log" || fail "$1 not found as $3"
+
+	image "$2" 1
+	run_flashrom -p "$dummy" -w "$TMPDIR/image.bin"
+	cmp -s "$TMPDIR/chip.bin" "$TMPDIR/image.bin" || fail "$1 contents differ after writing"
+	run_flashrom -p "$dummy" -v "$TMPDIR/image.bin"
+
+	image "$2" 2
+	run_flashrom -p "$dummy" -w "$TMPDIR/image.bin"
+	cmp -s "$TMPDIR/chip.bin" "$TMPDIR/image.bin" || fail "$1 contents differ after rewriting"
+
+	run_flashrom -p "$dummy" -E
+	erased "$2" >"$TMPDIR/erased.bin"
+	cmp -s "$TMPDIR/chip.bin" "$TMPDIR/erased.bin" || fail "$1 not erased"
+	echo "PASS: $1"
+}
+
+check_chip S29GL032N 4194304 "CFI-capable chip"
+check_chip 28F320J3 4194304 "CFI-capable chip"
+check_chip MX29GL640EH/L 8388608 "MX29GL640EH/L"
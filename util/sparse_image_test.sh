@@ -0,0 +1,187 @@
+#!/bin/sh
+#
+# This file is part of the flashrom project.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; version 2 of the License.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# Checks writing Intel HEX and Motorola S-record files against the dummy
+# programmer:
+#
+#   sparse_image_test.sh <flashrom>
+
+if [ $# -ne 1 ]; then
+	echo "usage: $0 <flashrom>" >&2
+	exit 2
+fi
+
+FLASHROM=$1
+# 4 KiB sectors, so records can share an erase block.
+CHIP=SST25VF032B
+SIZE=4194304
+
+TMPDIR=$(mktemp -d -t flashrom_sparse.XXXXXXXXXX) || exit 1
+trap 'rm -rf "$TMPDIR"' EXIT
+DUMMY="dummy:emulate=$CHIP,image=$TMPDIR/chip.bin"
+
+fail() {
+	cat "$TMPDIR/log"
+	echo "FAIL: $1" >&2
+	exit 1
+}
+
+# Expects success unless the first argument is "!".
+run_flashrom() {
+	expect=0
+	if [ "$1" = "!" ]; then
+		expect=1
+		shift
+	fi
+	"$FLASHROM" "$@" >"$TMPDIR/log" 2>&1
+	ret=$?
+	if [ $expect -eq 0 ] && [ $ret -ne 0 ]; then
+		fail "flashrom $* returned $ret"
+	elif [ $expect -ne 0 ] && [ $ret -eq 0 ]; then
+		fail "flashrom $* succeeded"
+	fi
+}
+
+tohex() {
+	printf '%s' "$1" | od -An -tx1 | tr -d ' \n'
+}
+
+# Intel HEX record: type, 16 bit address and data in hex.
+ihex() {
+	awk -v t="$1" -v a="$2" -v d="$3" 'function hv(c) { return index("0123456789abcdef", tolower(c)) - 1 }
+	BEGIN { n = length(d) / 2; sum = n + int(a / 256) + a % 256 + t
+		out = sprintf(":%02X%04X%02X", n, a, t)
+		for (i = 1; i <= n; i++) {
+			b = hv(substr(d, 2 * i - 1, 1)) * 16 + hv(substr(d, 2 * i, 1)); sum += b
+			out = out sprintf("%02X", b)
+		}
+		printf "%s%02X\n", out, (256 - sum % 256) % 256 }'
+}
+
+# S-record: type digit, address and data in hex.
+srec() {
+	awk -v t="$1" -v a="$2" -v d="$3" 'function hv(c) { return index("0123456789abcdef", tolower(c)) - 1 }
+	BEGIN { al = (t == 0 || t == 1 || t == 5 || t == 9) ? 2 : (t == 2 || t == 8) ? 3 : 4
+		n = length(d) / 2; sum = al + n + 1
+		out = sprintf("S%d%02X", t, al + n + 1)
+		for (i = al - 1; i >= 0; i--) {
+			b = int(a / 256 ^ i) % 256; sum += b
+			out = out sprintf("%02X", b)
+		}
+		for (i = 1; i <= n; i++) {
+			b = hv(substr(d, 2 * i - 1, 1)) * 16 + hv(substr(d, 2 * i, 1)); sum += b
+			out = out sprintf("%02X", b)
+		}
+		printf "%s%02X\n", out, 255 - sum % 256 }'
+}
+
+# Puts text at offset into the expected image.
+expect_data() {
+	printf '%s' "$2" | dd of="$TMPDIR/expected.bin" bs=1 seek="$1" conv=notrunc 2>/dev/null
+}
+
+# Writes the sparse image $1 into a chip holding the pattern and compares with expected.bin.
+# The remaining arguments are erase blocks that must be processed exactly once.
+check_write() {
+	cp "$TMPDIR/pattern.bin" "$TMPDIR/chip.bin"
+	image=$1
+	shift
+	run_flashrom -p "$DUMMY" -V -w "$image"
+	cmp -s "$TMPDIR/chip.bin" "$TMPDIR/expected.bin" || fail "chip contents differ after writing $image"
+	for block in "$@"; do
+		[ "$(grep -o "$block:" "$TMPDIR/log" | wc -l)" -eq 1 ] || fail "$block not written exactly once"
+	done
+	run_flashrom -p "$DUMMY" -v "$image"
+}
+
+awk 'BEGIN { x = 1; while (n < '$SIZE') { x = (x * 1103515245 + 12345) % 2147483648;
+	s = sprintf("%08x\n", x); printf "%s", s; n += length(s) } }' | head -c $SIZE >"$TMPDIR/pattern.bin"
+
+# Intel HEX: gaps within one sector, extended segment and extended linear addresses.
+cp "$TMPDIR/pattern.bin" "$TMPDIR/expected.bin"
+{
+	ihex 0 $((0x1010)) "$(tohex first)"
+	ihex 0 $((0x1200)) "$(tohex second)"
+	ihex 0 $((0x1f00)) "$(tohex third)"
+	ihex 2 0 1000			# segment base 0x10000
+	ihex 0 $((0x0100)) "$(tohex segment)"
+	ihex 4 0 0030			# linear base 0x300000
+	ihex 0 $((0xfffc)) "$(tohex linear)"
+	ihex 5 0 00000000		# start linear address, ignored
+	ihex 1 0 ""
+} >"$TMPDIR/image.hex"
+expect_data $((0x1010)) first
+expect_data $((0x1200)) second
+expect_data $((0x1f00)) third
+expect_data $((0x10100)) segment
+expect_data $((0x30fffc)) linear
+check_write "$TMPDIR/image.hex" 0x001000-0x001fff
+echo "PASS: Intel HEX"
+
+# S-records: all three address sizes, gaps within one sector.
+cp "$TMPDIR/pattern.bin" "$TMPDIR/expected.bin"
+{
+	srec 0 0 "$(tohex header)"
+	srec 1 $((0x2010)) "$(tohex s1-a)"
+	srec 1 $((0x2800)) "$(tohex s1-b)"
+	srec 2 $((0x123456)) "$(tohex s2)"
+	srec 3 $((0x3ffff0)) "$(tohex s3)"
+	srec 5 3 ""
+	srec 7 0 ""
+} >"$TMPDIR/image.srec"
+expect_data $((0x2010)) s1-a
+expect_data $((0x2800)) s1-b
+expect_data $((0x123456)) s2
+expect_data $((0x3ffff0)) s3
+check_write "$TMPDIR/image.srec" 0x002000-0x002fff
+echo "PASS: S-record"
+
+# More extents than layout regions, one per sector.
+cp "$TMPDIR/pattern.bin" "$TMPDIR/expected.bin"
+i=0
+{
+	while [ $i -lt 200 ]; do
+		srec 3 $((i * 16384 + 100)) "$(tohex "extent$i")"
+		i=$((i + 1))
+	done
+	srec 7 0 ""
+} >"$TMPDIR/many.srec"
+i=0
+while [ $i -lt 200 ]; do
+	expect_data $((i * 16384 + 100)) "extent$i"
+	i=$((i + 1))
+done
+check_write "$TMPDIR/many.srec"
+echo "PASS: 200 extents"
+
+# Broken files must be rejected before anything is written.
+bad() {
+	cp "$TMPDIR/pattern.bin" "$TMPDIR/chip.bin"
+	run_flashrom ! -p "$DUMMY" -w "$TMPDIR/bad"
+	grep -q "$1" "$TMPDIR/log" || fail "expected \"$1\""
+	cmp -s "$TMPDIR/chip.bin" "$TMPDIR/pattern.bin" || fail "chip changed by a rejected image"
+}
+
+{ ihex 0 16 "$(tohex data)"; ihex 0 32 "$(tohex more)" | sed 's/..$/00/'; ihex 1 0 ""; } >"$TMPDIR/bad"
+bad "Invalid record in line 2"
+{ srec 0 0 ""; srec 1 16 "$(tohex data)" | sed 's/..$/00/'; srec 9 0 ""; } >"$TMPDIR/bad"
+bad "Invalid record in line 2"
+{ srec 1 16 "$(tohex data)"; srec 1 18 "$(tohex overlap)"; srec 9 0 ""; } >"$TMPDIR/bad"
+bad "overlaps earlier data"
+{ ihex 4 0 0040; ihex 0 0 "$(tohex beyond)"; ihex 1 0 ""; } >"$TMPDIR/bad"
+bad "beyond the flash chip's size"
+{ ihex 0 16 "$(tohex data)"; } >"$TMPDIR/bad"
+bad "without an end record"
+{ ihex 1 0 ""; } >"$TMPDIR/bad"
+bad "contains no data"
+echo "PASS: broken images rejected"
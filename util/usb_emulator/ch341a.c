@@ -0,0 +1,158 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * WCH CH341A in its stream mode, as driven by ch341a_spi.c. Every 32-byte
+ * OUT packet carries one stream command. UIO streams toggle CS, SPI streams
+ * return one IN packet with a byte for every byte shifted out.
+ */
+
+#include <string.h>
+#include <libusb.h>
+#include "usb_emulator.h"
+
+#define WRITE_EP		0x02
+#define READ_EP			0x82
+#define PACKET_LENGTH		0x20
+
+#define CMD_SPI_STREAM		0xa8
+#define CMD_UIO_STREAM		0xab
+
+#define UIO_STM_IN		0x00
+#define UIO_STM_DIR		0x40
+#define UIO_STM_OUT		0x80
+#define UIO_STM_US		0xc0
+#define UIO_STM_END		0x20
+
+/* IN packets waiting for the host, enough for the largest transfer of the driver. */
+#define IN_QUEUE_LEN		512
+
+struct in_packet {
+	uint8_t data[PACKET_LENGTH];
+	int len;
+	int pos;
+};
+
+static struct in_packet in_queue[IN_QUEUE_LEN];
+static unsigned int in_head, in_count;
+
+/* The CH341A shifts the LSB first. */
+static uint8_t reverse_byte(uint8_t x)
+{
+	x = (x >> 4) | (x << 4);
+	x = ((x & 0xcc) >> 2) | ((x & 0x33) << 2);
+	x = ((x & 0xaa) >> 1) | ((x & 0x55) << 1);
+	return x;
+}
+
+static int ch341a_init(void)
+{
+	in_head = in_count = 0;
+	return 0;
+}
+
+static void uio_stream(const uint8_t *p, int len)
+{
+	int i;
+
+	for (i = 0; i < len && p[i] != UIO_STM_END; i++) {
+		switch (p[i] & 0xc0) {
+		case UIO_STM_OUT:
+			/* D0 is CS#. */
+			emu_flash_select(!(p[i] & 0x01));
+			break;
+		case UIO_STM_DIR:
+			if (!(p[i] & 0x3f))
+				emu_flash_select(false);
+			break;
+		default:
+			/* Delays are instant, pin reads aren't used. */
+			break;
+		}
+	}
+}
+
+static int spi_stream(const uint8_t *p, int len)
+{
+	struct in_packet *pkt;
+	int i;
+
+	if (!len)
+		return 0;
+	if (in_count == IN_QUEUE_LEN)
+		return -1;
+	pkt = &in_queue[(in_head + in_count++) % IN_QUEUE_LEN];
+	for (i = 0; i < len; i++)
+		pkt->data[i] = reverse_byte(emu_flash_xfer(reverse_byte(p[i])));
+	pkt->len = len;
+	pkt->pos = 0;
+	return 0;
+}
+
+static int ch341a_bulk_out(uint8_t endpoint, const uint8_t *data, int length)
+{
+	int done, n;
+
+	if (endpoint != WRITE_EP)
+		return LIBUSB_ERROR_PIPE;
+	for (done = 0; done < length; done += n) {
+		n = length - done < PACKET_LENGTH ? length - done : PACKET_LENGTH;
+		switch (data[done]) {
+		case CMD_UIO_STREAM:
+			uio_stream(data + done + 1, n - 1);
+			break;
+		case CMD_SPI_STREAM:
+			if (spi_stream(data + done + 1, n - 1))
+				return LIBUSB_ERROR_OVERFLOW;
+			break;
+		default:
+			/* The I2C stream only configures the clock. */
+			break;
+		}
+	}
+	return length;
+}
+
+/* Every IN transfer ends with the short packet of one SPI stream. */
+static int ch341a_bulk_in(uint8_t endpoint, uint8_t *data, int length)
+{
+	struct in_packet *pkt;
+	int n;
+
+	if (endpoint != READ_EP)
+		return LIBUSB_ERROR_PIPE;
+	if (!in_count)
+		return 0;
+	pkt = &in_queue[in_head];
+	n = pkt->len - pkt->pos < length ? pkt->len - pkt->pos : length;
+	memcpy(data, pkt->data + pkt->pos, n);
+	pkt->pos += n;
+	if (pkt->pos == pkt->len) {
+		in_head = (in_head + 1) % IN_QUEUE_LEN;
+		in_count--;
+	}
+	return n;
+}
+
+const struct usb_emu_model usb_emu_ch341a = {
+	.name		= "ch341a",
+	.vendor_id	= 0x1a86,
+	.product_id	= 0x5512,
+	.bcd_device	= 0x0304,
+	.product	= "USB UART-LPT",
+	.endpoints	= { WRITE_EP, READ_EP },
+	.max_packet_size = PACKET_LENGTH,
+	.init		= ch341a_init,
+	.bulk_out	= ch341a_bulk_out,
+	.bulk_in	= ch341a_bulk_in,
+};
@@ -0,0 +1,326 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Dediprog SF100/SF600 as driven by dediprog.c. Plain SPI commands are
+ * vendor control transfers, bulk reads and writes are set up by a control
+ * transfer and then move 512 bytes per bulk transfer. The firmware version
+ * selects the command packet layout like in the driver:
+ *
+ *   device=SF100|SF600 (default SF600), fw=<major>.<minor>.<patch> (default 7.2.21)
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <libusb.h>
+#include "usb_emulator.h"
+
+#define REQTYPE_OTHER_IN	0xc3
+#define REQTYPE_EP_OUT		0x42
+#define REQTYPE_EP_IN		0xc2
+
+#define CMD_TRANSCEIVE		0x01
+#define CMD_READ_PROG_INFO	0x08
+#define CMD_SET_VOLTAGE		0x0b
+#define CMD_READ_ID		0x07	/* with REQTYPE_OTHER_IN */
+#define CMD_READ		0x20
+#define CMD_WRITE		0x30
+
+#define READ_MODE_STD			1
+#define READ_MODE_FAST			2
+#define READ_MODE_4B_ADDR_FAST		4
+#define READ_MODE_4B_ADDR_FAST_0x0C	5
+
+#define WRITE_MODE_PAGE_PGM			1
+#define WRITE_MODE_4B_ADDR_256B_PAGE_PGM	9
+#define WRITE_MODE_4B_ADDR_256B_PAGE_PGM_0x12	11
+
+#define BULK_CHUNK		512
+#define PAGE_SIZE		256
+
+#define FIRMWARE_VERSION(x, y, z) ((x) << 16 | (y) << 8 | (z))
+
+enum protocol {
+	PROTOCOL_V1,
+	PROTOCOL_V2,
+	PROTOCOL_V3,
+};
+
+static bool sf600;
+static int firmware;
+static enum protocol protocol;
+static uint8_t out_ep, in_ep;
+
+/* Bulk operation set up by CMD_READ or CMD_WRITE. */
+static uint8_t bulk_cmd;
+static uint8_t bulk_mode;
+static unsigned int bulk_count;
+static unsigned int bulk_addr;
+
+/* Same thresholds as protocol() in the driver. */
+static enum protocol firmware_protocol(void)
+{
+	if (sf600) {
+		if (firmware < FIRMWARE_VERSION(6, 9, 0))
+			return PROTOCOL_V1;
+		return firmware <= FIRMWARE_VERSION(7, 2, 21) ? PROTOCOL_V2 : PROTOCOL_V3;
+	}
+	return firmware < FIRMWARE_VERSION(5, 5, 0) ? PROTOCOL_V1 : PROTOCOL_V2;
+}
+
+static int dediprog_init(void)
+{
+	const char *device = usb_emu_option("device");
+	const char *fw = usb_emu_option("fw");
+	int major = 7, minor = 2, patch = 21;
+
+	sf600 = !device || !strcmp(device, "SF600");
+	if (!sf600 && strcmp(device, "SF100")) {
+		fprintf(stderr, "usb_emulator: unknown Dediprog device %s\n", device);
+		return 1;
+	}
+	if (fw && sscanf(fw, "%d.%d.%d", &major, &minor, &patch) != 3) {
+		fprintf(stderr, "usb_emulator: can't parse firmware version %s\n", fw);
+		return 1;
+	}
+	firmware = FIRMWARE_VERSION(major, minor, patch);
+	protocol = firmware_protocol();
+	/* SF100 uses endpoint 2 in both directions. */
+	out_ep = sf600 ? 0x01 : 0x02;
+	in_ep = 0x82;
+	bulk_count = 0;
+	return 0;
+}
+
+static void spi_command(const uint8_t *cmd, unsigned int len)
+{
+	unsigned int i;
+
+	emu_flash_select(true);
+	for (i = 0; i < len; i++)
+		emu_flash_xfer(cmd[i]);
+}
+
+static void spi_address(unsigned int addr, bool addr_4ba)
+{
+	if (addr_4ba)
+		emu_flash_xfer(addr >> 24);
+	emu_flash_xfer(addr >> 16);
+	emu_flash_xfer(addr >> 8);
+	emu_flash_xfer(addr);
+}
+
+/* Sets up a bulk transfer from the command packet, see prepare_rw_cmd() in the driver. */
+static int bulk_setup(uint8_t cmd, uint16_t value, uint16_t index, const uint8_t *p, uint16_t length)
+{
+	const uint16_t expected = protocol == PROTOCOL_V1 ? 5 : protocol == PROTOCOL_V2 ? 10 :
+				  cmd == CMD_READ ? 12 : 14;
+
+	if (length != expected)
+		return LIBUSB_ERROR_PIPE;
+	bulk_cmd = cmd;
+	bulk_count = p[0] | p[1] << 8;
+	bulk_mode = p[3];
+	if (protocol == PROTOCOL_V1)
+		bulk_addr = value | (index & 0xff) << 16;
+	else
+		bulk_addr = p[6] | p[7] << 8 | p[8] << 16 | (unsigned int)p[9] << 24;
+	/* V3 fast reads carry the address length and dummy cycles of the read mode, standard reads 0. */
+	if (protocol == PROTOCOL_V3 && cmd == CMD_READ) {
+		const bool addr_4ba = bulk_mode == READ_MODE_4B_ADDR_FAST || bulk_mode == READ_MODE_4B_ADDR_FAST_0x0C;
+		const bool std = bulk_mode == READ_MODE_STD;
+		if (p[10] != (std ? 0 : addr_4ba ? 4 : 3) || p[11] != (std ? 0 : 4)) {
+			fprintf(stderr, "usb_emulator: read mode %u with address length %u and %u dummy cycles / 2\n",
+				bulk_mode, p[10], p[11]);
+			return LIBUSB_ERROR_PIPE;
+		}
+	}
+	return length;
+}
+
+static int transceive_out(uint16_t value, uint16_t index, const uint8_t *data, uint16_t length)
+{
+	const bool read = protocol == PROTOCOL_V1 ? index & 1 : value & 1;
+
+	spi_command(data, length);
+	/* The response is fetched with another control transfer in the same CS cycle. */
+	if (!read)
+		emu_flash_select(false);
+	return length;
+}
+
+static int transceive_in(uint8_t *data, uint16_t length)
+{
+	unsigned int i;
+
+	for (i = 0; i < length; i++)
+		data[i] = emu_flash_xfer(0xff);
+	emu_flash_select(false);
+	return length;
+}
+
+static int dediprog_control(uint8_t request_type, uint8_t request, uint16_t value, uint16_t index,
+			    uint8_t *data, uint16_t length)
+{
+	char info[32];
+	int n;
+
+	switch (request_type) {
+	case REQTYPE_EP_IN:
+		if (request == CMD_TRANSCEIVE)
+			return transceive_in(data, length);
+		if (request == CMD_READ_PROG_INFO) {
+			/* The version string is padded with spaces to 16 bytes. */
+			memset(info, ' ', sizeof(info));
+			n = snprintf(info, sizeof(info), "SF%d V:%d.%d.%d", sf600 ? 600 : 100,
+				     firmware >> 16, firmware >> 8 & 0xff, firmware & 0xff);
+			info[n] = ' ';
+			memcpy(data, info, length < 16 ? length : 16);
+			return length < 16 ? length : 16;
+		}
+		return LIBUSB_ERROR_PIPE;
+	case REQTYPE_OTHER_IN:
+		if (request == CMD_READ_ID && length >= 3) {
+			/* SF012345 */
+			data[0] = 0x00;
+			data[1] = 0x30;
+			data[2] = 0x39;
+			return 3;
+		}
+		if (request == CMD_SET_VOLTAGE && length >= 1) {
+			data[0] = 0x6f;
+			return 1;
+		}
+		return LIBUSB_ERROR_PIPE;
+	case REQTYPE_EP_OUT:
+		switch (request) {
+		case CMD_TRANSCEIVE:
+			return transceive_out(value, index, data, length);
+		case CMD_READ:
+		case CMD_WRITE:
+			return bulk_setup(request, value, index, data, length);
+		default:
+			/* LEDs, voltage, clock, target and standalone mode have no effect here. */
+			return length;
+		}
+	default:
+		return LIBUSB_ERROR_PIPE;
+	}
+}
+
+/* Programs one page with WREN, page program and waiting for WIP like the firmware does. */
+static int bulk_write_page(const uint8_t *data)
+{
+	const uint8_t wren = 0x06;
+	uint8_t opcode = 0x02;
+	bool addr_4ba = false;
+	unsigned int i;
+
+	switch (bulk_mode) {
+	case WRITE_MODE_PAGE_PGM:
+		break;
+	case WRITE_MODE_4B_ADDR_256B_PAGE_PGM:
+		addr_4ba = true;
+		break;
+	case WRITE_MODE_4B_ADDR_256B_PAGE_PGM_0x12:
+		opcode = 0x12;
+		addr_4ba = true;
+		break;
+	default:
+		fprintf(stderr, "usb_emulator: unsupported Dediprog write mode %u\n", bulk_mode);
+		return LIBUSB_ERROR_PIPE;
+	}
+	spi_command(&wren, 1);
+	emu_flash_select(false);
+	spi_command(&opcode, 1);
+	spi_address(bulk_addr, addr_4ba);
+	for (i = 0; i < PAGE_SIZE; i++)
+		emu_flash_xfer(data[i]);
+	emu_flash_select(false);
+	bulk_addr += PAGE_SIZE;
+	return 0;
+}
+
+static int dediprog_bulk_out(uint8_t endpoint, const uint8_t *data, int length)
+{
+	int ret;
+
+	if (endpoint != out_ep || bulk_cmd != CMD_WRITE || !bulk_count)
+		return LIBUSB_ERROR_PIPE;
+	/* The second half of every 512 byte transfer is padding. */
+	if (length != BULK_CHUNK)
+		return LIBUSB_ERROR_PIPE;
+	ret = bulk_write_page(data);
+	if (ret)
+		return ret;
+	bulk_count--;
+	return length;
+}
+
+static int dediprog_bulk_in(uint8_t endpoint, uint8_t *data, int length)
+{
+	uint8_t opcode = 0x03;
+	bool addr_4ba = false, dummy = true;
+	int i;
+
+	if (endpoint != in_ep)
+		return LIBUSB_ERROR_PIPE;
+	if (bulk_cmd != CMD_READ || !bulk_count)
+		return 0;
+	if (length < BULK_CHUNK)
+		return LIBUSB_ERROR_OVERFLOW;
+
+	switch (bulk_mode) {
+	case READ_MODE_STD:
+		dummy = false;
+		break;
+	case READ_MODE_FAST:
+		opcode = 0x0b;
+		break;
+	case READ_MODE_4B_ADDR_FAST:
+		opcode = 0x0b;
+		addr_4ba = true;
+		break;
+	case READ_MODE_4B_ADDR_FAST_0x0C:
+		opcode = 0x0c;
+		addr_4ba = true;
+		break;
+	default:
+		fprintf(stderr, "usb_emulator: unsupported Dediprog read mode %u\n", bulk_mode);
+		return LIBUSB_ERROR_PIPE;
+	}
+	spi_command(&opcode, 1);
+	spi_address(bulk_addr, addr_4ba);
+	if (dummy)
+		emu_flash_xfer(0xff);
+	for (i = 0; i < BULK_CHUNK; i++)
+		data[i] = emu_flash_xfer(0xff);
+	emu_flash_select(false);
+	bulk_addr += BULK_CHUNK;
+	bulk_count--;
+	return BULK_CHUNK;
+}
+
+const struct usb_emu_model usb_emu_dediprog = {
+	.name		= "dediprog",
+	.vendor_id	= 0x0483,
+	.product_id	= 0xdada,
+	.bcd_device	= 0x0100,
+	.product	= "Dediprog",
+	.endpoints	= { 0x01, 0x02, 0x82 },
+	.max_packet_size = 512,
+	.init		= dediprog_init,
+	.control	= dediprog_control,
+	.bulk_out	= dediprog_bulk_out,
+	.bulk_in	= dediprog_bulk_in,
+};
@@ -0,0 +1,269 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * FTDI FT2232H channel A in MPSSE mode, as driven by ft2232_spi.c through
+ * libftdi, which talks to the chip with plain libusb calls. The MPSSE command
+ * stream may be split across OUT transfers at any byte. Every IN packet starts
+ * with two modem status bytes, libftdi strips them again.
+ *
+ * Only the byte-wise, MSB or LSB first data commands are modelled. Bit-wise and
+ * TMS shifts aren't used by ft2232_spi.c and are answered like unknown
+ * commands, with 0xfa and the command byte.
+ */
+
+#include <string.h>
+#include <libusb.h>
+#include "usb_emulator.h"
+
+#define WRITE_EP		0x02
+#define READ_EP			0x81
+#define PACKET_LENGTH		512
+
+/* Vendor requests of the FTDI chips. */
+#define SIO_RESET		0x00
+#define SIO_SET_BITMODE		0x0b
+#define SIO_RESET_SIO		0
+#define SIO_RESET_PURGE_RX	1
+#define SIO_RESET_PURGE_TX	2
+#define BITMODE_MPSSE		0x02
+#define REQUEST_TYPE_MASK	0x60
+
+/* Bits of the data shifting commands. */
+#define MPSSE_WRITE_NEG		0x01
+#define MPSSE_BITMODE		0x02
+#define MPSSE_LSB		0x08
+#define MPSSE_DO_WRITE		0x10
+#define MPSSE_DO_READ		0x20
+#define MPSSE_WRITE_TMS		0x40
+
+#define SET_BITS_LOW		0x80
+#define GET_BITS_LOW		0x81
+#define SET_BITS_HIGH		0x82
+#define GET_BITS_HIGH		0x83
+#define TCK_DIVISOR		0x86
+#define CLK_BITS		0x8e
+#define CLK_BYTES		0x8f
+#define DRIVE_OPEN_COLLECTOR	0x9e
+#define BAD_COMMAND		0xfa
+
+/* TMS/CS is bit 3 of the low byte. */
+#define PIN_CS			0x08
+
+/* The longest command is a 64 KiB write plus its three byte header. */
+#define CMD_BUF_LEN		(3 + 65536)
+/* Enough for the 64 KiB read of one command and the bytes of a few others. */
+#define IN_QUEUE_LEN		(2 * 65536)
+
+static uint8_t cmd_buf[CMD_BUF_LEN];
+static unsigned int cmd_len;
+
+static uint8_t in_queue[IN_QUEUE_LEN];
+static unsigned int in_head, in_count;
+
+static uint8_t reverse_byte(uint8_t x)
+{
+	x = (x >> 4) | (x << 4);
+	x = ((x & 0xcc) >> 2) | ((x & 0x33) << 2);
+	x = ((x & 0xaa) >> 1) | ((x & 0x55) << 1);
+	return x;
+}
+
+static void mpsse_reset(void)
+{
+	cmd_len = 0;
+	in_head = in_count = 0;
+	emu_flash_select(false);
+}
+
+static int ft2232_init(void)
+{
+	mpsse_reset();
+	return 0;
+}
+
+static int in_put(uint8_t val)
+{
+	if (in_count == IN_QUEUE_LEN)
+		return -1;
+	in_queue[(in_head + in_count++) % IN_QUEUE_LEN] = val;
+	return 0;
+}
+
+/*
+ * Returns the length of the command at the start of buf, 0 if it can't be told
+ * from the first len bytes yet.
+ */
+static unsigned int command_length(const uint8_t *buf, unsigned int len)
+{
+	const uint8_t cmd = buf[0];
+
+	if (!(cmd & 0x80)) {
+		if (cmd & (MPSSE_BITMODE | MPSSE_WRITE_TMS))
+			return 1;
+		if (!(cmd & MPSSE_DO_WRITE))
+			return 3;
+		if (len < 3)
+			return 0;
+		return 3 + (buf[1] | buf[2] << 8) + 1;
+	}
+	switch (cmd) {
+	case SET_BITS_LOW:
+	case SET_BITS_HIGH:
+	case TCK_DIVISOR:
+	case CLK_BYTES:
+	case DRIVE_OPEN_COLLECTOR:
+		return 3;
+	case CLK_BITS:
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+/* Runs one complete command. */
+static int run_command(const uint8_t *buf)
+{
+	const uint8_t cmd = buf[0];
+	unsigned int i, n;
+
+	if (!(cmd & 0x80) && !(cmd & (MPSSE_BITMODE | MPSSE_WRITE_TMS))) {
+		n = (buf[1] | buf[2] << 8) + 1;
+		for (i = 0; i < n; i++) {
+			uint8_t out = cmd & MPSSE_DO_WRITE ? buf[3 + i] : 0;
+			uint8_t in;
+
+			if (cmd & MPSSE_LSB)
+				out = reverse_byte(out);
+			in = emu_flash_xfer(out);
+			if (cmd & MPSSE_LSB)
+				in = reverse_byte(in);
+			if ((cmd & MPSSE_DO_READ) && in_put(in))
+				return -1;
+		}
+		return 0;
+	}
+	switch (cmd) {
+	case SET_BITS_LOW:
+		/* CS# only follows the value while it is an output. */
+		if (buf[2] & PIN_CS)
+			emu_flash_select(!(buf[1] & PIN_CS));
+		return 0;
+	case GET_BITS_LOW:
+	case GET_BITS_HIGH:
+		return in_put(0);
+	case SET_BITS_HIGH:
+	case TCK_DIVISOR:
+	case CLK_BITS:
+	case CLK_BYTES:
+	case DRIVE_OPEN_COLLECTOR:
+	case 0x84: case 0x85:		/* loopback on/off */
+	case 0x87:			/* send immediate */
+	case 0x8a: case 0x8b:		/* divide by 5 off/on */
+	case 0x8c: case 0x8d:		/* 3-phase clocking on/off */
+	case 0x96: case 0x97:		/* adaptive clocking on/off */
+		/* Clocking and timing are instant here. */
+		return 0;
+	default:
+		if (in_put(BAD_COMMAND) || in_put(cmd))
+			return -1;
+		return 0;
+	}
+}
+
+static int ft2232_control(uint8_t request_type, uint8_t request, uint16_t value, uint16_t index,
+			  uint8_t *data, uint16_t length)
+{
+	if ((request_type & REQUEST_TYPE_MASK) != LIBUSB_REQUEST_TYPE_VENDOR)
+		return LIBUSB_ERROR_PIPE;
+	/* Status, latency timer, pins and EEPROM reads all read back as zero. */
+	if (request_type & LIBUSB_ENDPOINT_IN) {
+		memset(data, 0, length);
+		return length;
+	}
+	if (request == SIO_RESET) {
+		if (value == SIO_RESET_SIO || value == SIO_RESET_PURGE_RX)
+			in_head = in_count = 0;
+		if (value == SIO_RESET_SIO || value == SIO_RESET_PURGE_TX)
+			cmd_len = 0;
+	} else if (request == SIO_SET_BITMODE && value >> 8 == BITMODE_MPSSE) {
+		mpsse_reset();
+	}
+	/* Baud rate, latency timer, flow control etc. don't matter for MPSSE. */
+	return 0;
+}
+
+static int ft2232_bulk_out(uint8_t endpoint, const uint8_t *data, int length)
+{
+	unsigned int pos = 0, n;
+
+	if (endpoint != WRITE_EP)
+		return LIBUSB_ERROR_PIPE;
+	if (cmd_len + length > CMD_BUF_LEN)
+		return LIBUSB_ERROR_OVERFLOW;
+	memcpy(cmd_buf + cmd_len, data, length);
+	cmd_len += length;
+	while (pos < cmd_len) {
+		n = command_length(cmd_buf + pos, cmd_len - pos);
+		if (!n || pos + n > cmd_len)
+			break;
+		if (run_command(cmd_buf + pos))
+			return LIBUSB_ERROR_OVERFLOW;
+		pos += n;
+	}
+	/* Keep the start of a command that is still incomplete. */
+	memmove(cmd_buf, cmd_buf + pos, cmd_len - pos);
+	cmd_len -= pos;
+	return length;
+}
+
+/* The chip answers every IN transfer, with just the status bytes if nothing is queued. */
+static int ft2232_bulk_in(uint8_t endpoint, uint8_t *data, int length)
+{
+	int pos = 0, n;
+
+	if (endpoint != READ_EP)
+		return LIBUSB_ERROR_PIPE;
+	do {
+		if (length - pos < 2)
+			break;
+		n = length - pos - 2;
+		if (n > PACKET_LENGTH - 2)
+			n = PACKET_LENGTH - 2;
+		if ((unsigned int)n > in_count)
+			n = in_count;
+		data[pos++] = 0x32;
+		data[pos++] = 0x60;
+		for (; n; n--) {
+			data[pos++] = in_queue[in_head];
+			in_head = (in_head + 1) % IN_QUEUE_LEN;
+			in_count--;
+		}
+	/* A short packet ends the transfer. */
+	} while (in_count && pos % PACKET_LENGTH == 0);
+	return pos;
+}
+
+const struct usb_emu_model usb_emu_ft2232 = {
+	.name		= "ft2232",
+	.vendor_id	= 0x0403,
+	.product_id	= 0x6010,
+	.bcd_device	= 0x0700,
+	.product	= "Dual RS232-HS",
+	.endpoints	= { READ_EP, WRITE_EP },
+	.max_packet_size = PACKET_LENGTH,
+	.init		= ft2232_init,
+	.control	= ft2232_control,
+	.bulk_out	= ft2232_bulk_out,
+	.bulk_in	= ft2232_bulk_in,
+};
@@ -0,0 +1,69 @@
+#!/bin/sh
+#
+# This file is part of the flashrom project.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; version 2 of the License.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# Writes a seeded pattern through an emulated USB programmer and reads it back:
+#
+#   roundtrip.sh <flashrom> <libflashrom-usb-emulator.so> <programmer> <emulator config>
+#
+# e.g. roundtrip.sh ./flashrom ./libflashrom-usb-emulator.so dediprog dediprog,fw=7.2.22
+# The emulated chip starts out erased, its image lives in a temporary directory.
+
+if [ $# -ne 4 ]; then
+	echo "usage: $0 <flashrom> <libflashrom-usb-emulator.so> <programmer> <emulator config>" >&2
+	exit 2
+fi
+
+FLASHROM=$1
+EMULATOR=$2
+PROGRAMMER=$3
+CONFIG=$4
+
+# The preload has to be found from any working directory.
+case "$EMULATOR" in
+/*) ;;
+*) EMULATOR=$(pwd)/$EMULATOR ;;
+esac
+
+TMPDIR=$(mktemp -d -t flashrom_usb_emulator.XXXXXXXXXX) || exit 1
+trap 'rm -rf "$TMPDIR"' EXIT
+
+run_flashrom() {
+	FLASHROM_USB_EMULATOR="$CONFIG,image=$TMPDIR/chip.bin" LD_PRELOAD="$EMULATOR" \
+		"$FLASHROM" -p "$PROGRAMMER" "$@" >"$TMPDIR/log" 2>&1
+	ret=$?
+	if [ $ret -ne 0 ]; then
+		cat "$TMPDIR/log"
+		echo "FAIL: flashrom -p $PROGRAMMER $* with $CONFIG returned $ret" >&2
+		exit 1
+	fi
+}
+
+# Reading the erased chip first tells us its size.
+run_flashrom -r "$TMPDIR/erased.bin"
+SIZE=$(wc -c <"$TMPDIR/erased.bin")
+# Same data on every run, so a failure can be reproduced.
+awk -v x=1 -v size="$SIZE" 'BEGIN { while (n < size) { x = (x * 1103515245 + 12345) % 2147483648;
+	s = sprintf("%08x\n", x); printf "%s", s; n += length(s) } }' | head -c "$SIZE" >"$TMPDIR/pattern.bin"
+
+run_flashrom -w "$TMPDIR/pattern.bin"
+run_flashrom -r "$TMPDIR/readback.bin"
+
+if ! cmp -s "$TMPDIR/pattern.bin" "$TMPDIR/readback.bin"; then
+	echo "FAIL: read back data differs with $CONFIG" >&2
+	exit 1
+fi
+if ! cmp -s "$TMPDIR/pattern.bin" "$TMPDIR/chip.bin"; then
+	echo "FAIL: emulated chip contents differ with $CONFIG" >&2
+	exit 1
+fi
+echo "PASS: $PROGRAMMER with $CONFIG"
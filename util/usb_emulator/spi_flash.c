@@ -0,0 +1,296 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * The SPI NOR chip behind the emulated programmers. It is driven byte by
+ * byte like the real thing: commands are decoded while they are clocked in
+ * and program, erase and register writes take effect when CS goes high.
+ * Operations finish immediately, so WIP is never seen set.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "usb_emulator.h"
+
+#define PAGE_SIZE	256
+
+#define SR_WIP		0x01
+#define SR_WEL		0x02
+
+struct emu_flash_chip {
+	const char *name;
+	uint8_t id[3];
+	unsigned int size;
+	bool addr_4ba;		/* Has 4-byte address mode and the extended address register. */
+};
+
+static const struct emu_flash_chip chips[] = {
+	{ "W25Q64FV",	{ 0xef, 0x40, 0x17 },  8 * 1024 * 1024, false },
+	{ "W25Q128FV",	{ 0xef, 0x40, 0x18 }, 16 * 1024 * 1024, false },
+	{ "W25Q256FV",	{ 0xef, 0x40, 0x19 }, 32 * 1024 * 1024, true },
+	{ NULL },
+};
+
+static const struct emu_flash_chip *chip;
+static uint8_t *contents;
+static const char *image_name;
+
+static uint8_t status1, status2;
+static bool in_4ba_mode;
+static uint8_t ext_addr;
+
+/* State of the command clocked in since CS went low. */
+static bool selected;
+static unsigned int pos;
+static uint8_t opcode;
+static unsigned int addr;
+static unsigned int addr_len;
+static unsigned int dummy_len;
+static uint8_t data[PAGE_SIZE];
+static unsigned int data_len;
+
+int emu_flash_init(const char *name, const char *image)
+{
+	FILE *f;
+
+	for (chip = chips; chip->name; chip++) {
+		if (!strcmp(chip->name, name))
+			break;
+	}
+	if (!chip->name) {
+		fprintf(stderr, "usb_emulator: unknown SPI chip %s\n", name);
+		return 1;
+	}
+	contents = malloc(chip->size);
+	if (!contents)
+		return 1;
+	memset(contents, 0xff, chip->size);
+	image_name = image;
+	if (!image)
+		return 0;
+
+	/* Like the dummy programmer, a missing image is fine and will be created on exit. */
+	f = fopen(image, "rb");
+	if (!f)
+		return 0;
+	if (fread(contents, 1, chip->size, f) != chip->size)
+		fprintf(stderr, "usb_emulator: %s is smaller than the %u B chip, ignoring the rest\n",
+			image, chip->size);
+	fclose(f);
+	return 0;
+}
+
+int emu_flash_save(void)
+{
+	FILE *f;
+	int ret = 0;
+
+	if (!contents || !image_name)
+		return 0;
+	f = fopen(image_name, "wb");
+	if (!f) {
+		fprintf(stderr, "usb_emulator: can't write %s: %s\n", image_name, strerror(errno));
+		return 1;
+	}
+	if (fwrite(contents, 1, chip->size, f) != chip->size)
+		ret = 1;
+	if (fclose(f))
+		ret = 1;
+	return ret;
+}
+
+static unsigned int erase_size(uint8_t op)
+{
+	switch (op) {
+	case 0x20:
+	case 0x21:
+		return 4 * 1024;
+	case 0x52:
+	case 0x5c:
+		return 32 * 1024;
+	case 0xd8:
+	case 0xdc:
+		return 64 * 1024;
+	default:
+		return 0;
+	}
+}
+
+/* Returns the number of address bytes of an opcode, 0 if it has none. */
+static unsigned int opcode_addr_len(uint8_t op)
+{
+	switch (op) {
+	case 0x13:
+	case 0x0c:
+	case 0x12:
+	case 0x21:
+	case 0x5c:
+	case 0xdc:
+		return chip->addr_4ba ? 4 : 0;
+	case 0x03:
+	case 0x0b:
+	case 0x02:
+	case 0x20:
+	case 0x52:
+	case 0xd8:
+		return in_4ba_mode ? 4 : 3;
+	default:
+		return 0;
+	}
+}
+
+/* Completes the address, 3-byte addresses get the extended address register as upper byte. */
+static unsigned int full_addr(void)
+{
+	if (addr_len == 3 && chip->addr_4ba)
+		addr |= (unsigned int)ext_addr << 24;
+	return addr % chip->size;
+}
+
+/* Executes commands that act when CS goes high. */
+static void finish_command(void)
+{
+	const bool wel = status1 & SR_WEL;
+	const bool addr_done = addr_len && pos >= 1 + addr_len;
+	unsigned int size, i;
+
+	switch (opcode) {
+	case 0x06:
+		status1 |= SR_WEL;
+		return;
+	case 0x04:
+		status1 &= ~SR_WEL;
+		return;
+	case 0xb7:
+		if (chip->addr_4ba)
+			in_4ba_mode = true;
+		return;
+	case 0xe9:
+		in_4ba_mode = false;
+		return;
+	case 0xc5:
+		if (wel && pos >= 2 && chip->addr_4ba)
+			ext_addr = data[0];
+		break;
+	case 0x01:
+		if (!wel || pos < 2)
+			return;
+		status1 = (status1 & 0x03) | (data[0] & 0xfc);
+		if (pos >= 3)
+			status2 = data[1];
+		break;
+	case 0x31:
+		if (!wel || pos < 2)
+			return;
+		status2 = data[0];
+		break;
+	case 0x02:
+	case 0x12:
+		if (!wel || !addr_done || pos == 1 + addr_len)
+			return;
+		/* Data beyond the page end wraps around, only the last 256 bytes stay. */
+		for (i = 0; i < data_len && i < PAGE_SIZE; i++) {
+			const unsigned int page = addr & ~(PAGE_SIZE - 1);
+			const unsigned int offs = (addr + i) % PAGE_SIZE;
+			contents[page + offs] &= data[offs];
+		}
+		break;
+	case 0x60:
+	case 0xc7:
+		if (!wel)
+			return;
+		memset(contents, 0xff, chip->size);
+		break;
+	default:
+		size = erase_size(opcode);
+		if (!size || !wel || !addr_done)
+			return;
+		memset(contents + (addr & ~(size - 1)), 0xff, size);
+		break;
+	}
+	status1 &= ~SR_WEL;
+}
+
+void emu_flash_select(bool select)
+{
+	if (select == selected)
+		return;
+	selected = select;
+	if (!select && pos)
+		finish_command();
+	pos = 0;
+}
+
+uint8_t emu_flash_xfer(uint8_t out)
+{
+	uint8_t in = 0xff;
+
+	if (!selected || !chip)
+		return in;
+
+	if (pos == 0) {
+		opcode = out;
+		addr = 0;
+		addr_len = opcode_addr_len(opcode);
+		dummy_len = opcode == 0x0b || opcode == 0x0c ? 1 : 0;
+		data_len = 0;
+		memset(data, 0xff, sizeof(data));
+		pos++;
+		return in;
+	}
+
+	if (pos <= addr_len) {
+		addr = addr << 8 | out;
+		if (pos == addr_len)
+			addr = full_addr();
+		pos++;
+		return in;
+	}
+
+	switch (opcode) {
+	case 0x9f:
+		in = pos <= 3 ? chip->id[pos - 1] : 0xff;
+		break;
+	case 0x05:
+		in = status1;
+		break;
+	case 0x35:
+		in = status2;
+		break;
+	case 0xc8:
+		in = ext_addr;
+		break;
+	case 0x03:
+	case 0x13:
+	case 0x0b:
+	case 0x0c:
+		if (pos > addr_len + dummy_len) {
+			in = contents[addr];
+			addr = (addr + 1) % chip->size;
+		}
+		break;
+	case 0x02:
+	case 0x12:
+		data[(addr + data_len) % PAGE_SIZE] = out;
+		data_len++;
+		break;
+	default:
+		if (pos - 1 < sizeof(data))
+			data[pos - 1] = out;
+		break;
+	}
+	pos++;
+	return in;
+}
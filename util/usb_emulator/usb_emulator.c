@@ -0,0 +1,721 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * A stand-in for libusb-1.0 that puts an emulated USB programmer in front of
+ * an emulated SPI flash chip, so that the USB programmer drivers can be run
+ * and benchmarked without hardware. Preload it into an unmodified flashrom:
+ *
+ *   FLASHROM_USB_EMULATOR=ch341a,chip=W25Q128FV,image=flash.bin,latency=1000 \
+ *   LD_PRELOAD=./libflashrom-usb-emulator.so flashrom -p ch341a_spi -r out.bin
+ *
+ * The first word picks the device model (ch341a, dediprog or ft2232), the options are
+ *   chip=<name>		W25Q64FV, W25Q128FV (default) or W25Q256FV
+ *   image=<file>		chip contents, read at start and written back at libusb_exit()
+ *   latency=<us>		time from submitting a transfer until it completes (default 0)
+ *   bandwidth=<B/s>	bus throughput shared by all transfers, 0 is unlimited (default)
+ *   stats			print transfer counts and time spent waiting for the bus at exit
+ *   verbose		log every transfer
+ * plus the options of the device model.
+ *
+ * Transfers complete in submission order per endpoint. Asynchronous transfers
+ * overlap their latency like on a real bus, so pipelining in the drivers
+ * shows up in the run time.
+ *
+ * "make check" and "meson test" round trip a seeded pattern through every model
+ * with roundtrip.sh, but only where libusb-1.0 was found: the emulator is built
+ * against its headers. ft2232_spi goes through libftdi, which ends up in the
+ * same libusb calls. pickit2_spi, stlinkv3_spi, raiden_debug_spi and
+ * developerbox_spi (CP210x GPIO bitbanging) are not modelled and not covered.
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <libusb.h>
+#include "usb_emulator.h"
+
+#define MAX_OPTIONS	16
+
+struct libusb_context {
+	int refs;
+};
+
+struct libusb_device {
+	int refs;
+};
+
+struct libusb_device_handle {
+	struct libusb_device *dev;
+};
+
+/* Bookkeeping in front of every transfer like libusb does it. */
+struct emu_transfer {
+	struct emu_transfer *next;
+	uint64_t submitted;
+	uint64_t due;
+	bool pending;
+	bool cancelled;
+	struct libusb_transfer transfer;	/* Must be last, it ends with the iso packets. */
+};
+
+static const struct usb_emu_model *const models[] = {
+	&usb_emu_ch341a,
+	&usb_emu_dediprog,
+	&usb_emu_ft2232,
+	NULL,
+};
+
+static struct libusb_context default_context;
+static struct libusb_device device;
+static const struct usb_emu_model *model;
+static bool configured;
+static int context_refs;
+
+static char *config;
+static const char *option_names[MAX_OPTIONS];
+static const char *option_values[MAX_OPTIONS];
+static unsigned int option_count;
+static int verbose;
+
+static uint64_t latency_us;
+static uint64_t bandwidth;
+static uint64_t bus_free;		/* When the bus is done with what was submitted so far. */
+
+static struct emu_transfer *pending_head, *pending_tail;
+
+static struct {
+	unsigned long control, bulk_out, bulk_in;
+	uint64_t bytes_out, bytes_in;
+	uint64_t wait_us;
+} stats;
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void sleep_until(uint64_t t)
+{
+	const uint64_t now = now_us();
+	struct timespec ts;
+
+	if (t <= now)
+		return;
+	ts.tv_sec = (t - now) / 1000000;
+	ts.tv_nsec = (t - now) % 1000000 * 1000;
+	while (nanosleep(&ts, &ts) && errno == EINTR)
+		;
+	stats.wait_us += t - now;
+}
+
+static void log_transfer(const char *what, uint8_t endpoint, int len, int ret)
+{
+	if (verbose)
+		fprintf(stderr, "usb_emulator: %s ep 0x%02x len %d: %d\n", what, endpoint, len, ret);
+}
+
+const char *usb_emu_option(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < option_count; i++) {
+		if (!strcmp(option_names[i], name))
+			return option_values[i] ? option_values[i] : "";
+	}
+	return NULL;
+}
+
+int usb_emu_verbose(void)
+{
+	return verbose;
+}
+
+/* Parses FLASHROM_USB_EMULATOR and brings up the device once per process. */
+static int configure(void)
+{
+	const char *env = getenv("FLASHROM_USB_EMULATOR");
+	const char *opt;
+	char *tok, *save;
+	unsigned int i;
+
+	if (configured)
+		return 0;
+	if (!env) {
+		fprintf(stderr, "usb_emulator: FLASHROM_USB_EMULATOR is not set, no devices present\n");
+		return 1;
+	}
+	config = strdup(env);
+	if (!config)
+		return 1;
+	tok = strtok_r(config, ",", &save);
+	for (i = 0; tok && models[i]; i++) {
+		if (!strcmp(models[i]->name, tok))
+			break;
+	}
+	if (!tok || !models[i]) {
+		fprintf(stderr, "usb_emulator: unknown device model %s\n", tok ? tok : "(none)");
+		return 1;
+	}
+	while ((tok = strtok_r(NULL, ",", &save)) && option_count < MAX_OPTIONS) {
+		char *eq = strchr(tok, '=');
+		if (eq)
+			*eq++ = '\0';
+		option_names[option_count] = tok;
+		option_values[option_count++] = eq;
+	}
+
+	verbose = usb_emu_option("verbose") != NULL;
+	opt = usb_emu_option("latency");
+	latency_us = opt ? strtoull(opt, NULL, 0) : 0;
+	opt = usb_emu_option("bandwidth");
+	bandwidth = opt ? strtoull(opt, NULL, 0) : 0;
+	opt = usb_emu_option("chip");
+	if (emu_flash_init(opt ? opt : "W25Q128FV", usb_emu_option("image")))
+		return 1;
+	if (models[i]->init && models[i]->init())
+		return 1;
+	model = models[i];
+	configured = true;
+	return 0;
+}
+
+/* Completion time of a transfer of len bytes submitted now. */
+static uint64_t schedule(int len)
+{
+	const uint64_t now = now_us();
+
+	if (bus_free < now)
+		bus_free = now;
+	if (bandwidth)
+		bus_free += (uint64_t)len * 1000000 / bandwidth;
+	return bus_free > now + latency_us ? bus_free : now + latency_us;
+}
+
+int LIBUSB_CALL libusb_init(libusb_context **ctx)
+{
+	if (!configured)
+		configure();
+	if (ctx)
+		*ctx = &default_context;
+	context_refs++;
+	return 0;
+}
+
+void LIBUSB_CALL libusb_exit(libusb_context *ctx)
+{
+	if (!context_refs || --context_refs)
+		return;
+	if (configured)
+		emu_flash_save();
+	if (usb_emu_option("stats"))
+		fprintf(stderr, "usb_emulator: %lu control, %lu bulk out (%llu B), %lu bulk in (%llu B) transfers, "
+			"%llu us waiting for the bus\n", stats.control, stats.bulk_out,
+			(unsigned long long)stats.bytes_out, stats.bulk_in, (unsigned long long)stats.bytes_in,
+			(unsigned long long)stats.wait_us);
+}
+
+void LIBUSB_CALL libusb_set_debug(libusb_context *ctx, int level)
+{
+}
+
+int LIBUSB_CALL libusb_set_option(libusb_context *ctx, enum libusb_option option, ...)
+{
+	return LIBUSB_SUCCESS;
+}
+
+const char * LIBUSB_CALL libusb_error_name(int errcode)
+{
+	switch (errcode) {
+	case LIBUSB_SUCCESS:		return "LIBUSB_SUCCESS / LIBUSB_TRANSFER_COMPLETED";
+	case LIBUSB_ERROR_IO:		return "LIBUSB_ERROR_IO";
+	case LIBUSB_ERROR_INVALID_PARAM: return "LIBUSB_ERROR_INVALID_PARAM";
+	case LIBUSB_ERROR_ACCESS:	return "LIBUSB_ERROR_ACCESS";
+	case LIBUSB_ERROR_NO_DEVICE:	return "LIBUSB_ERROR_NO_DEVICE";
+	case LIBUSB_ERROR_NOT_FOUND:	return "LIBUSB_ERROR_NOT_FOUND";
+	case LIBUSB_ERROR_BUSY:		return "LIBUSB_ERROR_BUSY";
+	case LIBUSB_ERROR_TIMEOUT:	return "LIBUSB_ERROR_TIMEOUT";
+	case LIBUSB_ERROR_OVERFLOW:	return "LIBUSB_ERROR_OVERFLOW";
+	case LIBUSB_ERROR_PIPE:		return "LIBUSB_ERROR_PIPE";
+	case LIBUSB_ERROR_INTERRUPTED:	return "LIBUSB_ERROR_INTERRUPTED";
+	case LIBUSB_ERROR_NO_MEM:	return "LIBUSB_ERROR_NO_MEM";
+	case LIBUSB_ERROR_NOT_SUPPORTED: return "LIBUSB_ERROR_NOT_SUPPORTED";
+	default:			return "LIBUSB_ERROR_OTHER";
+	}
+}
+
+ssize_t LIBUSB_CALL libusb_get_device_list(libusb_context *ctx, libusb_device ***list)
+{
+	libusb_device **l = calloc(2, sizeof(*l));
+
+	if (!l)
+		return LIBUSB_ERROR_NO_MEM;
+	if (!model) {
+		*list = l;
+		return 0;
+	}
+	l[0] = libusb_ref_device(&device);
+	*list = l;
+	return 1;
+}
+
+void LIBUSB_CALL libusb_free_device_list(libusb_device **list, int unref_devices)
+{
+	libusb_device **l;
+
+	if (!list)
+		return;
+	for (l = list; unref_devices && *l; l++)
+		libusb_unref_device(*l);
+	free(list);
+}
+
+libusb_device * LIBUSB_CALL libusb_ref_device(libusb_device *dev)
+{
+	dev->refs++;
+	return dev;
+}
+
+void LIBUSB_CALL libusb_unref_device(libusb_device *dev)
+{
+	dev->refs--;
+}
+
+int LIBUSB_CALL libusb_get_device_descriptor(libusb_device *dev, struct libusb_device_descriptor *desc)
+{
+	memset(desc, 0, sizeof(*desc));
+	desc->bLength = 18;
+	desc->bDescriptorType = 1;
+	desc->bcdUSB = 0x0200;
+	desc->bMaxPacketSize0 = 64;
+	desc->idVendor = model->vendor_id;
+	desc->idProduct = model->product_id;
+	desc->bcdDevice = model->bcd_device;
+	desc->iProduct = model->product ? 2 : 0;
+	desc->iSerialNumber = model->serial ? 3 : 0;
+	desc->bNumConfigurations = 1;
+	return 0;
+}
+
+int LIBUSB_CALL libusb_get_config_descriptor(libusb_device *dev, uint8_t config_index,
+					     struct libusb_config_descriptor **config_desc)
+{
+	struct {
+		struct libusb_config_descriptor config;
+		struct libusb_interface interface;
+		struct libusb_interface_descriptor altsetting;
+		struct libusb_endpoint_descriptor endpoints[4];
+	} *d;
+	unsigned int i;
+
+	if (config_index)
+		return LIBUSB_ERROR_NOT_FOUND;
+	d = calloc(1, sizeof(*d));
+	if (!d)
+		return LIBUSB_ERROR_NO_MEM;
+	for (i = 0; i < 4 && model->endpoints[i]; i++) {
+		d->endpoints[i].bLength = 7;
+		d->endpoints[i].bDescriptorType = 5;
+		d->endpoints[i].bEndpointAddress = model->endpoints[i];
+		d->endpoints[i].bmAttributes = LIBUSB_TRANSFER_TYPE_BULK;
+		d->endpoints[i].wMaxPacketSize = model->max_packet_size;
+	}
+	d->altsetting.bLength = 9;
+	d->altsetting.bDescriptorType = 4;
+	d->altsetting.bNumEndpoints = i;
+	d->altsetting.bInterfaceClass = 0xff;
+	d->altsetting.endpoint = d->endpoints;
+	d->interface.altsetting = &d->altsetting;
+	d->interface.num_altsetting = 1;
+	d->config.bLength = 9;
+	d->config.bDescriptorType = 2;
+	d->config.bNumInterfaces = 1;
+	d->config.bConfigurationValue = 1;
+	d->config.interface = &d->interface;
+	/* The config descriptor is the first member, so this frees everything. */
+	*config_desc = &d->config;
+	return 0;
+}
+
+void LIBUSB_CALL libusb_free_config_descriptor(struct libusb_config_descriptor *config_desc)
+{
+	free(config_desc);
+}
+
+uint8_t LIBUSB_CALL libusb_get_bus_number(libusb_device *dev)
+{
+	return 1;
+}
+
+uint8_t LIBUSB_CALL libusb_get_device_address(libusb_device *dev)
+{
+	return 2;
+}
+
+int LIBUSB_CALL libusb_open(libusb_device *dev, libusb_device_handle **dev_handle)
+{
+	libusb_device_handle *h = calloc(1, sizeof(*h));
+
+	if (!h)
+		return LIBUSB_ERROR_NO_MEM;
+	h->dev = libusb_ref_device(dev);
+	*dev_handle = h;
+	return 0;
+}
+
+void LIBUSB_CALL libusb_close(libusb_device_handle *dev_handle)
+{
+	if (!dev_handle)
+		return;
+	libusb_unref_device(dev_handle->dev);
+	free(dev_handle);
+}
+
+libusb_device * LIBUSB_CALL libusb_get_device(libusb_device_handle *dev_handle)
+{
+	return dev_handle->dev;
+}
+
+libusb_device_handle * LIBUSB_CALL libusb_open_device_with_vid_pid(libusb_context *ctx, uint16_t vendor_id,
+								   uint16_t product_id)
+{
+	libusb_device_handle *h;
+
+	if (!model || model->vendor_id != vendor_id || model->product_id != product_id)
+		return NULL;
+	return libusb_open(&device, &h) ? NULL : h;
+}
+
+int LIBUSB_CALL libusb_get_configuration(libusb_device_handle *dev_handle, int *config_value)
+{
+	*config_value = 1;
+	return 0;
+}
+
+int LIBUSB_CALL libusb_set_configuration(libusb_device_handle *dev_handle, int configuration)
+{
+	return configuration == 1 || configuration == -1 ? 0 : LIBUSB_ERROR_NOT_FOUND;
+}
+
+int LIBUSB_CALL libusb_claim_interface(libusb_device_handle *dev_handle, int interface_number)
+{
+	return interface_number ? LIBUSB_ERROR_NOT_FOUND : 0;
+}
+
+int LIBUSB_CALL libusb_release_interface(libusb_device_handle *dev_handle, int interface_number)
+{
+	return interface_number ? LIBUSB_ERROR_NOT_FOUND : 0;
+}
+
+int LIBUSB_CALL libusb_set_interface_alt_setting(libusb_device_handle *dev_handle, int interface_number,
+						 int alternate_setting)
+{
+	return interface_number || alternate_setting ? LIBUSB_ERROR_NOT_FOUND : 0;
+}
+
+int LIBUSB_CALL libusb_detach_kernel_driver(libusb_device_handle *dev_handle, int interface_number)
+{
+	/* No kernel driver is bound to an emulated device. */
+	return LIBUSB_ERROR_NOT_FOUND;
+}
+
+int LIBUSB_CALL libusb_set_auto_detach_kernel_driver(libusb_device_handle *dev_handle, int enable)
+{
+	return 0;
+}
+
+int LIBUSB_CALL libusb_get_string_descriptor_ascii(libusb_device_handle *dev_handle, uint8_t desc_index,
+						   unsigned char *data, int length)
+{
+	const char *s = desc_index == 2 ? model->product : desc_index == 3 ? model->serial : NULL;
+
+	if (!s || length < 1)
+		return LIBUSB_ERROR_PIPE;
+	snprintf((char *)data, length, "%s", s);
+	return strlen((char *)data);
+}
+
+static struct emu_transfer *emu_transfer(struct libusb_transfer *transfer)
+{
+	return (struct emu_transfer *)((char *)transfer - offsetof(struct emu_transfer, transfer));
+}
+
+struct libusb_transfer * LIBUSB_CALL libusb_alloc_transfer(int iso_packets)
+{
+	struct emu_transfer *t = calloc(1, sizeof(*t) + iso_packets * sizeof(struct libusb_iso_packet_descriptor));
+
+	if (!t)
+		return NULL;
+	t->transfer.num_iso_packets = iso_packets;
+	return &t->transfer;
+}
+
+void LIBUSB_CALL libusb_free_transfer(struct libusb_transfer *transfer)
+{
+	if (!transfer)
+		return;
+	if (transfer->flags & LIBUSB_TRANSFER_FREE_BUFFER)
+		free(transfer->buffer);
+	free(emu_transfer(transfer));
+}
+
+int LIBUSB_CALL libusb_submit_transfer(struct libusb_transfer *transfer)
+{
+	struct emu_transfer *t = emu_transfer(transfer);
+
+	if (t->pending)
+		return LIBUSB_ERROR_BUSY;
+	if (!model)
+		return LIBUSB_ERROR_NO_DEVICE;
+	if (transfer->type != LIBUSB_TRANSFER_TYPE_BULK && transfer->type != LIBUSB_TRANSFER_TYPE_INTERRUPT)
+		return LIBUSB_ERROR_NOT_SUPPORTED;
+	t->submitted = now_us();
+	t->due = schedule(transfer->length);
+	t->pending = true;
+	t->cancelled = false;
+	t->next = NULL;
+	transfer->actual_length = 0;
+	if (pending_tail)
+		pending_tail->next = t;
+	else
+		pending_head = t;
+	pending_tail = t;
+	return 0;
+}
+
+int LIBUSB_CALL libusb_cancel_transfer(struct libusb_transfer *transfer)
+{
+	struct emu_transfer *t = emu_transfer(transfer);
+
+	if (!t->pending || t->cancelled)
+		return LIBUSB_ERROR_NOT_FOUND;
+	t->cancelled = true;
+	return 0;
+}
+
+/* Lets the device model handle a transfer that is due. Returns false if an IN transfer has to wait for data. */
+static bool run_transfer(struct libusb_transfer *transfer, uint64_t now)
+{
+	const struct emu_transfer *t = emu_transfer(transfer);
+	int ret;
+
+	if (t->cancelled) {
+		transfer->status = LIBUSB_TRANSFER_CANCELLED;
+		return true;
+	}
+	if (transfer->endpoint & LIBUSB_ENDPOINT_IN) {
+		ret = model->bulk_in(transfer->endpoint, transfer->buffer, transfer->length);
+		if (ret == 0) {
+			if (!transfer->timeout || now < t->submitted + transfer->timeout * 1000ULL)
+				return false;
+			transfer->status = LIBUSB_TRANSFER_TIMED_OUT;
+			return true;
+		}
+		stats.bulk_in++;
+	} else {
+		ret = model->bulk_out(transfer->endpoint, transfer->buffer, transfer->length);
+		stats.bulk_out++;
+	}
+	log_transfer(transfer->endpoint & LIBUSB_ENDPOINT_IN ? "bulk in" : "bulk out", transfer->endpoint,
+		     transfer->length, ret);
+	if (ret < 0) {
+		transfer->status = ret == LIBUSB_ERROR_OVERFLOW ? LIBUSB_TRANSFER_OVERFLOW : LIBUSB_TRANSFER_STALL;
+		return true;
+	}
+	transfer->actual_length = ret;
+	if (transfer->endpoint & LIBUSB_ENDPOINT_IN)
+		stats.bytes_in += ret;
+	else
+		stats.bytes_out += ret;
+	if ((transfer->flags & LIBUSB_TRANSFER_SHORT_NOT_OK) && ret < transfer->length)
+		transfer->status = LIBUSB_TRANSFER_ERROR;
+	else
+		transfer->status = LIBUSB_TRANSFER_COMPLETED;
+	return true;
+}
+
+/* Completes all due transfers and returns how many, *next is set to when something may happen next. */
+static int process_transfers(uint64_t *next)
+{
+	struct emu_transfer *done = NULL, **done_tail = &done;
+	struct emu_transfer **pp = &pending_head;
+	uint32_t blocked = 0;	/* Endpoints with a transfer waiting, later ones must wait too. */
+	const uint64_t now = now_us();
+	int count = 0;
+
+	*next = UINT64_MAX;
+	while (*pp) {
+		struct emu_transfer *t = *pp;
+		struct libusb_transfer *transfer = &t->transfer;
+		const uint32_t ep_bit = 1U << ((transfer->endpoint & 0x0f) | (transfer->endpoint & 0x80) >> 3);
+		uint64_t wake = t->due;
+
+		if (!(blocked & ep_bit) && (t->cancelled || t->due <= now) && run_transfer(transfer, now)) {
+			*pp = t->next;
+			t->next = NULL;
+			t->pending = false;
+			*done_tail = t;
+			done_tail = &t->next;
+			count++;
+			continue;
+		}
+		blocked |= ep_bit;
+		/* An IN transfer waiting for data is looked at again when its timeout expires. */
+		if (t->due <= now)
+			wake = transfer->timeout ? t->submitted + transfer->timeout * 1000ULL : UINT64_MAX;
+		if (wake < *next)
+			*next = wake;
+		pp = &t->next;
+	}
+	pending_tail = NULL;
+	for (pp = &pending_head; *pp; pp = &(*pp)->next)
+		pending_tail = *pp;
+
+	/* Callbacks run last, they may submit new transfers. */
+	while (done) {
+		struct emu_transfer *t = done;
+		done = t->next;
+		t->next = NULL;
+		if (t->transfer.callback)
+			t->transfer.callback(&t->transfer);
+	}
+	return count;
+}
+
+int LIBUSB_CALL libusb_handle_events_timeout_completed(libusb_context *ctx, struct timeval *tv, int *completed)
+{
+	const uint64_t deadline = now_us() + (uint64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+	uint64_t next;
+
+	while (1) {
+		if (process_transfers(&next) || (completed && *completed))
+			return 0;
+		/* Nothing else can feed an IN transfer while we wait. */
+		if (next == UINT64_MAX || next >= deadline) {
+			sleep_until(deadline);
+			return 0;
+		}
+		sleep_until(next);
+	}
+}
+
+int LIBUSB_CALL libusb_handle_events_timeout(libusb_context *ctx, struct timeval *tv)
+{
+	return libusb_handle_events_timeout_completed(ctx, tv, NULL);
+}
+
+int LIBUSB_CALL libusb_handle_events_completed(libusb_context *ctx, int *completed)
+{
+	struct timeval tv = { 60, 0 };
+
+	return libusb_handle_events_timeout_completed(ctx, &tv, completed);
+}
+
+int LIBUSB_CALL libusb_handle_events(libusb_context *ctx)
+{
+	return libusb_handle_events_completed(ctx, NULL);
+}
+
+static void LIBUSB_CALL sync_transfer_cb(struct libusb_transfer *transfer)
+{
+	*(int *)transfer->user_data = 1;
+}
+
+/* Synchronous transfers are asynchronous ones waited for, like in libusb. */
+static int sync_transfer(libusb_device_handle *dev_handle, unsigned char endpoint, unsigned char type,
+			 unsigned char *data, int length, int *actual_length, unsigned int timeout)
+{
+	struct libusb_transfer *transfer = libusb_alloc_transfer(0);
+	int completed = 0, ret;
+
+	if (!transfer)
+		return LIBUSB_ERROR_NO_MEM;
+	libusb_fill_bulk_transfer(transfer, dev_handle, endpoint, data, length, sync_transfer_cb, &completed,
+				  timeout);
+	transfer->type = type;
+	ret = libusb_submit_transfer(transfer);
+	if (ret) {
+		libusb_free_transfer(transfer);
+		return ret;
+	}
+	while (!completed)
+		libusb_handle_events_completed(NULL, &completed);
+
+	if (actual_length)
+		*actual_length = transfer->actual_length;
+	switch (transfer->status) {
+	case LIBUSB_TRANSFER_COMPLETED:
+		ret = 0;
+		break;
+	case LIBUSB_TRANSFER_TIMED_OUT:
+		ret = LIBUSB_ERROR_TIMEOUT;
+		break;
+	case LIBUSB_TRANSFER_STALL:
+		ret = LIBUSB_ERROR_PIPE;
+		break;
+	case LIBUSB_TRANSFER_OVERFLOW:
+		ret = LIBUSB_ERROR_OVERFLOW;
+		break;
+	default:
+		ret = LIBUSB_ERROR_IO;
+		break;
+	}
+	libusb_free_transfer(transfer);
+	return ret;
+}
+
+int LIBUSB_CALL libusb_bulk_transfer(libusb_device_handle *dev_handle, unsigned char endpoint,
+				     unsigned char *data, int length, int *actual_length, unsigned int timeout)
+{
+	return sync_transfer(dev_handle, endpoint, LIBUSB_TRANSFER_TYPE_BULK, data, length, actual_length,
+			     timeout);
+}
+
+int LIBUSB_CALL libusb_interrupt_transfer(libusb_device_handle *dev_handle, unsigned char endpoint,
+					  unsigned char *data, int length, int *actual_length, unsigned int timeout)
+{
+	return sync_transfer(dev_handle, endpoint, LIBUSB_TRANSFER_TYPE_INTERRUPT, data, length, actual_length,
+			     timeout);
+}
+
+/* Control transfers go through endpoint 0 and wait for everything submitted before them. */
+int LIBUSB_CALL libusb_control_transfer(libusb_device_handle *dev_handle, uint8_t request_type,
+					uint8_t bRequest, uint16_t wValue, uint16_t wIndex, unsigned char *data,
+					uint16_t wLength, unsigned int timeout)
+{
+	int ret;
+
+	if (!model)
+		return LIBUSB_ERROR_NO_DEVICE;
+	if (!model->control)
+		return LIBUSB_ERROR_PIPE;
+	sleep_until(schedule(8 + wLength));
+	ret = model->control(request_type, bRequest, wValue, wIndex, data, wLength);
+	stats.control++;
+	if (ret > 0) {
+		if (request_type & LIBUSB_ENDPOINT_IN)
+			stats.bytes_in += ret;
+		else
+			stats.bytes_out += ret;
+	}
+	if (verbose)
+		fprintf(stderr, "usb_emulator: control 0x%02x 0x%02x value 0x%04x index 0x%04x len %u: %d\n",
+			request_type, bRequest, wValue, wIndex, wLength, ret);
+	return ret;
+}
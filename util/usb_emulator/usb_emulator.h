@@ -0,0 +1,57 @@
+/*
+ * This file is part of the flashrom project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __USB_EMULATOR_H__
+#define __USB_EMULATOR_H__ 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * A USB programmer model. It sees the payload of every transfer once the
+ * emulated bus delivered it. All handlers return the number of bytes handled
+ * or a negative libusb error code, bulk_in returns 0 while the device has no
+ * data to send.
+ */
+struct usb_emu_model {
+	const char *name;
+	uint16_t vendor_id;
+	uint16_t product_id;
+	uint16_t bcd_device;
+	const char *product;
+	const char *serial;
+	/* Endpoints of interface 0, terminated by 0. */
+	uint8_t endpoints[4];
+	uint16_t max_packet_size;
+	int (*init)(void);
+	int (*control)(uint8_t request_type, uint8_t request, uint16_t value, uint16_t index,
+		       uint8_t *data, uint16_t length);
+	int (*bulk_out)(uint8_t endpoint, const uint8_t *data, int length);
+	int (*bulk_in)(uint8_t endpoint, uint8_t *data, int length);
+};
+
+extern const struct usb_emu_model usb_emu_ch341a;
+extern const struct usb_emu_model usb_emu_dediprog;
+extern const struct usb_emu_model usb_emu_ft2232;
+
+/* usb_emulator.c */
+const char *usb_emu_option(const char *name);
+int usb_emu_verbose(void);
+
+/* spi_flash.c */
+int emu_flash_init(const char *chip, const char *image);
+int emu_flash_save(void);
+void emu_flash_select(bool selected);
+uint8_t emu_flash_xfer(uint8_t out);
+
+#endif				/* !__USB_EMULATOR_H__ */